@@ -42,6 +42,7 @@ int compile(regex_t *, const chr *, size_t, int);
 static void moresubs(struct vars *, size_t);
 static int freev(struct vars *, int);
 static void makesearch(struct vars *, struct nfa *);
+static void findprefix(struct guts *, const chr *, size_t);
 static struct subre *parse(struct vars *, int, int, struct state *, struct state *);
 static struct subre *parsebranch(struct vars *, int, int, struct state *, struct state *, int);
 static void parseqatom(struct vars *, int, int, struct state *, struct state *, struct subre *);
@@ -355,6 +356,9 @@ compile(
     v->cm = &g->cmap;
     g->lacons = NULL;
     g->nlacons = 0;
+    g->prefix = NULL;
+    g->nprefix = 0;
+    g->prefixflags = 0;
     ZAPCNFA(g->search);
     v->nfa = newnfa(v, v->cm, NULL);
     CNOERR();
@@ -455,6 +459,7 @@ compile(
     g->lacons = v->lacons;
     v->lacons = NULL;
     g->nlacons = v->nlacons;
+    findprefix(g, string, len);
 
     if (flags&REG_DUMP) {
 	dump(re, stdout);
@@ -543,6 +548,129 @@ freev(
     return ret;
 }
 
+/*
+ - regprefix - report the literal that every match of an RE begins with
+ * Returns REG_NOMATCH if there is no such literal.
+ ^ int regprefix(regex_t *, const chr **, size_t *, int *);
+ */
+int
+regprefix(
+    regex_t *re,
+    const chr **prefixp,	/* the literal; owned by re */
+    size_t *lenp,		/* its length */
+    int *flagsp)		/* REG_PREFIX_* flags */
+{
+    struct guts *g;
+
+    if (re == NULL || re->re_magic != REMAGIC) {
+	return REG_INVARG;
+    }
+    g = (struct guts *) re->re_guts;
+    if (g->prefix == NULL) {
+	return REG_NOMATCH;
+    }
+    *prefixp = g->prefix;
+    *lenp = g->nprefix;
+    *flagsp = g->prefixflags;
+    return REG_OKAY;
+}
+
+/*
+ - findprefix - find the literal that every match must begin with
+ * The compacted NFA of the whole RE is walked from its initial state for as
+ * long as each state has exactly one way out, on a color holding a single
+ * chr.  That chr is recovered by looking it up in the RE source; one that
+ * was only written as an escape just ends the prefix early.
+ ^ static void findprefix(struct guts *, const chr *, size_t);
+ */
+static void
+findprefix(
+    struct guts *g,
+    const chr *string,		/* RE source */
+    size_t len)
+{
+    struct cnfa *cnfa = &g->tree->cnfa;
+    struct colormap *cm = &g->cmap;
+    struct colordesc *cd;
+    struct carc *ca;
+    size_t st, n, i;
+    size_t nextst = (size_t) -1;
+    int anchored = 1;
+    int ncontext = 0;
+    int nreal = 0;
+    color prevco = COLORLESS;
+    chr *prefix;
+
+    if (NULLCNFA(*cnfa)) {
+	return;
+    }
+
+    /*
+     * The arcs out of the pre state consume the chr (or BOS/BOL) in front
+     * of the match.  They must all agree on where the match proper starts.
+     * If they are only BOS/BOL arcs the RE is anchored; if they cover every
+     * real color, the chr in front of the match does not matter.
+     */
+
+    for (ca = cnfa->states[cnfa->pre]; ca->co != COLORLESS; ca++) {
+	if (nextst == (size_t) -1) {
+	    nextst = ca->to;
+	} else if (ca->to != nextst) {
+	    return;
+	}
+	if (ca->co == cnfa->bos[0] || ca->co == cnfa->bos[1]) {
+	    continue;
+	}
+	anchored = 0;
+	if (ca->co != prevco) {
+	    ncontext++;
+	    prevco = ca->co;
+	}
+    }
+    if (nextst == (size_t) -1) {
+	return;
+    }
+    for (cd = cm->cd; cd < CDEND(cm); cd++) {
+	if (!UNUSEDCOLOR(cd) && !(cd->flags&PSEUDO)) {
+	    nreal++;
+	}
+    }
+
+    prefix = (chr *) MALLOC(cnfa->nstates * sizeof(chr));
+    if (prefix == NULL) {
+	return;
+    }
+    n = 0;
+    for (st = nextst; n < cnfa->nstates; st = ca->to) {
+	ca = cnfa->states[st];
+	if (ca[0].co == COLORLESS || ca[1].co != COLORLESS
+		|| ca->co >= cnfa->ncolors) {
+	    break;		/* not a single plain arc */
+	}
+	cd = &cm->cd[ca->co];
+	if (cd->nchrs != 1 || (cd->flags&PSEUDO)) {
+	    break;
+	}
+	for (i = 0; i < len; i++) {
+	    if (GETCOLOR(cm, string[i]) == ca->co) {
+		break;
+	    }
+	}
+	if (i == len) {
+	    break;
+	}
+	prefix[n++] = string[i];
+    }
+    if (n == 0) {
+	FREE(prefix);
+	return;
+    }
+    g->prefix = prefix;
+    g->nprefix = n;
+    g->prefixflags = (anchored ? REG_PREFIX_BOS : 0)
+	    | (!anchored && ncontext == nreal ? REG_PREFIX_NOCONTEXT : 0);
+}
+
 /*
  - makesearch - turn an NFA into a search NFA (implicit prepend of .*?)
  * NFA must have been optimize()d already.
@@ -2032,6 +2160,9 @@ rfree(
 	if (!NULLCNFA(g->search)) {
 	    freecnfa(&g->search);
 	}
+	if (g->prefix != NULL) {
+	    FREE(g->prefix);
+	}
 	FREE(g);
     }
 }
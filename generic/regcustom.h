@@ -70,14 +70,20 @@
 #define	__REG_NOFRONT		/* Don't want regcomp() and regexec() */
 #define	__REG_NOCHAR		/* Or the char versions */
 #define	regfree		TclReFree
+#define	regprefix	TclRePrefix
 #define	regerror	TclReError
 /* --- end --- */
 
 /*
- * Internal character type and related.
+ * Internal character type and related. Defining REG_BYTES builds the matcher
+ * over bytes that are chrs themselves, as in byte arrays and ASCII strings.
  */
 
+#ifdef REG_BYTES
+typedef unsigned char chr;	/* The type itself. */
+#else
 typedef Tcl_UniChar chr;	/* The type itself. */
+#endif
 typedef int pchr;		/* What it promotes to. */
 typedef unsigned uchr;		/* Unsigned type that will hold a chr. */
 typedef int celt;		/* Type to hold chr, or NOCELT */
@@ -108,7 +114,11 @@ typedef int celt;		/* Type to hold chr, or NOCELT */
  */
 
 #define	compile		TclReComp
+#ifdef REG_BYTES
+#define	exec		TclReExecBytes
+#else
 #define	exec		TclReExec
+#endif
 
 /*
 & Enable/disable debugging code (by whether REG_DEBUG is defined or not).
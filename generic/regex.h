@@ -103,6 +103,7 @@ extern "C" {
 #define	__REG_NOFRONT		/* don't want regcomp() and regexec() */
 #define	__REG_NOCHAR		/* or the char versions */
 #define	regfree		TclReFree
+#define	regprefix	TclRePrefix
 #define	regerror	TclReError
 /* --- end --- */
 
@@ -202,6 +203,12 @@ typedef struct {
 #define	REG_MTRACE	0020	/* none of your business */
 #define	REG_SMALL	0040	/* none of your business */
 
+/*
+ * regprefix() flags
+ */
+#define	REG_PREFIX_BOS		0001	/* match can only begin at BOS */
+#define	REG_PREFIX_NOCONTEXT	0002	/* chr before match is never looked at */
+
 /*
  * misc generics (may be more functions here eventually)
  ^ void regfree(regex_t *);
@@ -265,8 +272,10 @@ int regexec(regex_t *, const char *, size_t, regmatch_t [], int);
 #endif
 #ifdef __REG_WIDE_T
 MODULE_SCOPE int __REG_WIDE_EXEC(regex_t *, const __REG_WIDE_T *, size_t, rm_detail_t *, size_t, regmatch_t [], int);
+MODULE_SCOPE int TclReExecBytes(regex_t *, const unsigned char *, size_t, rm_detail_t *, size_t, regmatch_t [], int);
 #endif
 MODULE_SCOPE void regfree(regex_t *);
+MODULE_SCOPE int regprefix(regex_t *, const __REG_WIDE_T **, size_t *, int *);
 MODULE_SCOPE size_t regerror(int, char *, size_t);
 /* automatically gathered by fwd; do not hand-edit */
 /* =====^!^===== end forwards =====^!^===== */
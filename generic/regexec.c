@@ -201,6 +201,12 @@ exec(
 	FreeVars(v);
 	return REG_NOMATCH;
     }
+#ifdef REG_BYTES
+    if (v->g->info&REG_UBACKREF) {
+	FreeVars(v);
+	return REG_INVARG;	/* g->compare works on Tcl_UniChar */
+    }
+#endif
     backref = (v->g->info&REG_UBACKREF) ? 1 : 0;
     v->eflags = flags;
     if (v->g->cflags&REG_NOSUB) {
@@ -0,0 +1,21 @@
+/*
+ * regexecb.c --
+ *
+ *	Builds the matcher of regexec.c a second time, as TclReExecBytes, over
+ *	strings of bytes in which every byte is one character. Byte arrays and
+ *	ASCII strings can then be matched without a Tcl_UniChar copy.
+ *
+ * See the file "license.terms" for information on usage and redistribution of
+ * this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ */
+
+#define REG_BYTES
+#include "regexec.c"
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 4
+ * fill-column: 78
+ * End:
+ */
@@ -401,6 +401,9 @@ struct guts {
     int (*compare) (const chr *, const chr *, size_t);
     struct subre *lacons;	/* lookahead-constraint vector */
     size_t nlacons;		/* size of lacons */
+    chr *prefix;		/* literal every match begins with, or NULL */
+    size_t nprefix;		/* length of prefix */
+    int prefixflags;		/* REG_PREFIX_* flags for prefix */
 };
 
 /*
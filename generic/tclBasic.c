@@ -422,6 +422,13 @@ static const UnsafeEnsembleInfo unsafeEnsembleCommands[] = {
     {"process", "status"},
     {"process", "purge"},
     {"process", "autopurge"},
+    /* [tcl::unsupported] commands that change process- or thread-wide
+     * state */
+    {"unsupported", "bytecodecache"},
+    {"unsupported", "execstats"},
+    {"unsupported", "profile"},
+    {"unsupported", "regexpcache"},
+    {"unsupported", "sharedbytecode"},
     /* [zipfs] has MANY unsafe commands! */
     {"zipfs", "lmkimg"},
     {"zipfs", "lmkzip"},
@@ -443,46 +450,55 @@ typedef struct {
 				 * "::tcl::mathfunc::<name>". */
     Tcl_ObjCmdProc *objCmdProc;	/* Function that evaluates the function */
     double (*fn)(double x);	/* Real function pointer */
+    CompileProc *compileProc;	/* Checks the argument count of a direct
+				 * invocation. Non-NULL also marks the
+				 * function as pure, so that calls with
+				 * literal arguments may be folded by the
+				 * expression compiler. */
 } BuiltinFuncDef;
 static const BuiltinFuncDef BuiltinFuncTable[] = {
-    { "abs",	ExprAbsFunc,	NULL			},
-    { "acos",	ExprUnaryFunc,	acos			},
-    { "asin",	ExprUnaryFunc,	asin			},
-    { "atan",	ExprUnaryFunc,	atan			},
-    { "atan2",	ExprBinaryFunc,	(double (*)(double))(void *)(double (*)(double, double)) atan2},
-    { "bool",	ExprBoolFunc,	NULL			},
-    { "ceil",	ExprCeilFunc,	NULL			},
-    { "cos",	ExprUnaryFunc,	cos				},
-    { "cosh",	ExprUnaryFunc,	cosh			},
-    { "double",	ExprDoubleFunc,	NULL			},
-    { "entier",	ExprIntFunc,	NULL			},
-    { "exp",	ExprUnaryFunc,	exp				},
-    { "floor",	ExprFloorFunc,	NULL			},
-    { "fmod",	ExprBinaryFunc,	(double (*)(double))(void *)(double (*)(double, double)) fmod},
-    { "hypot",	ExprBinaryFunc,	(double (*)(double))(void *)(double (*)(double, double)) hypot},
-    { "int",	ExprIntFunc,	NULL			},
-    { "isfinite", ExprIsFiniteFunc, NULL        	},
-    { "isinf",	ExprIsInfinityFunc, NULL        	},
-    { "isnan",	ExprIsNaNFunc,	NULL            	},
-    { "isnormal", ExprIsNormalFunc, NULL        	},
-    { "isqrt",	ExprIsqrtFunc,	NULL			},
-    { "issubnormal", ExprIsSubnormalFunc, NULL,         },
-    { "isunordered", ExprIsUnorderedFunc, NULL,         },
-    { "log",	ExprUnaryFunc,	log				},
-    { "log10",	ExprUnaryFunc,	log10			},
-    { "max",	ExprMaxFunc,	NULL			},
-    { "min",	ExprMinFunc,	NULL			},
-    { "pow",	ExprBinaryFunc,	(double (*)(double))(void *)(double (*)(double, double)) pow},
-    { "rand",	ExprRandFunc,	NULL			},
-    { "round",	ExprRoundFunc,	NULL			},
-    { "sin",	ExprUnaryFunc,	sin				},
-    { "sinh",	ExprUnaryFunc,	sinh			},
-    { "sqrt",	ExprSqrtFunc,	NULL			},
-    { "srand",	ExprSrandFunc,	NULL			},
-    { "tan",	ExprUnaryFunc,	tan				},
-    { "tanh",	ExprUnaryFunc,	tanh			},
-    { "wide",	ExprWideFunc,	NULL			},
-    { NULL, NULL, NULL }
+    { "abs",	ExprAbsFunc,	NULL,	TclCompileBasic1ArgCmd},
+    { "acos",	ExprUnaryFunc,	acos,	TclCompileBasic1ArgCmd},
+    { "asin",	ExprUnaryFunc,	asin,	TclCompileBasic1ArgCmd},
+    { "atan",	ExprUnaryFunc,	atan,	TclCompileBasic1ArgCmd},
+    { "atan2",	ExprBinaryFunc,	(double (*)(double))(void *)(double (*)(double, double)) atan2,
+	    TclCompileBasic2ArgCmd},
+    { "bool",	ExprBoolFunc,	NULL,	TclCompileBasic1ArgCmd},
+    { "ceil",	ExprCeilFunc,	NULL,	TclCompileBasic1ArgCmd},
+    { "cos",	ExprUnaryFunc,	cos,	TclCompileBasic1ArgCmd},
+    { "cosh",	ExprUnaryFunc,	cosh,	TclCompileBasic1ArgCmd},
+    { "double",	ExprDoubleFunc,	NULL,	TclCompileBasic1ArgCmd},
+    { "entier",	ExprIntFunc,	NULL,	TclCompileBasic1ArgCmd},
+    { "exp",	ExprUnaryFunc,	exp,	TclCompileBasic1ArgCmd},
+    { "floor",	ExprFloorFunc,	NULL,	TclCompileBasic1ArgCmd},
+    { "fmod",	ExprBinaryFunc,	(double (*)(double))(void *)(double (*)(double, double)) fmod,
+	    TclCompileBasic2ArgCmd},
+    { "hypot",	ExprBinaryFunc,	(double (*)(double))(void *)(double (*)(double, double)) hypot,
+	    TclCompileBasic2ArgCmd},
+    { "int",	ExprIntFunc,	NULL,	TclCompileBasic1ArgCmd},
+    { "isfinite", ExprIsFiniteFunc, NULL,	TclCompileBasic1ArgCmd},
+    { "isinf", ExprIsInfinityFunc, NULL,	TclCompileBasic1ArgCmd},
+    { "isnan", ExprIsNaNFunc, NULL,	TclCompileBasic1ArgCmd},
+    { "isnormal", ExprIsNormalFunc, NULL,	TclCompileBasic1ArgCmd},
+    { "isqrt",	ExprIsqrtFunc,	NULL,	TclCompileBasic1ArgCmd},
+    { "issubnormal", ExprIsSubnormalFunc, NULL,	TclCompileBasic1ArgCmd},
+    { "isunordered", ExprIsUnorderedFunc, NULL,	TclCompileBasic2ArgCmd},
+    { "log",	ExprUnaryFunc,	log,	TclCompileBasic1ArgCmd},
+    { "log10",	ExprUnaryFunc,	log10,	TclCompileBasic1ArgCmd},
+    { "max",	ExprMaxFunc,	NULL,	TclCompileBasicMin1ArgCmd},
+    { "min",	ExprMinFunc,	NULL,	TclCompileBasicMin1ArgCmd},
+    { "pow",	ExprBinaryFunc,	(double (*)(double))(void *)(double (*)(double, double)) pow,
+	    TclCompileBasic2ArgCmd},
+    { "rand",	ExprRandFunc,	NULL,	NULL},
+    { "round",	ExprRoundFunc,	NULL,	TclCompileBasic1ArgCmd},
+    { "sin",	ExprUnaryFunc,	sin,	TclCompileBasic1ArgCmd},
+    { "sinh",	ExprUnaryFunc,	sinh,	TclCompileBasic1ArgCmd},
+    { "sqrt",	ExprSqrtFunc,	NULL,	TclCompileBasic1ArgCmd},
+    { "srand",	ExprSrandFunc,	NULL,	NULL},
+    { "tan",	ExprUnaryFunc,	tan,	TclCompileBasic1ArgCmd},
+    { "tanh",	ExprUnaryFunc,	tanh,	TclCompileBasic1ArgCmd},
+    { "wide",	ExprWideFunc,	NULL,	TclCompileBasic1ArgCmd},
+    { NULL, NULL, NULL, NULL }
 };
 
 /*
@@ -844,6 +860,7 @@ Tcl_CreateInterp(void)
     iPtr->errorStack = Tcl_NewListObj(0, NULL);
     Tcl_IncrRefCount(iPtr->errorStack);
     iPtr->resetErrorStack = 1;
+    iPtr->execStatsPtr = NULL;
     TclNewLiteralStringObj(iPtr->upLiteral,"UP");
     Tcl_IncrRefCount(iPtr->upLiteral);
     TclNewLiteralStringObj(iPtr->callLiteral,"CALL");
@@ -903,6 +920,9 @@ Tcl_CreateInterp(void)
         iPtr->flags |= INTERP_DEBUG_FRAME;
     }
 #endif
+    if (getenv("TCL_INLINE_PROCS") != NULL) {
+	iPtr->flags |= INLINE_PROCS;
+    }
 
     /*
      * Initialise the tables for variable traces and searches *before*
@@ -1121,6 +1141,18 @@ Tcl_CreateInterp(void)
 	    Tcl_DisassembleObjCmd, INT2PTR(1), NULL);
     Tcl_CreateObjCommand(interp, "::tcl::unsupported::representation",
 	    Tcl_RepresentationCmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::tcl::unsupported::bytecodecache",
+	    Tcl_ByteCodeCacheObjCmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::tcl::unsupported::sharedbytecode",
+	    Tcl_SharedByteCodeObjCmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::tcl::unsupported::inlineprocs",
+	    Tcl_InlineProcsObjCmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::tcl::unsupported::profile",
+	    Tcl_ProfileObjCmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::tcl::unsupported::execstats",
+	    Tcl_ExecStatsObjCmd, NULL, NULL);
+    Tcl_CreateObjCommand(interp, "::tcl::unsupported::regexpcache",
+	    Tcl_RegexpCacheObjCmd, NULL, NULL);
 
     /* Adding the bytecode assembler command */
     cmdPtr = (Command *) Tcl_NRCreateCommand(interp,
@@ -1162,8 +1194,9 @@ Tcl_CreateInterp(void)
     for (builtinFuncPtr = BuiltinFuncTable; builtinFuncPtr->name != NULL;
 	    builtinFuncPtr++) {
 	strcpy(mathFuncName+MATH_FUNC_PREFIX_LEN, builtinFuncPtr->name);
-	Tcl_CreateObjCommand(interp, mathFuncName,
+	cmdPtr = (Command *) Tcl_CreateObjCommand(interp, mathFuncName,
 		builtinFuncPtr->objCmdProc, (void *)builtinFuncPtr->fn, NULL);
+	cmdPtr->compileProc = builtinFuncPtr->compileProc;
 	Tcl_Export(interp, nsPtr, builtinFuncPtr->name, 0);
     }
 
@@ -4578,6 +4611,10 @@ EvalObjvCore(
 		    commandPtr, cmdPtr, objv);
     }
 
+    if (iPtr->execStatsPtr) {
+	TclCountCommand(iPtr, cmdPtr);
+    }
+
     TclNRAddCallback(interp, Dispatch,
 	    cmdPtr->nreProc ? cmdPtr->nreProc : cmdPtr->objProc,
 	    cmdPtr->objClientData, INT2PTR(objc), objv);
@@ -7012,6 +7049,74 @@ Tcl_GetVersion(
     }
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclIsPureMathFunc --
+ *
+ *	Determines whether the math function with the given name, as it
+ *	would be resolved from the current namespace, is one of the builtin
+ *	functions whose result depends only on its arguments.
+ *
+ * Results:
+ *	Returns 1 if calls to the function with literal arguments may be
+ *	evaluated once at compile time, and 0 otherwise.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclIsPureMathFunc(
+    Tcl_Interp *interp,		/* Interpreter in which to resolve the
+				 * function. */
+    Tcl_Obj *namePtr)		/* Name of the function, without the
+				 * "tcl::mathfunc::" prefix. */
+{
+    const BuiltinFuncDef *builtinFuncPtr;
+    const char *name = TclGetString(namePtr);
+    Command *cmdPtr;
+    Tcl_DString cmdName;
+
+    /*
+     * Interpreter-wide execution traces must see every call.
+     */
+
+    if (((Interp *) interp)->flags & DONT_COMPILE_CMDS_INLINE) {
+	return 0;
+    }
+    for (builtinFuncPtr = BuiltinFuncTable; builtinFuncPtr->name != NULL;
+	    builtinFuncPtr++) {
+	if (strcmp(name, builtinFuncPtr->name) == 0) {
+	    break;
+	}
+    }
+    if (builtinFuncPtr->compileProc == NULL) {
+	return 0;
+    }
+
+    /*
+     * The function must not have been redefined, shadowed or traced. Each
+     * of those bumps an epoch because the command has a compileProc, so code
+     * folded under the original definition is recompiled.
+     */
+
+    Tcl_DStringInit(&cmdName);
+    TclDStringAppendLiteral(&cmdName, "tcl::mathfunc::");
+    Tcl_DStringAppend(&cmdName, name, namePtr->length);
+    cmdPtr = (Command *) Tcl_FindCommand(interp, Tcl_DStringValue(&cmdName),
+	    NULL, 0);
+    Tcl_DStringFree(&cmdName);
+
+    return (cmdPtr != NULL)
+	    && (cmdPtr->objProc == builtinFuncPtr->objCmdProc)
+	    && (cmdPtr->objClientData == (void *) builtinFuncPtr->fn)
+	    && (cmdPtr->compileProc == builtinFuncPtr->compileProc)
+	    && !(cmdPtr->flags & CMD_HAS_EXEC_TRACES);
+}
+
 /*
  *----------------------------------------------------------------------
  *
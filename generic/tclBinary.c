@@ -13,6 +13,7 @@
 
 #include "tclInt.h"
 #include "tclTomMath.h"
+#include "tclPackedList.h"
 
 #include <math.h>
 #include <assert.h>
@@ -1616,12 +1617,21 @@ BinaryScanCmd(
 		if ((length - offset) < (count * size)) {
 		    goto done;
 		}
+		/*
+		 * The numbers are collected into a packed list as long as
+		 * they fit in one.
+		 */
+
 		TclNewObj(valuePtr);
 		src = buffer + offset;
 		for (i = 0; i < count; i++) {
 		    elementPtr = ScanNumber(src, cmd, flags, &numberCachePtr);
 		    src += size;
-		    Tcl_ListObjAppendElement(NULL, valuePtr, elementPtr);
+		    Tcl_IncrRefCount(elementPtr);
+		    if (!TclPackedListObjAppend(valuePtr, 1, &elementPtr)) {
+			Tcl_ListObjAppendElement(NULL, valuePtr, elementPtr);
+		    }
+		    Tcl_DecrRefCount(elementPtr);
 		}
 		offset += count * size;
 	    }
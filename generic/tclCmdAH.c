@@ -18,6 +18,8 @@
 #   include "tclWinInt.h"
 #endif
 #include "tclArithSeries.h"
+#include "tclPackedList.h"
+#include "tclListView.h"
 
 /*
  * The state structure used by [foreach]. Note that the actual structure has
@@ -2814,8 +2816,10 @@ EachloopCmd(
 	    &statePtr->varcList[i], &statePtr->varvList[i]);
 
 	/* Values */
-	if (TclHasInternalRep(objv[2+i*2],&tclArithSeriesType.objType)) {
-	    /* Special case for Arith Series */
+	if (TclHasInternalRep(objv[2+i*2],&tclArithSeriesType.objType)
+		|| TclHasInternalRep(objv[2+i*2],&tclPackedListType.objType)
+		|| TclHasInternalRep(objv[2+i*2],&tclListViewType.objType)) {
+	    /* Special case for Arith Series, packed lists and list views */
 	    statePtr->aCopyList[i] = Tcl_DuplicateObj(objv[2+i*2]);
 	    if (statePtr->aCopyList[i] == NULL) {
 		result = TCL_ERROR;
@@ -2897,8 +2901,13 @@ ForeachLoopStep(
 	break;
     case TCL_OK:
 	if (statePtr->resultList != NULL) {
+	    Tcl_Obj *resultObj = Tcl_GetObjResult(interp);
+
+	    if (TclPackedListObjAppend(statePtr->resultList, 1, &resultObj)) {
+		break;
+	    }
 	    result = Tcl_ListObjAppendElement(
-		interp, statePtr->resultList, Tcl_GetObjResult(interp));
+		interp, statePtr->resultList, resultObj);
 	    if (result != TCL_OK) {
 		/* e.g. memory alloc failure on big data tests */
 		goto done;
@@ -2965,10 +2974,16 @@ ForeachAssignments(
 
     for (i=0 ; i<statePtr->numLists ; i++) {
 	int isarithseries = TclHasInternalRep(statePtr->aCopyList[i],&tclArithSeriesType.objType);
+	int ispacked = TclHasInternalRep(statePtr->aCopyList[i],&tclPackedListType.objType);
+	int isview = TclHasInternalRep(statePtr->aCopyList[i],&tclListViewType.objType);
 	for (v=0 ; v<statePtr->varcList[i] ; v++) {
 	    k = statePtr->index[i]++;
 	    if (k < statePtr->argcList[i]) {
-		if (isarithseries) {
+		if (ispacked) {
+		    valuePtr = TclPackedListObjIndex(statePtr->aCopyList[i], k);
+		} else if (isview) {
+		    valuePtr = TclListViewObjIndex(statePtr->aCopyList[i], k);
+		} else if (isarithseries) {
 		    valuePtr = TclArithSeriesObjIndex(interp, statePtr->aCopyList[i], k);
 		    if (valuePtr == NULL) {
 			Tcl_AppendObjToErrorInfo(interp, Tcl_ObjPrintf(
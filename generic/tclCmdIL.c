@@ -20,6 +20,8 @@
 #include "tclInt.h"
 #include "tclRegexp.h"
 #include "tclArithSeries.h"
+#include "tclPackedList.h"
+#include "tclListView.h"
 #include "tclTomMath.h"
 #include <math.h>
 #include <assert.h>
@@ -144,6 +146,9 @@ static Tcl_ObjCmdProc	InfoCmdTypeCmd;
 static Tcl_ObjCmdProc	InfoTclVersionCmd;
 static SortElement *	MergeLists(SortElement *leftPtr, SortElement *rightPtr,
 			    SortInfo *infoPtr);
+static int		RadixSortElements(SortInfo *infoPtr,
+			    SortElement *elementArray,
+			    SortElement **headPtrPtr);
 static int		SortCompare(SortElement *firstPtr, SortElement *second,
 			    SortInfo *infoPtr);
 static Tcl_Obj *	SelectObjFromSublist(Tcl_Obj *firstPtr,
@@ -2796,6 +2801,10 @@ Tcl_LrangeObjCmd(
 	} else {
 	    return TCL_ERROR;
 	}
+    } else if (TclHasInternalRep(objv[1], &tclPackedListType.objType)) {
+	Tcl_SetObjResult(interp, TclPackedListObjRange(objv[1], first, last));
+    } else if (TclHasInternalRep(objv[1], &tclListViewType.objType)) {
+	Tcl_SetObjResult(interp, TclListViewObjRange(objv[1], first, last));
     } else {
 	Tcl_Obj *resultObj = TclListObjRange(interp, objv[1], first, last);
 	if (resultObj == NULL) {
@@ -3021,6 +3030,33 @@ Tcl_LrepeatObjCmd(
     }
     totalElems = objc * elementCount;
 
+    /*
+     * Repeated numbers, as used to initialise a numeric array, are stored
+     * packed when they are all integers or all doubles.
+     */
+
+    if (totalElems) {
+	PackedValue *values;
+	Tcl_Obj *unitObj = TclNewPackedListFromObjv(objc, objv);
+
+	if (unitObj != NULL) {
+	    PackedValue *unitValues;
+	    int isDouble;
+	    Tcl_Size unitLength;
+
+	    TclGetPackedListValues(unitObj, &isDouble, &unitLength,
+		    &unitValues);
+	    listPtr = TclNewPackedListObj(isDouble, totalElems, &values);
+	    for (i=0 ; i<elementCount ; i++) {
+		memcpy(values + i * objc, unitValues,
+			objc * sizeof(PackedValue));
+	    }
+	    Tcl_DecrRefCount(unitObj);
+	    Tcl_SetObjResult(interp, listPtr);
+	    return TCL_OK;
+	}
+    }
+
     /*
      * Get an empty list object that is allocated large enough to hold each
      * init value elementCount times.
@@ -3221,6 +3257,15 @@ Tcl_LreverseObjCmd(
 	}
     } /* end ArithSeries */
 
+    if (TclHasInternalRep(objv[1], &tclPackedListType.objType)) {
+	Tcl_SetObjResult(interp, TclPackedListObjReverse(objv[1]));
+	return TCL_OK;
+    }
+    if (TclHasInternalRep(objv[1], &tclListViewType.objType)) {
+	Tcl_SetObjResult(interp, TclListViewObjReverse(objv[1]));
+	return TCL_OK;
+    }
+
     /* True List */
     if (TclListObjLengthM(interp, objv[1], &elemc) != TCL_OK) {
 	return TCL_ERROR;
@@ -3238,7 +3283,16 @@ Tcl_LreverseObjCmd(
 	return TCL_ERROR;
     }
 
-    if (Tcl_IsShared(objv[1])
+    if (elemc >= LIST_VIEW_MIN_LENGTH && (Tcl_IsShared(objv[1])
+	    || ListObjRepIsShared(objv[1]))) {
+	/*
+	 * A large list that cannot be reversed in place is viewed backwards
+	 * rather than copied.
+	 */
+
+	Tcl_SetObjResult(interp,
+		TclNewListViewObj(objv[1], elemc - 1, -1, elemc));
+    } else if (Tcl_IsShared(objv[1])
 	|| ListObjRepIsShared(objv[1])) { /* Bug 1675044 */
 	Tcl_Obj *resultObj, **dataArray;
 	ListRep listRep;
@@ -3268,6 +3322,7 @@ Tcl_LreverseObjCmd(
 	 * returning a pointer to the live array of Tcl_Obj values.
 	 */
 
+	ListObjResetIndex(objv[1]);
 	for (i=0,j=elemc-1 ; i<j ; i++,j--) {
 	    Tcl_Obj *tmp = elemv[i];
 
@@ -3315,6 +3370,8 @@ Tcl_LsearchObjCmd(
     double patDouble, objDouble;
     SortInfo sortInfo;
     Tcl_Obj *patObj, **listv, *listPtr, *startPtr, *itemPtr;
+    PackedValue *packedValues = NULL;
+    int packedIsDouble = 0;
     SortStrCmpFn_t strCmpFn = TclUtfCmp;
     Tcl_RegExp regexp = NULL;
     static const char *const options[] = {
@@ -3608,13 +3665,28 @@ Tcl_LsearchObjCmd(
     }
 
     /*
-     * Make sure the list argument is a list object and get its length and a
+     * A packed list searched for a number as a whole is searched on its
+     * unboxed values, and only the elements returned are boxed. Otherwise,
+     * make sure the list argument is a list object and get its length and a
      * pointer to its array of element pointers.
      */
 
-    result = TclListObjGetElementsM(interp, objv[objc - 2], &listc, &listv);
-    if (result != TCL_OK) {
-	goto done;
+    listv = NULL;
+    if ((mode == EXACT || mode == SORTED) && dataType != ASCII
+	    && dataType != DICTIONARY && groupSize == 1
+	    && sortInfo.indexc == 0 && objv[objc - 1] != objv[objc - 2]
+	    && startPtr != objv[objc - 2]
+	    && TclGetPackedListValues(objv[objc - 2], &packedIsDouble, &listc,
+		    &packedValues)
+	    && dataType == INTEGER && packedIsDouble) {
+	packedValues = NULL;
+    }
+    if (packedValues == NULL) {
+	result = TclListObjGetElementsM(interp, objv[objc - 2], &listc,
+		&listv);
+	if (result != TCL_OK) {
+	    goto done;
+	}
     }
 
     /*
@@ -3717,7 +3789,9 @@ Tcl_LsearchObjCmd(
 	     * 1844789]
 	     */
 
-	    TclListObjGetElementsM(NULL, objv[objc - 2], &listc, &listv);
+	    if (packedValues == NULL) {
+		TclListObjGetElementsM(NULL, objv[objc - 2], &listc, &listv);
+	    }
 	    break;
 	case REAL:
 	    result = Tcl_GetDoubleFromObj(interp, patObj, &patDouble);
@@ -3730,7 +3804,9 @@ Tcl_LsearchObjCmd(
 	     * 1844789]
 	     */
 
-	    TclListObjGetElementsM(NULL, objv[objc - 2], &listc, &listv);
+	    if (packedValues == NULL) {
+		TclListObjGetElementsM(NULL, objv[objc - 2], &listc, &listv);
+	    }
 	    break;
 	}
     } else {
@@ -3768,6 +3844,8 @@ Tcl_LsearchObjCmd(
 		    result = sortInfo.resultCode;
 		    goto done;
 		}
+	    } else if (packedValues != NULL) {
+		itemPtr = NULL;
 	    } else {
 		itemPtr = listv[i+groupOffset];
 	    }
@@ -3781,8 +3859,11 @@ Tcl_LsearchObjCmd(
 		match = DictionaryCompare(patternBytes, bytes);
 		break;
 	    case INTEGER:
-		result = TclGetWideIntFromObj(interp, itemPtr, &objWide);
-		if (result != TCL_OK) {
+		if (packedValues != NULL) {
+		    objWide = packedValues[i].wideValue;
+		} else if (TclGetWideIntFromObj(interp, itemPtr,
+			&objWide) != TCL_OK) {
+		    result = TCL_ERROR;
 		    goto done;
 		}
 		if (patWide == objWide) {
@@ -3794,8 +3875,12 @@ Tcl_LsearchObjCmd(
 		}
 		break;
 	    case REAL:
-		result = Tcl_GetDoubleFromObj(interp, itemPtr, &objDouble);
-		if (result != TCL_OK) {
+		if (packedValues != NULL) {
+		    objDouble = packedIsDouble ? packedValues[i].doubleValue
+			    : (double) packedValues[i].wideValue;
+		} else if (Tcl_GetDoubleFromObj(interp, itemPtr,
+			&objDouble) != TCL_OK) {
+		    result = TCL_ERROR;
 		    goto done;
 		}
 		if (patDouble == objDouble) {
@@ -3858,6 +3943,26 @@ Tcl_LsearchObjCmd(
 	if (allMatches) {
 	    listPtr = Tcl_NewListObj(0, NULL);
 	}
+
+	/*
+	 * A plain exact string search of a list searched repeatedly is
+	 * answered from the search index of the list.
+	 */
+
+	if (mode == EXACT && dataType == ASCII && !noCase && !negatedMatch
+		&& groupSize == 1 && sortInfo.indexc == 0
+		&& TclListObjIndexedFind(objv[objc - 2], patObj, start, &i)) {
+	    for (; i >= 0; i = TclListObjIndexedNext(objv[objc - 2], i)) {
+		if (!allMatches) {
+		    index = i;
+		    break;
+		}
+		Tcl_ListObjAppendElement(interp, listPtr,
+			inlineReturn ? listv[i] : Tcl_NewWideIntObj(i));
+	    }
+	    goto searchDone;
+	}
+
 	for (i = start; i < listc; i += groupSize) {
 	    match = 0;
 	    if (sortInfo.indexc != 0) {
@@ -3869,6 +3974,8 @@ Tcl_LsearchObjCmd(
 		    result = sortInfo.resultCode;
 		    goto done;
 		}
+	    } else if (packedValues != NULL) {
+		itemPtr = NULL;
 	    } else {
 		itemPtr = listv[i+groupOffset];
 	    }
@@ -3899,22 +4006,30 @@ Tcl_LsearchObjCmd(
 		    break;
 
 		case INTEGER:
-		    result = TclGetWideIntFromObj(interp, itemPtr, &objWide);
-		    if (result != TCL_OK) {
+		    if (packedValues != NULL) {
+			objWide = packedValues[i].wideValue;
+		    } else if (TclGetWideIntFromObj(interp, itemPtr,
+			    &objWide) != TCL_OK) {
 			if (listPtr != NULL) {
 			    Tcl_DecrRefCount(listPtr);
 			}
+			result = TCL_ERROR;
 			goto done;
 		    }
 		    match = (objWide == patWide);
 		    break;
 
 		case REAL:
-		    result = Tcl_GetDoubleFromObj(interp,itemPtr, &objDouble);
-		    if (result != TCL_OK) {
+		    if (packedValues != NULL) {
+			objDouble = packedIsDouble
+				? packedValues[i].doubleValue
+				: (double) packedValues[i].wideValue;
+		    } else if (Tcl_GetDoubleFromObj(interp, itemPtr,
+			    &objDouble) != TCL_OK) {
 			if (listPtr) {
 			    Tcl_DecrRefCount(listPtr);
 			}
+			result = TCL_ERROR;
 			goto done;
 		    }
 		    match = (objDouble == patDouble);
@@ -3965,6 +4080,9 @@ Tcl_LsearchObjCmd(
 		} else if (groupSize > 1) {
 		    Tcl_ListObjReplace(interp, listPtr, LIST_MAX, 0,
 			    groupSize, &listv[i]);
+		} else if (packedValues != NULL) {
+		    Tcl_ListObjAppendElement(interp, listPtr,
+			    TclPackedListObjIndex(objv[objc - 2], i));
 		} else {
 		    itemPtr = listv[i];
 		    Tcl_ListObjAppendElement(interp, listPtr, itemPtr);
@@ -3990,6 +4108,7 @@ Tcl_LsearchObjCmd(
      * Return everything or a single value.
      */
 
+  searchDone:
     if (allMatches) {
 	Tcl_SetObjResult(interp, listPtr);
     } else if (!inlineReturn) {
@@ -4022,6 +4141,9 @@ Tcl_LsearchObjCmd(
 		    &sortInfo));
 	} else if (groupSize > 1) {
 	    Tcl_SetObjResult(interp, Tcl_NewListObj(groupSize, &listv[index]));
+	} else if (packedValues != NULL) {
+	    Tcl_SetObjResult(interp,
+		    TclPackedListObjIndex(objv[objc - 2], index));
 	} else {
 	    Tcl_SetObjResult(interp, listv[index]);
 	}
@@ -4796,6 +4918,26 @@ Tcl_LsortObjCmd(
 	sortInfo.compareCmdPtr = newCommandPtr;
     }
 
+    /*
+     * A packed list sorted numerically as a whole is sorted on its unboxed
+     * values.
+     */
+
+    if (TclHasInternalRep(listObj, &tclPackedListType.objType)
+	    && !group && sortInfo.indexc == 0) {
+	PackedValue *values;
+	int isDouble;
+
+	TclGetPackedListValues(listObj, &isDouble, &length, &values);
+	if ((sortInfo.sortMode == SORTMODE_INTEGER && !isDouble)
+		|| sortInfo.sortMode == SORTMODE_REAL) {
+	    Tcl_SetObjResult(interp, TclPackedListObjSort(listObj,
+		    sortInfo.sortMode == SORTMODE_REAL, sortInfo.isIncreasing,
+		    sortInfo.unique, indices));
+	    goto done;
+	}
+    }
+
     if (TclHasInternalRep(listObj,&tclArithSeriesType.objType)) {
 	sortInfo.resultCode = TclArithSeriesGetElements(interp,
 	    listObj, &length, &listObjPtrs);
@@ -4960,6 +5102,9 @@ Tcl_LsortObjCmd(
 	 */
 
 	elementArray[i].nextPtr = NULL;
+	if (sortMode == SORTMODE_INTEGER || sortMode == SORTMODE_REAL) {
+	    continue;
+	}
 	elementPtr = &elementArray[i];
 	for (j=0 ; subList[j] ; j++) {
 	    elementPtr = MergeLists(subList[j], elementPtr, &sortInfo);
@@ -4972,19 +5117,50 @@ Tcl_LsortObjCmd(
     }
 
     /*
-     * Merge all sublists
+     * Numeric keys are sorted by radix instead of merged. Should there be no
+     * memory for that, they are merged after all.
      */
 
-    elementPtr = subList[0];
-    for (j=1 ; j<NUM_LISTS ; j++) {
-	elementPtr = MergeLists(subList[j], elementPtr, &sortInfo);
+    if ((sortMode != SORTMODE_INTEGER && sortMode != SORTMODE_REAL)
+	    || !RadixSortElements(&sortInfo, elementArray, &elementPtr)) {
+	if (sortMode == SORTMODE_INTEGER || sortMode == SORTMODE_REAL) {
+	    for (i=0; i < length; i++) {
+		elementPtr = &elementArray[i];
+		for (j=0 ; subList[j] ; j++) {
+		    elementPtr = MergeLists(subList[j], elementPtr, &sortInfo);
+		    subList[j] = NULL;
+		}
+		if (j >= NUM_LISTS) {
+		    j = NUM_LISTS-1;
+		}
+		subList[j] = elementPtr;
+	    }
+	}
+
+	/*
+	 * Merge all sublists
+	 */
+
+	elementPtr = subList[0];
+	for (j=1 ; j<NUM_LISTS ; j++) {
+	    elementPtr = MergeLists(subList[j], elementPtr, &sortInfo);
+	}
     }
 
     /*
-     * Now store the sorted elements in the result list.
+     * Now store the sorted elements in the result list. Indices, and the
+     * result of an integer sort of plain numbers, are stored packed.
      */
 
-    if (sortInfo.resultCode == TCL_OK) {
+    if (sortInfo.resultCode == TCL_OK && indices && !group) {
+	PackedValue *values;
+
+	resultPtr = TclNewPackedListObj(0, sortInfo.numElements, &values);
+	for (i=0; elementPtr != NULL ; elementPtr = elementPtr->nextPtr) {
+	    values[i++].wideValue = elementPtr->payload.index;
+	}
+	Tcl_SetObjResult(interp, resultPtr);
+    } else if (sortInfo.resultCode == TCL_OK) {
 	ListRep listRep;
 	Tcl_Obj **newArray, *objPtr;
 
@@ -5006,12 +5182,6 @@ Tcl_LsortObjCmd(
 		    }
 		}
 	    }
-	} else if (indices) {
-	    for (i=0; elementPtr != NULL ; elementPtr = elementPtr->nextPtr) {
-		TclNewIndexObj(objPtr, elementPtr->payload.index);
-		newArray[i++] = objPtr;
-		Tcl_IncrRefCount(objPtr);
-	    }
 	} else {
 	    for (i=0; elementPtr != NULL ; elementPtr = elementPtr->nextPtr) {
 		objPtr = elementPtr->payload.objPtr;
@@ -5024,6 +5194,15 @@ Tcl_LsortObjCmd(
 	    listRep.spanPtr->spanStart = listRep.storePtr->firstUsed;
 	    listRep.spanPtr->spanLength = listRep.storePtr->numUsed;
 	}
+	if (!group && sortInfo.sortMode == SORTMODE_INTEGER
+		&& sortInfo.indexc == 0) {
+	    Tcl_Obj *packedPtr = TclNewPackedListFromObjv(i, newArray);
+
+	    if (packedPtr != NULL) {
+		Tcl_DecrRefCount(resultPtr);
+		resultPtr = packedPtr;
+	    }
+	}
 	Tcl_SetObjResult(interp, resultPtr);
     }
 
@@ -5159,6 +5338,80 @@ Tcl_LeditObjCmd(
     return TCL_OK;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * RadixSortElements --
+ *
+ *	Sort elements with integer or double collation keys by radix, with
+ *	the same stable result and handling of -unique as merging them.
+ *
+ * Results:
+ *	1 with *headPtrPtr set to the first of the sorted elements, chained
+ *	through their nextPtr fields; 0 if there was not enough memory.
+ *
+ * Side effects:
+ *	With -unique, infoPtr->numElements is updated.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+RadixSortElements(
+    SortInfo *infoPtr,		/* Information about the sort. */
+    SortElement *elementArray,	/* The elements to sort. */
+    SortElement **headPtrPtr)	/* Where to put the first sorted element. */
+{
+    size_t i, numElements = infoPtr->numElements;
+    TclSortKey *keys;
+    SortElement *tailPtr = NULL;
+
+    keys = (TclSortKey *) Tcl_AttemptAlloc(numElements * sizeof(TclSortKey));
+    if (keys == NULL) {
+	return 0;
+    }
+    for (i = 0; i < numElements; i++) {
+	if (infoPtr->sortMode == SORTMODE_INTEGER) {
+	    keys[i].key = TclWideSortKey(elementArray[i].collationKey.wideValue);
+	} else {
+	    keys[i].key = TclDoubleSortKey(
+		    elementArray[i].collationKey.doubleValue);
+	}
+	if (!infoPtr->isIncreasing) {
+	    keys[i].key = ~keys[i].key;
+	}
+	keys[i].index = i;
+    }
+    if (!TclSortKeys(keys, numElements)) {
+	Tcl_Free(keys);
+	return 0;
+    }
+
+    /*
+     * Of a run of equal elements, -unique keeps the last.
+     */
+
+    *headPtrPtr = NULL;
+    for (i = 0; i < numElements; i++) {
+	SortElement *elementPtr = &elementArray[keys[i].index];
+
+	if (infoPtr->unique && i + 1 < numElements
+		&& keys[i].key == keys[i + 1].key) {
+	    infoPtr->numElements--;
+	    continue;
+	}
+	if (tailPtr == NULL) {
+	    *headPtrPtr = elementPtr;
+	} else {
+	    tailPtr->nextPtr = elementPtr;
+	}
+	tailPtr = elementPtr;
+    }
+    tailPtr->nextPtr = NULL;
+    Tcl_Free(keys);
+    return 1;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -5289,8 +5542,26 @@ SortCompare(
     int order = 0;
 
     if (infoPtr->sortMode == SORTMODE_ASCII) {
-	order = TclUtfCmp(elemPtr1->collationKey.strValuePtr,
-		elemPtr2->collationKey.strValuePtr);
+	const unsigned char *s1 = (const unsigned char *)
+		elemPtr1->collationKey.strValuePtr;
+	const unsigned char *s2 = (const unsigned char *)
+		elemPtr2->collationKey.strValuePtr;
+
+	/*
+	 * Compare bytes directly as long as both strings are ASCII, where the
+	 * byte order is the character order; from the first other character
+	 * on, leave it to TclUtfCmp.
+	 */
+
+	while (*s1 == *s2 && *s1 != '\0' && *s1 < 0x80) {
+	    s1++;
+	    s2++;
+	}
+	if (*s1 != '\0' && *s2 != '\0' && (*s1 | *s2) >= 0x80) {
+	    order = TclUtfCmp((const char *) s1, (const char *) s2);
+	} else {
+	    order = *s1 - *s2;
+	}
     } else if (infoPtr->sortMode == SORTMODE_ASCII_NC) {
 	order = TclUtfCasecmp(elemPtr1->collationKey.strValuePtr,
 		elemPtr2->collationKey.strValuePtr);
@@ -31,6 +31,53 @@ static Tcl_NRPostProc	TryPostHandler;
 static int		UniCharIsAscii(int character);
 static int		UniCharIsHexDigit(int character);
 
+/*
+ * [string map] with many keys matches them all in one pass over the string
+ * using an Aho-Corasick automaton. A state stands for a prefix of some keys;
+ * its fail link leads to the state for the longest proper suffix of that
+ * prefix that is also one, and its output link to the nearest state along
+ * the fail links that spells a whole key. The automaton of a mapping given
+ * as a list is kept with the list (see TclListObjSetCache) for reuse. A
+ * dictionary has no room for it, so for a mapping given as a dictionary one
+ * is only built if the string is at least STRING_MAP_DICT_RATIO times as
+ * long as all the keys together, which makes up for building it.
+ */
+
+#define STRING_MAP_MIN_KEYS	8
+#define STRING_MAP_DICT_RATIO	2
+
+typedef struct {
+    int ch;			/* Character of the transition. */
+    Tcl_Size next;		/* State the transition leads to. */
+} MapEdge;
+
+typedef struct {
+    Tcl_Size firstEdge;		/* Index of the first transition in edges. */
+    Tcl_Size numEdges;		/* Number of transitions, sorted by ch. */
+    Tcl_Size fail;		/* Fail link; the root links to itself. */
+    Tcl_Size outputLink;	/* Output link, or -1. */
+    Tcl_Size key;		/* Lowest index of the keys spelled by this
+				 * state, or -1. */
+    Tcl_Size depth;		/* Number of characters spelled. */
+} MapState;
+
+typedef struct {
+    int nocase;			/* Whether the keys were folded to lower
+				 * case. */
+    MapState *states;		/* The states; the root is the first. */
+    MapEdge *edges;		/* The transitions of all states. */
+} MapAutomaton;
+
+static int		MapKeysFitIn(Tcl_Size mapElemc,
+			    Tcl_Obj *const mapElemv[], Tcl_Size limit);
+static MapAutomaton *	MapAutomatonNew(Tcl_Size mapElemc,
+			    Tcl_Obj *const mapElemv[], int nocase);
+static void		MapAutomatonFree(void *clientData);
+static void		MapAutomatonApply(MapAutomaton *mapPtr,
+			    Tcl_Obj *const mapElemv[],
+			    const Tcl_UniChar *string, Tcl_Size length,
+			    Tcl_Obj *resultPtr);
+
 /*
  * Default set of characters to trim in [string trim] and friends. This is a
  * UTF-8 literal string containing all Unicode space characters [TIP #413]
@@ -1934,6 +1981,300 @@ UniCharIsHexDigit(
     return (character >= 0) && (character < 0x80) && isxdigit(UCHAR(character));
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * MapKeysFitIn --
+ *
+ *	Tell whether the keys of a [string map] mapping have at most limit
+ *	characters in all.
+ *
+ * Results:
+ *	1 if so, 0 otherwise.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+MapKeysFitIn(
+    Tcl_Size mapElemc,		/* Number of keys and values. */
+    Tcl_Obj *const mapElemv[],	/* Keys alternating with values. */
+    Tcl_Size limit)		/* Largest total number of characters. */
+{
+    Tcl_Size i;
+
+    for (i = 0; i < mapElemc; i += 2) {
+	limit -= Tcl_GetCharLength(mapElemv[i]);
+	if (limit < 0) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MapAutomatonNew, MapAutomatonFree --
+ *
+ *	Build the automaton matching the keys of a [string map] mapping, and
+ *	release it. Empty keys are left out, as [string map] never matches
+ *	them.
+ *
+ * Results:
+ *	MapAutomatonNew returns the new automaton.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static inline Tcl_Size
+MapGoto(
+    const MapAutomaton *mapPtr,
+    Tcl_Size state,
+    int ch)
+{
+    const MapEdge *edges = mapPtr->edges + mapPtr->states[state].firstEdge;
+    Tcl_Size lo = 0, hi = mapPtr->states[state].numEdges;
+
+    while (lo < hi) {
+	Tcl_Size mid = lo + (hi - lo) / 2;
+
+	if (edges[mid].ch < ch) {
+	    lo = mid + 1;
+	} else {
+	    hi = mid;
+	}
+    }
+    return (lo < mapPtr->states[state].numEdges && edges[lo].ch == ch)
+	    ? edges[lo].next : -1;
+}
+
+static inline Tcl_Size
+MapStep(
+    const MapAutomaton *mapPtr,
+    Tcl_Size state,
+    int ch)
+{
+    Tcl_Size next;
+
+    while ((next = MapGoto(mapPtr, state, ch)) < 0) {
+	if (state == 0) {
+	    return 0;
+	}
+	state = mapPtr->states[state].fail;
+    }
+    return next;
+}
+
+static MapAutomaton *
+MapAutomatonNew(
+    Tcl_Size mapElemc,		/* Number of keys and values. */
+    Tcl_Obj *const mapElemv[],	/* Keys alternating with values. */
+    int nocase)			/* Whether to match regardless of case. */
+{
+    MapAutomaton *mapPtr = (MapAutomaton *)Tcl_Alloc(sizeof(MapAutomaton));
+    MapState *states;
+    MapEdge **children, *edgePtr;
+    Tcl_Size i, k, numStates = 1, maxStates = 1, head, tail, *queue;
+
+    for (i = 0; i < mapElemc; i += 2) {
+	Tcl_Size length;
+
+	Tcl_GetUnicodeFromObj(mapElemv[i], &length);
+	maxStates += length;
+    }
+    states = (MapState *)Tcl_Alloc(maxStates * sizeof(MapState));
+    children = (MapEdge **)Tcl_Alloc(maxStates * sizeof(MapEdge *));
+    states[0].numEdges = 0;
+    states[0].key = -1;
+    states[0].depth = 0;
+    children[0] = NULL;
+
+    /*
+     * Build the trie of the keys. Each state gets its own sorted array of
+     * transitions for now, with room for a power of two of them.
+     */
+
+    for (i = 0; i < mapElemc; i += 2) {
+	Tcl_Size length, state = 0;
+	Tcl_UniChar *key = Tcl_GetUnicodeFromObj(mapElemv[i], &length);
+
+	if (length == 0) {
+	    continue;
+	}
+	for (k = 0; k < length; k++) {
+	    int ch = nocase ? Tcl_UniCharToLower(key[k]) : key[k];
+	    Tcl_Size lo = 0, hi = states[state].numEdges;
+	    MapEdge *edges = children[state];
+
+	    while (lo < hi) {
+		Tcl_Size mid = lo + (hi - lo) / 2;
+
+		if (edges[mid].ch < ch) {
+		    lo = mid + 1;
+		} else {
+		    hi = mid;
+		}
+	    }
+	    if (lo < states[state].numEdges && edges[lo].ch == ch) {
+		state = edges[lo].next;
+		continue;
+	    }
+	    if ((states[state].numEdges & (states[state].numEdges - 1)) == 0) {
+		edges = (MapEdge *)Tcl_Realloc(edges, (states[state].numEdges
+			? 2 * states[state].numEdges : 1) * sizeof(MapEdge));
+		children[state] = edges;
+	    }
+	    memmove(edges + lo + 1, edges + lo,
+		    (states[state].numEdges - lo) * sizeof(MapEdge));
+	    edges[lo].ch = ch;
+	    edges[lo].next = numStates;
+	    states[state].numEdges++;
+	    states[numStates].numEdges = 0;
+	    states[numStates].key = -1;
+	    states[numStates].depth = states[state].depth + 1;
+	    children[numStates] = NULL;
+	    state = numStates++;
+	}
+	if (states[state].key < 0) {
+	    states[state].key = i / 2;
+	}
+    }
+
+    /*
+     * Gather the transitions into one array; every state but the root has
+     * exactly one leading to it.
+     */
+
+    mapPtr->nocase = nocase;
+    mapPtr->states = states;
+    mapPtr->edges = edgePtr = (MapEdge *)
+	    Tcl_Alloc(numStates * sizeof(MapEdge));
+    for (i = 0; i < numStates; i++) {
+	states[i].firstEdge = edgePtr - mapPtr->edges;
+	if (children[i] != NULL) {
+	    memcpy(edgePtr, children[i], states[i].numEdges * sizeof(MapEdge));
+	    edgePtr += states[i].numEdges;
+	    Tcl_Free(children[i]);
+	}
+    }
+    Tcl_Free(children);
+
+    /*
+     * Set the fail and output links breadth first, so that those of the
+     * shallower states they depend on are set already.
+     */
+
+    queue = (Tcl_Size *)Tcl_Alloc(numStates * sizeof(Tcl_Size));
+    states[0].fail = 0;
+    states[0].outputLink = -1;
+    queue[0] = 0;
+    for (head = 0, tail = 1; head < tail; head++) {
+	Tcl_Size state = queue[head];
+	MapEdge *edges = mapPtr->edges + states[state].firstEdge;
+
+	for (k = 0; k < states[state].numEdges; k++) {
+	    Tcl_Size next = edges[k].next, fail = 0;
+
+	    if (state != 0) {
+		fail = MapStep(mapPtr, states[state].fail, edges[k].ch);
+	    }
+	    states[next].fail = fail;
+	    states[next].outputLink = (states[fail].key >= 0)
+		    ? fail : states[fail].outputLink;
+	    queue[tail++] = next;
+	}
+    }
+    Tcl_Free(queue);
+    return mapPtr;
+}
+
+static void
+MapAutomatonFree(
+    void *clientData)
+{
+    MapAutomaton *mapPtr = (MapAutomaton *)clientData;
+
+    Tcl_Free(mapPtr->edges);
+    Tcl_Free(mapPtr->states);
+    Tcl_Free(mapPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * MapAutomatonApply --
+ *
+ *	Append a string to an object with the keys of a mapping replaced by
+ *	their values, as [string map] does: at each position the first key in
+ *	the mapping that matches there is replaced, and matching resumes after
+ *	it.
+ *
+ *	The automaton reports matches as they end, so a match is kept until
+ *	no match starting at or before it can be found any more: any match
+ *	yet to end starts within the characters spelled by the current state.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Appends to resultPtr.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+MapAutomatonApply(
+    MapAutomaton *mapPtr,	/* Automaton built from mapElemv. */
+    Tcl_Obj *const mapElemv[],	/* Keys alternating with values. */
+    const Tcl_UniChar *string,	/* String to map. */
+    Tcl_Size length,		/* Number of characters in string. */
+    Tcl_Obj *resultPtr)		/* Object to append the result to. */
+{
+    const MapState *states = mapPtr->states;
+    Tcl_Size i = 0, done = 0, state = 0;
+    Tcl_Size bestStart = -1, bestKey = -1, bestLength = 0;
+
+    while (i < length) {
+	int ch = string[i++];
+	Tcl_Size out;
+
+	if (mapPtr->nocase) {
+	    ch = Tcl_UniCharToLower(ch);
+	}
+	state = MapStep(mapPtr, state, ch);
+	out = (states[state].key >= 0) ? state : states[state].outputLink;
+	for (; out >= 0; out = states[out].outputLink) {
+	    Tcl_Size start = i - states[out].depth;
+
+	    if (bestStart < 0 || start < bestStart
+		    || (start == bestStart && states[out].key < bestKey)) {
+		bestStart = start;
+		bestKey = states[out].key;
+		bestLength = states[out].depth;
+	    }
+	}
+	if (bestStart >= 0
+		&& (bestStart < i - states[state].depth || i == length)) {
+	    Tcl_Size valueLength;
+	    Tcl_UniChar *value = Tcl_GetUnicodeFromObj(
+		    mapElemv[2 * bestKey + 1], &valueLength);
+
+	    if (bestStart > done) {
+		Tcl_AppendUnicodeToObj(resultPtr, string + done,
+			bestStart - done);
+	    }
+	    Tcl_AppendUnicodeToObj(resultPtr, value, valueLength);
+	    i = done = bestStart + bestLength;
+	    state = 0;
+	    bestStart = -1;
+	}
+    }
+    if (length > done) {
+	Tcl_AppendUnicodeToObj(resultPtr, string + done, length - done);
+    }
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2122,6 +2463,31 @@ StringMapCmd(
 		}
 	    }
 	}
+    } else if (mapElemc >= 2 * STRING_MAP_MIN_KEYS && (!mapWithDict
+	    || MapKeysFitIn(mapElemc, mapElemv,
+		    length1 / STRING_MAP_DICT_RATIO))) {
+	/*
+	 * Match all the keys at once. The automaton of a list is kept with
+	 * it; that of a dictionary is only used for this call.
+	 */
+
+	MapAutomaton *mapPtr = NULL;
+	int freeMap = 0;
+
+	if (!mapWithDict) {
+	    mapPtr = (MapAutomaton *)
+		    TclListObjGetCache(objv[objc-2], MapAutomatonFree);
+	}
+	if (mapPtr == NULL || mapPtr->nocase != nocase) {
+	    mapPtr = MapAutomatonNew(mapElemc, mapElemv, nocase);
+	    freeMap = mapWithDict || !TclListObjSetCache(objv[objc-2], mapPtr,
+		    MapAutomatonFree);
+	}
+	MapAutomatonApply(mapPtr, mapElemv, ustring1, length1, resultPtr);
+	if (freeMap) {
+	    MapAutomatonFree(mapPtr);
+	}
+	p = ustring1 = end;
     } else {
 	Tcl_UniChar **mapStrings;
 	Tcl_Size *mapLens;
@@ -0,0 +1,2450 @@
+/*
+ * tclCompCache.c --
+ *
+ *	This file implements the persistent bytecode cache. When a cache
+ *	directory is configured for an interpreter (with the environment
+ *	variable TCL_BYTECODE_CACHE or [tcl::unsupported::bytecodecache]), the
+ *	compiled form of the scripts of sourced files, and of the procedure
+ *	bodies and other script literals they contain, is written to files in
+ *	that directory and read back from there the next time the same script
+ *	is compiled in the same context, so that it need not be compiled
+ *	again.
+ *
+ *	The same encoded compilations can also be kept in a process-wide store
+ *	in memory (enabled with the environment variable TCL_BYTECODE_SHARE
+ *	or [tcl::unsupported::sharedbytecode]), from which every interpreter
+ *	of every thread can load them. The ByteCodes that interpreters load
+ *	from the same entry of the store also share their code, exception
+ *	ranges, aux data and command map (a ByteCodeBody), so that only the
+ *	literals and the caches are held once per interpreter.
+ *
+ * See the file "license.terms" for information on usage and redistribution of
+ * this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ */
+
+#include "tclInt.h"
+#include "tclCompile.h"
+#ifdef _WIN32
+#   include "tclWinInt.h"
+#endif
+
+/*
+ * A cache file holds, in this order: the magic string, the cache key (the
+ * description of the compilation context made by TclGetByteCodeCacheKey),
+ * the source of the script, the signatures of the commands the compiler
+ * resolved, the contents of the CompileEnv after compilation, and a MAC of
+ * all of the above. The file is named after a hash of the key and the
+ * source. All integers are stored as 4 byte big-endian values, all strings as
+ * their length followed by their bytes. Change the magic string whenever the
+ * format changes.
+ *
+ * The code in a cache file is executed without further ado, so only files
+ * that cannot have been written by anyone else are used: the directory and
+ * the files must belong to the user and must not be writable by others, and
+ * the MAC is keyed with a random secret kept in the file CACHE_KEY_FILE of
+ * the directory (readable by the user only) and with the digest of the
+ * instruction set of the build. The code is also checked for well-formedness
+ * before use.
+ */
+
+#define CACHE_MAGIC		"TclBCC02"
+#define CACHE_MAGIC_LENGTH	8
+#define CACHE_MAC_LENGTH	8
+#define CACHE_KEY_FILE		"key"
+#define CACHE_KEY_LENGTH	16
+#define CACHE_ASSOC_KEY		"tclByteCodeCache"
+#define CACHE_NAME_LENGTH	17	/* 16 hex digits and the NUL. */
+
+/*
+ * Kinds of literals, as far as the literal tables are concerned.
+ */
+
+enum LiteralKind {
+    LITERAL_SHARED,		/* In the local and global literal tables. */
+    LITERAL_SHARED_CMD,		/* Same, and registered as a command name. */
+    LITERAL_LOCAL,		/* Only in the local literal table. */
+    LITERAL_PRIVATE,		/* In no table, just in the literal array. */
+    LITERAL_PRIVATE_LIST	/* Same, and a list without a string
+				 * representation (see TclCompileListCmd). */
+};
+
+/*
+ * Per-interpreter state of the bytecode cache, kept as associated data.
+ */
+
+typedef struct {
+    Tcl_Obj *dirPtr;		/* Normalized path of the cache directory, or
+				 * NULL if the cache is disabled. */
+    Tcl_WideUInt instDigest;	/* Hash of the instruction table, so that
+				 * files written by builds with different
+				 * instruction sets are never used. */
+    int keyState;		/* 1 if macKey holds the secret key of the
+				 * cache directory, -1 if the directory is
+				 * not private or has no usable key, 0 if it
+				 * was not looked at yet. */
+    unsigned char macKey[CACHE_KEY_LENGTH];
+				/* The secret key of the cache directory. */
+    size_t numLoaded;		/* Number of scripts loaded from the cache. */
+    size_t numStored;		/* Number of scripts written to the cache. */
+    int busy;			/* Set while a cache file is read or written:
+				 * scripts compiled meanwhile (e.g., by an
+				 * encoding or filesystem implemented in Tcl)
+				 * bypass the cache. */
+} ByteCodeCache;
+
+/*
+ * The process-wide store of encoded compilations. The encoding in an entry is
+ * never modified once created; entries are reference counted so that they
+ * can be replaced or removed while other threads are decoding them. All
+ * fields, and the reference counts of the bodies, are guarded by the mutex
+ * of the store.
+ */
+
+typedef struct {
+    size_t refCount;		/* Number of threads decoding the entry, plus
+				 * one while it is in the store. */
+    ByteCodeBody *bodyPtr;	/* The body shared by the ByteCodes decoded
+				 * from the entry, made from the first one, or
+				 * NULL if none was made yet. */
+    Tcl_Size length;		/* Number of bytes of the encoding. */
+    unsigned char bytes[TCLFLEXARRAY];
+				/* The encoding, as in a cache file. */
+} SharedCode;
+
+#define SHARED_CODE_LIMIT	((size_t) 64 << 20)
+				/* Maximum number of bytes in the store. */
+
+static struct {
+    int initialized;		/* Whether the other fields are set up. */
+    int enabled;		/* Whether compilations are stored. */
+    Tcl_HashTable table;	/* Maps cache names to SharedCode entries. */
+    size_t numBytes;		/* Total size of the entries in the table. */
+} sharedCode;
+TCL_DECLARE_MUTEX(sharedCodeMutex)
+
+/*
+ * State of the decoding of a cache file.
+ */
+
+typedef struct {
+    const unsigned char *next;	/* Next byte to decode. */
+    const unsigned char *end;	/* End of the data. */
+    int ok;			/* Whether all reads so far stayed within the
+				 * data. */
+} CacheReader;
+
+/*
+ * Prototypes for procedures defined later in this file:
+ */
+
+static Tcl_Obj *	CacheFilePath(ByteCodeCache *bccPtr, const char *name);
+static Tcl_WideUInt	CacheMac(ByteCodeCache *bccPtr,
+			    const unsigned char *bytes, size_t length);
+static void		CacheName(Tcl_Obj *keyPtr, CompileEnv *envPtr,
+			    char *name);
+static int		CheckDependencies(Tcl_Interp *interp,
+			    CacheReader *readerPtr);
+static void		ClearSharedCode(void);
+static Tcl_WideUInt	CommandSignature(Tcl_Interp *interp,
+			    Tcl_Obj *nameObj);
+static int		DecodeCompilation(Tcl_Interp *interp,
+			    const unsigned char *bytes, Tcl_Size length,
+			    Tcl_Obj *keyPtr, CompileEnv *envPtr);
+static void		DeleteByteCodeCache(void *clientData,
+			    Tcl_Interp *interp);
+static SharedCode *	FetchSharedCode(const char *name);
+static void		FreeSharedCode(SharedCode *codePtr);
+static ByteCodeCache *	GetByteCodeCache(Tcl_Interp *interp);
+static int		GetCacheKey(ByteCodeCache *bccPtr);
+static Tcl_Size		GetCount(CacheReader *readerPtr, size_t minSize);
+static Tcl_Size		GetInt(CacheReader *readerPtr);
+static const char *	GetString(CacheReader *readerPtr,
+			    Tcl_Size *lengthPtr);
+static Tcl_WideUInt	HashBytes(Tcl_WideUInt hash, const void *bytes,
+			    size_t length);
+static int		IsPrivateFile(Tcl_Obj *pathPtr, int secret);
+static void		PutInt(Tcl_DString *dsPtr, Tcl_Size value);
+static void		PutString(Tcl_DString *dsPtr, const char *bytes,
+			    Tcl_Size length);
+static int		ReadAuxData(CacheReader *readerPtr,
+			    CompileEnv *envPtr);
+static void		ReleaseSharedCode(SharedCode *codePtr);
+static void		ShareByteCodeBody(SharedCode *codePtr,
+			    CompileEnv *envPtr);
+static int		ReadCompileEnv(Tcl_Interp *interp,
+			    CacheReader *readerPtr, CompileEnv *envPtr);
+static int		ReadKeyFile(Tcl_Obj *pathPtr, unsigned char *key);
+static int		ReadRandomBytes(unsigned char *bytes,
+			    Tcl_Size length);
+static void		ResetCompileEnv(Tcl_Interp *interp,
+			    CompileEnv *envPtr);
+static int		SetCacheDirectory(Tcl_Interp *interp,
+			    ByteCodeCache *bccPtr, Tcl_Obj *dirPtr);
+static int		SharedCodeEnabled(void);
+static int		StoreSharedCode(const char *name,
+			    const unsigned char *bytes, Tcl_Size length,
+			    SharedCode **codePtrPtr);
+static int		VerifyCode(CompileEnv *envPtr);
+static int		WriteAuxData(AuxData *auxDataPtr, Tcl_DString *dsPtr);
+static int		WriteCacheFile(ByteCodeCache *bccPtr,
+			    Tcl_Obj *pathPtr, Tcl_DString *dsPtr);
+static int		WriteCompileEnv(Tcl_Interp *interp,
+			    CompileEnv *envPtr, Tcl_DString *dsPtr);
+static void		WriteDependencies(Tcl_Interp *interp,
+			    Tcl_Obj *cmdDepsPtr, Tcl_DString *dsPtr);
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * HashBytes --
+ *
+ *	Continues a 64-bit FNV-1a hash over a sequence of bytes.
+ *
+ * Results:
+ *	The new hash value.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+#define HASH_INIT	((Tcl_WideUInt) 0xCBF29CE484222325)
+#define HASH_PRIME	((Tcl_WideUInt) 0x100000001B3)
+
+static Tcl_WideUInt
+HashBytes(
+    Tcl_WideUInt hash,
+    const void *bytes,
+    size_t length)
+{
+    const unsigned char *p = (const unsigned char *) bytes;
+
+    while (length--) {
+	hash = (hash ^ *p++) * HASH_PRIME;
+    }
+    return hash;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * PutInt, PutString --
+ *
+ *	Append an integer or a counted string to the encoded form of a
+ *	compilation.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Appends to the DString.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+PutInt(
+    Tcl_DString *dsPtr,
+    Tcl_Size value)
+{
+    unsigned char buf[4];
+
+    TclStoreInt4AtPtr(value, buf);
+    Tcl_DStringAppend(dsPtr, (char *) buf, 4);
+}
+
+static void
+PutString(
+    Tcl_DString *dsPtr,
+    const char *bytes,
+    Tcl_Size length)
+{
+    PutInt(dsPtr, length);
+    Tcl_DStringAppend(dsPtr, bytes, length);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetInt, GetCount, GetString --
+ *
+ *	Decode an integer, an item count or a counted string from a cache
+ *	file. GetCount checks that the count is not negative and that there
+ *	is enough data left for that many items of at least minSize bytes.
+ *
+ * Results:
+ *	The decoded value. If the data is exhausted or a value is invalid, the
+ *	reader's ok flag is cleared and 0 or an empty string is returned.
+ *
+ * Side effects:
+ *	Advances the reader.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_Size
+GetInt(
+    CacheReader *readerPtr)
+{
+    Tcl_Size value;
+
+    if (readerPtr->end - readerPtr->next < 4) {
+	readerPtr->ok = 0;
+	return 0;
+    }
+    value = TclGetInt4AtPtr(readerPtr->next);
+    readerPtr->next += 4;
+    return value;
+}
+
+static Tcl_Size
+GetCount(
+    CacheReader *readerPtr,
+    size_t minSize)
+{
+    Tcl_Size count = GetInt(readerPtr);
+
+    if (count < 0
+	    || (size_t) count > (size_t) (readerPtr->end - readerPtr->next) / minSize) {
+	readerPtr->ok = 0;
+	return 0;
+    }
+    return count;
+}
+
+static const char *
+GetString(
+    CacheReader *readerPtr,
+    Tcl_Size *lengthPtr)
+{
+    const char *bytes;
+    Tcl_Size length = GetCount(readerPtr, 1);
+
+    bytes = (const char *) readerPtr->next;
+    readerPtr->next += length;
+    *lengthPtr = length;
+    return bytes;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CacheMac --
+ *
+ *	Computes the MAC of the contents of a cache file: SipHash-2-4 keyed
+ *	with the secret key of the cache directory, into which the digest of
+ *	the instruction set is mixed.
+ *
+ * Results:
+ *	The MAC.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+#define ROTL64(x, n)	(((x) << (n)) | ((x) >> (64 - (n))))
+#define SIPROUND() \
+    do {								\
+	v0 += v1; v1 = ROTL64(v1, 13); v1 ^= v0; v0 = ROTL64(v0, 32);	\
+	v2 += v3; v3 = ROTL64(v3, 16); v3 ^= v2;			\
+	v0 += v3; v3 = ROTL64(v3, 21); v3 ^= v0;			\
+	v2 += v1; v1 = ROTL64(v1, 17); v1 ^= v2; v2 = ROTL64(v2, 32);	\
+    } while (0)
+
+static Tcl_WideUInt
+CacheMac(
+    ByteCodeCache *bccPtr,
+    const unsigned char *bytes,
+    size_t length)
+{
+    Tcl_WideUInt k0 = 0, k1 = 0, v0, v1, v2, v3, m;
+    size_t i, j;
+
+    for (i = 0; i < 8; i++) {
+	k0 |= (Tcl_WideUInt) bccPtr->macKey[i] << (8 * i);
+	k1 |= (Tcl_WideUInt) bccPtr->macKey[i + 8] << (8 * i);
+    }
+    k0 ^= bccPtr->instDigest;
+    v0 = k0 ^ (Tcl_WideUInt) 0x736F6D6570736575;
+    v1 = k1 ^ (Tcl_WideUInt) 0x646F72616E646F6D;
+    v2 = k0 ^ (Tcl_WideUInt) 0x6C7967656E657261;
+    v3 = k1 ^ (Tcl_WideUInt) 0x7465646279746573;
+
+    for (i = 0; i + 8 <= length; i += 8) {
+	for (m = 0, j = 0; j < 8; j++) {
+	    m |= (Tcl_WideUInt) bytes[i + j] << (8 * j);
+	}
+	v3 ^= m;
+	SIPROUND();
+	SIPROUND();
+	v0 ^= m;
+    }
+    for (m = (Tcl_WideUInt) length << 56, j = 0; i + j < length; j++) {
+	m |= (Tcl_WideUInt) bytes[i + j] << (8 * j);
+    }
+    v3 ^= m;
+    SIPROUND();
+    SIPROUND();
+    v0 ^= m;
+    v2 ^= 0xFF;
+    SIPROUND();
+    SIPROUND();
+    SIPROUND();
+    SIPROUND();
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * IsPrivateFile --
+ *
+ *	Tells whether a file or directory of the bytecode cache can only have
+ *	been written by the user: it must belong to the effective user and
+ *	must not be writable by the group or others. Files with secret
+ *	contents must not be readable by them either.
+ *
+ * Results:
+ *	1 if the file is private, else 0 (also if it does not exist).
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+IsPrivateFile(
+    Tcl_Obj *pathPtr,
+    int secret)			/* Whether reading must be denied too. */
+{
+#ifdef _WIN32
+    (void) secret;
+    return TclWinFileOwned(pathPtr);
+#else
+    Tcl_StatBuf buf;
+    int mask = secret ? (S_IRWXG | S_IRWXO) : (S_IWGRP | S_IWOTH);
+
+    return (Tcl_FSStat(pathPtr, &buf) == 0) && (buf.st_uid == geteuid())
+	    && !(buf.st_mode & mask);
+#endif
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetCacheKey, ReadKeyFile, ReadRandomBytes --
+ *
+ *	GetCacheKey checks that the cache directory is private and loads its
+ *	secret key into macKey, creating the key file with random contents if
+ *	there is none. The result is remembered until the directory is
+ *	changed. ReadKeyFile reads the key from a private key file;
+ *	ReadRandomBytes reads from the system's random number source.
+ *
+ * Results:
+ *	Each returns 1 on success, else 0. The cache directory must not be
+ *	used when GetCacheKey fails.
+ *
+ * Side effects:
+ *	May create the key file.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+GetCacheKey(
+    ByteCodeCache *bccPtr)
+{
+    Tcl_Obj *nameObj, *pathPtr, *tempPtr;
+    unsigned char key[CACHE_KEY_LENGTH];
+    Tcl_Channel chan;
+    int ok, written;
+
+    if (bccPtr->keyState != 0) {
+	return bccPtr->keyState > 0;
+    }
+    bccPtr->keyState = -1;
+    if (!IsPrivateFile(bccPtr->dirPtr, 0)) {
+	return 0;
+    }
+
+    nameObj = Tcl_NewStringObj(CACHE_KEY_FILE, -1);
+    Tcl_IncrRefCount(nameObj);
+    pathPtr = Tcl_FSJoinToPath(bccPtr->dirPtr, 1, &nameObj);
+    Tcl_IncrRefCount(pathPtr);
+    Tcl_DecrRefCount(nameObj);
+
+    /*
+     * Create the key under a temporary name and link it into place, so that
+     * a key another process created meanwhile is never replaced: the files
+     * that process wrote would no longer be accepted.
+     */
+
+    ok = ReadKeyFile(pathPtr, bccPtr->macKey);
+    if (!ok && ReadRandomBytes(key, CACHE_KEY_LENGTH)) {
+	TclNewObj(tempPtr);
+	Tcl_IncrRefCount(tempPtr);
+	chan = TclpOpenTemporaryFile(bccPtr->dirPtr, NULL, NULL, tempPtr);
+	if (chan != NULL) {
+	    Tcl_SetChannelOption(NULL, chan, "-translation", "binary");
+	    written = (Tcl_Write(chan, (char *) key, CACHE_KEY_LENGTH)
+		    == CACHE_KEY_LENGTH);
+	    if (Tcl_Close(NULL, chan) == TCL_OK && written) {
+		Tcl_FSLink(pathPtr, tempPtr, TCL_CREATE_HARD_LINK);
+	    }
+	    Tcl_FSDeleteFile(tempPtr);
+	}
+	Tcl_DecrRefCount(tempPtr);
+	ok = ReadKeyFile(pathPtr, bccPtr->macKey);
+    }
+    Tcl_DecrRefCount(pathPtr);
+    if (ok) {
+	bccPtr->keyState = 1;
+    }
+    return ok;
+}
+
+static int
+ReadKeyFile(
+    Tcl_Obj *pathPtr,
+    unsigned char *key)
+{
+    Tcl_Channel chan;
+    char extra;
+    int ok;
+
+    if (!IsPrivateFile(pathPtr, 1)) {
+	return 0;
+    }
+    chan = Tcl_FSOpenFileChannel(NULL, pathPtr, "rb", 0);
+    if (chan == NULL) {
+	return 0;
+    }
+    ok = (Tcl_Read(chan, (char *) key, CACHE_KEY_LENGTH) == CACHE_KEY_LENGTH)
+	    && (Tcl_Read(chan, &extra, 1) == 0);
+    Tcl_Close(NULL, chan);
+    return ok;
+}
+
+static int
+ReadRandomBytes(
+    unsigned char *bytes,
+    Tcl_Size length)
+{
+    Tcl_Channel chan = Tcl_OpenFileChannel(NULL, "/dev/urandom", "rb", 0);
+    int ok;
+
+    if (chan == NULL) {
+	return 0;
+    }
+    ok = (Tcl_Read(chan, (char *) bytes, length) == length);
+    Tcl_Close(NULL, chan);
+    return ok;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetByteCodeCache --
+ *
+ *	Returns the bytecode cache state of an interpreter, creating it (and
+ *	configuring it from the TCL_BYTECODE_CACHE environment variable) when
+ *	it is first needed.
+ *
+ * Results:
+ *	The cache state.
+ *
+ * Side effects:
+ *	May create the associated data of the interpreter.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static ByteCodeCache *
+GetByteCodeCache(
+    Tcl_Interp *interp)
+{
+    ByteCodeCache *bccPtr = (ByteCodeCache *)
+	    Tcl_GetAssocData(interp, CACHE_ASSOC_KEY, NULL);
+    const InstructionDesc *instPtr;
+    const char *dir;
+    Tcl_DString ds;
+
+    if (bccPtr != NULL) {
+	return bccPtr;
+    }
+
+    bccPtr = (ByteCodeCache *) Tcl_Alloc(sizeof(ByteCodeCache));
+    bccPtr->dirPtr = NULL;
+    bccPtr->numLoaded = 0;
+    bccPtr->numStored = 0;
+    bccPtr->busy = 0;
+    bccPtr->keyState = 0;
+    bccPtr->instDigest = HashBytes(HASH_INIT, TCL_PATCH_LEVEL,
+	    strlen(TCL_PATCH_LEVEL));
+    for (instPtr = tclInstructionTable; instPtr->name; instPtr++) {
+	bccPtr->instDigest = HashBytes(bccPtr->instDigest, instPtr->name,
+		strlen(instPtr->name) + 1);
+	bccPtr->instDigest = HashBytes(bccPtr->instDigest,
+		&instPtr->numBytes, sizeof(instPtr->numBytes));
+	bccPtr->instDigest = HashBytes(bccPtr->instDigest,
+		instPtr->opTypes, sizeof(instPtr->opTypes));
+    }
+    Tcl_SetAssocData(interp, CACHE_ASSOC_KEY, DeleteByteCodeCache, bccPtr);
+
+    dir = TclGetEnv("TCL_BYTECODE_CACHE", &ds);
+    if (dir != NULL) {
+	if (*dir != '\0') {
+	    Tcl_Obj *dirPtr = Tcl_NewStringObj(dir, -1);
+
+	    Tcl_IncrRefCount(dirPtr);
+	    SetCacheDirectory(NULL, bccPtr, dirPtr);
+	    Tcl_DecrRefCount(dirPtr);
+	}
+	Tcl_DStringFree(&ds);
+    }
+    return bccPtr;
+}
+
+static void
+DeleteByteCodeCache(
+    void *clientData,
+    TCL_UNUSED(Tcl_Interp *))
+{
+    ByteCodeCache *bccPtr = (ByteCodeCache *) clientData;
+
+    if (bccPtr->dirPtr != NULL) {
+	Tcl_DecrRefCount(bccPtr->dirPtr);
+    }
+    Tcl_Free(bccPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SetCacheDirectory --
+ *
+ *	Sets the directory of the bytecode cache of an interpreter. An empty
+ *	directory name disables the cache.
+ *
+ * Results:
+ *	A standard Tcl result; an error message is left in the interpreter
+ *	(if it is not NULL) when the name cannot be normalized.
+ *
+ * Side effects:
+ *	Changes the cache state.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+SetCacheDirectory(
+    Tcl_Interp *interp,
+    ByteCodeCache *bccPtr,
+    Tcl_Obj *dirPtr)
+{
+    Tcl_Obj *normPtr = NULL;
+
+    if (TclGetString(dirPtr)[0] != '\0') {
+	normPtr = Tcl_FSGetNormalizedPath(interp, dirPtr);
+	if (normPtr == NULL) {
+	    return TCL_ERROR;
+	}
+	Tcl_IncrRefCount(normPtr);
+    }
+    if (bccPtr->dirPtr != NULL) {
+	Tcl_DecrRefCount(bccPtr->dirPtr);
+    }
+    bccPtr->dirPtr = normPtr;
+    bccPtr->keyState = 0;
+    return TCL_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tcl_ByteCodeCacheObjCmd --
+ *
+ *	Implementation of the "::tcl::unsupported::bytecodecache" command,
+ *	which sets the directory of the bytecode cache of the interpreter
+ *	(an empty string disables the cache) and reports on the cache.
+ *
+ * Results:
+ *	A standard Tcl result. The result is a dictionary with the cache
+ *	directory and the numbers of scripts loaded from and stored to the
+ *	cache by the interpreter.
+ *
+ * Side effects:
+ *	May change the cache directory.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+Tcl_ByteCodeCacheObjCmd(
+    TCL_UNUSED(void *),
+    Tcl_Interp *interp,		/* Current interpreter. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    ByteCodeCache *bccPtr;
+    Tcl_Obj *resultPtr;
+
+    if (objc > 2) {
+	Tcl_WrongNumArgs(interp, 1, objv, "?directory?");
+	return TCL_ERROR;
+    }
+    bccPtr = GetByteCodeCache(interp);
+    if (objc == 2 && SetCacheDirectory(interp, bccPtr, objv[1]) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    TclNewObj(resultPtr);
+    Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("directory", -1),
+	    bccPtr->dirPtr ? bccPtr->dirPtr : Tcl_NewObj());
+    Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("loaded", -1),
+	    Tcl_NewWideIntObj((Tcl_WideInt) bccPtr->numLoaded));
+    Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("stored", -1),
+	    Tcl_NewWideIntObj((Tcl_WideInt) bccPtr->numStored));
+    Tcl_SetObjResult(interp, resultPtr);
+    return TCL_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tcl_SharedByteCodeObjCmd --
+ *
+ *	Implementation of the "::tcl::unsupported::sharedbytecode" command,
+ *	which enables or disables (and empties) the process-wide store of
+ *	compilations and reports on it.
+ *
+ * Results:
+ *	A standard Tcl result. The result is a dictionary telling whether the
+ *	store is enabled, and the number of compilations and bytes in it.
+ *
+ * Side effects:
+ *	May change the state of the store, for all threads.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+Tcl_SharedByteCodeObjCmd(
+    TCL_UNUSED(void *),
+    Tcl_Interp *interp,		/* Current interpreter. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    Tcl_Obj *resultPtr;
+    int enabled;
+    size_t numEntries, numBytes;
+
+    if (objc > 2) {
+	Tcl_WrongNumArgs(interp, 1, objv, "?boolean?");
+	return TCL_ERROR;
+    }
+    if (objc == 2
+	    && Tcl_GetBooleanFromObj(interp, objv[1], &enabled) != TCL_OK) {
+	return TCL_ERROR;
+    }
+
+    SharedCodeEnabled();
+    Tcl_MutexLock(&sharedCodeMutex);
+    if (objc == 2) {
+	if (!enabled) {
+	    ClearSharedCode();
+	}
+	sharedCode.enabled = enabled;
+    }
+    enabled = sharedCode.enabled;
+    numEntries = sharedCode.table.numEntries;
+    numBytes = sharedCode.numBytes;
+    Tcl_MutexUnlock(&sharedCodeMutex);
+
+    TclNewObj(resultPtr);
+    Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("enabled", -1),
+	    Tcl_NewBooleanObj(enabled));
+    Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("scripts", -1),
+	    Tcl_NewWideIntObj((Tcl_WideInt) numEntries));
+    Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("bytes", -1),
+	    Tcl_NewWideIntObj((Tcl_WideInt) numBytes));
+    Tcl_SetObjResult(interp, resultPtr);
+    return TCL_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclGetByteCodeCacheKey --
+ *
+ *	Decides whether the script about to be compiled in a CompileEnv can
+ *	be looked up in (and stored to) the bytecode cache of the interpreter,
+ *	and describes the context of its compilation. Only scripts of sourced
+ *	files and the literal scripts in them (procedure bodies, namespace
+ *	eval bodies, ...) are cached, and only when no name resolvers are
+ *	involved and the code cannot refer to the local variables of an
+ *	enclosing procedure frame.
+ *
+ * Results:
+ *	The cache key (with a reference count of 1, for the caller), or NULL
+ *	if the script is not to be cached.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_Obj *
+TclGetByteCodeCacheKey(
+    Tcl_Interp *interp,
+    CompileEnv *envPtr)
+{
+    Interp *iPtr = (Interp *) interp;
+    Namespace *nsPtr = iPtr->varFramePtr->nsPtr;
+    Proc *procPtr = envPtr->procPtr;
+    ByteCodeCache *bccPtr;
+    Tcl_Obj *keyPtr;
+    char buf[40];
+
+    if ((iPtr->flags & DELETED)
+	    || envPtr->extCmdMapPtr->type != TCL_LOCATION_SOURCE) {
+	return NULL;
+    }
+    bccPtr = GetByteCodeCache(interp);
+    if ((bccPtr->dirPtr == NULL && !SharedCodeEnabled()) || bccPtr->busy) {
+	return NULL;
+    }
+    if (iPtr->resolverPtr || nsPtr->cmdResProc || nsPtr->varResProc
+	    || nsPtr->compiledVarResProc) {
+	return NULL;
+    }
+    if (procPtr ? (procPtr->numCompiledLocals != procPtr->numArgs)
+	    : (iPtr->varFramePtr->localCachePtr != NULL)) {
+	return NULL;
+    }
+
+    /*
+     * Everything besides the commands that are resolved during the
+     * compilation (see CheckDependencies) which decides on what code is
+     * generated.
+     */
+
+    snprintf(buf, sizeof(buf), "%016" TCL_LL_MODIFIER "x %d%d%d%d",
+	    (long long) bccPtr->instDigest,
+	    Tcl_GetParent(interp) == NULL && !Tcl_LimitTypeEnabled(interp,
+		    TCL_LIMIT_COMMANDS|TCL_LIMIT_TIME),
+	    iPtr->optimizer != NULL, Tcl_IsSafe(interp),
+	    (iPtr->flags & DONT_COMPILE_CMDS_INLINE) != 0);
+    keyPtr = Tcl_ObjPrintf("%s %s\n%s\n", TCL_PATCH_LEVEL, buf,
+	    nsPtr->fullName);
+    if (procPtr) {
+	CompiledLocal *localPtr;
+
+	Tcl_AppendToObj(keyPtr, "proc", -1);
+	for (localPtr = procPtr->firstLocalPtr; localPtr != NULL;
+		localPtr = localPtr->nextPtr) {
+	    Tcl_AppendPrintfToObj(keyPtr, " %" TCL_Z_MODIFIER "d:%s:%d",
+		    (size_t) localPtr->nameLength, localPtr->name,
+		    localPtr->flags);
+	}
+    } else {
+	Tcl_AppendToObj(keyPtr, "script", -1);
+    }
+    Tcl_IncrRefCount(keyPtr);
+    return keyPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CacheName, CacheFilePath --
+ *
+ *	CacheName computes the name under which the compilation of a script
+ *	is cached: a hash of the cache key and the source, in hexadecimal.
+ *	CacheFilePath computes the path of the cache file with that name.
+ *
+ * Results:
+ *	CacheName writes the name into a buffer of CACHE_NAME_LENGTH bytes.
+ *	CacheFilePath returns the path, with a reference count of 1 for the
+ *	caller.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+CacheName(
+    Tcl_Obj *keyPtr,
+    CompileEnv *envPtr,
+    char *name)
+{
+    Tcl_Size length;
+    const char *bytes = Tcl_GetStringFromObj(keyPtr, &length);
+    Tcl_WideUInt hash = HashBytes(HASH_INIT, bytes, length);
+
+    hash = HashBytes(hash, envPtr->source, envPtr->numSrcBytes);
+    snprintf(name, CACHE_NAME_LENGTH, "%016" TCL_LL_MODIFIER "x",
+	    (long long) hash);
+}
+
+static Tcl_Obj *
+CacheFilePath(
+    ByteCodeCache *bccPtr,
+    const char *name)
+{
+    Tcl_Obj *nameObj, *pathPtr;
+
+    nameObj = Tcl_ObjPrintf("%s.tbc", name);
+    Tcl_IncrRefCount(nameObj);
+    pathPtr = Tcl_FSJoinToPath(bccPtr->dirPtr, 1, &nameObj);
+    Tcl_IncrRefCount(pathPtr);
+    Tcl_DecrRefCount(nameObj);
+    return pathPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CommandSignature --
+ *
+ *	Computes a hash of what the compiler needs to know about the command
+ *	a name resolves to: its full name, whether and how it may be
+ *	compiled and, for ensembles compiled by TclCompileEnsemble, the
+ *	configuration of the ensemble.
+ *
+ * Results:
+ *	The hash value.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_WideUInt
+CommandSignature(
+    Tcl_Interp *interp,
+    Tcl_Obj *nameObj)
+{
+    Command *cmdPtr = (Command *) Tcl_GetCommandFromObj(interp, nameObj);
+    Tcl_WideUInt hash = HASH_INIT;
+    Tcl_Obj *objPtr;
+    Tcl_Size length;
+    const char *bytes;
+    int bits;
+
+    if (cmdPtr == NULL) {
+	return hash;
+    }
+
+    TclNewObj(objPtr);
+    Tcl_GetCommandFullName(interp, (Tcl_Command) cmdPtr, objPtr);
+    bytes = Tcl_GetStringFromObj(objPtr, &length);
+    hash = HashBytes(hash, bytes, length + 1);
+    Tcl_DecrRefCount(objPtr);
+
+    bits = (cmdPtr->compileProc != NULL)
+	    | (cmdPtr->compileProc == TclCompileNoOp) << 1
+	    | ((cmdPtr->nsPtr->flags & NS_SUPPRESS_COMPILATION) != 0) << 2
+	    | ((cmdPtr->flags & CMD_HAS_EXEC_TRACES) != 0) << 3
+	    | ((cmdPtr->flags & CMD_COMPILES_EXPANDED) != 0) << 4;
+    hash = HashBytes(hash, &bits, sizeof(bits));
+
+    if (cmdPtr->compileProc == TclCompileEnsemble) {
+	Tcl_Command token = (Tcl_Command) cmdPtr;
+
+	Tcl_GetEnsembleFlags(NULL, token, &bits);
+	hash = HashBytes(hash, &bits, sizeof(bits));
+	objPtr = NULL;
+	Tcl_GetEnsembleMappingDict(NULL, token, &objPtr);
+	if (objPtr != NULL) {
+	    bytes = Tcl_GetStringFromObj(objPtr, &length);
+	    hash = HashBytes(hash, bytes, length + 1);
+	}
+	objPtr = NULL;
+	Tcl_GetEnsembleSubcommandList(NULL, token, &objPtr);
+	if (objPtr != NULL) {
+	    bytes = Tcl_GetStringFromObj(objPtr, &length);
+	    hash = HashBytes(hash, bytes, length + 1);
+	}
+	objPtr = NULL;
+	Tcl_GetEnsembleParameterList(NULL, token, &objPtr);
+	if (objPtr != NULL) {
+	    bytes = Tcl_GetStringFromObj(objPtr, &length);
+	    hash = HashBytes(hash, bytes, length + 1);
+	}
+    }
+    return hash;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WriteDependencies, CheckDependencies --
+ *
+ *	The code the compiler generates depends on what the command names it
+ *	resolves refer to. WriteDependencies encodes the signatures of the
+ *	commands the names recorded during a compilation resolved to;
+ *	CheckDependencies decodes them and checks that the names still resolve
+ *	to commands with the same signatures.
+ *
+ * Results:
+ *	CheckDependencies returns whether the code in the cache file is valid
+ *	in the current context.
+ *
+ * Side effects:
+ *	WriteDependencies appends to the DString.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+WriteDependencies(
+    Tcl_Interp *interp,
+    Tcl_Obj *cmdDepsPtr,
+    Tcl_DString *dsPtr)
+{
+    Tcl_HashTable namesTable;
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    Tcl_Obj **objv, *nameObj;
+    Tcl_Size i, objc;
+    Tcl_WideUInt signature;
+    int isNew;
+
+    Tcl_InitHashTable(&namesTable, TCL_STRING_KEYS);
+    TclListObjGetElementsM(NULL, cmdDepsPtr, &objc, &objv);
+    for (i = 0; i < objc; i++) {
+	Tcl_CreateHashEntry(&namesTable, TclGetString(objv[i]), &isNew);
+    }
+
+    PutInt(dsPtr, namesTable.numEntries);
+    for (hPtr = Tcl_FirstHashEntry(&namesTable, &search); hPtr != NULL;
+	    hPtr = Tcl_NextHashEntry(&search)) {
+	const char *name = (const char *) Tcl_GetHashKey(&namesTable, hPtr);
+
+	nameObj = Tcl_NewStringObj(name, -1);
+	Tcl_IncrRefCount(nameObj);
+	signature = CommandSignature(interp, nameObj);
+	Tcl_DecrRefCount(nameObj);
+	PutString(dsPtr, name, strlen(name));
+	PutInt(dsPtr, (Tcl_Size) (signature >> 32));
+	PutInt(dsPtr, (Tcl_Size) (signature & 0xFFFFFFFF));
+    }
+    Tcl_DeleteHashTable(&namesTable);
+}
+
+static int
+CheckDependencies(
+    Tcl_Interp *interp,
+    CacheReader *readerPtr)
+{
+    Tcl_Size i, numDeps, length;
+    const char *name;
+    Tcl_Obj *nameObj;
+    Tcl_WideUInt signature;
+
+    numDeps = GetCount(readerPtr, 12);
+    for (i = 0; i < numDeps; i++) {
+	name = GetString(readerPtr, &length);
+	signature = (Tcl_WideUInt) (unsigned) GetInt(readerPtr) << 32;
+	signature |= (unsigned) GetInt(readerPtr);
+	if (!readerPtr->ok) {
+	    return 0;
+	}
+	nameObj = Tcl_NewStringObj(name, length);
+	Tcl_IncrRefCount(nameObj);
+	if (CommandSignature(interp, nameObj) != signature) {
+	    readerPtr->ok = 0;
+	}
+	Tcl_DecrRefCount(nameObj);
+	if (!readerPtr->ok) {
+	    return 0;
+	}
+    }
+    return readerPtr->ok;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WriteAuxData, ReadAuxData --
+ *
+ *	Encode and decode an AuxData item. Only the types of AuxData the core
+ *	compiler creates are supported.
+ *
+ * Results:
+ *	WriteAuxData returns 0 if the type of the AuxData is not supported;
+ *	ReadAuxData returns 0 if the data is not valid.
+ *
+ * Side effects:
+ *	WriteAuxData appends to the DString; ReadAuxData adds an AuxData item
+ *	to the CompileEnv.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+WriteAuxData(
+    AuxData *auxDataPtr,
+    Tcl_DString *dsPtr)
+{
+    const char *typeName = auxDataPtr->type->name;
+    Tcl_Size i, j;
+
+    if (auxDataPtr->type != TclGetAuxDataType(typeName)) {
+	return 0;
+    }
+    PutString(dsPtr, typeName, strlen(typeName));
+
+    if (auxDataPtr->type == &tclJumptableInfoType) {
+	JumptableInfo *jtPtr = (JumptableInfo *) auxDataPtr->clientData;
+	Tcl_HashEntry *hPtr;
+	Tcl_HashSearch search;
+
+	PutInt(dsPtr, jtPtr->hashTable.numEntries);
+	for (hPtr = Tcl_FirstHashEntry(&jtPtr->hashTable, &search);
+		hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	    const char *key = (const char *)
+		    Tcl_GetHashKey(&jtPtr->hashTable, hPtr);
+
+	    PutString(dsPtr, key, strlen(key));
+	    PutInt(dsPtr, PTR2INT(Tcl_GetHashValue(hPtr)));
+	}
+    } else if (!strcmp(typeName, "DictUpdateInfo")) {
+	DictUpdateInfo *duiPtr = (DictUpdateInfo *) auxDataPtr->clientData;
+
+	PutInt(dsPtr, duiPtr->length);
+	for (i = 0; i < duiPtr->length; i++) {
+	    PutInt(dsPtr, duiPtr->varIndices[i]);
+	}
+    } else if (!strcmp(typeName, "ForeachInfo")
+	    || !strcmp(typeName, "NewForeachInfo")) {
+	ForeachInfo *infoPtr = (ForeachInfo *) auxDataPtr->clientData;
+
+	PutInt(dsPtr, infoPtr->numLists);
+	PutInt(dsPtr, infoPtr->firstValueTemp);
+	PutInt(dsPtr, infoPtr->loopCtTemp);
+	for (i = 0; i < infoPtr->numLists; i++) {
+	    ForeachVarList *varListPtr = infoPtr->varLists[i];
+
+	    PutInt(dsPtr, varListPtr->numVars);
+	    for (j = 0; j < varListPtr->numVars; j++) {
+		PutInt(dsPtr, varListPtr->varIndexes[j]);
+	    }
+	}
+    } else {
+	return 0;
+    }
+    return 1;
+}
+
+static int
+ReadAuxData(
+    CacheReader *readerPtr,
+    CompileEnv *envPtr)
+{
+    const AuxDataType *typePtr;
+    Tcl_DString ds;
+    const char *bytes;
+    Tcl_Size i, j, length, count;
+
+    Tcl_DStringInit(&ds);
+    bytes = GetString(readerPtr, &length);
+    Tcl_DStringAppend(&ds, bytes, length);
+    typePtr = TclGetAuxDataType(Tcl_DStringValue(&ds));
+    if (!readerPtr->ok || typePtr == NULL) {
+	Tcl_DStringFree(&ds);
+	return 0;
+    }
+
+    if (typePtr == &tclJumptableInfoType) {
+	JumptableInfo *jtPtr = (JumptableInfo *)
+		Tcl_Alloc(sizeof(JumptableInfo));
+	Tcl_HashEntry *hPtr;
+	int isNew;
+
+	Tcl_InitHashTable(&jtPtr->hashTable, TCL_STRING_KEYS);
+	TclCreateAuxData(jtPtr, typePtr, envPtr);
+	count = GetCount(readerPtr, 8);
+	for (i = 0; i < count; i++) {
+	    bytes = GetString(readerPtr, &length);
+	    Tcl_DStringSetLength(&ds, 0);
+	    Tcl_DStringAppend(&ds, bytes, length);
+	    hPtr = Tcl_CreateHashEntry(&jtPtr->hashTable,
+		    Tcl_DStringValue(&ds), &isNew);
+	    Tcl_SetHashValue(hPtr, INT2PTR(GetInt(readerPtr)));
+	}
+    } else if (!strcmp(typePtr->name, "DictUpdateInfo")) {
+	DictUpdateInfo *duiPtr;
+
+	count = GetCount(readerPtr, 4);
+	duiPtr = (DictUpdateInfo *) Tcl_Alloc(
+		offsetof(DictUpdateInfo, varIndices) + sizeof(Tcl_Size) * count);
+	duiPtr->length = count;
+	for (i = 0; i < count; i++) {
+	    duiPtr->varIndices[i] = GetInt(readerPtr);
+	}
+	TclCreateAuxData(duiPtr, typePtr, envPtr);
+    } else {
+	ForeachInfo *infoPtr;
+	ForeachVarList *varListPtr;
+
+	count = GetCount(readerPtr, 12);
+	infoPtr = (ForeachInfo *) Tcl_Alloc(offsetof(ForeachInfo, varLists)
+		+ count * sizeof(ForeachVarList *));
+	infoPtr->numLists = 0;
+	infoPtr->firstValueTemp = GetInt(readerPtr);
+	infoPtr->loopCtTemp = GetInt(readerPtr);
+	TclCreateAuxData(infoPtr, typePtr, envPtr);
+	for (i = 0; i < count; i++) {
+	    length = GetCount(readerPtr, 4);
+	    varListPtr = (ForeachVarList *) Tcl_Alloc(
+		    offsetof(ForeachVarList, varIndexes)
+		    + length * sizeof(Tcl_Size));
+	    varListPtr->numVars = length;
+	    for (j = 0; j < length; j++) {
+		varListPtr->varIndexes[j] = GetInt(readerPtr);
+	    }
+	    infoPtr->varLists[infoPtr->numLists++] = varListPtr;
+	}
+    }
+    Tcl_DStringFree(&ds);
+    return readerPtr->ok;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WriteCompileEnv --
+ *
+ *	Encodes the result of a compilation: the procedure's compiled locals
+ *	created by the compilation, the code, the literals (with their
+ *	invisible continuation lines), the exception ranges, the AuxData
+ *	items, the command location map and the TIP #280 line information
+ *	(relative to the first line of the script).
+ *
+ * Results:
+ *	Returns 0 if the compilation cannot be encoded.
+ *
+ * Side effects:
+ *	Appends to the DString.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+WriteCompileEnv(
+    Tcl_Interp *interp,
+    CompileEnv *envPtr,
+    Tcl_DString *dsPtr)
+{
+    Proc *procPtr = envPtr->procPtr;
+    LiteralTable *tablePtr = &envPtr->localLitTable;
+    ExtCmdLoc *eclPtr = envPtr->extCmdMapPtr;
+    Tcl_Size i, j, length;
+    const char *bytes;
+    char *inLocalTable;
+
+    /*
+     * The compiled locals. Those of the arguments are part of the key.
+     */
+
+    if (procPtr != NULL) {
+	CompiledLocal *localPtr = procPtr->firstLocalPtr;
+
+	PutInt(dsPtr, procPtr->numCompiledLocals - procPtr->numArgs);
+	for (i = 0; localPtr != NULL; i++, localPtr = localPtr->nextPtr) {
+	    if (i < procPtr->numArgs) {
+		continue;
+	    }
+	    if (localPtr->flags & VAR_TEMPORARY) {
+		PutInt(dsPtr, -1);
+	    } else {
+		PutString(dsPtr, localPtr->name, localPtr->nameLength);
+	    }
+	}
+    } else {
+	PutInt(dsPtr, 0);
+    }
+
+    PutString(dsPtr, (char *) envPtr->codeStart,
+	    envPtr->codeNext - envPtr->codeStart);
+
+    /*
+     * The literals, with the literal tables they are in.
+     */
+
+    PutInt(dsPtr, envPtr->literalArrayNext);
+    inLocalTable = (char *) Tcl_Alloc(envPtr->literalArrayNext + 1);
+    memset(inLocalTable, 0, envPtr->literalArrayNext + 1);
+    for (i = 0; i < (Tcl_Size) tablePtr->numBuckets; i++) {
+	LiteralEntry *entryPtr;
+
+	for (entryPtr = tablePtr->buckets[i]; entryPtr != NULL;
+		entryPtr = entryPtr->nextPtr) {
+	    inLocalTable[entryPtr - envPtr->literalArrayPtr] = 1;
+	}
+    }
+    for (i = 0; i < envPtr->literalArrayNext; i++) {
+	Tcl_Obj *objPtr = envPtr->literalArrayPtr[i].objPtr;
+	ContLineLoc *clLocPtr = TclContinuationsGet(objPtr);
+	LiteralEntry *globalPtr;
+
+	if (!inLocalTable[i] && objPtr->bytes == NULL) {
+	    /*
+	     * Don't generate the string representation of the literal itself,
+	     * the code may count on there not being one.
+	     */
+
+	    Tcl_Obj *dupPtr = Tcl_DuplicateObj(objPtr);
+
+	    PutInt(dsPtr, TclHasInternalRep(objPtr, &tclListType.objType)
+		    ? LITERAL_PRIVATE_LIST : LITERAL_PRIVATE);
+	    bytes = Tcl_GetStringFromObj(dupPtr, &length);
+	    PutString(dsPtr, bytes, length);
+	    Tcl_DecrRefCount(dupPtr);
+	    PutInt(dsPtr, 0);
+	    continue;
+	} else if (!inLocalTable[i]) {
+	    PutInt(dsPtr, LITERAL_PRIVATE);
+	} else if ((globalPtr = TclLookupLiteralEntry(interp, objPtr))) {
+	    PutInt(dsPtr, globalPtr->nsPtr ? LITERAL_SHARED_CMD
+		    : LITERAL_SHARED);
+	} else {
+	    PutInt(dsPtr, LITERAL_LOCAL);
+	}
+	bytes = Tcl_GetStringFromObj(objPtr, &length);
+	PutString(dsPtr, bytes, length);
+	PutInt(dsPtr, clLocPtr ? clLocPtr->num : 0);
+	for (j = 0; clLocPtr && j < clLocPtr->num; j++) {
+	    PutInt(dsPtr, clLocPtr->loc[j]);
+	}
+    }
+    Tcl_Free(inLocalTable);
+
+    PutInt(dsPtr, envPtr->exceptArrayNext);
+    for (i = 0; i < envPtr->exceptArrayNext; i++) {
+	ExceptionRange *rangePtr = &envPtr->exceptArrayPtr[i];
+
+	PutInt(dsPtr, rangePtr->type);
+	PutInt(dsPtr, rangePtr->nestingLevel);
+	PutInt(dsPtr, rangePtr->codeOffset);
+	PutInt(dsPtr, rangePtr->numCodeBytes);
+	PutInt(dsPtr, rangePtr->breakOffset);
+	PutInt(dsPtr, rangePtr->continueOffset);
+	PutInt(dsPtr, rangePtr->catchOffset);
+    }
+
+    PutInt(dsPtr, envPtr->auxDataArrayNext);
+    for (i = 0; i < envPtr->auxDataArrayNext; i++) {
+	if (!WriteAuxData(&envPtr->auxDataArrayPtr[i], dsPtr)) {
+	    return 0;
+	}
+    }
+
+    PutInt(dsPtr, envPtr->numCommands);
+    for (i = 0; i < envPtr->numCommands; i++) {
+	CmdLocation *locPtr = &envPtr->cmdMapPtr[i];
+
+	PutInt(dsPtr, locPtr->codeOffset);
+	PutInt(dsPtr, locPtr->numCodeBytes);
+	PutInt(dsPtr, locPtr->srcOffset);
+	PutInt(dsPtr, locPtr->numSrcBytes);
+    }
+
+    PutInt(dsPtr, eclPtr->nuloc);
+    for (i = 0; i < eclPtr->nuloc; i++) {
+	ECL *locPtr = &eclPtr->loc[i];
+
+	PutInt(dsPtr, locPtr->srcOffset);
+	PutInt(dsPtr, locPtr->nline);
+	for (j = 0; j < locPtr->nline; j++) {
+	    PutInt(dsPtr, locPtr->line[j] < 0 ? -1
+		    : locPtr->line[j] - eclPtr->start);
+	}
+    }
+
+    PutInt(dsPtr, envPtr->maxStackDepth);
+    PutInt(dsPtr, envPtr->maxExceptDepth);
+    return 1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ReadCompileEnv --
+ *
+ *	Decodes the result of a compilation encoded by WriteCompileEnv into a
+ *	freshly initialized CompileEnv.
+ *
+ * Results:
+ *	Returns 1 on success. Returns 0 if the data is not valid (see also
+ *	VerifyCode); the CompileEnv is then reset to its initial state.
+ *
+ * Side effects:
+ *	Fills the CompileEnv, registers literals and creates compiled locals
+ *	of the procedure, just as compiling the script would.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ReadCompileEnv(
+    Tcl_Interp *interp,
+    CacheReader *readerPtr,
+    CompileEnv *envPtr)
+{
+    ExtCmdLoc *eclPtr = envPtr->extCmdMapPtr;
+    Tcl_Size i, j, count, length, index;
+    const char *bytes;
+    int *lines;
+
+    count = GetCount(readerPtr, 4);
+    if (count > 0 && envPtr->procPtr == NULL) {
+	goto error;
+    }
+    for (i = 0; i < count; i++) {
+	length = GetInt(readerPtr);
+	if (!readerPtr->ok) {
+	    goto error;
+	} else if (length < 0) {
+	    index = TclFindCompiledLocal(NULL, 0, 1, envPtr);
+	} else {
+	    readerPtr->next -= 4;
+	    bytes = GetString(readerPtr, &length);
+	    if (!readerPtr->ok) {
+		goto error;
+	    }
+	    index = TclFindCompiledLocal(bytes, length, 1, envPtr);
+	}
+	if (index != envPtr->procPtr->numArgs + i) {
+	    goto error;
+	}
+    }
+
+    bytes = GetString(readerPtr, &length);
+    if (!readerPtr->ok || length < 1) {
+	goto error;
+    }
+    while (envPtr->codeEnd - envPtr->codeStart < length) {
+	TclExpandCodeArray(envPtr);
+    }
+    memcpy(envPtr->codeStart, bytes, length);
+    envPtr->codeNext = envPtr->codeStart + length;
+
+    count = GetCount(readerPtr, 12);
+    for (i = 0; i < count; i++) {
+	int kind = GetInt(readerPtr);
+
+	bytes = GetString(readerPtr, &length);
+	if (!readerPtr->ok) {
+	    goto error;
+	}
+	switch (kind) {
+	case LITERAL_SHARED:
+	    index = TclRegisterLiteral(envPtr, bytes, length, 0);
+	    break;
+	case LITERAL_SHARED_CMD:
+	    index = TclRegisterLiteral(envPtr, bytes, length,
+		    LITERAL_CMD_NAME);
+	    break;
+	case LITERAL_LOCAL:
+	    index = TclRegisterLiteral(envPtr, bytes, length,
+		    LITERAL_UNSHARED);
+	    break;
+	case LITERAL_PRIVATE:
+	case LITERAL_PRIVATE_LIST: {
+	    Tcl_Obj *objPtr = Tcl_NewStringObj(bytes, length);
+
+	    if (kind == LITERAL_PRIVATE_LIST) {
+		if (Tcl_ListObjLength(NULL, objPtr, &index) != TCL_OK) {
+		    Tcl_DecrRefCount(objPtr);
+		    goto error;
+		}
+		TclInvalidateStringRep(objPtr);
+	    }
+	    index = TclAddLiteralObj(envPtr, objPtr, NULL);
+	    break;
+	}
+	default:
+	    goto error;
+	}
+	if (index != i) {
+	    goto error;
+	}
+
+	length = GetCount(readerPtr, 4);
+	if (length > 0) {
+	    lines = (int *) Tcl_Alloc(length * sizeof(int));
+	    for (j = 0; j < length; j++) {
+		lines[j] = GetInt(readerPtr);
+	    }
+	    TclContinuationsEnter(TclFetchLiteral(envPtr, index), length,
+		    lines);
+	    Tcl_Free(lines);
+	}
+    }
+
+    count = GetCount(readerPtr, 28);
+    for (i = 0; i < count; i++) {
+	ExceptionRangeType type = (ExceptionRangeType) GetInt(readerPtr);
+	ExceptionRange *rangePtr;
+
+	if (type != LOOP_EXCEPTION_RANGE && type != CATCH_EXCEPTION_RANGE) {
+	    goto error;
+	}
+	rangePtr = &envPtr->exceptArrayPtr[TclCreateExceptRange(type, envPtr)];
+	rangePtr->nestingLevel = GetInt(readerPtr);
+	rangePtr->codeOffset = GetInt(readerPtr);
+	rangePtr->numCodeBytes = GetInt(readerPtr);
+	rangePtr->breakOffset = GetInt(readerPtr);
+	rangePtr->continueOffset = GetInt(readerPtr);
+	rangePtr->catchOffset = GetInt(readerPtr);
+    }
+
+    count = GetCount(readerPtr, 8);
+    for (i = 0; i < count; i++) {
+	if (!ReadAuxData(readerPtr, envPtr)) {
+	    goto error;
+	}
+    }
+
+    count = GetCount(readerPtr, 16);
+    if (count > envPtr->cmdMapEnd) {
+	envPtr->cmdMapPtr = (CmdLocation *)
+		Tcl_Alloc(count * sizeof(CmdLocation));
+	envPtr->cmdMapEnd = count;
+	envPtr->mallocedCmdMap = 1;
+    }
+    for (i = 0; i < count; i++) {
+	CmdLocation *locPtr = &envPtr->cmdMapPtr[i];
+
+	locPtr->codeOffset = GetInt(readerPtr);
+	locPtr->numCodeBytes = GetInt(readerPtr);
+	locPtr->srcOffset = GetInt(readerPtr);
+	locPtr->numSrcBytes = GetInt(readerPtr);
+    }
+    envPtr->numCommands = count;
+
+    count = GetCount(readerPtr, 8);
+    if (count > 0) {
+	eclPtr->loc = (ECL *) Tcl_Alloc(count * sizeof(ECL));
+	eclPtr->nloc = count;
+    }
+    for (i = 0; i < count; i++) {
+	ECL *locPtr = &eclPtr->loc[i];
+
+	locPtr->srcOffset = GetInt(readerPtr);
+	length = GetCount(readerPtr, 4);
+	locPtr->nline = length;
+	locPtr->line = (int *) Tcl_Alloc((length + 1) * sizeof(int));
+	locPtr->next = NULL;
+	eclPtr->nuloc++;
+	for (j = 0; j < length; j++) {
+	    int line = GetInt(readerPtr);
+
+	    locPtr->line[j] = (line < 0) ? -1 : line + eclPtr->start;
+	}
+    }
+
+    envPtr->maxStackDepth = GetInt(readerPtr);
+    envPtr->maxExceptDepth = GetInt(readerPtr);
+    if (readerPtr->ok && readerPtr->next == readerPtr->end
+	    && VerifyCode(envPtr)) {
+	return 1;
+    }
+
+  error:
+    ResetCompileEnv(interp, envPtr);
+    return 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * VerifyCode --
+ *
+ *	Checks that the code decoded into a CompileEnv is well formed: that
+ *	it is a sequence of complete instructions ending with INST_DONE, that
+ *	their operands refer to existing local variables, literals and AuxData
+ *	items of the right type, that all jumps (including those of jump
+ *	tables and exception ranges) land inside the code, and that the
+ *	command map stays within the code and the source.
+ *
+ * Results:
+ *	Returns 1 if the code is well formed, else 0.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+#define IN_CODE(offset)	((offset) >= 0 && (offset) < length)
+#define IS_LOCAL(index)	((index) >= 0 && (index) < numLocals)
+
+static int
+VerifyCode(
+    CompileEnv *envPtr)
+{
+    const unsigned char *code = envPtr->codeStart;
+    Tcl_Size length = envPtr->codeNext - envPtr->codeStart;
+    Tcl_Size numLocals = envPtr->procPtr
+	    ? envPtr->procPtr->numCompiledLocals : 0;
+    Tcl_Size pc, lastPc = 0, i, j, operand;
+    const InstructionDesc *instPtr;
+    AuxData *auxPtr;
+
+    for (pc = 0; pc < length; pc += instPtr->numBytes) {
+	const unsigned char *p = code + pc + 1;
+
+	if (code[pc] >= LAST_INST_OPCODE) {
+	    return 0;
+	}
+	instPtr = &tclInstructionTable[code[pc]];
+	if (instPtr->numBytes > length - pc) {
+	    return 0;
+	}
+	for (i = 0; i < instPtr->numOperands; i++) {
+	    switch (instPtr->opTypes[i]) {
+	    case OPERAND_INT1:
+	    case OPERAND_UINT1:
+		p++;
+		break;
+	    case OPERAND_INT4:
+	    case OPERAND_UINT4:
+	    case OPERAND_IDX4:
+		p += 4;
+		break;
+	    case OPERAND_LVT1:
+		operand = TclGetUInt1AtPtr(p++);
+		if (!IS_LOCAL(operand)) {
+		    return 0;
+		}
+		break;
+	    case OPERAND_LVT4:
+		operand = TclGetInt4AtPtr(p);
+		p += 4;
+		if (!IS_LOCAL(operand)) {
+		    return 0;
+		}
+		break;
+	    case OPERAND_LIT1:
+		operand = TclGetUInt1AtPtr(p++);
+		if (operand >= envPtr->literalArrayNext) {
+		    return 0;
+		}
+		break;
+	    case OPERAND_LIT4:
+		operand = TclGetInt4AtPtr(p);
+		p += 4;
+		if (operand < 0 || operand >= envPtr->literalArrayNext) {
+		    return 0;
+		}
+		break;
+	    case OPERAND_OFFSET1:
+		operand = pc + TclGetInt1AtPtr(p++);
+		if (!IN_CODE(operand)) {
+		    return 0;
+		}
+		break;
+	    case OPERAND_OFFSET4:
+		operand = pc + TclGetInt4AtPtr(p);
+		p += 4;
+		if (!IN_CODE(operand)) {
+		    return 0;
+		}
+		break;
+	    case OPERAND_SCLS1:
+		if (TclGetUInt1AtPtr(p++) > STR_CLASS_UNICODE) {
+		    return 0;
+		}
+		break;
+	    case OPERAND_AUX4:
+		operand = TclGetInt4AtPtr(p);
+		p += 4;
+		if (operand < 0 || operand >= envPtr->auxDataArrayNext) {
+		    return 0;
+		}
+		auxPtr = &envPtr->auxDataArrayPtr[operand];
+		switch (code[pc]) {
+		case INST_JUMP_TABLE: {
+		    JumptableInfo *jtPtr;
+		    Tcl_HashEntry *hPtr;
+		    Tcl_HashSearch search;
+
+		    if (auxPtr->type != &tclJumptableInfoType) {
+			return 0;
+		    }
+		    jtPtr = (JumptableInfo *) auxPtr->clientData;
+		    for (hPtr = Tcl_FirstHashEntry(&jtPtr->hashTable, &search);
+			    hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+			if (!IN_CODE(pc + PTR2INT(Tcl_GetHashValue(hPtr)))) {
+			    return 0;
+			}
+		    }
+		    break;
+		}
+		case INST_FOREACH_START: {
+		    Tcl_Size stepPc;
+
+		    /*
+		     * The loopCtTemp field holds the distance from the loop's
+		     * INST_FOREACH_STEP back to the start of its body.
+		     */
+
+		    if (strcmp(auxPtr->type->name, "NewForeachInfo")) {
+			return 0;
+		    }
+		    operand = ((ForeachInfo *) auxPtr->clientData)->loopCtTemp;
+		    stepPc = pc + 5 - operand;
+		    if (!IN_CODE(stepPc) || code[stepPc] != INST_FOREACH_STEP
+			    || !IN_CODE(stepPc + operand)) {
+			return 0;
+		    }
+		    break;
+		}
+		case INST_DICT_UPDATE_START:
+		case INST_DICT_UPDATE_END:
+		    if (strcmp(auxPtr->type->name, "DictUpdateInfo")) {
+			return 0;
+		    }
+		    break;
+		default:
+		    return 0;
+		}
+		break;
+	    default:
+		return 0;
+	    }
+	}
+	if (code[pc] == INST_RETURN_CODE_BRANCH
+		&& !IN_CODE(pc + 2 * (TCL_CONTINUE + 1) - 1)) {
+	    return 0;
+	}
+	lastPc = pc;
+    }
+    if (length == 0 || code[lastPc] != INST_DONE) {
+	return 0;
+    }
+
+    /*
+     * The local variables the AuxData items refer to.
+     */
+
+    for (i = 0; i < envPtr->auxDataArrayNext; i++) {
+	auxPtr = &envPtr->auxDataArrayPtr[i];
+	if (!strcmp(auxPtr->type->name, "DictUpdateInfo")) {
+	    DictUpdateInfo *duiPtr = (DictUpdateInfo *) auxPtr->clientData;
+
+	    for (j = 0; j < duiPtr->length; j++) {
+		if (!IS_LOCAL(duiPtr->varIndices[j])) {
+		    return 0;
+		}
+	    }
+	} else if (auxPtr->type != &tclJumptableInfoType) {
+	    ForeachInfo *infoPtr = (ForeachInfo *) auxPtr->clientData;
+
+	    for (j = 0; j < infoPtr->numLists; j++) {
+		ForeachVarList *varListPtr = infoPtr->varLists[j];
+		Tcl_Size k;
+
+		for (k = 0; k < varListPtr->numVars; k++) {
+		    if (!IS_LOCAL(varListPtr->varIndexes[k])) {
+			return 0;
+		    }
+		}
+	    }
+	}
+    }
+
+    for (i = 0; i < envPtr->exceptArrayNext; i++) {
+	ExceptionRange *rangePtr = &envPtr->exceptArrayPtr[i];
+
+	if (rangePtr->codeOffset < 0 || rangePtr->numCodeBytes < 0
+		|| rangePtr->codeOffset > length - rangePtr->numCodeBytes) {
+	    return 0;
+	}
+	if (rangePtr->type == CATCH_EXCEPTION_RANGE
+		? !IN_CODE(rangePtr->catchOffset)
+		: (!IN_CODE(rangePtr->breakOffset)
+			|| (rangePtr->continueOffset != TCL_INDEX_NONE
+			&& !IN_CODE(rangePtr->continueOffset)))) {
+	    return 0;
+	}
+    }
+
+    for (i = 0; i < envPtr->numCommands; i++) {
+	CmdLocation *locPtr = &envPtr->cmdMapPtr[i];
+
+	if (locPtr->codeOffset < 0 || locPtr->numCodeBytes < 0
+		|| locPtr->codeOffset > length - locPtr->numCodeBytes
+		|| locPtr->srcOffset < 0 || locPtr->numSrcBytes < 0
+		|| locPtr->srcOffset
+			> envPtr->numSrcBytes - locPtr->numSrcBytes) {
+	    return 0;
+	}
+    }
+    return envPtr->maxStackDepth >= 0 && envPtr->maxExceptDepth >= 0;
+}
+
+#undef IN_CODE
+#undef IS_LOCAL
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ResetCompileEnv --
+ *
+ *	Returns a CompileEnv that was partially filled from a cache file to
+ *	the state it had after TclInitCompileEnv, so that the script can be
+ *	compiled after all.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Releases what the CompileEnv holds and deletes the compiled locals
+ *	that were created for the procedure.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ResetCompileEnv(
+    Tcl_Interp *interp,
+    CompileEnv *envPtr)
+{
+    Interp *iPtr = (Interp *) interp;
+    Proc *procPtr = envPtr->procPtr;
+    const char *source = envPtr->source;
+    Tcl_Size i, numSrcBytes = envPtr->numSrcBytes;
+
+    /*
+     * TclInitCompileEnv consumed the TCL_EVAL_FILE flag of a sourced file.
+     */
+
+    if (iPtr->invokeCmdFramePtr == NULL) {
+	iPtr->evalFlags |= TCL_EVAL_FILE;
+    }
+    TclFreeCompileEnv(envPtr);
+
+    if (procPtr != NULL && procPtr->numCompiledLocals > procPtr->numArgs) {
+	CompiledLocal *localPtr = procPtr->firstLocalPtr;
+	CompiledLocal *lastPtr = NULL;
+
+	for (i = 0; i < procPtr->numArgs; i++) {
+	    lastPtr = localPtr;
+	    localPtr = localPtr->nextPtr;
+	}
+	if (lastPtr) {
+	    lastPtr->nextPtr = NULL;
+	} else {
+	    procPtr->firstLocalPtr = NULL;
+	}
+	procPtr->lastLocalPtr = lastPtr;
+	while (localPtr) {
+	    CompiledLocal *toFree = localPtr;
+
+	    localPtr = localPtr->nextPtr;
+	    Tcl_Free(toFree);
+	}
+	procPtr->numCompiledLocals = procPtr->numArgs;
+    }
+
+    iPtr->compiledProcPtr = procPtr;
+    TclInitCompileEnv(interp, envPtr, source, numSrcBytes,
+	    iPtr->invokeCmdFramePtr, iPtr->invokeWord);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * DecodeCompilation --
+ *
+ *	Checks that an encoded compilation (the contents of a cache file
+ *	without the MAC) was made for the given key and the script of a
+ *	CompileEnv, and that the commands the code depends on are still the
+ *	same, and if so, fills the CompileEnv from it.
+ *
+ * Results:
+ *	Returns 1 if the CompileEnv was filled, else 0.
+ *
+ * Side effects:
+ *	See ReadCompileEnv.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+DecodeCompilation(
+    Tcl_Interp *interp,
+    const unsigned char *bytes,
+    Tcl_Size length,
+    Tcl_Obj *keyPtr,
+    CompileEnv *envPtr)
+{
+    CacheReader reader;
+    const char *string;
+    Tcl_Size keyLength;
+    const char *keyBytes = Tcl_GetStringFromObj(keyPtr, &keyLength);
+
+    if (length < CACHE_MAGIC_LENGTH
+	    || memcmp(bytes, CACHE_MAGIC, CACHE_MAGIC_LENGTH) != 0) {
+	return 0;
+    }
+    reader.next = bytes + CACHE_MAGIC_LENGTH;
+    reader.end = bytes + length;
+    reader.ok = 1;
+
+    /*
+     * The name is only a hash: check that the data is for this key and this
+     * script, and that the commands the code depends on are the same.
+     */
+
+    string = GetString(&reader, &length);
+    if (!reader.ok || length != keyLength
+	    || memcmp(string, keyBytes, length) != 0) {
+	return 0;
+    }
+    string = GetString(&reader, &length);
+    if (!reader.ok || length != envPtr->numSrcBytes
+	    || memcmp(string, envPtr->source, length) != 0) {
+	return 0;
+    }
+    return CheckDependencies(interp, &reader)
+	    && ReadCompileEnv(interp, &reader, envPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclLoadCachedByteCode --
+ *
+ *	Looks for the compiled form of the script of a CompileEnv in the
+ *	process-wide store and then in the bytecode cache directory, and if a
+ *	valid one is found, fills the CompileEnv with it as if the script had
+ *	been compiled. The key must have been obtained from
+ *	TclGetByteCodeCacheKey for the same CompileEnv.
+ *
+ * Results:
+ *	Returns 1 if the CompileEnv was filled from the cache, else 0.
+ *
+ * Side effects:
+ *	Reads the cache file, which is only used if it is private and its MAC
+ *	is right. A compilation loaded from a file is added to the
+ *	process-wide store. A compilation that is in the store gets the body
+ *	of its entry (see ShareByteCodeBody).
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclLoadCachedByteCode(
+    Tcl_Interp *interp,
+    Tcl_Obj *keyPtr,
+    CompileEnv *envPtr)
+{
+    ByteCodeCache *bccPtr = GetByteCodeCache(interp);
+    SharedCode *codePtr;
+    Tcl_Obj *pathPtr, *dataPtr;
+    Tcl_Channel chan;
+    const unsigned char *bytes;
+    Tcl_Size length;
+    Tcl_WideUInt mac;
+    char name[CACHE_NAME_LENGTH];
+    int loaded = 0;
+
+    CacheName(keyPtr, envPtr, name);
+    codePtr = FetchSharedCode(name);
+    if (codePtr != NULL) {
+	loaded = DecodeCompilation(interp, codePtr->bytes, codePtr->length,
+		keyPtr, envPtr);
+	if (loaded) {
+	    ShareByteCodeBody(codePtr, envPtr);
+	    bccPtr->numLoaded++;
+	}
+	ReleaseSharedCode(codePtr);
+	return loaded;
+    }
+    if (bccPtr->dirPtr == NULL) {
+	return 0;
+    }
+
+    bccPtr->busy = 1;
+    if (!GetCacheKey(bccPtr)) {
+	bccPtr->busy = 0;
+	return 0;
+    }
+    pathPtr = CacheFilePath(bccPtr, name);
+    chan = NULL;
+    if (IsPrivateFile(pathPtr, 0)) {
+	chan = Tcl_FSOpenFileChannel(NULL, pathPtr, "rb", 0);
+    }
+    Tcl_DecrRefCount(pathPtr);
+    if (chan == NULL) {
+	bccPtr->busy = 0;
+	return 0;
+    }
+    TclNewObj(dataPtr);
+    Tcl_IncrRefCount(dataPtr);
+    if (Tcl_ReadChars(chan, dataPtr, -1, 0) >= 0) {
+	bytes = Tcl_GetBytesFromObj(NULL, dataPtr, &length);
+	if (bytes != NULL && length > CACHE_MAC_LENGTH) {
+	    length -= CACHE_MAC_LENGTH;
+	    mac = CacheMac(bccPtr, bytes, length);
+	    if (TclGetUInt4AtPtr(bytes + length) == (unsigned) (mac >> 32)
+		    && TclGetUInt4AtPtr(bytes + length + 4)
+			    == (unsigned) (mac & 0xFFFFFFFF)
+		    && DecodeCompilation(interp, bytes, length, keyPtr,
+			    envPtr)) {
+		if (StoreSharedCode(name, bytes, length, &codePtr)) {
+		    ShareByteCodeBody(codePtr, envPtr);
+		    ReleaseSharedCode(codePtr);
+		}
+		bccPtr->numLoaded++;
+		loaded = 1;
+	    }
+	}
+    }
+    Tcl_Close(NULL, chan);
+    Tcl_DecrRefCount(dataPtr);
+    bccPtr->busy = 0;
+    return loaded;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclSaveCachedByteCode --
+ *
+ *	Stores the result of the compilation of the script of a CompileEnv
+ *	in the process-wide store and the bytecode cache directory. This must
+ *	be called right after compilation (the compiler must have recorded the
+ *	resolved command names in the CompileEnv's cmdDepsPtr), before the
+ *	CompileEnv is turned into a ByteCode.
+ *
+ * Results:
+ *	None. Failures (e.g., an unwritable or not private cache directory)
+ *	are ignored.
+ *
+ * Side effects:
+ *	Writes the cache file.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TclSaveCachedByteCode(
+    Tcl_Interp *interp,
+    Tcl_Obj *keyPtr,
+    CompileEnv *envPtr)
+{
+    ByteCodeCache *bccPtr = GetByteCodeCache(interp);
+    Tcl_Obj *pathPtr;
+    Tcl_DString ds;
+    Tcl_Size length;
+    const char *bytes;
+    Tcl_WideUInt mac;
+    char name[CACHE_NAME_LENGTH];
+    int stored;
+
+    if (envPtr->cmdDepsPtr == NULL) {
+	return;
+    }
+
+    Tcl_DStringInit(&ds);
+    Tcl_DStringAppend(&ds, CACHE_MAGIC, CACHE_MAGIC_LENGTH);
+    bytes = Tcl_GetStringFromObj(keyPtr, &length);
+    PutString(&ds, bytes, length);
+    PutString(&ds, envPtr->source, envPtr->numSrcBytes);
+    WriteDependencies(interp, envPtr->cmdDepsPtr, &ds);
+    if (WriteCompileEnv(interp, envPtr, &ds)) {
+	CacheName(keyPtr, envPtr, name);
+	stored = StoreSharedCode(name,
+		(unsigned char *) Tcl_DStringValue(&ds), Tcl_DStringLength(&ds),
+		NULL);
+	if (bccPtr->dirPtr != NULL) {
+	    bccPtr->busy = 1;
+	    if (GetCacheKey(bccPtr)) {
+		mac = CacheMac(bccPtr, (unsigned char *) Tcl_DStringValue(&ds),
+			Tcl_DStringLength(&ds));
+		PutInt(&ds, (Tcl_Size) (mac >> 32));
+		PutInt(&ds, (Tcl_Size) (mac & 0xFFFFFFFF));
+		pathPtr = CacheFilePath(bccPtr, name);
+		if (WriteCacheFile(bccPtr, pathPtr, &ds)) {
+		    stored = 1;
+		}
+		Tcl_DecrRefCount(pathPtr);
+	    }
+	    bccPtr->busy = 0;
+	}
+	if (stored) {
+	    bccPtr->numStored++;
+	}
+    }
+    Tcl_DStringFree(&ds);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * WriteCacheFile --
+ *
+ *	Writes a cache file. The data is written to a temporary file which is
+ *	then renamed, so that concurrent readers never see a partial file.
+ *
+ * Results:
+ *	Returns whether the file was written.
+ *
+ * Side effects:
+ *	Writes to the cache directory.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+WriteCacheFile(
+    ByteCodeCache *bccPtr,
+    Tcl_Obj *pathPtr,
+    Tcl_DString *dsPtr)
+{
+    Tcl_Obj *tempPtr;
+    Tcl_Channel chan;
+    int written = 0;
+
+    TclNewObj(tempPtr);
+    Tcl_IncrRefCount(tempPtr);
+    chan = TclpOpenTemporaryFile(bccPtr->dirPtr, NULL, NULL, tempPtr);
+    if (chan != NULL) {
+	Tcl_SetChannelOption(NULL, chan, "-translation", "binary");
+	written = (Tcl_Write(chan, Tcl_DStringValue(dsPtr),
+		Tcl_DStringLength(dsPtr)) == Tcl_DStringLength(dsPtr));
+	if (Tcl_Close(NULL, chan) != TCL_OK) {
+	    written = 0;
+	}
+	if (written && Tcl_FSRenameFile(tempPtr, pathPtr) != TCL_OK) {
+	    written = 0;
+	}
+	if (!written) {
+	    Tcl_FSDeleteFile(tempPtr);
+	}
+    }
+    Tcl_DecrRefCount(tempPtr);
+    return written;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SharedCodeEnabled --
+ *
+ *	Tells whether compilations are kept in the process-wide store. The
+ *	store is set up, and configured from the TCL_BYTECODE_SHARE
+ *	environment variable, when this is first called.
+ *
+ * Results:
+ *	Whether the store is enabled.
+ *
+ * Side effects:
+ *	May initialize the store.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+SharedCodeEnabled(void)
+{
+    int enabled;
+
+    Tcl_MutexLock(&sharedCodeMutex);
+    if (!sharedCode.initialized) {
+	Tcl_DString ds;
+	const char *value = TclGetEnv("TCL_BYTECODE_SHARE", &ds);
+
+	Tcl_InitHashTable(&sharedCode.table, TCL_STRING_KEYS);
+	sharedCode.numBytes = 0;
+	sharedCode.enabled = 0;
+	if (value != NULL) {
+	    Tcl_GetBoolean(NULL, value, &sharedCode.enabled);
+	    Tcl_DStringFree(&ds);
+	}
+	sharedCode.initialized = 1;
+    }
+    enabled = sharedCode.enabled;
+    Tcl_MutexUnlock(&sharedCodeMutex);
+    return enabled;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FetchSharedCode, ReleaseSharedCode, FreeSharedCode --
+ *
+ *	FetchSharedCode looks up an encoded compilation in the process-wide
+ *	store; the caller may read the returned entry until it passes it to
+ *	ReleaseSharedCode. FreeSharedCode frees an entry whose reference
+ *	count has dropped to zero; it must be called with the store's mutex
+ *	held.
+ *
+ * Results:
+ *	FetchSharedCode returns the entry, or NULL if there is none.
+ *
+ * Side effects:
+ *	Changes the reference count of the entry; ReleaseSharedCode frees it
+ *	if it was removed from the store in the meantime. Freeing an entry
+ *	releases its body.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static SharedCode *
+FetchSharedCode(
+    const char *name)
+{
+    SharedCode *codePtr = NULL;
+    Tcl_HashEntry *hPtr;
+
+    if (!SharedCodeEnabled()) {
+	return NULL;
+    }
+    Tcl_MutexLock(&sharedCodeMutex);
+    hPtr = Tcl_FindHashEntry(&sharedCode.table, name);
+    if (hPtr != NULL) {
+	codePtr = (SharedCode *) Tcl_GetHashValue(hPtr);
+	codePtr->refCount++;
+    }
+    Tcl_MutexUnlock(&sharedCodeMutex);
+    return codePtr;
+}
+
+static void
+ReleaseSharedCode(
+    SharedCode *codePtr)
+{
+    Tcl_MutexLock(&sharedCodeMutex);
+    if (codePtr->refCount-- <= 1) {
+	FreeSharedCode(codePtr);
+    }
+    Tcl_MutexUnlock(&sharedCodeMutex);
+}
+
+static void
+FreeSharedCode(
+    SharedCode *codePtr)
+{
+    if (codePtr->bodyPtr != NULL && codePtr->bodyPtr->refCount-- <= 1) {
+	TclFreeByteCodeBody(codePtr->bodyPtr);
+    }
+    Tcl_Free(codePtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ShareByteCodeBody, TclReleaseByteCodeBody --
+ *
+ *	ShareByteCodeBody gives a CompileEnv just decoded from an entry of the
+ *	process-wide store the body of that entry, which is made from the
+ *	CompileEnv if the entry has none yet, so that the ByteCode made from
+ *	the CompileEnv shares it with those of other interpreters.
+ *	TclReleaseByteCodeBody drops a reference to a body.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The aux data items of the CompileEnv pass to the new body or are
+ *	freed, since the body has its own. TclReleaseByteCodeBody frees the
+ *	body when it is no longer used.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ShareByteCodeBody(
+    SharedCode *codePtr,
+    CompileEnv *envPtr)
+{
+    ByteCodeBody *bodyPtr;
+    AuxData *auxDataPtr = envPtr->auxDataArrayPtr;
+    Tcl_Size i;
+
+    Tcl_MutexLock(&sharedCodeMutex);
+    bodyPtr = codePtr->bodyPtr;
+    if (bodyPtr == NULL) {
+	bodyPtr = TclCreateByteCodeBody(envPtr);
+	bodyPtr->refCount++;
+	codePtr->bodyPtr = bodyPtr;
+    } else {
+	bodyPtr->refCount++;
+    }
+    Tcl_MutexUnlock(&sharedCodeMutex);
+
+    for (i = 0; i < envPtr->auxDataArrayNext; i++) {
+	if (auxDataPtr->type->freeProc != NULL) {
+	    auxDataPtr->type->freeProc(auxDataPtr->clientData);
+	}
+	auxDataPtr++;
+    }
+    envPtr->auxDataArrayNext = 0;
+    envPtr->bodyPtr = bodyPtr;
+}
+
+void
+TclReleaseByteCodeBody(
+    ByteCodeBody *bodyPtr)
+{
+    int unused;
+
+    Tcl_MutexLock(&sharedCodeMutex);
+    unused = (bodyPtr->refCount-- <= 1);
+    Tcl_MutexUnlock(&sharedCodeMutex);
+    if (unused) {
+	TclFreeByteCodeBody(bodyPtr);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * StoreSharedCode --
+ *
+ *	Adds an encoded compilation to the process-wide store, replacing any
+ *	entry with the same name. Nothing is added once the store holds
+ *	SHARED_CODE_LIMIT bytes.
+ *
+ * Results:
+ *	Returns whether the compilation was added. If so and codePtrPtr is not
+ *	NULL, the new entry is stored there, to be released by the caller
+ *	with ReleaseSharedCode.
+ *
+ * Side effects:
+ *	Copies the data.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+StoreSharedCode(
+    const char *name,
+    const unsigned char *bytes,
+    Tcl_Size length,
+    SharedCode **codePtrPtr)
+{
+    SharedCode *codePtr, *oldPtr;
+    Tcl_HashEntry *hPtr;
+    int isNew;
+
+    if (!SharedCodeEnabled()) {
+	return 0;
+    }
+    codePtr = (SharedCode *) Tcl_Alloc(offsetof(SharedCode, bytes) + length);
+    codePtr->refCount = (codePtrPtr != NULL) ? 2 : 1;
+    codePtr->bodyPtr = NULL;
+    codePtr->length = length;
+    memcpy(codePtr->bytes, bytes, length);
+
+    Tcl_MutexLock(&sharedCodeMutex);
+    if (!sharedCode.enabled
+	    || sharedCode.numBytes + length > SHARED_CODE_LIMIT) {
+	Tcl_MutexUnlock(&sharedCodeMutex);
+	Tcl_Free(codePtr);
+	return 0;
+    }
+    hPtr = Tcl_CreateHashEntry(&sharedCode.table, name, &isNew);
+    if (!isNew) {
+	oldPtr = (SharedCode *) Tcl_GetHashValue(hPtr);
+	sharedCode.numBytes -= oldPtr->length;
+	if (oldPtr->refCount-- <= 1) {
+	    FreeSharedCode(oldPtr);
+	}
+    }
+    Tcl_SetHashValue(hPtr, codePtr);
+    sharedCode.numBytes += length;
+    Tcl_MutexUnlock(&sharedCodeMutex);
+
+    if (codePtrPtr != NULL) {
+	*codePtrPtr = codePtr;
+    }
+    return 1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ClearSharedCode --
+ *
+ *	Removes all entries from the process-wide store. Must be called with
+ *	the store's mutex held.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Frees the entries that are not being read.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ClearSharedCode(void)
+{
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+
+    for (hPtr = Tcl_FirstHashEntry(&sharedCode.table, &search); hPtr != NULL;
+	    hPtr = Tcl_NextHashEntry(&search)) {
+	SharedCode *codePtr = (SharedCode *) Tcl_GetHashValue(hPtr);
+
+	if (codePtr->refCount-- <= 1) {
+	    FreeSharedCode(codePtr);
+	}
+	Tcl_DeleteHashEntry(hPtr);
+    }
+    sharedCode.numBytes = 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclFinalizeByteCodeCache --
+ *
+ *	Frees the process-wide store of compilations when Tcl is finalized.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	See above.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TclFinalizeByteCodeCache(void)
+{
+    Tcl_MutexLock(&sharedCodeMutex);
+    if (sharedCode.initialized) {
+	ClearSharedCode();
+	Tcl_DeleteHashTable(&sharedCode.table);
+	sharedCode.initialized = 0;
+    }
+    Tcl_MutexUnlock(&sharedCodeMutex);
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 4
+ * fill-column: 78
+ * End:
+ */
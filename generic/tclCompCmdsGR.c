@@ -2372,9 +2372,10 @@ TclCompileReturnCmd(
 	 */
 
 	int index = envPtr->exceptArrayNext - 1;
+	int base = (envPtr->inlinePtr ? envPtr->inlinePtr->exceptBase : 0);
 	int enclosingCatch = 0;
 
-	while (index >= 0) {
+	while (index >= base) {
 	    ExceptionRange range = envPtr->exceptArrayPtr[index];
 
 	    if ((range.type == CATCH_EXCEPTION_RANGE)
@@ -2387,12 +2388,17 @@ TclCompileReturnCmd(
 	if (!enclosingCatch) {
 	    /*
 	     * ... and there is no enclosing catch. Issue the maximally
-	     * efficient exit instruction.
+	     * efficient exit instruction, or jump to the end of the body of
+	     * the procedure if it is being inlined.
 	     */
 
 	    Tcl_DecrRefCount(returnOpts);
-	    TclEmitOpcode(INST_DONE, envPtr);
-	    TclAdjustStackDepth(1, envPtr);
+	    if (envPtr->inlinePtr) {
+		TclEmitInlinedReturn(envPtr);
+	    } else {
+		TclEmitOpcode(INST_DONE, envPtr);
+		TclAdjustStackDepth(1, envPtr);
+	    }
 	    return TCL_OK;
 	}
     }
@@ -509,13 +509,14 @@ typedef struct JumpList {
 
 static void		CompileExprTree(Tcl_Interp *interp, OpNode *nodes,
 			    int index, Tcl_Obj *const **litObjvPtr,
-			    Tcl_Obj *const *funcObjv, Tcl_Token *tokenPtr,
+			    Tcl_Obj *const **funcObjvPtr, Tcl_Token *tokenPtr,
 			    CompileEnv *envPtr, int optimize);
 static void		ConvertTreeToTokens(const char *start, Tcl_Size numBytes,
 			    OpNode *nodes, Tcl_Token *tokenPtr,
 			    Tcl_Parse *parsePtr);
 static int		ExecConstantExprTree(Tcl_Interp *interp, OpNode *nodes,
-			    int index, Tcl_Obj * const **litObjvPtr);
+			    int index, Tcl_Obj * const **litObjvPtr,
+			    Tcl_Obj *const **funcObjvPtr);
 static int		ParseExpr(Tcl_Interp *interp, const char *start,
 			    Tcl_Size numBytes, OpNode **opTreePtr,
 			    Tcl_Obj *litList, Tcl_Obj *funcList,
@@ -1080,13 +1081,24 @@ ParseExpr(
 	    nodePtr->mark = MARK_RIGHT;
 
 	    /*
-	     * A FUNCTION cannot be a constant expression, because Tcl allows
-	     * functions to return variable results with the same arguments;
-	     * for example, rand(). Other unary operators can root a constant
+	     * A FUNCTION generally cannot be a constant expression, because
+	     * Tcl allows functions to return variable results with the same
+	     * arguments; for example, rand(). The exceptions are the builtin
+	     * functions known to be pure, when we are going to compile the
+	     * expression. Other unary operators can root a constant
 	     * expression, so long as the argument is a constant expression.
 	     */
 
-	    nodePtr->constant = (lexeme != FUNCTION);
+	    nodePtr->constant = 1;
+	    if (lexeme == FUNCTION) {
+		Tcl_Size numFuncs;
+		Tcl_Obj *funcName;
+
+		TclListObjLengthM(NULL, funcList, &numFuncs);
+		Tcl_ListObjIndex(NULL, funcList, numFuncs - 1, &funcName);
+		nodePtr->constant = !parseOnly
+			&& TclIsPureMathFunc(interp, funcName);
+	    }
 
 	    /*
 	     * This unary operator is a new incomplete tree, so push it onto
@@ -1368,13 +1380,14 @@ ParseExpr(
 	    nodePtr->left = complete;
 
 	    /*
-	     * The COMMA operator cannot be optimized, since the function
-	     * needs all of its arguments, and optimization would reduce the
-	     * number. Other binary operators root constant expressions when
-	     * both arguments are constant expressions.
+	     * Binary operators root constant expressions when both arguments
+	     * are constant expressions. A constant COMMA only tells the
+	     * enclosing FUNCTION that all its arguments are constant; it is
+	     * never optimized on its own, since the function needs all of
+	     * its arguments, and optimization would reduce the number.
 	     */
 
-	    nodePtr->constant = (lexeme != COMMA);
+	    nodePtr->constant = 1;
 
 	    if (IsOperator(complete)) {
 		nodes[complete].p.parent = nodesUsed;
@@ -2220,15 +2233,31 @@ TclCompileExpr(
 
 	Tcl_Size objc;
 	Tcl_Obj *const *litObjv;
-	Tcl_Obj **funcObjv;
+	Tcl_Obj *const *funcObjv;
 
 	/* TIP #280 : Track Lines within the expression */
 	TclAdvanceLines(&envPtr->line, script,
 		script + TclParseAllWhiteSpace(script, numBytes));
 
 	TclListObjGetElementsM(NULL, litList, &objc, (Tcl_Obj ***)&litObjv);
-	TclListObjGetElementsM(NULL, funcList, &objc, &funcObjv);
-	CompileExprTree(interp, opTree, 0, &litObjv, funcObjv,
+	TclListObjGetElementsM(NULL, funcList, &objc, (Tcl_Obj ***)&funcObjv);
+
+	/*
+	 * Calls to pure functions may be folded, so the code depends on what
+	 * the function names resolve to.
+	 */
+
+	if (envPtr->cmdDepsPtr != NULL) {
+	    Tcl_Size i;
+
+	    for (i = 0; i < objc; i++) {
+		Tcl_Obj *cmdObj = Tcl_ObjPrintf("tcl::mathfunc::%s",
+			TclGetString(funcObjv[i]));
+
+		Tcl_ListObjAppendElement(NULL, envPtr->cmdDepsPtr, cmdObj);
+	    }
+	}
+	CompileExprTree(interp, opTree, 0, &litObjv, &funcObjv,
 		parsePtr->tokenPtr, envPtr, optimize);
     } else {
 	TclCompileSyntaxError(interp, envPtr);
@@ -2247,14 +2276,14 @@ TclCompileExpr(
  * ExecConstantExprTree --
  *	Compiles and executes bytecode for the subexpression tree at index
  *	in the nodes array.  This subexpression must be constant, made up
- *	of only constant operators (not functions) and literals.
+ *	of only constant operators, pure functions and literals.
  *
  * Results:
  *	A standard Tcl return code and result left in interp.
  *
  * Side effects:
- *	Consumes subtree of nodes rooted at index.  Advances the pointer
- *	*litObjvPtr.
+ *	Consumes subtree of nodes rooted at index.  Advances the pointers
+ *	*litObjvPtr and, when the subtree calls functions, *funcObjvPtr.
  *
  *----------------------------------------------------------------------
  */
@@ -2264,7 +2293,8 @@ ExecConstantExprTree(
     Tcl_Interp *interp,
     OpNode *nodes,
     int index,
-    Tcl_Obj *const **litObjvPtr)
+    Tcl_Obj *const **litObjvPtr,
+    Tcl_Obj *const **funcObjvPtr)
 {
     CompileEnv *envPtr;
     ByteCode *byteCodePtr;
@@ -2279,8 +2309,8 @@ ExecConstantExprTree(
 
     envPtr = (CompileEnv *)TclStackAlloc(interp, sizeof(CompileEnv));
     TclInitCompileEnv(interp, envPtr, NULL, 0, NULL, 0);
-    CompileExprTree(interp, nodes, index, litObjvPtr, NULL, NULL, envPtr,
-	    0 /* optimize */);
+    CompileExprTree(interp, nodes, index, litObjvPtr, funcObjvPtr, NULL,
+	    envPtr, 0 /* optimize */);
     TclEmitOpcode(INST_DONE, envPtr);
     byteCodePtr = TclInitByteCode(envPtr);
     TclFreeCompileEnv(envPtr);
@@ -2299,17 +2329,18 @@ ExecConstantExprTree(
  *	Compiles and writes to envPtr instructions for the subexpression tree
  *	at index in the nodes array. (*litObjvPtr) must point to the proper
  *	location in a corresponding literals list. Likewise, when non-NULL,
- *	funcObjv and tokenPtr must point into matching arrays of function
- *	names and Tcl_Token's derived from earlier call to ParseExpr(). When
- *	optimize is true, any constant subexpressions will be precomputed.
+ *	(*funcObjvPtr) and tokenPtr must point into matching arrays of
+ *	function names and Tcl_Token's derived from earlier call to
+ *	ParseExpr(). When optimize is true, any constant subexpressions will
+ *	be precomputed.
  *
  * Results:
  *	None.
  *
  * Side effects:
  *	Adds instructions to envPtr to evaluate the expression at runtime.
- *	Consumes subtree of nodes rooted at index. Advances the pointer
- *	*litObjvPtr.
+ *	Consumes subtree of nodes rooted at index. Advances the pointers
+ *	*litObjvPtr and *funcObjvPtr.
  *
  *----------------------------------------------------------------------
  */
@@ -2320,7 +2351,7 @@ CompileExprTree(
     OpNode *nodes,
     int index,
     Tcl_Obj *const **litObjvPtr,
-    Tcl_Obj *const *funcObjv,
+    Tcl_Obj *const **funcObjvPtr,
     Tcl_Token *tokenPtr,
     CompileEnv *envPtr,
     int optimize)
@@ -2352,8 +2383,8 @@ CompileExprTree(
 
 		Tcl_DStringInit(&cmdName);
 		TclDStringAppendLiteral(&cmdName, "tcl::mathfunc::");
-		p = Tcl_GetStringFromObj(*funcObjv, &length);
-		funcObjv++;
+		p = Tcl_GetStringFromObj(**funcObjvPtr, &length);
+		(*funcObjvPtr)++;
 		Tcl_DStringAppend(&cmdName, p, length);
 		TclEmitPush(TclRegisterLiteral(envPtr,
 			Tcl_DStringValue(&cmdName),
@@ -2551,11 +2582,51 @@ CompileExprTree(
 	    tokenPtr += tokenPtr->numComponents + 1;
 	    break;
 	default:
-	    if (optimize && nodes[next].constant) {
+	    if (optimize && nodes[next].constant
+		    && (nodes[next].lexeme != COMMA)) {
 		Tcl_InterpState save = Tcl_SaveInterpState(interp, TCL_OK);
+		Tcl_Obj *const *litObjv = *litObjvPtr;
+		Tcl_Obj *const *funcObjv = *funcObjvPtr;
+		int first = next, last = next, code;
+		OpNode *savePtr;
+
+		/*
+		 * Executing the subtree consumes its nodes. Keep a copy, so
+		 * that a failing function call can still be compiled, and
+		 * raise its error at runtime in the usual way. The nodes of a
+		 * subtree are contiguous in the array, in source order.
+		 */
+
+		while ((nodes[first].mark == MARK_LEFT)
+			&& IsOperator(nodes[first].left)) {
+		    first = nodes[first].left;
+		}
+		while (IsOperator(nodes[last].right)) {
+		    last = nodes[last].right;
+		}
+		savePtr = (OpNode *)TclStackAlloc(interp,
+			(last - first + 1) * sizeof(OpNode));
+		memcpy(savePtr, nodes + first,
+			(last - first + 1) * sizeof(OpNode));
 
-		if (ExecConstantExprTree(interp, nodes, next, litObjvPtr)
-			== TCL_OK) {
+		code = ExecConstantExprTree(interp, nodes, next, litObjvPtr,
+			funcObjvPtr);
+		if ((code == TCL_OK) && (*funcObjvPtr != funcObjv)) {
+		    void *ptr;
+		    int type;
+
+		    /*
+		     * A function may return NaN, which only becomes an error
+		     * when used. Leave that to happen at runtime.
+		     */
+
+		    if ((Tcl_GetNumberFromObj(NULL, Tcl_GetObjResult(interp),
+			    &ptr, &type) != TCL_OK)
+			    || (type == TCL_NUMBER_NAN)) {
+			code = TCL_ERROR;
+		    }
+		}
+		if (code == TCL_OK) {
 		    int idx;
 		    Tcl_Obj *objPtr = Tcl_GetObjResult(interp);
 
@@ -2586,11 +2657,36 @@ CompileExprTree(
 			idx = TclAddLiteralObj(envPtr, objPtr, NULL);
 		    }
 		    TclEmitPush(idx, envPtr);
+
+		    /*
+		     * Like a call, a folded function may return a value in
+		     * non-canonical form.
+		     */
+
+		    convert = (*funcObjvPtr != funcObjv);
+		} else if (*funcObjvPtr != funcObjv) {
+		    /*
+		     * Compile the subtree again without optimizing its root.
+		     * The QUESTION/COLON and FUNCTION/OPEN_PAREN combinations
+		     * each count as one operator.
+		     */
+
+		    memcpy(nodes + first, savePtr,
+			    (last - first + 1) * sizeof(OpNode));
+		    *litObjvPtr = litObjv;
+		    *funcObjvPtr = funcObjv;
+		    nodes[next].constant = 0;
+		    if ((nodes[next].lexeme == QUESTION)
+			    || (nodes[next].lexeme == FUNCTION)) {
+			nodes[nodes[next].right].constant = 0;
+		    }
+		    nodePtr = nodes + next;
 		} else {
 		    TclCompileSyntaxError(interp, envPtr);
+		    convert = 0;
 		}
+		TclStackFree(interp, savePtr);
 		Tcl_RestoreInterpState(interp, save);
-		convert = 0;
 	    } else {
 		nodePtr = nodes + next;
 	    }
@@ -2648,7 +2744,7 @@ TclSingleOpCmd(
     nodes[1].right = OT_LITERAL;
     nodes[1].p.parent = 0;
 
-    return ExecConstantExprTree(interp, nodes, 0, &litObjv);
+    return ExecConstantExprTree(interp, nodes, 0, &litObjv, NULL);
 }
 
 /*
@@ -2723,7 +2819,7 @@ TclSortingOpCmd(
 	nodes[0].right = lastAnd;
 	nodes[lastAnd].p.parent = 0;
 
-	code = ExecConstantExprTree(interp, nodes, 0, &litObjPtrPtr);
+	code = ExecConstantExprTree(interp, nodes, 0, &litObjPtrPtr, NULL);
 
 	TclStackFree(interp, nodes);
 	TclStackFree(interp, litObjv);
@@ -2806,7 +2902,7 @@ TclVariadicOpCmd(
 	    nodes[1].p.parent = 0;
 	}
 
-	code = ExecConstantExprTree(interp, nodes, 0, &litObjPtrPtr);
+	code = ExecConstantExprTree(interp, nodes, 0, &litObjPtrPtr, NULL);
 
 	Tcl_DecrRefCount(litObjv[decrMe]);
 	return code;
@@ -2843,7 +2939,7 @@ TclVariadicOpCmd(
 	nodes[0].right = lastOp;
 	nodes[lastOp].p.parent = 0;
 
-	code = ExecConstantExprTree(interp, nodes, 0, &litObjv);
+	code = ExecConstantExprTree(interp, nodes, 0, &litObjv, NULL);
 
 	TclStackFree(interp, nodes);
 	return code;
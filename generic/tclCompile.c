@@ -665,6 +665,85 @@ InstructionDesc const tclInstructionTable[] = {
 	 * set in flags.
 	 */
 
+    {"inlineGuard",	  9,   0,	   2,	{OPERAND_OFFSET4, OPERAND_AUX4}},
+	/* Checks that the command named by the invocation on the stack is
+	 * still the procedure described by the InlinedProcInfo op2, whose body
+	 * has been inlined after this instruction. If it is not, jumps op1
+	 * bytes to the code invoking the command normally.
+	 * Stack:  ... cmdName arg1 ... argN => ... cmdName arg1 ... argN */
+
+    /*
+     * Superinstructions: the bytes and operands are those of the first
+     * instruction they cover, the stack effect is that of the whole
+     * sequence.
+     */
+
+    {"addScalarLit1",	  2,   +1,	   1,	{OPERAND_LVT1}},
+	/* Covers loadScalar1 op1; push1 lit; add; storeScalar1 var.
+	 * Stack:  ... => ... sum */
+    {"addScalarScalar1",  2,   +1,	   1,	{OPERAND_LVT1}},
+	/* Covers loadScalar1 op1; loadScalar1 var2; add; storeScalar1 var.
+	 * Stack:  ... => ... sum */
+    {"listIndexScalar1",  2,   0,	   1,	{OPERAND_LVT1}},
+	/* Covers loadScalar1 op1; listIndex.
+	 * Stack:  ... list => ... element */
+    {"eqJump",		  1,   -2,	   0,	{OPERAND_NONE}},
+	/* Covers eq and the conditional jump after it. */
+    {"neqJump",		  1,   -2,	   0,	{OPERAND_NONE}},
+	/* Covers neq and the conditional jump after it. */
+    {"ltJump",		  1,   -2,	   0,	{OPERAND_NONE}},
+	/* Covers lt and the conditional jump after it. */
+    {"gtJump",		  1,   -2,	   0,	{OPERAND_NONE}},
+	/* Covers gt and the conditional jump after it. */
+    {"leJump",		  1,   -2,	   0,	{OPERAND_NONE}},
+	/* Covers le and the conditional jump after it. */
+    {"geJump",		  1,   -2,	   0,	{OPERAND_NONE}},
+	/* Covers ge and the conditional jump after it. */
+
+    /*
+     * Type-specialized instructions, rewritten in place of the generic ones
+     * by TEBC as it learns the operand types; same shape as those.
+     */
+
+    {"eqInt",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* eq specialized for two integers. */
+    {"neqInt",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* neq specialized for two integers. */
+    {"ltInt",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* lt specialized for two integers. */
+    {"gtInt",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* gt specialized for two integers. */
+    {"leInt",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* le specialized for two integers. */
+    {"geInt",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* ge specialized for two integers. */
+    {"addInt",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* add specialized for two integers. */
+    {"subInt",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* sub specialized for two integers. */
+    {"multInt",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* mult specialized for two integers. */
+    {"eqDbl",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* eq specialized for two doubles. */
+    {"neqDbl",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* neq specialized for two doubles. */
+    {"ltDbl",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* lt specialized for two doubles. */
+    {"gtDbl",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* gt specialized for two doubles. */
+    {"leDbl",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* le specialized for two doubles. */
+    {"geDbl",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* ge specialized for two doubles. */
+    {"addDbl",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* add specialized for two doubles. */
+    {"subDbl",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* sub specialized for two doubles. */
+    {"multDbl",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* mult specialized for two doubles. */
+    {"divDbl",		  1,   -1,	   0,	{OPERAND_NONE}},
+	/* div specialized for two doubles. */
+
     {NULL, 0, 0, 0, {OPERAND_NONE}}
 };
 
@@ -672,22 +751,45 @@ InstructionDesc const tclInstructionTable[] = {
  * Prototypes for procedures defined later in this file:
  */
 
+static int		CheckInlinedCode(CompileEnv *envPtr,
+			    Tcl_Size codeOffset, InlineEnv *inlinePtr);
 static void		CleanupByteCode(ByteCode *codePtr);
+static int		CompileInlinedBody(Tcl_Interp *interp,
+			    const char *body, Tcl_Size numBytes,
+			    InlineEnv *inlinePtr, CompileEnv *envPtr);
+static int		CompileInlinedProc(Tcl_Interp *interp,
+			    Tcl_Parse *parsePtr, Tcl_Obj *cmdObj,
+			    CompileEnv *envPtr);
+static size_t		CompileInvocationWords(Tcl_Interp *interp,
+			    Tcl_Token *tokenPtr, Tcl_Obj *cmdObj,
+			    size_t numWords, CompileEnv *envPtr);
 static ByteCode *	CompileSubstObj(Tcl_Interp *interp, Tcl_Obj *objPtr,
 			    int flags);
+static void		DiscardCode(CompileEnv *envPtr, Tcl_Size codeOffset,
+			    Tcl_Size numCommands, Tcl_Size exceptArrayNext,
+			    Tcl_Size auxDataArrayNext);
 static void		DupByteCodeInternalRep(Tcl_Obj *srcPtr,
 			    Tcl_Obj *copyPtr);
+static void *		DupInlinedProcInfo(void *clientData);
 static unsigned char *	EncodeCmdLocMap(CompileEnv *envPtr,
 			    ByteCode *codePtr, unsigned char *startPtr);
 static void		EnterCmdExtentData(CompileEnv *envPtr,
 			    Tcl_Size cmdNumber, Tcl_Size numSrcBytes, Tcl_Size numCodeBytes);
 static void		EnterCmdStartData(CompileEnv *envPtr,
 			    Tcl_Size cmdNumber, Tcl_Size srcOffset, Tcl_Size codeOffset);
+static Tcl_Size		FindInlinedLocal(InlineEnv *inlinePtr,
+			    const char *name, Tcl_Size nameBytes, int create,
+			    Proc *procPtr);
 static void		FreeByteCodeInternalRep(Tcl_Obj *objPtr);
+static void		FreeInlinedProcInfo(void *clientData);
 static void		FreeSubstCodeInternalRep(Tcl_Obj *objPtr);
 static int		GetCmdLocEncodingSize(CompileEnv *envPtr);
 static int		IsCompactibleCompileEnv(CompileEnv *envPtr);
+static Tcl_Size		NewCompiledLocal(Proc *procPtr, const char *name,
+			    Tcl_Size nameBytes);
 static void		PreventCycle(Tcl_Obj *objPtr, CompileEnv *envPtr);
+static AuxDataPrintProc	PrintInlinedProcInfo;
+static AuxDataPrintProc	DisassembleInlinedProcInfo;
 #ifdef TCL_COMPILE_STATS
 static void		RecordByteCodeStats(ByteCode *codePtr);
 #endif /* TCL_COMPILE_STATS */
@@ -734,6 +836,29 @@ static const Tcl_ObjType substCodeType = {
 };
 #define SubstFlags(objPtr) (objPtr)->internalRep.twoPtrValue.ptr2
 
+/*
+ * tclInlinedProcInfoType describes the InlinedProcInfo of each call site
+ * where the body of a procedure has been inlined. It is deliberately not
+ * registered, so that the bytecode cache never stores such code: the
+ * information refers to a command of a particular interpreter.
+ */
+
+const AuxDataType tclInlinedProcInfoType = {
+    "InlinedProcInfo",		/* name */
+    DupInlinedProcInfo,		/* dupProc */
+    FreeInlinedProcInfo,	/* freeProc */
+    PrintInlinedProcInfo,	/* printProc */
+    DisassembleInlinedProcInfo	/* disassembleProc */
+};
+
+/*
+ * Limits on the procedures that are inlined: the length of the body, in
+ * bytes of source and of bytecode.
+ */
+
+#define INLINE_MAX_SOURCE	256
+#define INLINE_MAX_CODE		160
+
 /*
  * Helper macros.
  */
@@ -781,6 +906,8 @@ TclSetByteCodeFromAny(
     const char *stringPtr;
     Proc *procPtr = iPtr->compiledProcPtr;
     ContLineLoc *clLocPtr;
+    Tcl_Obj *cacheKeyPtr = NULL;
+    Tcl_Obj *cmdDepsPtr = NULL;
 
 #ifdef TCL_COMPILE_DEBUG
     if (!traceInitialized) {
@@ -819,6 +946,24 @@ TclSetByteCodeFromAny(
 	compEnv.clNext = &clLocPtr->loc[0];
     }
 
+    /*
+     * If the interpreter has a bytecode cache, try to load the compiled form
+     * of the script from there. Otherwise have the compiler record the
+     * command names it resolves, so the result can be stored in the cache.
+     */
+
+    if (hookProc == NULL && clLocPtr == NULL) {
+	cacheKeyPtr = TclGetByteCodeCacheKey(interp, &compEnv);
+    }
+    if (cacheKeyPtr != NULL) {
+	if (TclLoadCachedByteCode(interp, cacheKeyPtr, &compEnv)) {
+	    goto loaded;
+	}
+	TclNewObj(cmdDepsPtr);
+	Tcl_IncrRefCount(cmdDepsPtr);
+	compEnv.cmdDepsPtr = cmdDepsPtr;
+    }
+
     TclCompileScript(interp, stringPtr, length, &compEnv);
 
     /*
@@ -846,6 +991,7 @@ TclSetByteCodeFromAny(
 	    compEnv.clNext = &clLocPtr->loc[0];
 	}
 	compEnv.atCmdStart = 2;		/* The disabling magic. */
+	compEnv.cmdDepsPtr = cmdDepsPtr;
 	TclCompileScript(interp, stringPtr, length, &compEnv);
 	assert (compEnv.atCmdStart > 1);
 	TclEmitOpcode(INST_DONE, &compEnv);
@@ -881,11 +1027,18 @@ TclSetByteCodeFromAny(
 	Tcl_Panic("Maximum byte code length %d exceeded.", INT_MAX);
     }
 
+    if (cacheKeyPtr != NULL) {
+	TclSaveCachedByteCode(interp, cacheKeyPtr, &compEnv);
+	Tcl_DecrRefCount(cmdDepsPtr);
+    }
+
     /*
      * Change the object into a ByteCode object. Ownership of the literal
      * objects and aux data items passes to the ByteCode object.
      */
 
+  loaded:
+
 #ifdef TCL_COMPILE_DEBUG
     TclVerifyLocalLiteralTable(&compEnv);
 #endif /*TCL_COMPILE_DEBUG*/
@@ -901,6 +1054,9 @@ TclSetByteCodeFromAny(
     }
 
     TclFreeCompileEnv(&compEnv);
+    if (cacheKeyPtr != NULL) {
+	Tcl_DecrRefCount(cacheKeyPtr);
+    }
     return result;
 }
 
@@ -1125,12 +1281,16 @@ CleanupByteCode(
 	}
     }
 
-    auxDataPtr = codePtr->auxDataArrayPtr;
-    for (i = 0;  i < numAuxDataItems;  i++) {
-	if (auxDataPtr->type->freeProc != NULL) {
-	    auxDataPtr->type->freeProc(auxDataPtr->clientData);
+    if (codePtr->bodyPtr) {
+	TclReleaseByteCodeBody(codePtr->bodyPtr);
+    } else {
+	auxDataPtr = codePtr->auxDataArrayPtr;
+	for (i = 0;  i < numAuxDataItems;  i++) {
+	    if (auxDataPtr->type->freeProc != NULL) {
+		auxDataPtr->type->freeProc(auxDataPtr->clientData);
+	    }
+	    auxDataPtr++;
 	}
-	auxDataPtr++;
     }
 
     /*
@@ -1155,9 +1315,113 @@ CleanupByteCode(
 	TclFreeLocalCache(interp, codePtr->localCachePtr);
     }
 
+    if (codePtr->invokeCachePtr) {
+	TclFreeInvokeCache(codePtr->invokeCachePtr);
+    }
+    if (codePtr->genericSites) {
+	Tcl_Free(codePtr->genericSites);
+    }
+
     TclHandleRelease(codePtr->interpHandle);
     Tcl_Free(codePtr);
 }
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclCreateInvokeCache --
+ *
+ *	Create the (empty) inline cache for the command invocations of a
+ *	ByteCode, with one slot for each INST_INVOKE_STK* instruction in it.
+ *
+ * Results:
+ *	The new cache, to be released with TclFreeInvokeCache.
+ *
+ * Side effects:
+ *	Allocates memory.
+ *
+ *----------------------------------------------------------------------
+ */
+
+InvokeCache *
+TclCreateInvokeCache(
+    ByteCode *codePtr)		/* The ByteCode to create a cache for. */
+{
+    InvokeCache *cachePtr;
+    unsigned char *pc, *codeEnd = codePtr->codeStart + codePtr->numCodeBytes;
+    Tcl_Size numSites = 0, numSlots = 2, i;
+
+    for (pc = codePtr->codeStart ; pc < codeEnd ;
+	    pc += tclInstructionTable[*pc].numBytes) {
+	if ((*pc == INST_INVOKE_STK1) || (*pc == INST_INVOKE_STK4)) {
+	    numSites++;
+	}
+    }
+
+    /*
+     * Keep the table at most half full so that probe sequences stay short.
+     */
+
+    while (numSlots < 2 * numSites) {
+	numSlots *= 2;
+    }
+    cachePtr = (InvokeCache *)Tcl_Alloc(offsetof(InvokeCache, entries)
+	    + numSlots * sizeof(InvokeCacheEntry));
+    memset(cachePtr->entries, 0, numSlots * sizeof(InvokeCacheEntry));
+    cachePtr->mask = numSlots - 1;
+    for (i = 0 ; i < numSlots ; i++) {
+	cachePtr->entries[i].pcOffset = TCL_INDEX_NONE;
+    }
+
+    for (pc = codePtr->codeStart ; pc < codeEnd ;
+	    pc += tclInstructionTable[*pc].numBytes) {
+	if ((*pc == INST_INVOKE_STK1) || (*pc == INST_INVOKE_STK4)) {
+	    Tcl_Size offset = pc - codePtr->codeStart;
+
+	    for (i = offset & cachePtr->mask ;
+		    cachePtr->entries[i].pcOffset != TCL_INDEX_NONE ;
+		    i = (i + 1) & cachePtr->mask) {
+		/* Empty loop body. */
+	    }
+	    cachePtr->entries[i].pcOffset = offset;
+	}
+    }
+    return cachePtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclFreeInvokeCache --
+ *
+ *	Release an inline cache of command invocations.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Drops the references to the cached command names and commands, and
+ *	frees the memory.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TclFreeInvokeCache(
+    InvokeCache *cachePtr)	/* The cache to release. */
+{
+    Tcl_Size i;
+
+    for (i = 0 ; i <= cachePtr->mask ; i++) {
+	InvokeCacheEntry *entryPtr = &cachePtr->entries[i];
+
+	if (entryPtr->namePtr) {
+	    Tcl_DecrRefCount(entryPtr->namePtr);
+	    TclCleanupCommandMacro(entryPtr->cmdPtr);
+	}
+    }
+    Tcl_Free(cachePtr);
+}
 
 /*
  * ---------------------------------------------------------------------
@@ -1616,6 +1880,9 @@ TclInitCompileEnv(
      */
 
     envPtr->clNext = NULL;
+    envPtr->cmdDepsPtr = NULL;
+    envPtr->inlinePtr = NULL;
+    envPtr->bodyPtr = NULL;
 
     envPtr->auxDataArrayPtr = envPtr->staticAuxDataArraySpace;
     envPtr->auxDataArrayNext = 0;
@@ -1699,6 +1966,10 @@ TclFreeCompileEnv(
 	ReleaseCmdWordData(envPtr->extCmdMapPtr);
 	envPtr->extCmdMapPtr = NULL;
     }
+    if (envPtr->bodyPtr) {
+	TclReleaseByteCodeBody(envPtr->bodyPtr);
+	envPtr->bodyPtr = NULL;
+    }
 }
 
 /*
@@ -1779,110 +2050,796 @@ TclWordKnownAtCompileTime(
 	Tcl_AppendObjToObj(valuePtr, tempPtr);
 	Tcl_DecrRefCount(tempPtr);
     }
-    return 1;
+    return 1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclCompileScript --
+ *
+ *	Compiles a Tcl script in a string.
+ *
+ * Results:
+ *
+ *	A standard Tcl result. If an error occurs, an
+ *	error message is left in the interpreter's result.
+ *
+ * Side effects:
+ *	Adds instructions to envPtr to evaluate the script at runtime.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ExpandRequested(
+    Tcl_Token *tokenPtr,
+    size_t numWords)
+{
+    /* Determine whether any words of the command require expansion */
+    while (numWords--) {
+	if (tokenPtr->type == TCL_TOKEN_EXPAND_WORD) {
+	    return 1;
+	}
+	tokenPtr = TokenAfter(tokenPtr);
+    }
+    return 0;
+}
+
+static void
+CompileCmdLiteral(
+    Tcl_Interp *interp,
+    Tcl_Obj *cmdObj,
+    CompileEnv *envPtr)
+{
+    const char *bytes;
+    Command *cmdPtr;
+    int cmdLitIdx, extraLiteralFlags = LITERAL_CMD_NAME;
+    Tcl_Size length;
+
+    cmdPtr = (Command *) Tcl_GetCommandFromObj(interp, cmdObj);
+    if ((cmdPtr != NULL) && (cmdPtr->flags & CMD_VIA_RESOLVER)) {
+	extraLiteralFlags |= LITERAL_UNSHARED;
+    }
+
+    bytes = Tcl_GetStringFromObj(cmdObj, &length);
+    cmdLitIdx = TclRegisterLiteral(envPtr, bytes, length, extraLiteralFlags);
+
+    if (cmdPtr && TclRoutineHasName(cmdPtr)) {
+	TclSetCmdNameObj(interp, TclFetchLiteral(envPtr, cmdLitIdx), cmdPtr);
+    }
+    TclEmitPush(cmdLitIdx, envPtr);
+}
+
+void
+TclCompileInvocation(
+    Tcl_Interp *interp,
+    Tcl_Token *tokenPtr,
+    Tcl_Obj *cmdObj,
+    size_t numWords,
+    CompileEnv *envPtr)
+{
+    size_t wordIdx;
+    int depth = TclGetStackDepth(envPtr);
+
+    wordIdx = CompileInvocationWords(interp, tokenPtr, cmdObj, numWords,
+	    envPtr);
+    if (wordIdx <= 255) {
+	TclEmitInvoke(envPtr, INST_INVOKE_STK1, wordIdx);
+    } else {
+	TclEmitInvoke(envPtr, INST_INVOKE_STK4, wordIdx);
+    }
+    TclCheckStackDepth(depth+1, envPtr);
+}
+
+static size_t
+CompileInvocationWords(
+    Tcl_Interp *interp,
+    Tcl_Token *tokenPtr,
+    Tcl_Obj *cmdObj,
+    size_t numWords,
+    CompileEnv *envPtr)
+{
+    DefineLineInformation;
+    size_t wordIdx = 0;
+
+    if (cmdObj) {
+	CompileCmdLiteral(interp, cmdObj, envPtr);
+	wordIdx = 1;
+	tokenPtr = TokenAfter(tokenPtr);
+    }
+
+    for (; wordIdx < numWords; wordIdx++, tokenPtr = TokenAfter(tokenPtr)) {
+	int objIdx;
+
+	SetLineInformation(wordIdx);
+
+	if (tokenPtr->type != TCL_TOKEN_SIMPLE_WORD) {
+	    CompileTokens(envPtr, tokenPtr, interp);
+	    continue;
+	}
+
+	objIdx = TclRegisterLiteral(envPtr,
+		tokenPtr[1].start, tokenPtr[1].size, 0);
+	if (envPtr->clNext) {
+	    TclContinuationsEnterDerived(TclFetchLiteral(envPtr, objIdx),
+		    tokenPtr[1].start - envPtr->source, envPtr->clNext);
+	}
+	TclEmitPush(objIdx, envPtr);
+    }
+    return wordIdx;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompileInlinedProc --
+ *
+ *	Compiles an invocation of a small procedure by inlining its body at
+ *	the call site, when the interpreter has the INLINE_PROCS flag set. The
+ *	code emitted is:
+ *
+ *		push the command name and arguments
+ *		inlineGuard slowPath, info
+ *		store the arguments into the procedure's variables, pop them
+ *		and the command name, unset the other variables
+ *		the body
+ *		unset the variables
+ *		jump done
+ *	    slowPath:
+ *		invokeStk
+ *	    done:
+ *
+ *	A procedure is only inlined when doing so cannot be told apart from
+ *	calling it, short of looking at the stack of frames or at the error
+ *	information. So the body may not invoke commands (only instructions
+ *	are allowed), may not refer to variables by computed names or to other
+ *	frames, may not loop and may only [return] normally. The guard makes
+ *	calls run normally when the command has been redefined, renamed or
+ *	traced since. Nothing is inlined while execution statistics are
+ *	collected, so that they count every call.
+ *
+ * Results:
+ *	TCL_OK if the invocation was compiled, TCL_ERROR if the procedure
+ *	cannot be inlined, in which case nothing has been emitted.
+ *
+ * Side effects:
+ *	Adds local variables to the procedure being compiled; those stay even
+ *	if the inlining fails.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+CompileInlinedProc(
+    Tcl_Interp *interp,		/* Used for error reporting and command
+				 * lookup. */
+    Tcl_Parse *parsePtr,	/* The invocation; none of its words are
+				 * expanded. */
+    Tcl_Obj *cmdObj,		/* The command word, known at compile time. */
+    CompileEnv *envPtr)		/* Holds resulting instructions. */
+{
+    Interp *iPtr = (Interp *) interp;
+    size_t numWords = parsePtr->numWords;
+    Command *cmdPtr;
+    Proc *procPtr;
+    CompiledLocal *argPtr;
+    InlineEnv inlineEnv;
+    InlinedProcInfo *infoPtr;
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    Tcl_Size numArgs, bodyLength, i, localIndex, *argIndices;
+    Tcl_Size numCommands = envPtr->numCommands;
+    Tcl_Size exceptArrayNext = envPtr->exceptArrayNext;
+    Tcl_Size auxDataArrayNext = envPtr->auxDataArrayNext;
+    Tcl_Size bodyCommands, bodyExceptArrayNext, bodyAuxDataArrayNext;
+    const char *body, *bytes;
+    int depth = TclGetStackDepth(envPtr);
+    int startOffset = CurrentOffset(envPtr);
+    int guardOffset, bodyOffset, jumpOffset, result = TCL_ERROR;
+
+    if ((envPtr->procPtr == NULL) || (envPtr->inlinePtr != NULL)
+	    || (iPtr->resolverPtr != NULL) || (iPtr->execStatsPtr != NULL)
+	    || (iPtr->flags & DONT_COMPILE_CMDS_INLINE)) {
+	return TCL_ERROR;
+    }
+    cmdPtr = (Command *) Tcl_GetCommandFromObj(interp, cmdObj);
+    if ((cmdPtr == NULL) || (cmdPtr->flags & CMD_HAS_EXEC_TRACES)) {
+	return TCL_ERROR;
+    }
+    procPtr = TclIsProc(cmdPtr);
+    if ((procPtr == NULL) || (procPtr->cmdPtr != cmdPtr)
+	    || (procPtr == envPtr->procPtr)
+	    || (cmdPtr->nsPtr != (Namespace *) TclGetCurrentNamespace(interp))
+	    || (cmdPtr->nsPtr->compiledVarResProc != NULL)
+	    || (cmdPtr->nsPtr->flags & NS_SUPPRESS_COMPILATION)
+	    || (procPtr->bodyPtr->bytes == NULL)) {
+	return TCL_ERROR;
+    }
+    body = Tcl_GetStringFromObj(procPtr->bodyPtr, &bodyLength);
+    numArgs = procPtr->numArgs;
+    if ((bodyLength > INLINE_MAX_SOURCE) || (numWords - 1 > (size_t) numArgs)) {
+	return TCL_ERROR;
+    }
+    argPtr = procPtr->firstLocalPtr;
+    for (i = 0; i < numArgs; i++, argPtr = argPtr->nextPtr) {
+	if ((argPtr->flags & VAR_IS_ARGS) || (argPtr->resolveInfo != NULL)
+		|| ((size_t) i >= numWords - 1 && argPtr->defValuePtr == NULL)) {
+	    return TCL_ERROR;
+	}
+    }
+
+    /*
+     * Give each argument a local variable, and check that there are no two
+     * arguments with the same name.
+     */
+
+    Tcl_InitHashTable(&inlineEnv.varTable, TCL_STRING_KEYS);
+    Tcl_InitHashTable(&inlineEnv.linkTable, TCL_ONE_WORD_KEYS);
+    TclNewObj(inlineEnv.suffixPtr);
+    Tcl_IncrRefCount(inlineEnv.suffixPtr);
+    Tcl_GetCommandFullName(interp, (Tcl_Command) cmdPtr, inlineEnv.suffixPtr);
+    inlineEnv.numReturns = inlineEnv.returnsSpace = 0;
+    inlineEnv.returnOffsets = NULL;
+
+    argIndices = (Tcl_Size *) Tcl_Alloc((numArgs + 1) * sizeof(Tcl_Size));
+    argPtr = procPtr->firstLocalPtr;
+    for (i = 0; i < numArgs; i++, argPtr = argPtr->nextPtr) {
+	argIndices[i] = FindInlinedLocal(&inlineEnv, argPtr->name,
+		argPtr->nameLength, 1, envPtr->procPtr);
+    }
+    if (inlineEnv.varTable.numEntries != numArgs) {
+	goto done;
+    }
+
+    CompileInvocationWords(interp, parsePtr->tokenPtr, cmdObj, numWords,
+	    envPtr);
+    guardOffset = CurrentOffset(envPtr);
+    TclEmitInstInt4(INST_INLINE_GUARD, 0, envPtr);
+    TclEmitInt4(0, envPtr);
+
+    /*
+     * Compile the body a first time to find out which variables it uses and
+     * whether it can be inlined at all, then throw that code away. The
+     * prologue, which depends on the variables, can only be emitted now.
+     */
+
+    bodyOffset = CurrentOffset(envPtr);
+    bodyCommands = envPtr->numCommands;
+    bodyExceptArrayNext = envPtr->exceptArrayNext;
+    bodyAuxDataArrayNext = envPtr->auxDataArrayNext;
+    envPtr->currStackDepth = depth;
+    if (CompileInlinedBody(interp, body, bodyLength, &inlineEnv,
+	    envPtr) != TCL_OK) {
+	goto failed;
+    }
+    for (i = 0; i < numArgs; i++) {
+	if (Tcl_FindHashEntry(&inlineEnv.linkTable, INT2PTR(argIndices[i]))) {
+	    goto failed;
+	}
+    }
+    DiscardCode(envPtr, bodyOffset, bodyCommands, bodyExceptArrayNext,
+	    bodyAuxDataArrayNext);
+    envPtr->currStackDepth = depth + numWords;
+
+    /*
+     * Prologue: pop the arguments (and the defaults of missing ones) into
+     * their variables, discard the command name, and clear any values that
+     * the other variables kept from an earlier call which failed.
+     */
+
+    argPtr = procPtr->firstLocalPtr;
+    for (i = 0; i < numArgs; i++, argPtr = argPtr->nextPtr) {
+	if ((size_t) i >= numWords - 1) {
+	    Tcl_Size length;
+
+	    bytes = Tcl_GetStringFromObj(argPtr->defValuePtr, &length);
+	    TclEmitPush(TclRegisterLiteral(envPtr, bytes, length, 0), envPtr);
+	}
+    }
+    for (i = numArgs; i-- > 0; ) {
+	Emit14Inst(INST_STORE_SCALAR, argIndices[i], envPtr);
+	TclEmitOpcode(INST_POP, envPtr);
+    }
+    TclEmitOpcode(INST_POP, envPtr);
+    for (hPtr = Tcl_FirstHashEntry(&inlineEnv.varTable, &search);
+	    hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	localIndex = PTR2INT(Tcl_GetHashValue(hPtr));
+	for (i = 0; i < numArgs && argIndices[i] != localIndex; i++) {
+	    /* Empty loop body */
+	}
+	if ((i == numArgs) && !Tcl_FindHashEntry(&inlineEnv.linkTable,
+		INT2PTR(localIndex))) {
+	    TclEmitInstInt1(INST_UNSET_SCALAR, 0, envPtr);
+	    TclEmitInt4(localIndex, envPtr);
+	}
+    }
+
+    if (CompileInlinedBody(interp, body, bodyLength, &inlineEnv,
+	    envPtr) != TCL_OK) {
+	goto failed;
+    }
+
+    /*
+     * Epilogue: clear the variables, so that the caller does not keep their
+     * values alive, then skip the normal invocation.
+     */
+
+    for (hPtr = Tcl_FirstHashEntry(&inlineEnv.varTable, &search);
+	    hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	localIndex = PTR2INT(Tcl_GetHashValue(hPtr));
+	if (!Tcl_FindHashEntry(&inlineEnv.linkTable, INT2PTR(localIndex))) {
+	    TclEmitInstInt1(INST_UNSET_SCALAR, 0, envPtr);
+	    TclEmitInt4(localIndex, envPtr);
+	}
+    }
+    jumpOffset = CurrentOffset(envPtr);
+    TclEmitInstInt4(INST_JUMP4, 0, envPtr);
+
+    TclStoreInt4AtPtr(CurrentOffset(envPtr) - guardOffset,
+	    envPtr->codeStart + guardOffset + 1);
+    TclAdjustStackDepth((int) numWords - 1, envPtr);
+    if (numWords <= 255) {
+	TclEmitInvoke(envPtr, INST_INVOKE_STK1, numWords);
+    } else {
+	TclEmitInvoke(envPtr, INST_INVOKE_STK4, numWords);
+    }
+    TclStoreInt4AtPtr(CurrentOffset(envPtr) - jumpOffset,
+	    envPtr->codeStart + jumpOffset + 1);
+
+    infoPtr = (InlinedProcInfo *) Tcl_Alloc(sizeof(InlinedProcInfo));
+    infoPtr->cmdPtr = cmdPtr;
+    cmdPtr->refCount++;
+    infoPtr->cmdEpoch = cmdPtr->cmdEpoch;
+    infoPtr->procPtr = procPtr;
+    infoPtr->numWords = numWords;
+    i = TclCreateAuxData(infoPtr, &tclInlinedProcInfoType, envPtr);
+    TclStoreInt4AtPtr(i, envPtr->codeStart + guardOffset + 5);
+    result = TCL_OK;
+    goto done;
+
+  failed:
+    DiscardCode(envPtr, startOffset, numCommands, exceptArrayNext,
+	    auxDataArrayNext);
+    envPtr->currStackDepth = depth;
+
+  done:
+    Tcl_Free(argIndices);
+    Tcl_Free(inlineEnv.returnOffsets);
+    Tcl_DecrRefCount(inlineEnv.suffixPtr);
+    Tcl_DeleteHashTable(&inlineEnv.varTable);
+    Tcl_DeleteHashTable(&inlineEnv.linkTable);
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompileInlinedBody --
+ *
+ *	Compiles the body of a procedure that is being inlined at the current
+ *	point, at which the stack has to be as the body expects it on entry.
+ *	The commands of the body are not entered into the command location
+ *	map, so that errors are reported against the invocation.
+ *
+ * Results:
+ *	TCL_OK if the code may be inlined, TCL_ERROR if not. In both cases,
+ *	the code has been emitted.
+ *
+ * Side effects:
+ *	Emits instructions.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+CompileInlinedBody(
+    Tcl_Interp *interp,		/* Used for error reporting. */
+    const char *body,		/* The body of the procedure. */
+    Tcl_Size numBytes,		/* Number of bytes in the body. */
+    InlineEnv *inlinePtr,	/* Describes the procedure. */
+    CompileEnv *envPtr)		/* Holds resulting instructions. */
+{
+    ExtCmdLoc *eclPtr = envPtr->extCmdMapPtr;
+    const char *source = envPtr->source;
+    Tcl_Size numSrcBytes = envPtr->numSrcBytes;
+    Tcl_Size numCommands = envPtr->numCommands;
+    int line = envPtr->line;
+    int *clNext = envPtr->clNext;
+    int atCmdStart = envPtr->atCmdStart;
+    int bodyOffset = CurrentOffset(envPtr);
+    Tcl_Size i;
+
+    inlinePtr->exceptBase = envPtr->exceptArrayNext;
+    inlinePtr->depth = TclGetStackDepth(envPtr);
+    inlinePtr->numReturns = 0;
+
+    /*
+     * There is no INST_START_CMD in inlined code: none of the checks it does
+     * are needed in code this short that cannot loop.
+     */
+
+    envPtr->source = body;
+    envPtr->numSrcBytes = numBytes;
+    envPtr->line = 1;
+    envPtr->clNext = NULL;
+    envPtr->atCmdStart = 2;
+    envPtr->inlinePtr = inlinePtr;
+    TclCompileScript(interp, body, numBytes, envPtr);
+    envPtr->inlinePtr = NULL;
+    envPtr->source = source;
+    envPtr->numSrcBytes = numSrcBytes;
+    envPtr->line = line;
+    envPtr->clNext = clNext;
+    envPtr->atCmdStart = (atCmdStart > 1 ? atCmdStart : 0);
+
+    while (eclPtr->nuloc > numCommands) {
+	eclPtr->nuloc--;
+	Tcl_Free(eclPtr->loc[eclPtr->nuloc].line);
+	eclPtr->loc[eclPtr->nuloc].line = NULL;
+    }
+    envPtr->numCommands = numCommands;
+
+    for (i = 0; i < inlinePtr->numReturns; i++) {
+	Tcl_Size offset = inlinePtr->returnOffsets[i];
+
+	TclStoreInt4AtPtr(CurrentOffset(envPtr) - offset,
+		envPtr->codeStart + offset + 1);
+    }
+
+    if (CurrentOffset(envPtr) - bodyOffset > INLINE_MAX_CODE) {
+	return TCL_ERROR;
+    }
+    return CheckInlinedCode(envPtr, bodyOffset, inlinePtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CheckInlinedCode --
+ *
+ *	Checks that the code compiled for an inlined procedure body runs the
+ *	same in the frame of the caller as in a frame of its own. Also records
+ *	which variables the code links to other variables.
+ *
+ * Results:
+ *	TCL_OK if the code may be inlined, TCL_ERROR if not.
+ *
+ * Side effects:
+ *	Fills the linkTable of the InlineEnv.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+CheckInlinedCode(
+    CompileEnv *envPtr,		/* Holds the code. */
+    Tcl_Size codeOffset,	/* Where the code of the body starts. */
+    InlineEnv *inlinePtr)	/* Describes the procedure. */
+{
+    unsigned char *pc = envPtr->codeStart + codeOffset;
+    int linksDone = 0, isNew, i, offset;
+
+    for (; pc < envPtr->codeNext; pc += tclInstructionTable[*pc].numBytes) {
+	switch (*pc) {
+	case INST_JUMP1:
+	case INST_JUMP_TRUE1:
+	case INST_JUMP_FALSE1:
+	    offset = TclGetInt1AtPtr(pc + 1);
+	    goto checkJump;
+	case INST_JUMP4:
+	case INST_JUMP_TRUE4:
+	case INST_JUMP_FALSE4:
+	    offset = TclGetInt4AtPtr(pc + 1);
+	checkJump:
+	    /*
+	     * Forward jumps only, so that the body cannot loop.
+	     */
+
+	    if ((offset <= 0) || (pc + offset > envPtr->codeNext)) {
+		return TCL_ERROR;
+	    }
+	    linksDone = 1;
+	    continue;
+
+	case INST_NSUPVAR:
+	case INST_VARIABLE:
+	    /*
+	     * A variable that is linked stays linked from one call to the next,
+	     * as it is never unset. So links must be made before anything else
+	     * touches a variable, and unconditionally.
+	     */
+
+	    if (linksDone) {
+		return TCL_ERROR;
+	    }
+	    Tcl_CreateHashEntry(&inlinePtr->linkTable,
+		    INT2PTR(TclGetUInt4AtPtr(pc + 1)), &isNew);
+	    continue;
+
+	case INST_DONE:
+	case INST_RETURN_IMM:
+	case INST_RETURN_STK:
+	case INST_SYNTAX:
+	case INST_BREAK:
+	case INST_CONTINUE:
+	case INST_START_CMD:
+	case INST_INLINE_GUARD:
+
+	    /*
+	     * Anything that runs a script or a command: it could look at the
+	     * frame or the stack of frames.
+	     */
+
+	case INST_INVOKE_STK1:
+	case INST_INVOKE_STK4:
+	case INST_INVOKE_EXPANDED:
+	case INST_INVOKE_REPLACE:
+	case INST_EVAL_STK:
+	case INST_EXPR_STK:
+	case INST_YIELD:
+	case INST_YIELD_TO_INVOKE:
+	case INST_TAILCALL:
+	case INST_TCLOO_NEXT:
+	case INST_TCLOO_NEXT_CLASS:
+
+	    /*
+	     * Variables named at runtime: the name would be looked up among the
+	     * variables of the caller.
+	     */
+
+	case INST_LOAD_SCALAR_STK:
+	case INST_LOAD_ARRAY_STK:
+	case INST_LOAD_STK:
+	case INST_STORE_SCALAR_STK:
+	case INST_STORE_ARRAY_STK:
+	case INST_STORE_STK:
+	case INST_INCR_SCALAR_STK:
+	case INST_INCR_ARRAY_STK:
+	case INST_INCR_STK:
+	case INST_INCR_SCALAR_STK_IMM:
+	case INST_INCR_ARRAY_STK_IMM:
+	case INST_INCR_STK_IMM:
+	case INST_APPEND_ARRAY_STK:
+	case INST_APPEND_STK:
+	case INST_LAPPEND_ARRAY_STK:
+	case INST_LAPPEND_STK:
+	case INST_EXIST_ARRAY_STK:
+	case INST_EXIST_STK:
+	case INST_UNSET_ARRAY_STK:
+	case INST_UNSET_STK:
+	case INST_ARRAY_EXISTS_STK:
+	case INST_ARRAY_MAKE_STK:
+	case INST_LAPPEND_LIST_ARRAY_STK:
+	case INST_LAPPEND_LIST_STK:
+	case INST_DICT_RECOMBINE_STK:
+
+	    /*
+	     * Other frames and the frame itself.
+	     */
+
+	case INST_UPVAR:
+	case INST_INFO_LEVEL_NUM:
+	case INST_INFO_LEVEL_ARGS:
+	case INST_TCLOO_SELF:
+	case INST_TCLOO_CLASS:
+	case INST_TCLOO_NS:
+	    return TCL_ERROR;
+	}
+
+	for (i = 0; i < tclInstructionTable[*pc].numOperands; i++) {
+	    if ((tclInstructionTable[*pc].opTypes[i] == OPERAND_LVT1)
+		    || (tclInstructionTable[*pc].opTypes[i] == OPERAND_LVT4)) {
+		linksDone = 1;
+	    }
+	}
+    }
+    return TCL_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * DiscardCode --
+ *
+ *	Throws away the code emitted since some point of a compilation,
+ *	together with the commands, exception ranges and auxiliary data
+ *	created since.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	See above. The stack depth is left for the caller to restore.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+DiscardCode(
+    CompileEnv *envPtr,		/* The compilation. */
+    Tcl_Size codeOffset,	/* The values, at the point to go back to, */
+    Tcl_Size numCommands,	/* of CurrentOffset(envPtr) and of the */
+    Tcl_Size exceptArrayNext,	/* fields of the same names. */
+    Tcl_Size auxDataArrayNext)
+{
+    ExtCmdLoc *eclPtr = envPtr->extCmdMapPtr;
+
+    envPtr->codeNext = envPtr->codeStart + codeOffset;
+    while (eclPtr->nuloc > numCommands) {
+	eclPtr->nuloc--;
+	Tcl_Free(eclPtr->loc[eclPtr->nuloc].line);
+	eclPtr->loc[eclPtr->nuloc].line = NULL;
+    }
+    envPtr->numCommands = numCommands;
+    envPtr->exceptArrayNext = exceptArrayNext;
+    while (envPtr->auxDataArrayNext > auxDataArrayNext) {
+	AuxData *auxDataPtr =
+		&envPtr->auxDataArrayPtr[--envPtr->auxDataArrayNext];
+
+	if (auxDataPtr->type->freeProc != NULL) {
+	    auxDataPtr->type->freeProc(auxDataPtr->clientData);
+	}
+    }
 }
-
+
 /*
  *----------------------------------------------------------------------
  *
- * TclCompileScript --
+ * TclEmitInlinedReturn --
  *
- *	Compiles a Tcl script in a string.
+ *	Emits the code of a [return] with no options from the body of a
+ *	procedure being inlined: a jump to the end of the body, with the
+ *	result on the stack.
  *
  * Results:
- *
- *	A standard Tcl result. If an error occurs, an
- *	error message is left in the interpreter's result.
+ *	None.
  *
  * Side effects:
- *	Adds instructions to envPtr to evaluate the script at runtime.
+ *	Emits instructions. If the stack holds more than the result, the
+ *	[return] cannot be turned into a jump; an INST_DONE is emitted instead,
+ *	which makes the body not inlined.
  *
  *----------------------------------------------------------------------
  */
 
-static int
-ExpandRequested(
-    Tcl_Token *tokenPtr,
-    size_t numWords)
+void
+TclEmitInlinedReturn(
+    CompileEnv *envPtr)		/* Holds resulting instructions. */
 {
-    /* Determine whether any words of the command require expansion */
-    while (numWords--) {
-	if (tokenPtr->type == TCL_TOKEN_EXPAND_WORD) {
-	    return 1;
-	}
-	tokenPtr = TokenAfter(tokenPtr);
+    InlineEnv *inlinePtr = envPtr->inlinePtr;
+
+    if (TclGetStackDepth(envPtr) != inlinePtr->depth + 1) {
+	TclEmitOpcode(INST_DONE, envPtr);
+	TclAdjustStackDepth(1, envPtr);
+	return;
     }
-    return 0;
+    if (inlinePtr->numReturns == inlinePtr->returnsSpace) {
+	inlinePtr->returnsSpace = 2 * inlinePtr->returnsSpace + 4;
+	inlinePtr->returnOffsets = (Tcl_Size *) Tcl_Realloc(
+		inlinePtr->returnOffsets,
+		inlinePtr->returnsSpace * sizeof(Tcl_Size));
+    }
+    inlinePtr->returnOffsets[inlinePtr->numReturns++] = CurrentOffset(envPtr);
+    TclEmitInstInt4(INST_JUMP4, 0, envPtr);
 }
 
-static void
-CompileCmdLiteral(
-    Tcl_Interp *interp,
-    Tcl_Obj *cmdObj,
-    CompileEnv *envPtr)
+/*
+ *----------------------------------------------------------------------
+ *
+ * DupInlinedProcInfo, FreeInlinedProcInfo, PrintInlinedProcInfo,
+ * DisassembleInlinedProcInfo --
+ *
+ *	Procedures to manage the InlinedProcInfo auxiliary data of inlined
+ *	procedure calls.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void *
+DupInlinedProcInfo(
+    void *clientData)
 {
-    const char *bytes;
-    Command *cmdPtr;
-    int cmdLitIdx, extraLiteralFlags = LITERAL_CMD_NAME;
-    Tcl_Size length;
+    InlinedProcInfo *srcPtr = (InlinedProcInfo *) clientData;
+    InlinedProcInfo *infoPtr = (InlinedProcInfo *)
+	    Tcl_Alloc(sizeof(InlinedProcInfo));
 
-    cmdPtr = (Command *) Tcl_GetCommandFromObj(interp, cmdObj);
-    if ((cmdPtr != NULL) && (cmdPtr->flags & CMD_VIA_RESOLVER)) {
-	extraLiteralFlags |= LITERAL_UNSHARED;
-    }
+    *infoPtr = *srcPtr;
+    infoPtr->cmdPtr->refCount++;
+    return infoPtr;
+}
 
-    bytes = Tcl_GetStringFromObj(cmdObj, &length);
-    cmdLitIdx = TclRegisterLiteral(envPtr, bytes, length, extraLiteralFlags);
+static void
+FreeInlinedProcInfo(
+    void *clientData)
+{
+    InlinedProcInfo *infoPtr = (InlinedProcInfo *) clientData;
 
-    if (cmdPtr && TclRoutineHasName(cmdPtr)) {
-	TclSetCmdNameObj(interp, TclFetchLiteral(envPtr, cmdLitIdx), cmdPtr);
-    }
-    TclEmitPush(cmdLitIdx, envPtr);
+    TclCleanupCommandMacro(infoPtr->cmdPtr);
+    Tcl_Free(infoPtr);
 }
 
-void
-TclCompileInvocation(
-    Tcl_Interp *interp,
-    Tcl_Token *tokenPtr,
-    Tcl_Obj *cmdObj,
-    size_t numWords,
-    CompileEnv *envPtr)
+static void
+PrintInlinedProcInfo(
+    void *clientData,
+    Tcl_Obj *appendObj,
+    TCL_UNUSED(ByteCode *),
+    TCL_UNUSED(size_t))
 {
-    DefineLineInformation;
-    size_t wordIdx = 0;
-    int depth = TclGetStackDepth(envPtr);
+    InlinedProcInfo *infoPtr = (InlinedProcInfo *) clientData;
 
-    if (cmdObj) {
-	CompileCmdLiteral(interp, cmdObj, envPtr);
-	wordIdx = 1;
-	tokenPtr = TokenAfter(tokenPtr);
-    }
+    Tcl_AppendPrintfToObj(appendObj, "\"%s\" epoch %" TCL_Z_MODIFIER "u",
+	    Tcl_GetCommandName(NULL, (Tcl_Command) infoPtr->cmdPtr),
+	    (size_t) infoPtr->cmdEpoch);
+}
 
-    for (; wordIdx < numWords; wordIdx++, tokenPtr = TokenAfter(tokenPtr)) {
-	int objIdx;
+static void
+DisassembleInlinedProcInfo(
+    void *clientData,
+    Tcl_Obj *dictObj,
+    TCL_UNUSED(ByteCode *),
+    TCL_UNUSED(size_t))
+{
+    InlinedProcInfo *infoPtr = (InlinedProcInfo *) clientData;
+
+    Tcl_DictObjPut(NULL, dictObj, Tcl_NewStringObj("command", -1),
+	    Tcl_NewStringObj(Tcl_GetCommandName(NULL,
+		    (Tcl_Command) infoPtr->cmdPtr), -1));
+    Tcl_DictObjPut(NULL, dictObj, Tcl_NewStringObj("epoch", -1),
+	    Tcl_NewWideIntObj((Tcl_WideInt) infoPtr->cmdEpoch));
+    Tcl_DictObjPut(NULL, dictObj, Tcl_NewStringObj("words", -1),
+	    Tcl_NewWideIntObj((Tcl_WideInt) infoPtr->numWords));
+}
 
-	SetLineInformation(wordIdx);
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tcl_InlineProcsObjCmd --
+ *
+ *	Implementation of the "::tcl::unsupported::inlineprocs" command, which
+ *	enables or disables the inlining of small procedures in the code that
+ *	the interpreter compiles from then on.
+ *
+ * Results:
+ *	A standard Tcl result. The result tells whether inlining is enabled.
+ *
+ * Side effects:
+ *	Changing the setting makes all bytecode of the interpreter be compiled
+ *	again before it is next run.
+ *
+ *----------------------------------------------------------------------
+ */
 
-	if (tokenPtr->type != TCL_TOKEN_SIMPLE_WORD) {
-	    CompileTokens(envPtr, tokenPtr, interp);
-	    continue;
-	}
+int
+Tcl_InlineProcsObjCmd(
+    TCL_UNUSED(void *),
+    Tcl_Interp *interp,		/* Current interpreter. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    Interp *iPtr = (Interp *) interp;
+    int enabled;
 
-	objIdx = TclRegisterLiteral(envPtr,
-		tokenPtr[1].start, tokenPtr[1].size, 0);
-	if (envPtr->clNext) {
-	    TclContinuationsEnterDerived(TclFetchLiteral(envPtr, objIdx),
-		    tokenPtr[1].start - envPtr->source, envPtr->clNext);
-	}
-	TclEmitPush(objIdx, envPtr);
+    if (objc > 2) {
+	Tcl_WrongNumArgs(interp, 1, objv, "?boolean?");
+	return TCL_ERROR;
     }
-
-    if (wordIdx <= 255) {
-	TclEmitInvoke(envPtr, INST_INVOKE_STK1, wordIdx);
-    } else {
-	TclEmitInvoke(envPtr, INST_INVOKE_STK4, wordIdx);
+    if (objc == 2) {
+	if (Tcl_GetBooleanFromObj(interp, objv[1], &enabled) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+	if (enabled != ((iPtr->flags & INLINE_PROCS) != 0)) {
+	    if (enabled) {
+		iPtr->flags |= INLINE_PROCS;
+	    } else {
+		iPtr->flags &= ~INLINE_PROCS;
+	    }
+	    iPtr->compileEpoch++;
+	}
     }
-    TclCheckStackDepth(depth+1, envPtr);
+    Tcl_SetObjResult(interp,
+	    Tcl_NewBooleanObj((iPtr->flags & INLINE_PROCS) != 0));
+    return TCL_OK;
 }
 
 static void
@@ -2080,6 +3037,9 @@ CompileCommandTokens(
     /* Is this a command we should (try to) compile with a compileProc ? */
     if (cmdKnown && !(iPtr->flags & DONT_COMPILE_CMDS_INLINE)) {
 	cmdPtr = (Command *) Tcl_GetCommandFromObj(interp, cmdObj);
+	if (envPtr->cmdDepsPtr != NULL) {
+	    Tcl_ListObjAppendElement(NULL, envPtr->cmdDepsPtr, cmdObj);
+	}
 	if (cmdPtr) {
 	    /*
 	     * Found a command.  Test the ways we can be told not to attempt
@@ -2113,7 +3073,9 @@ CompileCommandTokens(
 	if (expand) {
 	    CompileExpanded(interp, parsePtr->tokenPtr,
 		    cmdKnown ? cmdObj : NULL, (int)parsePtr->numWords, envPtr);
-	} else {
+	} else if (!cmdKnown || !(iPtr->flags & INLINE_PROCS)
+		|| CompileInlinedProc(interp, parsePtr, cmdObj,
+			envPtr) != TCL_OK) {
 	    TclCompileInvocation(interp, parsePtr->tokenPtr,
 		    cmdKnown ? cmdObj : NULL, (int)parsePtr->numWords, envPtr);
 	}
@@ -2848,6 +3810,7 @@ TclInitByteCode(
     Namespace *namespacePtr;
     int i, isNew;
     Interp *iPtr;
+    ByteCodeBody *bodyPtr = envPtr->bodyPtr;
 
     if (envPtr->iPtr == NULL) {
 	Tcl_Panic("TclInitByteCodeObj() called on uninitialized CompileEnv");
@@ -2870,11 +3833,15 @@ TclInitByteCode(
      */
 
     structureSize = TCL_ALIGN(sizeof(ByteCode));  /* align code bytes */
-    structureSize += TCL_ALIGN(codeBytes);	  /* align object array */
-    structureSize += TCL_ALIGN(objArrayBytes);	  /* align exc range arr */
-    structureSize += TCL_ALIGN(exceptArrayBytes); /* align AuxData array */
-    structureSize += auxDataArrayBytes;
-    structureSize += cmdLocBytes;
+    if (bodyPtr != NULL) {
+	structureSize += objArrayBytes;
+    } else {
+	structureSize += TCL_ALIGN(codeBytes);	      /* align object array */
+	structureSize += TCL_ALIGN(objArrayBytes);    /* align exc range arr */
+	structureSize += TCL_ALIGN(exceptArrayBytes); /* align AuxData array */
+	structureSize += auxDataArrayBytes;
+	structureSize += cmdLocBytes;
+    }
 
     if (envPtr->iPtr->varFramePtr != NULL) {
 	namespacePtr = envPtr->iPtr->varFramePtr->nsPtr;
@@ -2903,46 +3870,65 @@ TclInitByteCode(
     codePtr->numCodeBytes = codeBytes;
     codePtr->numLitObjects = numLitObjects;
     codePtr->numExceptRanges = envPtr->exceptArrayNext;
-    codePtr->numAuxDataItems = envPtr->auxDataArrayNext;
+    codePtr->numAuxDataItems = (bodyPtr != NULL) ?
+	    bodyPtr->numAuxDataItems : envPtr->auxDataArrayNext;
     codePtr->numCmdLocBytes = cmdLocBytes;
     codePtr->maxExceptDepth = envPtr->maxExceptDepth;
     codePtr->maxStackDepth = envPtr->maxStackDepth;
 
     p += TCL_ALIGN(sizeof(ByteCode));	/* align code bytes */
-    codePtr->codeStart = p;
-    memcpy(p, envPtr->codeStart, codeBytes);
-
-    p += TCL_ALIGN(codeBytes);		/* align object array */
-    codePtr->objArrayPtr = (Tcl_Obj **) p;
-    for (i = 0;  i < numLitObjects;  i++) {
-	codePtr->objArrayPtr[i] = TclFetchLiteral(envPtr, i);
-    }
+    if (bodyPtr != NULL) {
+	/*
+	 * Only the literal array is our own, the rest is in the shared body.
+	 * The CompileEnv's reference to the body passes to the ByteCode.
+	 */
 
-    p += TCL_ALIGN(objArrayBytes);	/* align exception range array */
-    if (exceptArrayBytes > 0) {
-	codePtr->exceptArrayPtr = (ExceptionRange *) p;
-	memcpy(p, envPtr->exceptArrayPtr, exceptArrayBytes);
+	codePtr->objArrayPtr = (Tcl_Obj **) p;
+	codePtr->codeStart = bodyPtr->codeStart;
+	codePtr->exceptArrayPtr = bodyPtr->exceptArrayPtr;
+	codePtr->auxDataArrayPtr = bodyPtr->auxDataArrayPtr;
+	codePtr->codeDeltaStart = bodyPtr->codeDeltaStart;
+	codePtr->codeLengthStart = bodyPtr->codeLengthStart;
+	codePtr->srcDeltaStart = bodyPtr->srcDeltaStart;
+	codePtr->srcLengthStart = bodyPtr->srcLengthStart;
+	envPtr->bodyPtr = NULL;
     } else {
-	codePtr->exceptArrayPtr = NULL;
-    }
+	codePtr->codeStart = p;
+	memcpy(p, envPtr->codeStart, codeBytes);
 
-    p += TCL_ALIGN(exceptArrayBytes);	/* align AuxData array */
-    if (auxDataArrayBytes > 0) {
-	codePtr->auxDataArrayPtr = (AuxData *) p;
-	memcpy(p, envPtr->auxDataArrayPtr, auxDataArrayBytes);
-    } else {
-	codePtr->auxDataArrayPtr = NULL;
-    }
+	p += TCL_ALIGN(codeBytes);	/* align object array */
+	codePtr->objArrayPtr = (Tcl_Obj **) p;
 
-    p += auxDataArrayBytes;
+	p += TCL_ALIGN(objArrayBytes);	/* align exception range array */
+	if (exceptArrayBytes > 0) {
+	    codePtr->exceptArrayPtr = (ExceptionRange *) p;
+	    memcpy(p, envPtr->exceptArrayPtr, exceptArrayBytes);
+	} else {
+	    codePtr->exceptArrayPtr = NULL;
+	}
+
+	p += TCL_ALIGN(exceptArrayBytes);	/* align AuxData array */
+	if (auxDataArrayBytes > 0) {
+	    codePtr->auxDataArrayPtr = (AuxData *) p;
+	    memcpy(p, envPtr->auxDataArrayPtr, auxDataArrayBytes);
+	} else {
+	    codePtr->auxDataArrayPtr = NULL;
+	}
+
+	p += auxDataArrayBytes;
 #ifndef TCL_COMPILE_DEBUG
-    EncodeCmdLocMap(envPtr, codePtr, (unsigned char *) p);
+	EncodeCmdLocMap(envPtr, codePtr, (unsigned char *) p);
 #else
-    nextPtr = EncodeCmdLocMap(envPtr, codePtr, (unsigned char *) p);
-    if (((size_t)(nextPtr - p)) != cmdLocBytes) {
-	Tcl_Panic("TclInitByteCodeObj: encoded cmd location bytes %lu != expected size %lu", (unsigned long)(nextPtr - p), (unsigned long)cmdLocBytes);
-    }
+	nextPtr = EncodeCmdLocMap(envPtr, codePtr, (unsigned char *) p);
+	if (((size_t)(nextPtr - p)) != cmdLocBytes) {
+	    Tcl_Panic("TclInitByteCodeObj: encoded cmd location bytes %lu != expected size %lu", (unsigned long)(nextPtr - p), (unsigned long)cmdLocBytes);
+	}
 #endif
+    }
+    codePtr->bodyPtr = bodyPtr;
+    for (i = 0;  i < numLitObjects;  i++) {
+	codePtr->objArrayPtr[i] = TclFetchLiteral(envPtr, i);
+    }
 
     /*
      * Record various compilation-related statistics about the new ByteCode
@@ -2970,9 +3956,102 @@ TclInitByteCode(
     envPtr->iPtr = NULL;
 
     codePtr->localCachePtr = NULL;
+    codePtr->invokeCachePtr = NULL;
+    codePtr->genericSites = NULL;
     return codePtr;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclCreateByteCodeBody, TclFreeByteCodeBody --
+ *
+ *	TclCreateByteCodeBody makes a ByteCodeBody, to be shared by several
+ *	ByteCodes, out of the code, exception ranges, aux data items and
+ *	command map of a CompileEnv. TclFreeByteCodeBody frees one once its
+ *	reference count has dropped to zero.
+ *
+ * Results:
+ *	TclCreateByteCodeBody returns the new body, with a reference count of
+ *	one.
+ *
+ * Side effects:
+ *	The aux data items pass from the CompileEnv to the body.
+ *
+ *----------------------------------------------------------------------
+ */
+
+ByteCodeBody *
+TclCreateByteCodeBody(
+    CompileEnv *envPtr)		/* The compiled code. */
+{
+    ByteCodeBody *bodyPtr;
+    ByteCode cmdMap;		/* Only receives the starts of the encoded
+				 * command map from EncodeCmdLocMap. */
+    size_t codeBytes = envPtr->codeNext - envPtr->codeStart;
+    size_t exceptArrayBytes = envPtr->exceptArrayNext * sizeof(ExceptionRange);
+    size_t auxDataArrayBytes = envPtr->auxDataArrayNext * sizeof(AuxData);
+    size_t structureSize;
+    unsigned char *p;
+
+    structureSize = TCL_ALIGN(sizeof(ByteCodeBody)); /* align code bytes */
+    structureSize += TCL_ALIGN(codeBytes);	  /* align exc range arr */
+    structureSize += TCL_ALIGN(exceptArrayBytes); /* align AuxData array */
+    structureSize += auxDataArrayBytes;
+    structureSize += GetCmdLocEncodingSize(envPtr);
+
+    p = (unsigned char *)Tcl_Alloc(structureSize);
+    bodyPtr = (ByteCodeBody *) p;
+    bodyPtr->refCount = 1;
+    bodyPtr->structureSize = structureSize;
+
+    p += TCL_ALIGN(sizeof(ByteCodeBody));
+    bodyPtr->codeStart = p;
+    memcpy(p, envPtr->codeStart, codeBytes);
+
+    p += TCL_ALIGN(codeBytes);
+    if (exceptArrayBytes > 0) {
+	bodyPtr->exceptArrayPtr = (ExceptionRange *) p;
+	memcpy(p, envPtr->exceptArrayPtr, exceptArrayBytes);
+    } else {
+	bodyPtr->exceptArrayPtr = NULL;
+    }
+
+    p += TCL_ALIGN(exceptArrayBytes);
+    bodyPtr->numAuxDataItems = envPtr->auxDataArrayNext;
+    if (auxDataArrayBytes > 0) {
+	bodyPtr->auxDataArrayPtr = (AuxData *) p;
+	memcpy(p, envPtr->auxDataArrayPtr, auxDataArrayBytes);
+    } else {
+	bodyPtr->auxDataArrayPtr = NULL;
+    }
+    envPtr->auxDataArrayNext = 0;
+
+    p += auxDataArrayBytes;
+    EncodeCmdLocMap(envPtr, &cmdMap, p);
+    bodyPtr->codeDeltaStart = cmdMap.codeDeltaStart;
+    bodyPtr->codeLengthStart = cmdMap.codeLengthStart;
+    bodyPtr->srcDeltaStart = cmdMap.srcDeltaStart;
+    bodyPtr->srcLengthStart = cmdMap.srcLengthStart;
+    return bodyPtr;
+}
+
+void
+TclFreeByteCodeBody(
+    ByteCodeBody *bodyPtr)
+{
+    AuxData *auxDataPtr = bodyPtr->auxDataArrayPtr;
+    Tcl_Size i;
+
+    for (i = 0;  i < bodyPtr->numAuxDataItems;  i++) {
+	if (auxDataPtr->type->freeProc != NULL) {
+	    auxDataPtr->type->freeProc(auxDataPtr->clientData);
+	}
+	auxDataPtr++;
+    }
+    Tcl_Free(bodyPtr);
+}
+
 ByteCode *
 TclInitByteCodeObj(
     Tcl_Obj *objPtr,		/* Points object that should be initialized,
@@ -3071,6 +4150,11 @@ TclFindCompiledLocal(
 	return TCL_INDEX_NONE;
     }
 
+    if (envPtr->inlinePtr && name) {
+	return FindInlinedLocal(envPtr->inlinePtr, name, nameBytes, create,
+		procPtr);
+    }
+
     if (name != NULL) {
 	Tcl_Size localCt = procPtr->numCompiledLocals;
 
@@ -3093,30 +4177,139 @@ TclFindCompiledLocal(
      */
 
     if (create || (name == NULL)) {
-	localVar = procPtr->numCompiledLocals;
-	localPtr = (CompiledLocal *)Tcl_Alloc(offsetof(CompiledLocal, name) + 1U + nameBytes);
-	if (procPtr->firstLocalPtr == NULL) {
-	    procPtr->firstLocalPtr = procPtr->lastLocalPtr = localPtr;
-	} else {
-	    procPtr->lastLocalPtr->nextPtr = localPtr;
-	    procPtr->lastLocalPtr = localPtr;
-	}
-	localPtr->nextPtr = NULL;
-	localPtr->nameLength = nameBytes;
-	localPtr->frameIndex = localVar;
-	localPtr->flags = 0;
-	if (name == NULL) {
-	    localPtr->flags |= VAR_TEMPORARY;
-	}
-	localPtr->defValuePtr = NULL;
-	localPtr->resolveInfo = NULL;
+	localVar = NewCompiledLocal(procPtr, name, nameBytes);
+    }
+    return localVar;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NewCompiledLocal --
+ *
+ *	Appends an entry for a variable to a procedure's array of local
+ *	variables. If the name is NULL, the variable is a temporary one.
+ *
+ * Results:
+ *	The index of the new entry.
+ *
+ * Side effects:
+ *	See above.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_Size
+NewCompiledLocal(
+    Proc *procPtr,		/* The procedure to add the variable to. */
+    const char *name,		/* Name of the variable, or NULL. */
+    Tcl_Size nameBytes)		/* Number of bytes in the name. */
+{
+    Tcl_Size localVar = procPtr->numCompiledLocals;
+    CompiledLocal *localPtr = (CompiledLocal *)
+	    Tcl_Alloc(offsetof(CompiledLocal, name) + 1U + nameBytes);
+
+    if (procPtr->firstLocalPtr == NULL) {
+	procPtr->firstLocalPtr = procPtr->lastLocalPtr = localPtr;
+    } else {
+	procPtr->lastLocalPtr->nextPtr = localPtr;
+	procPtr->lastLocalPtr = localPtr;
+    }
+    localPtr->nextPtr = NULL;
+    localPtr->nameLength = nameBytes;
+    localPtr->frameIndex = localVar;
+    localPtr->flags = 0;
+    if (name == NULL) {
+	localPtr->flags |= VAR_TEMPORARY;
+    }
+    localPtr->defValuePtr = NULL;
+    localPtr->resolveInfo = NULL;
+
+    if (name != NULL) {
+	memcpy(localPtr->name, name, nameBytes);
+    }
+    localPtr->name[nameBytes] = '\0';
+    procPtr->numCompiledLocals++;
+    return localVar;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FindInlinedLocal --
+ *
+ *	The version of TclFindCompiledLocal used while the body of a procedure
+ *	is being inlined. A variable of the inlined procedure is held in a
+ *	local variable of the caller whose name is that of the variable, a
+ *	NUL byte and the name of the procedure. Since no script can spell such
+ *	a name, these variables are out of reach of the caller's own code, but
+ *	error messages still show the name of the variable.
+ *
+ * Results:
+ *	The index of the local variable of the caller, or TCL_INDEX_NONE if
+ *	the procedure has no such variable yet and create is 0.
+ *
+ * Side effects:
+ *	May create a new local variable in the caller.
+ *
+ *----------------------------------------------------------------------
+ */
 
-	if (name != NULL) {
-	    memcpy(localPtr->name, name, nameBytes);
+static Tcl_Size
+FindInlinedLocal(
+    InlineEnv *inlinePtr,	/* The procedure being inlined. */
+    const char *name,		/* Name of the variable. */
+    Tcl_Size nameBytes,		/* Number of bytes in the name. */
+    int create,			/* If 1, allocate a local variable if the
+				 * procedure has no such variable yet. */
+    Proc *procPtr)		/* The procedure the body is inlined into. */
+{
+    Tcl_HashEntry *hPtr;
+    Tcl_DString ds;
+    CompiledLocal *localPtr;
+    const char *suffix;
+    Tcl_Size localVar = TCL_INDEX_NONE, suffixBytes, i;
+    int isNew;
+
+    Tcl_DStringInit(&ds);
+    Tcl_DStringAppend(&ds, name, nameBytes);
+    hPtr = Tcl_FindHashEntry(&inlinePtr->varTable, Tcl_DStringValue(&ds));
+    if (hPtr) {
+	Tcl_DStringFree(&ds);
+	return PTR2INT(Tcl_GetHashValue(hPtr));
+    }
+    if (!create) {
+	Tcl_DStringFree(&ds);
+	return TCL_INDEX_NONE;
+    }
+    hPtr = Tcl_CreateHashEntry(&inlinePtr->varTable, Tcl_DStringValue(&ds),
+	    &isNew);
+
+    /*
+     * Another call site may have inlined the same procedure already; share
+     * its variables.
+     */
+
+    suffix = Tcl_GetStringFromObj(inlinePtr->suffixPtr, &suffixBytes);
+    Tcl_DStringAppend(&ds, "", 1);
+    Tcl_DStringAppend(&ds, suffix, suffixBytes);
+    localPtr = procPtr->firstLocalPtr;
+    for (i = 0;  i < procPtr->numCompiledLocals;  i++) {
+	if (!TclIsVarTemporary(localPtr)
+		&& (localPtr->nameLength == Tcl_DStringLength(&ds))
+		&& !memcmp(localPtr->name, Tcl_DStringValue(&ds),
+			Tcl_DStringLength(&ds))) {
+	    localVar = i;
+	    break;
 	}
-	localPtr->name[nameBytes] = '\0';
-	procPtr->numCompiledLocals++;
+	localPtr = localPtr->nextPtr;
     }
+    if (localVar == TCL_INDEX_NONE) {
+	localVar = NewCompiledLocal(procPtr, Tcl_DStringValue(&ds),
+		Tcl_DStringLength(&ds));
+    }
+    Tcl_DStringFree(&ds);
+    Tcl_SetHashValue(hPtr, INT2PTR(localVar));
     return localVar;
 }
 
@@ -3481,7 +4674,8 @@ TclCreateExceptRange(
  *	creation point, and optionally the stack depth that is expected at
  *	that point. Relies on the fact that the range has a numCodeBytes = -1
  *	when it is being populated and that inner ranges come after outer
- *	ranges.
+ *	ranges. Within an inlined procedure body, the ranges enclosing the
+ *	call site are not considered.
  *
  * ---------------------------------------------------------------------
  */
@@ -3493,9 +4687,10 @@ TclGetInnermostExceptionRange(
     ExceptionAux **auxPtrPtr)
 {
     size_t i = envPtr->exceptArrayNext;
+    size_t base = (envPtr->inlinePtr ? envPtr->inlinePtr->exceptBase : 0);
     ExceptionRange *rangePtr = envPtr->exceptArrayPtr + i;
 
-    while (i > 0) {
+    while (i > base) {
 	rangePtr--; i--;
 
 	if (CurrentOffset(envPtr) >= (int)rangePtr->codeOffset &&
@@ -4117,6 +5312,16 @@ TclFixupForwardJump(
 	}
     }
 
+    if (envPtr->inlinePtr) {
+	InlineEnv *inlinePtr = envPtr->inlinePtr;
+
+	for (k = 0 ; k < (int)inlinePtr->numReturns ; k++) {
+	    if (jumpFixupPtr->codeOffset < inlinePtr->returnOffsets[k]) {
+		inlinePtr->returnOffsets[k] += 3;
+	    }
+	}
+    }
+
     return 1;			/* the jump was grown */
 }
 
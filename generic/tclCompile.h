@@ -269,6 +269,36 @@ typedef struct AuxData {
     void *clientData;	/* The compilation data itself. */
 } AuxData;
 
+/*
+ * Structure describing a procedure body that the compiler is inlining at a
+ * call site (see CompileInlinedProc in tclCompile.c). The variables of the
+ * procedure get local variables of their own in the caller, and a [return]
+ * from the body becomes a jump to its end.
+ */
+
+typedef struct InlineEnv {
+    Tcl_HashTable varTable;	/* Maps the names of the procedure's variables
+				 * to the indices of the caller's local
+				 * variables that hold them. */
+    Tcl_HashTable linkTable;	/* Indices of those local variables that the
+				 * body links to other variables, e.g. with
+				 * [global]. */
+    Tcl_Obj *suffixPtr;		/* Fully qualified name of the procedure. It
+				 * is appended, after a NUL byte, to the names
+				 * of its variables to make up the names of
+				 * the caller's local variables. */
+    Tcl_Size exceptBase;	/* Index of the first exception range of the
+				 * body; enclosing ranges are not visible from
+				 * within it. */
+    Tcl_Size depth;		/* Stack depth at the start of the body. */
+    Tcl_Size numReturns;	/* Number of entries used in returnOffsets. */
+    Tcl_Size returnsSpace;	/* Number of entries allocated for
+				 * returnOffsets. */
+    Tcl_Size *returnOffsets;	/* Code offsets of the INST_JUMP4 instructions
+				 * issued for the [return]s of the body, to be
+				 * pointed at its end. */
+} InlineEnv;
+
 /*
  * Structure defining the compilation environment. After compilation, fields
  * describing bytecode instructions are copied out into the more compact
@@ -395,8 +425,52 @@ typedef struct CompileEnv {
     int *clNext;		/* If not NULL, it refers to the next slot in
 				 * clLoc to check for an invisible
 				 * continuation line. */
+    Tcl_Obj *cmdDepsPtr;	/* If not NULL, a list to which the compiler
+				 * appends the command names it resolves, so
+				 * that the bytecode cache can check later
+				 * that they still resolve the same way. Not
+				 * owned by the CompileEnv. */
+    InlineEnv *inlinePtr;	/* If not NULL, the procedure body currently
+				 * being inlined. */
+    struct ByteCodeBody *bodyPtr;
+				/* If not NULL, the body shared with other
+				 * interpreters that the ByteCode made from
+				 * this CompileEnv is to use instead of its
+				 * code, exception ranges, aux data items and
+				 * command map. Set by TclLoadCachedByteCode,
+				 * which takes the aux data items. */
 } CompileEnv;
 
+/*
+ * Inline cache of the commands invoked by a ByteCode: for each of its
+ * INST_INVOKE_STK* instructions, the command the invoked name resolved to the
+ * last time, with what is needed to check that resolution is still valid.
+ * The entries form an open-addressed table keyed by instruction offset; the
+ * cache is created when the ByteCode first invokes a command.
+ */
+
+typedef struct InvokeCacheEntry {
+    Tcl_Size pcOffset;		/* Offset of the invocation instruction in the
+				 * code, or TCL_INDEX_NONE for a free slot. */
+    Tcl_Obj *namePtr;		/* The command name value the entry was filled
+				 * for (we hold a reference), or NULL. */
+    Command *cmdPtr;		/* The command it resolved to (we hold a
+				 * reference). */
+    Namespace *refNsPtr;	/* Namespace the name was resolved in. */
+    size_t refNsId;		/* refNsPtr's unique namespace id. */
+    Tcl_Size refNsCmdEpoch;	/* refNsPtr's cmdRefEpoch at that time. */
+    Tcl_Size cmdEpoch;		/* cmdPtr's cmdEpoch at that time. */
+    size_t hits;		/* Number of invocations that used the cached
+				 * command. */
+    size_t misses;		/* Number of invocations that had to look the
+				 * command up. */
+} InvokeCacheEntry;
+
+typedef struct InvokeCache {
+    Tcl_Size mask;		/* Number of slots, a power of 2, minus 1. */
+    InvokeCacheEntry entries[TCLFLEXARRAY];
+} InvokeCache;
+
 /*
  * The structure defining the bytecode instructions resulting from compiling a
  * Tcl script. Note that this structure is variable length: a single heap
@@ -421,6 +495,35 @@ typedef struct CompileEnv {
 
 #define TCL_BYTECODE_RECOMPILE			0x0004
 
+/*
+ * The parts of a ByteCode that do not depend on the interpreter (the code,
+ * exception ranges, aux data items and encoded command location map) can be
+ * kept in a separate, reference counted block, which is then shared by the
+ * ByteCodes of all interpreters that load the same compilation from the
+ * process-wide store of the bytecode cache (see tclCompCache.c). Code in such
+ * a block is never rewritten.
+ */
+
+typedef struct ByteCodeBody {
+    size_t refCount;		/* Number of ByteCodes and CompileEnvs using
+				 * the body, plus one while the store entry it
+				 * belongs to exists. Changed only with the
+				 * mutex of the store held. */
+    size_t structureSize;	/* Number of bytes in the block. */
+    unsigned char *codeStart;	/* The code. */
+    ExceptionRange *exceptArrayPtr;
+				/* The ExceptionRange array, or NULL. */
+    AuxData *auxDataArrayPtr;	/* The auxiliary data array, or NULL. The
+				 * body owns the items. */
+    Tcl_Size numAuxDataItems;	/* Number of AuxData items. */
+    unsigned char *codeDeltaStart;
+    unsigned char *codeLengthStart;
+    unsigned char *srcDeltaStart;
+    unsigned char *srcLengthStart;
+				/* The encoded command location map, as in
+				 * ByteCode. */
+} ByteCodeBody;
+
 typedef struct ByteCode {
     TclHandle interpHandle;	/* Handle for interpreter containing the
 				 * compiled code. Commands and their compile
@@ -519,6 +622,18 @@ typedef struct ByteCode {
     LocalCache *localCachePtr;	/* Pointer to the start of the cached variable
 				 * names and initialisation data for local
 				 * variables. */
+    InvokeCache *invokeCachePtr;/* Commands resolved by the invocation
+				 * instructions, or NULL if none was executed
+				 * yet. */
+    unsigned char *genericSites;/* Bit map of the code offsets at which a
+				 * type-specialized instruction had to turn
+				 * back into the generic one. Those are not
+				 * specialized again. NULL if there are
+				 * none. */
+    ByteCodeBody *bodyPtr;	/* If not NULL, the shared block that
+				 * codeStart, exceptArrayPtr, auxDataArrayPtr
+				 * and the command map point into; the code is
+				 * then never rewritten. */
 #ifdef TCL_COMPILE_STATS
     Tcl_Time createTime;	/* Absolute time when the ByteCode was
 				 * created. */
@@ -837,6 +952,51 @@ enum TclInstruction {
 
     INST_LREPLACE4,
 
+    INST_INLINE_GUARD,
+
+    /*
+     * Superinstructions. These are never emitted by the compiler; the
+     * bytecode optimizer overlays them on the first instruction of a common
+     * sequence (see FuseInstructions in tclOptimize.c), which stays in place
+     * behind it and is run as is whenever the fast path does not apply.
+     */
+    INST_ADD_SCALAR_LIT1,
+    INST_ADD_SCALAR_SCALAR1,
+    INST_LIST_INDEX_SCALAR1,
+    INST_EQ_JUMP,
+    INST_NEQ_JUMP,
+    INST_LT_JUMP,
+    INST_GT_JUMP,
+    INST_LE_JUMP,
+    INST_GE_JUMP,
+
+    /*
+     * Type-specialized forms of the arithmetic and comparison instructions.
+     * Nor are these emitted by the compiler: TEBC rewrites a generic
+     * instruction to one of them in place once it has seen its operand types,
+     * and back again when their guard fails (type feedback). They must stay
+     * in the order of INST_EQ..INST_GE and INST_ADD..INST_DIV.
+     */
+    INST_EQ_INT,
+    INST_NEQ_INT,
+    INST_LT_INT,
+    INST_GT_INT,
+    INST_LE_INT,
+    INST_GE_INT,
+    INST_ADD_INT,
+    INST_SUB_INT,
+    INST_MULT_INT,
+    INST_EQ_DBL,
+    INST_NEQ_DBL,
+    INST_LT_DBL,
+    INST_GT_DBL,
+    INST_LE_DBL,
+    INST_GE_DBL,
+    INST_ADD_DBL,
+    INST_SUB_DBL,
+    INST_MULT_DBL,
+    INST_DIV_DBL,
+
     /* The last opcode */
     LAST_INST_OPCODE
 };
@@ -1045,6 +1205,26 @@ typedef struct {
 				 * STRUCTURE. */
 } DictUpdateInfo;
 
+/*
+ * Structure used to hold the information needed by INST_INLINE_GUARD to check
+ * that the command called at a site where a procedure body has been inlined
+ * is still that procedure. These structures are stored in CompileEnv and
+ * ByteCode structures as auxiliary data.
+ */
+
+typedef struct InlinedProcInfo {
+    Command *cmdPtr;		/* The command of the inlined procedure. We
+				 * hold a reference to it. */
+    Tcl_Size cmdEpoch;		/* The cmdEpoch of the command when it was
+				 * inlined. */
+    Proc *procPtr;		/* The procedure that was inlined. */
+    Tcl_Size numWords;		/* Number of words of the invocation; the
+				 * command name is the deepest of them on the
+				 * stack. */
+} InlinedProcInfo;
+
+MODULE_SCOPE const AuxDataType tclInlinedProcInfoType;
+
 /*
  * ClientData type used by the math operator commands.
  */
@@ -1111,9 +1291,11 @@ MODULE_SCOPE void	TclCompileVarSubst(Tcl_Interp *interp,
 			    Tcl_Token *tokenPtr, CompileEnv *envPtr);
 MODULE_SCOPE Tcl_Size	TclCreateAuxData(void *clientData,
 			    const AuxDataType *typePtr, CompileEnv *envPtr);
+MODULE_SCOPE ByteCodeBody *TclCreateByteCodeBody(CompileEnv *envPtr);
 MODULE_SCOPE Tcl_Size	TclCreateExceptRange(ExceptionRangeType type,
 			    CompileEnv *envPtr);
 MODULE_SCOPE ExecEnv *	TclCreateExecEnv(Tcl_Interp *interp, size_t size);
+MODULE_SCOPE InvokeCache * TclCreateInvokeCache(ByteCode *codePtr);
 MODULE_SCOPE Tcl_Obj *	TclCreateLiteral(Interp *iPtr, const char *bytes,
 			    Tcl_Size length, size_t hash, int *newPtr,
 			    Namespace *nsPtr, int flags,
@@ -1135,8 +1317,12 @@ MODULE_SCOPE Tcl_Size	TclFindCompiledLocal(const char *name, Tcl_Size nameChars,
 MODULE_SCOPE int	TclFixupForwardJump(CompileEnv *envPtr,
 			    JumpFixup *jumpFixupPtr, int jumpDist,
 			    int distThreshold);
+MODULE_SCOPE void	TclFreeByteCodeBody(ByteCodeBody *bodyPtr);
 MODULE_SCOPE void	TclFreeCompileEnv(CompileEnv *envPtr);
+MODULE_SCOPE void	TclFreeInvokeCache(InvokeCache *cachePtr);
 MODULE_SCOPE void	TclFreeJumpFixupArray(JumpFixupArray *fixupArrayPtr);
+MODULE_SCOPE Tcl_Obj *	TclGetByteCodeCacheKey(Tcl_Interp *interp,
+			    CompileEnv *envPtr);
 MODULE_SCOPE int	TclGetIndexFromToken(Tcl_Token *tokenPtr,
 			    size_t before, size_t after, int *indexPtr);
 MODULE_SCOPE ByteCode *	TclInitByteCode(CompileEnv *envPtr);
@@ -1149,6 +1335,7 @@ MODULE_SCOPE void	TclInitJumpFixupArray(JumpFixupArray *fixupArrayPtr);
 MODULE_SCOPE void	TclInitLiteralTable(LiteralTable *tablePtr);
 MODULE_SCOPE ExceptionRange *TclGetInnermostExceptionRange(CompileEnv *envPtr,
 			    int returnCode, ExceptionAux **auxPtrPtr);
+MODULE_SCOPE void	TclEmitInlinedReturn(CompileEnv *envPtr);
 MODULE_SCOPE void	TclAddLoopBreakFixup(CompileEnv *envPtr,
 			    ExceptionAux *auxPtr);
 MODULE_SCOPE void	TclAddLoopContinueFixup(CompileEnv *envPtr,
@@ -1159,10 +1346,14 @@ MODULE_SCOPE void	TclFinalizeLoopExceptionRange(CompileEnv *envPtr,
 MODULE_SCOPE char *	TclLiteralStats(LiteralTable *tablePtr);
 MODULE_SCOPE int	TclLog2(int value);
 #endif
+MODULE_SCOPE int	TclLoadCachedByteCode(Tcl_Interp *interp,
+			    Tcl_Obj *keyPtr, CompileEnv *envPtr);
 MODULE_SCOPE size_t	TclLocalScalar(const char *bytes, size_t numBytes,
 			    CompileEnv *envPtr);
 MODULE_SCOPE size_t	TclLocalScalarFromToken(Tcl_Token *tokenPtr,
 			    CompileEnv *envPtr);
+MODULE_SCOPE LiteralEntry * TclLookupLiteralEntry(Tcl_Interp *interp,
+			    Tcl_Obj *objPtr);
 MODULE_SCOPE void	TclOptimizeBytecode(void *envPtr);
 #ifdef TCL_COMPILE_DEBUG
 MODULE_SCOPE void	TclPrintByteCodeObj(Tcl_Interp *interp,
@@ -1180,7 +1371,10 @@ MODULE_SCOPE void	TclPushVarName(Tcl_Interp *interp,
 			    int *isScalarPtr);
 MODULE_SCOPE void	TclPreserveByteCode(ByteCode *codePtr);
 MODULE_SCOPE void	TclReleaseByteCode(ByteCode *codePtr);
+MODULE_SCOPE void	TclReleaseByteCodeBody(ByteCodeBody *bodyPtr);
 MODULE_SCOPE void	TclReleaseLiteral(Tcl_Interp *interp, Tcl_Obj *objPtr);
+MODULE_SCOPE void	TclSaveCachedByteCode(Tcl_Interp *interp,
+			    Tcl_Obj *keyPtr, CompileEnv *envPtr);
 MODULE_SCOPE void	TclInvalidateCmdLiteral(Tcl_Interp *interp,
 			    const char *name, Namespace *nsPtr);
 MODULE_SCOPE Tcl_ObjCmdProc	TclSingleOpCmd;
@@ -48,13 +48,6 @@ static Tcl_FreeInternalRepProc	FreeDictInternalRep;
 static void			InvalidateDictChain(Tcl_Obj *dictObj);
 static Tcl_SetFromAnyProc	SetDictFromAny;
 static Tcl_UpdateStringProc	UpdateStringOfDict;
-static Tcl_AllocHashEntryProc	AllocChainEntry;
-static inline void		InitChainTable(struct Dict *dict);
-static inline void		DeleteChainTable(struct Dict *dict);
-static inline Tcl_HashEntry *	CreateChainEntry(struct Dict *dict,
-					Tcl_Obj *keyPtr, int *newPtr);
-static inline int		DeleteChainEntry(struct Dict *dict,
-					Tcl_Obj *keyPtr);
 static Tcl_NRPostProc		FinalizeDictUpdate;
 static Tcl_NRPostProc		FinalizeDictWith;
 static Tcl_ObjCmdProc		DictForNRCmd;
@@ -94,41 +87,131 @@ static const EnsembleImplMap implementationMap[] = {
 };
 
 /*
- * Internal representation of the entries in the hash table that backs a
- * dictionary.
+ * Internal representation of the entries of a dictionary. Entries live in a
+ * dense array in insertion order; an entry whose key is NULL has been
+ * deleted and is skipped by everything that walks the array.
  */
 
-typedef struct ChainEntry {
-    Tcl_HashEntry entry;
-    struct ChainEntry *prevPtr;
-    struct ChainEntry *nextPtr;
-} ChainEntry;
+typedef struct DictEntry {
+    Tcl_Obj *key;		/* Key of the mapping, or NULL if this entry
+				 * has been deleted. */
+    Tcl_Obj *value;		/* Value of the mapping. */
+    TCL_HASH_TYPE hash;		/* Cached hash of the key's string rep. */
+} DictEntry;
+
+/*
+ * Dictionaries with at most this many entry slots have no index and are
+ * searched by a linear scan of the entry array, which is cheaper than
+ * hashing for the small dictionaries that dominate typical use. Larger
+ * dictionaries always have a power-of-two capacity.
+ */
+
+#define DICT_LINEAR_MAX	8
+
+/*
+ * Dictionaries that grow beyond this many entries switch to a persistent
+ * representation, so that copying one (as happens whenever a shared
+ * dictionary value is modified) takes constant time and each modification of
+ * the copy takes time logarithmic in its size, rather than both costing time
+ * proportional to the size.
+ *
+ * The persistent representation is made of two tries whose nodes are
+ * reference counted and shared between the copies of a dictionary. A hash
+ * array mapped trie (HAMT) maps each key to a position, and a radix trie maps
+ * positions (assigned in insertion order) to entries. Lookups go through
+ * both; iteration only walks the second.
+ */
+
+#define DICT_PERSISTENT_MIN	512
+
+#define HAMT_BITS	5
+#define HAMT_MASK	((1 << HAMT_BITS) - 1)
+
+typedef union HamtSlot {
+    struct {
+	Tcl_Obj *key;		/* Key of the entry. */
+	TCL_HASH_TYPE hash;	/* Cached hash of the key's string rep. */
+	Tcl_Size pos;		/* Position of the entry in the entry trie. */
+    } leaf;
+    struct HamtNode *node;	/* Child node for all keys whose hashes share
+				 * the digits leading to this slot. */
+} HamtSlot;
+
+typedef struct HamtNode {
+    size_t refCount;		/* Number of parents and dictionaries that
+				 * refer to this node. */
+    unsigned leafMap;		/* Hash digits present as leaves. */
+    unsigned nodeMap;		/* Hash digits present as child nodes. */
+    int collisions;		/* In a collision node (holding only leaves
+				 * whose keys have the same hash), the number
+				 * of leaves; 0 in other nodes. */
+    HamtSlot slots[TCLFLEXARRAY];
+				/* One slot per bit set in the maps, in order
+				 * of digit value. */
+} HamtNode;
+
+#define ORDER_BITS	5
+#define ORDER_FANOUT	(1 << ORDER_BITS)
+#define ORDER_MASK	(ORDER_FANOUT - 1)
+
+typedef struct OrderNode {
+    size_t refCount;		/* Number of parents and dictionaries that
+				 * refer to this node. */
+    union {
+	struct OrderNode *children[ORDER_FANOUT];
+				/* Subtrees, for interior nodes. */
+	DictEntry entries[ORDER_FANOUT];
+				/* Entries, for leaf nodes. */
+    } u;
+} OrderNode;
+
+typedef struct PersistentDict {
+    HamtNode *hamt;		/* Root of the key trie, or NULL if the
+				 * dictionary is empty. */
+    OrderNode *order;		/* Root of the entry trie, or NULL. */
+    int orderShift;		/* Bit position of the digit that selects
+				 * among the children of the root of the entry
+				 * trie; 0 when the root is a leaf. */
+} PersistentDict;
 
 /*
  * Internal representation of a dictionary.
  *
- * The internal representation of a dictionary object is a hash table (with
- * Tcl_Objs for both keys and values), a reference count and epoch number for
- * detecting concurrent modifications of the dictionary, and a pointer to the
- * parent object (used when invalidating string reps of pathed dictionary
- * trees) which is NULL in normal use. The fact that hash tables know (with
- * appropriate initialisation) already about objects makes key management /so/
- * much easier!
+ * The internal representation of a dictionary object is an array of entries
+ * (with Tcl_Objs for both keys and values) kept in the order in which the
+ * keys were first added, an open-addressed index mapping key hashes to
+ * positions in that array, a reference count and epoch number for detecting
+ * concurrent modifications of the dictionary, and a pointer to the parent
+ * object (used when invalidating string reps of pathed dictionary trees)
+ * which is NULL in normal use.
+ *
+ * The index has twice as many slots as the entry array has capacity, so it
+ * is never more than half full. Each slot holds one more than the position
+ * of an entry (zero marks a free slot) and is 8, 16 or 32 bits wide,
+ * whichever is the smallest that can address the whole entry array. The
+ * entry array and the index share one block of memory. Deleting an entry
+ * leaves its slot in place (the slot then matches nothing); the space is
+ * reclaimed when the entry array is next compacted.
  *
  * Reference counts are used to enable safe iteration across hashes while
  * allowing the type of the containing object to be modified.
  */
 
 typedef struct Dict {
-    Tcl_HashTable table;	/* Object hash table to store mapping in. */
-    ChainEntry *entryChainHead;	/* Linked list of all entries in the
-				 * dictionary. Used for doing traversal of the
-				 * entries in the order that they are
-				 * created. */
-    ChainEntry *entryChainTail;	/* Other end of linked list of all entries in
-				 * the dictionary. Used for doing traversal of
-				 * the entries in the order that they are
-				 * created. */
+    DictEntry *entries;		/* Array of entries in insertion order, with
+				 * the index following it in the same block
+				 * of memory. */
+    Tcl_Size numEntries;	/* Number of live entries. */
+    Tcl_Size used;		/* Number of entries in the array, including
+				 * deleted ones. */
+    Tcl_Size capacity;		/* Allocated length of the entry array. */
+    Tcl_Size indexMask;		/* Number of index slots less one, or 0 if
+				 * the dictionary has no index. */
+    int indexWidth;		/* Size in bytes of an index slot. */
+    PersistentDict *persist;	/* The tries of a dictionary in persistent
+				 * representation, in which case the entry
+				 * array is not used and positions count
+				 * through the entry trie. NULL otherwise. */
     TCL_HASH_TYPE epoch; 	/* Epoch counter */
     size_t refCount;		/* Reference counter (see above) */
     Tcl_Obj *chain;		/* Linked list used for invalidating the
@@ -165,25 +248,6 @@ const Tcl_ObjType tclDictType = {
         (dictRepPtr) = irPtr ? (Dict *)irPtr->twoPtrValue.ptr1 : NULL;          \
     } while (0)
 
-/*
- * The type of the specially adapted version of the Tcl_Obj*-containing hash
- * table defined in the tclObj.c code. This version differs in that it
- * allocates a bit more space in each hash entry in order to hold the pointers
- * used to keep the hash entries in a linked list.
- *
- * Note that this type of hash table is *only* suitable for direct use in
- * *this* file. Everything else should use the dict iterator API.
- */
-
-static const Tcl_HashKeyType chainHashType = {
-    TCL_HASH_KEY_TYPE_VERSION,
-    0,
-    TclHashObjKey,
-    TclCompareObjKeys,
-    AllocChainEntry,
-    TclFreeObjEntry
-};
-
 /*
  * Structure used in implementation of 'dict map' to hold the state that gets
  * passed between parts of the implementation.
@@ -204,135 +268,1223 @@ typedef struct {
 /***** START OF FUNCTIONS IMPLEMENTING DICT CORE API *****/
 
 /*
- *----------------------------------------------------------------------
- *
- * AllocChainEntry --
- *
- *	Allocate space for a Tcl_HashEntry containing the Tcl_Obj * key, and
- *	which has a bit of extra space afterwards for storing pointers to the
- *	rest of the chain of entries (the extra pointers are left NULL).
- *
- * Results:
- *	The return value is a pointer to the created entry.
- *
- * Side effects:
- *	Increments the reference count on the object.
- *
- *----------------------------------------------------------------------
+ * Helper functions that disguise most of the details relating to how the
+ * entry array and its index are managed. In particular, these manage the
+ * creation and deletion of the table, the lookup of a key, the adding of an
+ * entry and the removal of an entry.
  */
 
-static Tcl_HashEntry *
-AllocChainEntry(
-    TCL_UNUSED(Tcl_HashTable *),
-    void *keyPtr)
+static inline Tcl_Size
+IndexGet(
+    const Dict *dict,
+    Tcl_Size slot)
 {
-    Tcl_Obj *objPtr = (Tcl_Obj *)keyPtr;
-    ChainEntry *cPtr;
+    const void *index = dict->entries + dict->capacity;
+
+    switch (dict->indexWidth) {
+    case 1:
+	return ((const uint8_t *)index)[slot];
+    case 2:
+	return ((const uint16_t *)index)[slot];
+    case 4:
+	return ((const uint32_t *)index)[slot];
+    default:
+	return ((const Tcl_Size *)index)[slot];
+    }
+}
 
-    cPtr = (ChainEntry *)Tcl_Alloc(sizeof(ChainEntry));
-    cPtr->entry.key.objPtr = objPtr;
-    Tcl_IncrRefCount(objPtr);
-    Tcl_SetHashValue(&cPtr->entry, NULL);
-    cPtr->prevPtr = cPtr->nextPtr = NULL;
+static inline void
+IndexSet(
+    Dict *dict,
+    Tcl_Size slot,
+    Tcl_Size value)
+{
+    void *index = dict->entries + dict->capacity;
+
+    switch (dict->indexWidth) {
+    case 1:
+	((uint8_t *)index)[slot] = (uint8_t) value;
+	break;
+    case 2:
+	((uint16_t *)index)[slot] = (uint16_t) value;
+	break;
+    case 4:
+	((uint32_t *)index)[slot] = (uint32_t) value;
+	break;
+    default:
+	((Tcl_Size *)index)[slot] = value;
+    }
+}
+
+/*
+ * Walk the probe sequence of an index. The perturbation folds the high bits
+ * of the hash in so that keys whose hashes differ only there do not collide
+ * forever; once it reaches zero the sequence visits every slot.
+ */
+
+#define IndexProbeStart(dict, hash, slot, perturb) \
+    ((perturb) = (hash), (slot) = (Tcl_Size)((hash) & (dict)->indexMask))
+#define IndexProbeNext(dict, slot, perturb) \
+    ((perturb) >>= 5, \
+	(slot) = (Tcl_Size)(((slot)*5 + (perturb) + 1) & (dict)->indexMask))
 
-    return &cPtr->entry;
+static inline int
+SameKey(
+    Tcl_Obj *otherPtr,
+    TCL_HASH_TYPE otherHash,
+    Tcl_Obj *keyPtr,
+    TCL_HASH_TYPE hash)
+{
+    const char *p1, *p2;
+
+    if (otherPtr == keyPtr) {
+	return 1;
+    }
+    if (otherPtr == NULL || otherHash != hash) {
+	return 0;
+    }
+    p1 = TclGetString(otherPtr);
+    p2 = TclGetString(keyPtr);
+    return (otherPtr->length == keyPtr->length)
+	    && !memcmp(p1, p2, keyPtr->length);
 }
-
+
 /*
- * Helper functions that disguise most of the details relating to how the
- * linked list of hash entries is managed. In particular, these manage the
- * creation of the table and initializing of the chain, the deletion of the
- * table and chain, the adding of an entry to the chain, and the removal of an
- * entry from the chain.
+ * Record in the index (if there is one) that the entry at the given position
+ * has the given hash.
  */
 
 static inline void
-InitChainTable(
-    Dict *dict)
+IndexInsert(
+    Dict *dict,
+    TCL_HASH_TYPE hash,
+    Tcl_Size pos)
 {
-    Tcl_InitCustomHashTable(&dict->table, TCL_CUSTOM_PTR_KEYS,
-	    &chainHashType);
-    dict->entryChainHead = dict->entryChainTail = NULL;
+    Tcl_Size slot;
+    TCL_HASH_TYPE perturb;
+
+    if (dict->indexMask == 0) {
+	return;
+    }
+    IndexProbeStart(dict, hash, slot, perturb);
+    while (IndexGet(dict, slot)) {
+	IndexProbeNext(dict, slot, perturb);
+    }
+    IndexSet(dict, slot, pos + 1);
 }
 
-static inline void
-DeleteChainTable(
-    Dict *dict)
+/*
+ * Compute the capacity to allocate for a dictionary that must be able to
+ * hold the given number of entries.
+ */
+
+static inline Tcl_Size
+DictCapacity(
+    Tcl_Size needed)
 {
-    ChainEntry *cPtr;
+    Tcl_Size capacity = DICT_LINEAR_MAX * 2;
 
-    for (cPtr=dict->entryChainHead ; cPtr!=NULL ; cPtr=cPtr->nextPtr) {
-	Tcl_Obj *valuePtr = (Tcl_Obj *)Tcl_GetHashValue(&cPtr->entry);
+    if (needed <= DICT_LINEAR_MAX) {
+	return needed;
+    }
+    while (capacity < needed) {
+	capacity *= 2;
+    }
+    return capacity;
+}
+
+/*
+ * Move the live entries of a dictionary into a freshly allocated block that
+ * can hold the given number of entries, and rebuild the index. This both
+ * grows the table and squeezes out deleted entries.
+ */
 
-	TclDecrRefCount(valuePtr);
+static void
+ResizeDictTable(
+    Dict *dict,
+    Tcl_Size capacity)
+{
+    DictEntry *oldEntries = dict->entries;
+    Tcl_Size i, j, used = dict->used;
+    size_t indexBytes = 0;
+
+    dict->indexMask = 0;
+    dict->indexWidth = 0;
+    if (capacity > DICT_LINEAR_MAX) {
+	dict->indexMask = capacity * 2 - 1;
+	if (capacity < UINT8_MAX) {
+	    dict->indexWidth = 1;
+	} else if (capacity < UINT16_MAX) {
+	    dict->indexWidth = 2;
+	} else if ((size_t) capacity < UINT32_MAX) {
+	    dict->indexWidth = 4;
+	} else {
+	    dict->indexWidth = sizeof(Tcl_Size);
+	}
+	indexBytes = (size_t) (dict->indexMask + 1) * dict->indexWidth;
+    }
+
+    dict->entries = (DictEntry *)Tcl_Alloc(
+	    capacity * sizeof(DictEntry) + indexBytes);
+    dict->capacity = capacity;
+    if (indexBytes) {
+	memset(dict->entries + capacity, 0, indexBytes);
+    }
+
+    for (i=j=0 ; i<used ; i++) {
+	DictEntry *ePtr = &oldEntries[i];
+
+	if (ePtr->key == NULL) {
+	    continue;
+	}
+	dict->entries[j] = *ePtr;
+	IndexInsert(dict, ePtr->hash, j);
+	j++;
+    }
+    dict->used = j;
+
+    if (oldEntries != NULL) {
+	Tcl_Free(oldEntries);
     }
-    Tcl_DeleteHashTable(&dict->table);
 }
 
-static inline Tcl_HashEntry *
-CreateChainEntry(
+/*
+ * Look up the entry for a key in a dictionary using the entry array. The
+ * hash of the key is computed only when it is needed, and is returned
+ * through hashPtr (with *hashValidPtr set) so that an insertion following a
+ * failed lookup need not compute it again.
+ */
+
+static inline DictEntry *
+LookupDictEntry(
     Dict *dict,
     Tcl_Obj *keyPtr,
-    int *newPtr)
+    TCL_HASH_TYPE *hashPtr,
+    int *hashValidPtr)
+{
+    DictEntry *ePtr;
+    TCL_HASH_TYPE hash, perturb;
+    Tcl_Size i, slot;
+
+    if (dict->indexMask == 0) {
+	int hashValid = 0;
+
+	hash = 0;
+	for (i=0 ; i<dict->used ; i++) {
+	    ePtr = &dict->entries[i];
+	    if (ePtr->key == keyPtr) {
+		return ePtr;
+	    }
+	    if (ePtr->key == NULL) {
+		continue;
+	    }
+	    if (!hashValid) {
+		hash = TclHashObjKey(NULL, keyPtr);
+		hashValid = 1;
+	    }
+	    if (SameKey(ePtr->key, ePtr->hash, keyPtr, hash)) {
+		return ePtr;
+	    }
+	}
+	*hashPtr = hash;
+	*hashValidPtr = hashValid;
+	return NULL;
+    }
+
+    hash = TclHashObjKey(NULL, keyPtr);
+    *hashPtr = hash;
+    *hashValidPtr = 1;
+    IndexProbeStart(dict, hash, slot, perturb);
+    while ((i = IndexGet(dict, slot)) != 0) {
+	ePtr = &dict->entries[i - 1];
+	if (SameKey(ePtr->key, ePtr->hash, keyPtr, hash)) {
+	    return ePtr;
+	}
+	IndexProbeNext(dict, slot, perturb);
+    }
+    return NULL;
+}
+
+/*
+ * Helpers for the persistent representation. HAMT nodes hold a bitmap of the
+ * hash digits present at their level; a digit is either a leaf (key, hash
+ * and position in the entry trie) or a child node for keys sharing that
+ * digit. Keys whose hashes are identical are kept together in a collision
+ * node, a plain list of leaves, at the first level where they are apart from
+ * all other keys. Both tries are modified by path copying: a node with a reference
+ * count of one belongs to the dictionary being modified alone and is updated
+ * in place, while a shared node is copied first (adding a reference to each
+ * of its children). The functions that modify a node consume the reference
+ * to it that they are passed and return a reference to its replacement.
+ */
+
+static inline unsigned
+HamtHash(
+    TCL_HASH_TYPE hash)
 {
-    ChainEntry *cPtr = (ChainEntry *)
-	    Tcl_CreateHashEntry(&dict->table, keyPtr, newPtr);
+    unsigned h = (unsigned) hash;
 
     /*
-     * If this is a new entry in the hash table, stitch it into the chain.
+     * Scramble the key hash so that every 5-bit digit depends on the whole
+     * key; the low bits of the string hash alone cluster badly.
      */
 
-    if (*newPtr) {
-	cPtr->nextPtr = NULL;
-	if (dict->entryChainHead == NULL) {
-	    cPtr->prevPtr = NULL;
-	    dict->entryChainHead = cPtr;
-	    dict->entryChainTail = cPtr;
+    h ^= h >> 16;
+    h *= 0x7FEB352DU;
+    h ^= h >> 15;
+    h *= 0x846CA68BU;
+    h ^= h >> 16;
+    return h;
+}
+
+static inline int
+BitCount(
+    unsigned bits)
+{
+#if defined(__GNUC__)
+    return __builtin_popcount(bits);
+#else
+    int count = 0;
+
+    while (bits) {
+	bits &= bits - 1;
+	count++;
+    }
+    return count;
+#endif
+}
+
+#define HamtDigitBit(hash, shift) \
+    (1U << ((HamtHash(hash) >> (shift)) & HAMT_MASK))
+#define HamtSlotIndex(node, bit) \
+    BitCount(((node)->leafMap | (node)->nodeMap) & ((bit) - 1))
+
+static inline int
+HamtSize(
+    const HamtNode *node)
+{
+    if (node->collisions) {
+	return node->collisions;
+    }
+    return BitCount(node->leafMap | node->nodeMap);
+}
+
+/*
+ * Whether slot i (for digit bit) of a node holds a child node.
+ */
+
+#define HamtIsChild(node, bit) \
+    (!(node)->collisions && ((node)->nodeMap & (bit)))
+
+/*
+ * Iterate over the slots of a node, setting bit to the digit bit of each
+ * slot (0 in a collision node).
+ */
+
+#define HamtForEachSlot(node, i, n, bits, bit) \
+    for ((i)=0, (n)=HamtSize(node), (bits)=(node)->leafMap|(node)->nodeMap; \
+	    (bit)=(bits) & (~(bits)+1), (i)<(n) ; (i)++, (bits)&=~(bit))
+
+static HamtNode *
+HamtAlloc(
+    int numSlots)
+{
+    HamtNode *node = (HamtNode *)Tcl_Alloc(
+	    offsetof(HamtNode, slots) + numSlots * sizeof(HamtSlot));
+
+    node->refCount = 1;
+    node->leafMap = node->nodeMap = 0;
+    node->collisions = 0;
+    return node;
+}
+
+static inline void
+HamtSetLeaf(
+    HamtSlot *slotPtr,
+    Tcl_Obj *keyPtr,
+    TCL_HASH_TYPE hash,
+    Tcl_Size pos)
+{
+    slotPtr->leaf.key = keyPtr;
+    Tcl_IncrRefCount(keyPtr);
+    slotPtr->leaf.hash = hash;
+    slotPtr->leaf.pos = pos;
+}
+
+/*
+ * Add a reference to everything that the slots of a node refer to, except
+ * the slot at position skip (which may be -1 to skip nothing).
+ */
+
+static void
+HamtRetainSlots(
+    HamtNode *node,
+    int skip)
+{
+    int i, n;
+    unsigned bits, bit;
+
+    HamtForEachSlot(node, i, n, bits, bit) {
+	if (i == skip) {
+	    continue;
+	}
+	if (HamtIsChild(node, bit)) {
+	    node->slots[i].node->refCount++;
 	} else {
-	    cPtr->prevPtr = dict->entryChainTail;
-	    dict->entryChainTail->nextPtr = cPtr;
-	    dict->entryChainTail = cPtr;
+	    Tcl_IncrRefCount(node->slots[i].leaf.key);
 	}
     }
+}
 
-    return &cPtr->entry;
+static void
+HamtRelease(
+    HamtNode *node)
+{
+    int i, n;
+    unsigned bits, bit;
+
+    if (node->refCount-- > 1) {
+	return;
+    }
+    HamtForEachSlot(node, i, n, bits, bit) {
+	if (HamtIsChild(node, bit)) {
+	    HamtRelease(node->slots[i].node);
+	} else {
+	    TclDecrRefCount(node->slots[i].leaf.key);
+	}
+    }
+    Tcl_Free(node);
 }
 
-static inline int
-DeleteChainEntry(
+static HamtNode *
+HamtWritable(
+    HamtNode *node)
+{
+    HamtNode *copy;
+    int n;
+
+    if (node->refCount == 1) {
+	return node;
+    }
+    n = HamtSize(node);
+    copy = HamtAlloc(n);
+    copy->leafMap = node->leafMap;
+    copy->nodeMap = node->nodeMap;
+    copy->collisions = node->collisions;
+    memcpy(copy->slots, node->slots, n * sizeof(HamtSlot));
+    HamtRetainSlots(copy, -1);
+    node->refCount--;
+    return copy;
+}
+
+/*
+ * Make a copy of a node with an uninitialised slot inserted at position
+ * pos, or with the (leaf) slot at position pos removed. In both cases the
+ * maps are left for the caller to adjust.
+ */
+
+static HamtNode *
+HamtInsertSlot(
+    HamtNode *node,
+    int pos)
+{
+    int n = HamtSize(node);
+    HamtNode *copy = HamtAlloc(n + 1);
+
+    copy->leafMap = node->leafMap;
+    copy->nodeMap = node->nodeMap;
+    copy->collisions = node->collisions;
+    memcpy(copy->slots, node->slots, pos * sizeof(HamtSlot));
+    memcpy(copy->slots + pos + 1, node->slots + pos,
+	    (n - pos) * sizeof(HamtSlot));
+    if (node->refCount == 1) {
+	Tcl_Free(node);
+    } else {
+	HamtRetainSlots(node, -1);
+	node->refCount--;
+    }
+    return copy;
+}
+
+static HamtNode *
+HamtRemoveSlot(
+    HamtNode *node,
+    int pos)
+{
+    int n = HamtSize(node);
+    HamtNode *copy = HamtAlloc(n - 1);
+
+    copy->leafMap = node->leafMap;
+    copy->nodeMap = node->nodeMap;
+    copy->collisions = node->collisions;
+    memcpy(copy->slots, node->slots, pos * sizeof(HamtSlot));
+    memcpy(copy->slots + pos, node->slots + pos + 1,
+	    (n - pos - 1) * sizeof(HamtSlot));
+    if (node->refCount == 1) {
+	TclDecrRefCount(node->slots[pos].leaf.key);
+	Tcl_Free(node);
+    } else {
+	HamtRetainSlots(node, pos);
+	node->refCount--;
+    }
+    return copy;
+}
+
+/*
+ * Build the node that holds a new leaf together with an existing slot (a
+ * leaf, or a collision node) whose keys have the given hash, where the two
+ * hashes agree in all digits above the given level. The reference held by
+ * the existing slot is taken over.
+ */
+
+static HamtNode *
+HamtPair(
+    const HamtSlot *oldPtr,
+    int oldIsNode,
+    TCL_HASH_TYPE oldHash,
+    Tcl_Obj *keyPtr,
+    TCL_HASH_TYPE hash,
+    Tcl_Size pos,
+    int shift)
+{
+    HamtNode *node;
+    unsigned oldBit, newBit;
+
+    if (!oldIsNode && HamtHash(oldHash) == HamtHash(hash)) {
+	node = HamtAlloc(2);
+	node->collisions = 2;
+	node->slots[0] = *oldPtr;
+	HamtSetLeaf(&node->slots[1], keyPtr, hash, pos);
+	return node;
+    }
+    oldBit = HamtDigitBit(oldHash, shift);
+    newBit = HamtDigitBit(hash, shift);
+    if (oldBit == newBit) {
+	node = HamtAlloc(1);
+	node->nodeMap = oldBit;
+	node->slots[0].node = HamtPair(oldPtr, oldIsNode, oldHash, keyPtr,
+		hash, pos, shift + HAMT_BITS);
+    } else {
+	node = HamtAlloc(2);
+	if (oldIsNode) {
+	    node->nodeMap = oldBit;
+	} else {
+	    node->leafMap = oldBit;
+	}
+	node->leafMap |= newBit;
+	node->slots[oldBit > newBit] = *oldPtr;
+	HamtSetLeaf(&node->slots[newBit > oldBit], keyPtr, hash, pos);
+    }
+    return node;
+}
+
+static Tcl_Size
+HamtFind(
+    HamtNode *node,
+    Tcl_Obj *keyPtr,
+    TCL_HASH_TYPE hash)
+{
+    int shift = 0;
+
+    while (node != NULL) {
+	HamtSlot *slotPtr;
+	unsigned bit;
+
+	if (node->collisions) {
+	    int i;
+
+	    for (i=0 ; i<node->collisions ; i++) {
+		slotPtr = &node->slots[i];
+		if (SameKey(slotPtr->leaf.key, slotPtr->leaf.hash, keyPtr,
+			hash)) {
+		    return slotPtr->leaf.pos;
+		}
+	    }
+	    break;
+	}
+	bit = HamtDigitBit(hash, shift);
+	slotPtr = &node->slots[HamtSlotIndex(node, bit)];
+	if (node->nodeMap & bit) {
+	    node = slotPtr->node;
+	    shift += HAMT_BITS;
+	} else if ((node->leafMap & bit) && SameKey(slotPtr->leaf.key,
+		slotPtr->leaf.hash, keyPtr, hash)) {
+	    return slotPtr->leaf.pos;
+	} else {
+	    break;
+	}
+    }
+    return TCL_INDEX_NONE;
+}
+
+/*
+ * Add a key that is known not to be present.
+ */
+
+static HamtNode *
+HamtInsert(
+    HamtNode *node,
+    int shift,
+    Tcl_Obj *keyPtr,
+    TCL_HASH_TYPE hash,
+    Tcl_Size pos)
+{
+    unsigned bit;
+    int i;
+
+    if (node == NULL) {
+	node = HamtAlloc(1);
+	node->leafMap = HamtDigitBit(hash, shift);
+	HamtSetLeaf(&node->slots[0], keyPtr, hash, pos);
+	return node;
+    }
+    if (node->collisions) {
+	HamtSlot old;
+
+	if (HamtHash(node->slots[0].leaf.hash) == HamtHash(hash)) {
+	    i = node->collisions;
+	    node = HamtInsertSlot(node, i);
+	    node->collisions++;
+	    HamtSetLeaf(&node->slots[i], keyPtr, hash, pos);
+	    return node;
+	}
+
+	/*
+	 * The new key only shares some digits with the colliding keys, so
+	 * move the collision node down to where they part.
+	 */
+
+	old.node = node;
+	return HamtPair(&old, 1, node->slots[0].leaf.hash, keyPtr, hash, pos,
+		shift);
+    }
+
+    bit = HamtDigitBit(hash, shift);
+    i = HamtSlotIndex(node, bit);
+    if (node->nodeMap & bit) {
+	node = HamtWritable(node);
+	node->slots[i].node = HamtInsert(node->slots[i].node,
+		shift + HAMT_BITS, keyPtr, hash, pos);
+    } else if (node->leafMap & bit) {
+	HamtSlot old;
+
+	node = HamtWritable(node);
+	old = node->slots[i];
+	node->slots[i].node = HamtPair(&old, 0, old.leaf.hash, keyPtr, hash,
+		pos, shift + HAMT_BITS);
+	node->leafMap &= ~bit;
+	node->nodeMap |= bit;
+    } else {
+	node = HamtInsertSlot(node, i);
+	node->leafMap |= bit;
+	HamtSetLeaf(&node->slots[i], keyPtr, hash, pos);
+    }
+    return node;
+}
+
+/*
+ * Remove a key that is known to be present. Returns NULL if the node
+ * becomes empty. A child node left holding a single leaf is replaced by that
+ * leaf, so that every child node holds at least two keys.
+ */
+
+static HamtNode *
+HamtRemove(
+    HamtNode *node,
+    int shift,
+    Tcl_Obj *keyPtr,
+    TCL_HASH_TYPE hash)
+{
+    unsigned bit;
+    int i;
+
+    if (HamtSize(node) == 1 && !HamtIsChild(node, node->nodeMap)) {
+	HamtRelease(node);
+	return NULL;
+    }
+    if (node->collisions) {
+	for (i=0 ; !SameKey(node->slots[i].leaf.key, node->slots[i].leaf.hash,
+		keyPtr, hash) ; i++) {
+	    /* Empty loop body. */
+	}
+	node = HamtRemoveSlot(node, i);
+	node->collisions--;
+	return node;
+    }
+
+    bit = HamtDigitBit(hash, shift);
+    i = HamtSlotIndex(node, bit);
+    if (node->nodeMap & bit) {
+	HamtNode *child;
+
+	node = HamtWritable(node);
+	child = HamtRemove(node->slots[i].node, shift + HAMT_BITS, keyPtr,
+		hash);
+	if (HamtSize(child) == 1 && !HamtIsChild(child, child->nodeMap)) {
+	    node->slots[i] = child->slots[0];
+	    if (child->refCount == 1) {
+		Tcl_Free(child);
+	    } else {
+		Tcl_IncrRefCount(node->slots[i].leaf.key);
+		child->refCount--;
+	    }
+	    node->nodeMap &= ~bit;
+	    node->leafMap |= bit;
+	} else {
+	    node->slots[i].node = child;
+	}
+    } else {
+	node = HamtRemoveSlot(node, i);
+	node->leafMap &= ~bit;
+    }
+    return node;
+}
+
+/*
+ * Count the nodes of a key trie and find its depth, for [dict info].
+ */
+
+static void
+HamtStats(
+    HamtNode *node,
+    int depth,
+    Tcl_Size *numNodesPtr,
+    int *depthPtr)
+{
+    int i, n;
+    unsigned bits, bit;
+
+    (*numNodesPtr)++;
+    if (depth > *depthPtr) {
+	*depthPtr = depth;
+    }
+    HamtForEachSlot(node, i, n, bits, bit) {
+	if (HamtIsChild(node, bit)) {
+	    HamtStats(node->slots[i].node, depth + 1, numNodesPtr, depthPtr);
+	}
+    }
+}
+
+/*
+ * The entry trie is a radix tree over entry positions. Leaves hold the
+ * entries themselves, so an iteration only touches the trie; empty subtrees
+ * (never filled, or not yet reached by appends) are NULL.
+ */
+
+static OrderNode *
+OrderAlloc(
+    int shift)
+{
+    size_t size = shift ? sizeof(OrderNode *) * ORDER_FANOUT
+	    : sizeof(DictEntry) * ORDER_FANOUT;
+    OrderNode *node = (OrderNode *)Tcl_Alloc(offsetof(OrderNode, u) + size);
+
+    node->refCount = 1;
+    memset(&node->u, 0, size);
+    return node;
+}
+
+static void
+OrderRelease(
+    OrderNode *node,
+    int shift)
+{
+    int i;
+
+    if (node->refCount-- > 1) {
+	return;
+    }
+    for (i=0 ; i<ORDER_FANOUT ; i++) {
+	if (shift) {
+	    if (node->u.children[i] != NULL) {
+		OrderRelease(node->u.children[i], shift - ORDER_BITS);
+	    }
+	} else if (node->u.entries[i].key != NULL) {
+	    TclDecrRefCount(node->u.entries[i].key);
+	    TclDecrRefCount(node->u.entries[i].value);
+	}
+    }
+    Tcl_Free(node);
+}
+
+static OrderNode *
+OrderWritable(
+    OrderNode *node,
+    int shift)
+{
+    OrderNode *copy;
+    int i;
+
+    if (node == NULL) {
+	return OrderAlloc(shift);
+    }
+    if (node->refCount == 1) {
+	return node;
+    }
+    copy = OrderAlloc(shift);
+    for (i=0 ; i<ORDER_FANOUT ; i++) {
+	if (shift) {
+	    copy->u.children[i] = node->u.children[i];
+	    if (copy->u.children[i] != NULL) {
+		copy->u.children[i]->refCount++;
+	    }
+	} else {
+	    copy->u.entries[i] = node->u.entries[i];
+	    if (copy->u.entries[i].key != NULL) {
+		Tcl_IncrRefCount(copy->u.entries[i].key);
+		Tcl_IncrRefCount(copy->u.entries[i].value);
+	    }
+	}
+    }
+    node->refCount--;
+    return copy;
+}
+
+static DictEntry *
+OrderLookup(
+    OrderNode *node,
+    int shift,
+    Tcl_Size pos)
+{
+    for (; shift ; shift -= ORDER_BITS) {
+	node = node->u.children[(pos >> shift) & ORDER_MASK];
+    }
+    return &node->u.entries[pos & ORDER_MASK];
+}
+
+/*
+ * Get the entry at a position for modification, copying the path to it as
+ * needed.
+ */
+
+static DictEntry *
+OrderModify(
+    PersistentDict *pPtr,
+    Tcl_Size pos)
+{
+    OrderNode **linkPtr = &pPtr->order;
+    int shift = pPtr->orderShift;
+
+    while (1) {
+	*linkPtr = OrderWritable(*linkPtr, shift);
+	if (shift == 0) {
+	    return &(*linkPtr)->u.entries[pos & ORDER_MASK];
+	}
+	linkPtr = &(*linkPtr)->u.children[(pos >> shift) & ORDER_MASK];
+	shift -= ORDER_BITS;
+    }
+}
+
+/*
+ * Find the first entry at or after a position, updating the position. The
+ * caller must ensure that the position is within the capacity of the trie.
+ */
+
+static DictEntry *
+OrderNext(
+    OrderNode *node,
+    int shift,
+    Tcl_Size *posPtr)
+{
+    Tcl_Size pos = *posPtr;
+    int i;
+
+    if (node == NULL) {
+	return NULL;
+    }
+    i = (pos >> shift) & ORDER_MASK;
+    for (; i<ORDER_FANOUT ; i++) {
+	if (shift == 0) {
+	    if (node->u.entries[i].key != NULL) {
+		*posPtr = pos;
+		return &node->u.entries[i];
+	    }
+	    pos++;
+	} else if (node->u.children[i] != NULL) {
+	    DictEntry *ePtr = OrderNext(node->u.children[i],
+		    shift - ORDER_BITS, &pos);
+
+	    if (ePtr != NULL) {
+		*posPtr = pos;
+		return ePtr;
+	    }
+	} else {
+	    pos = ((pos >> shift) + 1) << shift;
+	}
+    }
+    *posPtr = pos;
+    return NULL;
+}
+
+/*
+ * Add an entry (with a NULL value) for a key known not to be present,
+ * packing the entry trie first if deletions have left it mostly empty.
+ */
+
+static void		RepackPersistentDict(Dict *dict);
+
+static DictEntry *
+PersistentAppend(
     Dict *dict,
-    Tcl_Obj *keyPtr)
+    Tcl_Obj *keyPtr,
+    TCL_HASH_TYPE hash)
 {
-    ChainEntry *cPtr = (ChainEntry *)
-	    Tcl_FindHashEntry(&dict->table, keyPtr);
+    PersistentDict *pPtr = dict->persist;
+    DictEntry *ePtr;
+
+    if (dict->used > 2 * dict->numEntries + ORDER_FANOUT) {
+	RepackPersistentDict(dict);
+    }
+    if ((dict->used >> pPtr->orderShift) >= ORDER_FANOUT) {
+	OrderNode *root = OrderAlloc(pPtr->orderShift + ORDER_BITS);
+
+	root->u.children[0] = pPtr->order;
+	pPtr->order = root;
+	pPtr->orderShift += ORDER_BITS;
+    }
+    pPtr->hamt = HamtInsert(pPtr->hamt, 0, keyPtr, hash, dict->used);
+    ePtr = OrderModify(pPtr, dict->used);
+    ePtr->key = keyPtr;
+    Tcl_IncrRefCount(keyPtr);
+    ePtr->value = NULL;
+    ePtr->hash = hash;
+    dict->used++;
+    dict->numEntries++;
+    return ePtr;
+}
 
-    if (cPtr == NULL) {
-	return 0;
+/*
+ * Rebuild the persistent representation of a dictionary with its entries at
+ * consecutive positions. The old tries may still be shared with other
+ * dictionaries.
+ */
+
+static void
+RepackPersistentDict(
+    Dict *dict)
+{
+    PersistentDict *pPtr = dict->persist;
+    OrderNode *oldOrder = pPtr->order;
+    HamtNode *oldHamt = pPtr->hamt;
+    int oldShift = pPtr->orderShift;
+    Tcl_Size pos = 0, oldUsed = dict->used;
+    DictEntry *ePtr;
+
+    pPtr->order = NULL;
+    pPtr->hamt = NULL;
+    pPtr->orderShift = 0;
+    dict->used = dict->numEntries = 0;
+    while (pos < oldUsed
+	    && (ePtr = OrderNext(oldOrder, oldShift, &pos)) != NULL) {
+	DictEntry *newPtr = PersistentAppend(dict, ePtr->key, ePtr->hash);
+
+	newPtr->value = ePtr->value;
+	Tcl_IncrRefCount(newPtr->value);
+	pos++;
+    }
+    if (oldHamt != NULL) {
+	HamtRelease(oldHamt);
+    }
+    if (oldOrder != NULL) {
+	OrderRelease(oldOrder, oldShift);
+    }
+}
+
+/*
+ * Switch a dictionary from the entry array to the persistent
+ * representation.
+ */
+
+static void
+MakeDictPersistent(
+    Dict *dict)
+{
+    DictEntry *entries = dict->entries;
+    Tcl_Size i, used = dict->used;
+
+    dict->persist = (PersistentDict *)Tcl_Alloc(sizeof(PersistentDict));
+    dict->persist->hamt = NULL;
+    dict->persist->order = NULL;
+    dict->persist->orderShift = 0;
+    dict->entries = NULL;
+    dict->numEntries = dict->used = dict->capacity = 0;
+    dict->indexMask = 0;
+    dict->indexWidth = 0;
+
+    for (i=0 ; i<used ; i++) {
+	DictEntry *ePtr = &entries[i];
+
+	if (ePtr->key != NULL) {
+	    PersistentAppend(dict, ePtr->key, ePtr->hash)->value = ePtr->value;
+	    TclDecrRefCount(ePtr->key);
+	}
+    }
+    if (entries != NULL) {
+	Tcl_Free(entries);
+    }
+}
+
+/*
+ * The functions below are what the rest of this file uses to operate on the
+ * table of a dictionary, whichever representation it has.
+ */
+
+static inline void
+InitDictTable(
+    Dict *dict,
+    Tcl_Size sizeHint)
+{
+    dict->entries = NULL;
+    dict->numEntries = dict->used = dict->capacity = 0;
+    dict->indexMask = 0;
+    dict->indexWidth = 0;
+    dict->persist = NULL;
+    if (sizeHint > DICT_PERSISTENT_MIN) {
+	MakeDictPersistent(dict);
+    } else if (sizeHint > 0) {
+	ResizeDictTable(dict, DictCapacity(sizeHint));
+    }
+}
+
+static inline void
+DeleteDictTable(
+    Dict *dict)
+{
+    Tcl_Size i;
+
+    if (dict->persist != NULL) {
+	if (dict->persist->hamt != NULL) {
+	    HamtRelease(dict->persist->hamt);
+	}
+	if (dict->persist->order != NULL) {
+	    OrderRelease(dict->persist->order, dict->persist->orderShift);
+	}
+	Tcl_Free(dict->persist);
+	return;
+    }
+    for (i=0 ; i<dict->used ; i++) {
+	DictEntry *ePtr = &dict->entries[i];
+
+	if (ePtr->key != NULL) {
+	    TclDecrRefCount(ePtr->key);
+	    TclDecrRefCount(ePtr->value);
+	}
+    }
+    if (dict->entries != NULL) {
+	Tcl_Free(dict->entries);
+    }
+}
+
+/*
+ * Get the first entry at or after a position in the dictionary's insertion
+ * order, updating the position. Returns NULL at the end of the dictionary.
+ */
+
+static inline DictEntry *
+NextDictEntry(
+    Dict *dict,
+    Tcl_Size *posPtr)
+{
+    Tcl_Size pos;
+
+    if (*posPtr >= dict->used) {
+	return NULL;
+    }
+    if (dict->persist != NULL) {
+	return OrderNext(dict->persist->order, dict->persist->orderShift,
+		posPtr);
+    }
+    for (pos=*posPtr ; pos<dict->used ; pos++) {
+	if (dict->entries[pos].key != NULL) {
+	    *posPtr = pos;
+	    return &dict->entries[pos];
+	}
+    }
+    return NULL;
+}
+
+/*
+ * Get the value for a key, or NULL if the key is absent. When the caller may
+ * go on to modify the value in place, a persistent dictionary first copies
+ * the path to the entry, so that the value's reference count also counts any
+ * other dictionary still sharing that entry.
+ */
+
+static inline Tcl_Obj *
+DictGetValue(
+    Dict *dict,
+    Tcl_Obj *keyPtr,
+    int forUpdate)
+{
+    DictEntry *ePtr;
+
+    if (dict->persist != NULL) {
+	Tcl_Size pos = HamtFind(dict->persist->hamt, keyPtr,
+		TclHashObjKey(NULL, keyPtr));
+
+	if (pos == TCL_INDEX_NONE) {
+	    return NULL;
+	}
+	if (forUpdate) {
+	    ePtr = OrderModify(dict->persist, pos);
+	} else {
+	    ePtr = OrderLookup(dict->persist->order,
+		    dict->persist->orderShift, pos);
+	}
     } else {
-	Tcl_Obj *valuePtr = (Tcl_Obj *)Tcl_GetHashValue(&cPtr->entry);
+	TCL_HASH_TYPE hash;
+	int hashValid;
 
-	TclDecrRefCount(valuePtr);
+	ePtr = LookupDictEntry(dict, keyPtr, &hash, &hashValid);
+	if (ePtr == NULL) {
+	    return NULL;
+	}
     }
+    return ePtr->value;
+}
 
-    /*
-     * Unstitch from the chain.
-     */
+/*
+ * Set the value for a key, adding the key if it is not present. Reference
+ * counts of the key and both the old and new values are managed here.
+ * Returns whether the key was added.
+ */
 
-    if (cPtr->nextPtr) {
-	cPtr->nextPtr->prevPtr = cPtr->prevPtr;
+static int
+DictPutValue(
+    Dict *dict,
+    Tcl_Obj *keyPtr,
+    Tcl_Obj *valuePtr)
+{
+    DictEntry *ePtr;
+    TCL_HASH_TYPE hash;
+    int isNew = 0;
+
+    if (dict->persist != NULL) {
+	Tcl_Size pos;
+
+	hash = TclHashObjKey(NULL, keyPtr);
+	pos = HamtFind(dict->persist->hamt, keyPtr, hash);
+	if (pos == TCL_INDEX_NONE) {
+	    ePtr = PersistentAppend(dict, keyPtr, hash);
+	    isNew = 1;
+	} else {
+	    ePtr = OrderModify(dict->persist, pos);
+	}
     } else {
-	dict->entryChainTail = cPtr->prevPtr;
+	int hashValid;
+
+	ePtr = LookupDictEntry(dict, keyPtr, &hash, &hashValid);
+	if (ePtr == NULL) {
+	    if (!hashValid) {
+		hash = TclHashObjKey(NULL, keyPtr);
+	    }
+
+	    /*
+	     * Make room at the end of the entry array. If there are deleted
+	     * entries and squeezing them out leaves the table no more than
+	     * two-thirds full, reuse the current capacity; otherwise grow,
+	     * switching to the persistent representation once the dictionary
+	     * is large enough.
+	     */
+
+	    if (dict->used == dict->capacity) {
+		Tcl_Size needed = dict->numEntries + 1;
+
+		if (needed > dict->capacity / 3 * 2) {
+		    needed += needed / 2;
+		}
+		if (needed < 4) {
+		    needed = 4;
+		}
+		needed = DictCapacity(needed);
+		if (needed > DICT_PERSISTENT_MIN) {
+		    MakeDictPersistent(dict);
+		    return DictPutValue(dict, keyPtr, valuePtr);
+		}
+		ResizeDictTable(dict, needed);
+	    }
+
+	    ePtr = &dict->entries[dict->used];
+	    ePtr->key = keyPtr;
+	    Tcl_IncrRefCount(keyPtr);
+	    ePtr->value = NULL;
+	    ePtr->hash = hash;
+	    IndexInsert(dict, hash, dict->used);
+	    dict->used++;
+	    dict->numEntries++;
+	    isNew = 1;
+	}
+    }
+
+    Tcl_IncrRefCount(valuePtr);
+    if (ePtr->value != NULL) {
+	TclDecrRefCount(ePtr->value);
     }
-    if (cPtr->prevPtr) {
-	cPtr->prevPtr->nextPtr = cPtr->nextPtr;
+    ePtr->value = valuePtr;
+    return isNew;
+}
+
+static int
+DeleteDictEntry(
+    Dict *dict,
+    Tcl_Obj *keyPtr)
+{
+    DictEntry *ePtr;
+
+    if (dict->persist != NULL) {
+	PersistentDict *pPtr = dict->persist;
+	TCL_HASH_TYPE hash = TclHashObjKey(NULL, keyPtr);
+	Tcl_Size pos = HamtFind(pPtr->hamt, keyPtr, hash);
+
+	if (pos == TCL_INDEX_NONE) {
+	    return 0;
+	}
+	pPtr->hamt = HamtRemove(pPtr->hamt, 0, keyPtr, hash);
+	ePtr = OrderModify(pPtr, pos);
     } else {
-	dict->entryChainHead = cPtr->nextPtr;
+	TCL_HASH_TYPE hash;
+	int hashValid;
+
+	ePtr = LookupDictEntry(dict, keyPtr, &hash, &hashValid);
+	if (ePtr == NULL) {
+	    return 0;
+	}
     }
 
-    Tcl_DeleteHashEntry(&cPtr->entry);
+    TclDecrRefCount(ePtr->key);
+    TclDecrRefCount(ePtr->value);
+    ePtr->key = ePtr->value = NULL;
+    dict->numEntries--;
+
+    /*
+     * When the dictionary becomes empty its slots can all be reused at once.
+     * In the persistent representation, the space of other deleted entries
+     * is recovered by repacking when entries are added. Without an index, deleted entries at the end of the array can be
+     * trimmed straight away; with one, their index slots still refer to
+     * them, so they have to wait for the next compaction.
+     */
+
+    if (dict->persist != NULL) {
+	if (dict->numEntries == 0) {
+	    OrderRelease(dict->persist->order, dict->persist->orderShift);
+	    dict->persist->order = NULL;
+	    dict->persist->orderShift = 0;
+	    dict->used = 0;
+	}
+    } else if (dict->numEntries == 0) {
+	dict->used = 0;
+	if (dict->indexMask) {
+	    memset(dict->entries + dict->capacity, 0,
+		    (size_t) (dict->indexMask + 1) * dict->indexWidth);
+	}
+    } else if (dict->indexMask == 0) {
+	while (dict->entries[dict->used - 1].key == NULL) {
+	    dict->used--;
+	}
+    }
     return 1;
 }
-
+
 /*
  *----------------------------------------------------------------------
  *
@@ -361,27 +1513,44 @@ DupDictInternalRep(
     Tcl_Obj *copyPtr)
 {
     Dict *oldDict, *newDict = (Dict *)Tcl_Alloc(sizeof(Dict));
-    ChainEntry *cPtr;
+    DictEntry *ePtr;
+    Tcl_Size i;
 
     DictGetInternalRep(srcPtr, oldDict);
 
     /*
-     * Copy values across from the old hash table.
+     * A dictionary in persistent representation shares its tries with the
+     * copy. Otherwise, copy values across from the old table; the keys are
+     * already known to be distinct, so the entries (with their cached
+     * hashes) can be copied directly.
      */
 
-    InitChainTable(newDict);
-    for (cPtr=oldDict->entryChainHead ; cPtr!=NULL ; cPtr=cPtr->nextPtr) {
-	Tcl_Obj *key = (Tcl_Obj *)Tcl_GetHashKey(&oldDict->table, &cPtr->entry);
-	Tcl_Obj *valuePtr = (Tcl_Obj *)Tcl_GetHashValue(&cPtr->entry);
-	int n;
-	Tcl_HashEntry *hPtr = CreateChainEntry(newDict, key, &n);
-
-	/*
-	 * Fill in the contents.
-	 */
-
-	Tcl_SetHashValue(hPtr, valuePtr);
-	Tcl_IncrRefCount(valuePtr);
+    if (oldDict->persist != NULL) {
+	InitDictTable(newDict, 0);
+	newDict->persist = (PersistentDict *)Tcl_Alloc(sizeof(PersistentDict));
+	*newDict->persist = *oldDict->persist;
+	if (newDict->persist->hamt != NULL) {
+	    newDict->persist->hamt->refCount++;
+	}
+	if (newDict->persist->order != NULL) {
+	    newDict->persist->order->refCount++;
+	}
+	newDict->numEntries = oldDict->numEntries;
+	newDict->used = oldDict->used;
+    } else {
+	InitDictTable(newDict, oldDict->numEntries);
+	for (i=0 ; i<oldDict->used ; i++) {
+	    ePtr = &oldDict->entries[i];
+	    if (ePtr->key == NULL) {
+		continue;
+	    }
+	    Tcl_IncrRefCount(ePtr->key);
+	    Tcl_IncrRefCount(ePtr->value);
+	    newDict->entries[newDict->used] = *ePtr;
+	    IndexInsert(newDict, ePtr->hash, newDict->used);
+	    newDict->used++;
+	}
+	newDict->numEntries = newDict->used;
     }
 
     /*
@@ -454,7 +1623,7 @@ static void
 DeleteDict(
     Dict *dict)
 {
-    DeleteChainTable(dict);
+    DeleteDictTable(dict);
     Tcl_Free(dict);
 }
 
@@ -487,9 +1656,9 @@ UpdateStringOfDict(
 #define LOCAL_SIZE 64
     char localFlags[LOCAL_SIZE], *flagPtr = NULL;
     Dict *dict;
-    ChainEntry *cPtr;
+    DictEntry *ePtr;
     Tcl_Obj *keyPtr, *valuePtr;
-    Tcl_Size i, length;
+    Tcl_Size i, pos, length;
     TCL_HASH_TYPE bytesNeeded = 0;
     const char *elem;
     char *dst;
@@ -505,7 +1674,7 @@ UpdateStringOfDict(
 
     assert (dict != NULL);
 
-    numElems = dict->table.numEntries * 2;
+    numElems = dict->numEntries * 2;
 
     /* Handle empty list case first, simplifies what follows */
     if (numElems == 0) {
@@ -522,18 +1691,19 @@ UpdateStringOfDict(
     } else {
 	flagPtr = (char *)Tcl_Alloc(numElems);
     }
-    for (i=0,cPtr=dict->entryChainHead; i<numElems; i+=2,cPtr=cPtr->nextPtr) {
+    for (i=0,pos=0; i<numElems; i+=2,pos++) {
 	/*
-	 * Assume that cPtr is never NULL since we know the number of array
+	 * Assume that ePtr is never NULL since we know the number of array
 	 * elements already.
 	 */
 
+	ePtr = NextDictEntry(dict, &pos);
 	flagPtr[i] = ( i ? TCL_DONT_QUOTE_HASH : 0 );
-	keyPtr = (Tcl_Obj *)Tcl_GetHashKey(&dict->table, &cPtr->entry);
+	keyPtr = ePtr->key;
 	elem = Tcl_GetStringFromObj(keyPtr, &length);
 	bytesNeeded += TclScanElement(elem, length, flagPtr+i);
 	flagPtr[i+1] = TCL_DONT_QUOTE_HASH;
-	valuePtr = (Tcl_Obj *)Tcl_GetHashValue(&cPtr->entry);
+	valuePtr = ePtr->value;
 	elem = Tcl_GetStringFromObj(valuePtr, &length);
 	bytesNeeded += TclScanElement(elem, length, flagPtr+i+1);
     }
@@ -545,15 +1715,16 @@ UpdateStringOfDict(
 
     dst = Tcl_InitStringRep(dictPtr, NULL, bytesNeeded - 1);
     TclOOM(dst, bytesNeeded);
-    for (i=0,cPtr=dict->entryChainHead; i<numElems; i+=2,cPtr=cPtr->nextPtr) {
+    for (i=0,pos=0; i<numElems; i+=2,pos++) {
+	ePtr = NextDictEntry(dict, &pos);
 	flagPtr[i] |= ( i ? TCL_DONT_QUOTE_HASH : 0 );
-	keyPtr = (Tcl_Obj *)Tcl_GetHashKey(&dict->table, &cPtr->entry);
+	keyPtr = ePtr->key;
 	elem = Tcl_GetStringFromObj(keyPtr, &length);
 	dst += TclConvertElement(elem, length, dst, flagPtr[i]);
 	*dst++ = ' ';
 
 	flagPtr[i+1] |= TCL_DONT_QUOTE_HASH;
-	valuePtr = (Tcl_Obj *)Tcl_GetHashValue(&cPtr->entry);
+	valuePtr = ePtr->value;
 	elem = Tcl_GetStringFromObj(valuePtr, &length);
 	dst += TclConvertElement(elem, length, dst, flagPtr[i+1]);
 	*dst++ = ' ';
@@ -591,11 +1762,9 @@ SetDictFromAny(
     Tcl_Interp *interp,
     Tcl_Obj *objPtr)
 {
-    Tcl_HashEntry *hPtr;
-    int isNew;
     Dict *dict = (Dict *)Tcl_Alloc(sizeof(Dict));
 
-    InitChainTable(dict);
+    InitDictTable(dict, 0);
 
     /*
      * Since lists and dictionaries have very closely-related string
@@ -612,14 +1781,12 @@ SetDictFromAny(
 	if (objc & 1) {
 	    goto missingValue;
 	}
+	InitDictTable(dict, objc / 2);
 
 	for (i=0 ; i<objc ; i+=2) {
 
-	    /* Store key and value in the hash table we're building. */
-	    hPtr = CreateChainEntry(dict, objv[i], &isNew);
-	    if (!isNew) {
-		Tcl_Obj *discardedValue = (Tcl_Obj *)Tcl_GetHashValue(hPtr);
-
+	    /* Store key and value in the table we're building. */
+	    if (!DictPutValue(dict, objv[i], objv[i+1])) {
 		/*
 		 * Not really a well-formed dictionary as there are duplicate
 		 * keys, so better get the string rep here so that we can
@@ -627,11 +1794,7 @@ SetDictFromAny(
 		 */
 
 		(void) TclGetString(objPtr);
-
-		TclDecrRefCount(discardedValue);
 	    }
-	    Tcl_SetHashValue(hPtr, objv[i+1]);
-	    Tcl_IncrRefCount(objv[i+1]); /* Since hash now holds ref to it */
 	}
     } else {
 	Tcl_Size length;
@@ -689,16 +1852,10 @@ SetDictFromAny(
 			TclCopyAndCollapse(elemSize, elemStart, dst));
 	    }
 
-	    /* Store key and value in the hash table we're building. */
-	    hPtr = CreateChainEntry(dict, keyPtr, &isNew);
-	    if (!isNew) {
-		Tcl_Obj *discardedValue = (Tcl_Obj *)Tcl_GetHashValue(hPtr);
-
+	    /* Store key and value in the table we're building. */
+	    if (!DictPutValue(dict, keyPtr, valuePtr)) {
 		TclDecrRefCount(keyPtr);
-		TclDecrRefCount(discardedValue);
 	    }
-	    Tcl_SetHashValue(hPtr, valuePtr);
-	    Tcl_IncrRefCount(valuePtr); /* since hash now holds ref to it */
 	}
     }
 
@@ -721,7 +1878,7 @@ SetDictFromAny(
 	Tcl_SetErrorCode(interp, "TCL", "VALUE", "DICTIONARY", NULL);
     }
   errorInFindDictElement:
-    DeleteChainTable(dict);
+    DeleteDictTable(dict);
     Tcl_Free(dict);
     return TCL_ERROR;
 }
@@ -798,12 +1955,10 @@ TclTraceDictPath(
     }
 
     for (i=0 ; i<keyc ; i++) {
-	Tcl_HashEntry *hPtr = Tcl_FindHashEntry(&dict->table, keyv[i]);
-	Tcl_Obj *tmpObj;
-
-	if (hPtr == NULL) {
-	    int isNew;			/* Dummy */
+	Tcl_Obj *tmpObj = DictGetValue(dict, keyv[i],
+		flags & DICT_PATH_UPDATE);
 
+	if (tmpObj == NULL) {
 	    if (flags & DICT_PATH_EXISTS) {
 		return DICT_PATH_NON_EXISTENT;
 	    }
@@ -818,17 +1973,9 @@ TclTraceDictPath(
 		return NULL;
 	    }
 
-	    /*
-	     * The next line should always set isNew to 1.
-	     */
-
-	    hPtr = CreateChainEntry(dict, keyv[i], &isNew);
 	    tmpObj = Tcl_NewDictObj();
-	    Tcl_IncrRefCount(tmpObj);
-	    Tcl_SetHashValue(hPtr, tmpObj);
+	    DictPutValue(dict, keyv[i], tmpObj);
 	} else {
-	    tmpObj = (Tcl_Obj *)Tcl_GetHashValue(hPtr);
-
 	    DictGetInternalRep(tmpObj, newDict);
 
 	    if (newDict == NULL) {
@@ -841,10 +1988,8 @@ TclTraceDictPath(
 	DictGetInternalRep(tmpObj, newDict);
 	if (flags & DICT_PATH_UPDATE) {
 	    if (Tcl_IsShared(tmpObj)) {
-		TclDecrRefCount(tmpObj);
 		tmpObj = Tcl_DuplicateObj(tmpObj);
-		Tcl_IncrRefCount(tmpObj);
-		Tcl_SetHashValue(hPtr, tmpObj);
+		DictPutValue(dict, keyv[i], tmpObj);
 		dict->epoch++;
 		DictGetInternalRep(tmpObj, newDict);
 	    }
@@ -929,8 +2074,6 @@ Tcl_DictObjPut(
     Tcl_Obj *valuePtr)
 {
     Dict *dict;
-    Tcl_HashEntry *hPtr;
-    int isNew;
 
     if (Tcl_IsShared(dictPtr)) {
 	Tcl_Panic("%s called with shared object", "Tcl_DictObjPut");
@@ -942,17 +2085,10 @@ Tcl_DictObjPut(
     }
 
     TclInvalidateStringRep(dictPtr);
-    hPtr = CreateChainEntry(dict, keyPtr, &isNew);
+    DictPutValue(dict, keyPtr, valuePtr);
     dict->refCount++;
     TclFreeInternalRep(dictPtr)
     DictSetInternalRep(dictPtr, dict);
-    Tcl_IncrRefCount(valuePtr);
-    if (!isNew) {
-	Tcl_Obj *oldValuePtr = (Tcl_Obj *)Tcl_GetHashValue(hPtr);
-
-	TclDecrRefCount(oldValuePtr);
-    }
-    Tcl_SetHashValue(hPtr, valuePtr);
     dict->epoch++;
     return TCL_OK;
 }
@@ -985,7 +2121,6 @@ Tcl_DictObjGet(
     Tcl_Obj **valuePtrPtr)
 {
     Dict *dict;
-    Tcl_HashEntry *hPtr;
 
     dict = GetDictFromObj(interp, dictPtr);
     if (dict == NULL) {
@@ -993,12 +2128,12 @@ Tcl_DictObjGet(
 	return TCL_ERROR;
     }
 
-    hPtr = Tcl_FindHashEntry(&dict->table, keyPtr);
-    if (hPtr == NULL) {
-	*valuePtrPtr = NULL;
-    } else {
-	*valuePtrPtr = (Tcl_Obj *)Tcl_GetHashValue(hPtr);
-    }
+    /*
+     * Callers may modify an unshared value of an unshared dictionary in
+     * place, so make sure that the value really is unshared.
+     */
+
+    *valuePtrPtr = DictGetValue(dict, keyPtr, !Tcl_IsShared(dictPtr));
     return TCL_OK;
 }
 
@@ -1038,7 +2173,7 @@ Tcl_DictObjRemove(
 	return TCL_ERROR;
     }
 
-    if (DeleteChainEntry(dict, keyPtr)) {
+    if (DeleteDictEntry(dict, keyPtr)) {
 	TclInvalidateStringRep(dictPtr);
 	dict->epoch++;
     }
@@ -1062,7 +2197,7 @@ TclDictGetSize(Tcl_Obj *dictPtr)
 {
     Dict *dict;
     DictGetInternalRep(dictPtr, dict);
-    return dict->table.numEntries;
+    return dict->numEntries;
 }
 
 /*
@@ -1097,7 +2232,7 @@ Tcl_DictObjSize(
 	return TCL_ERROR;
     }
 
-    *sizePtr = dict->table.numEntries;
+    *sizePtr = dict->numEntries;
     return TCL_OK;
 }
 
@@ -1141,28 +2276,34 @@ Tcl_DictObjFirst(
 				 * otherwise. */
 {
     Dict *dict;
-    ChainEntry *cPtr;
+    DictEntry *ePtr;
+    Tcl_Size pos = 0;
 
     dict = GetDictFromObj(interp, dictPtr);
     if (dict == NULL) {
 	return TCL_ERROR;
     }
 
-    cPtr = dict->entryChainHead;
-    if (cPtr == NULL) {
+    if (dict->numEntries == 0) {
 	searchPtr->epoch = 0;
 	*donePtr = 1;
     } else {
+	/*
+	 * The search context records the position of the next entry to look
+	 * at; deleted entries are skipped as they are reached.
+	 */
+
+	ePtr = NextDictEntry(dict, &pos);
 	*donePtr = 0;
 	searchPtr->dictionaryPtr = (Tcl_Dict) dict;
 	searchPtr->epoch = dict->epoch;
-	searchPtr->next = cPtr->nextPtr;
+	searchPtr->next = INT2PTR(pos + 1);
 	dict->refCount++;
 	if (keyPtrPtr != NULL) {
-	    *keyPtrPtr = (Tcl_Obj *)Tcl_GetHashKey(&dict->table, &cPtr->entry);
+	    *keyPtrPtr = ePtr->key;
 	}
 	if (valuePtrPtr != NULL) {
-	    *valuePtrPtr = (Tcl_Obj *)Tcl_GetHashValue(&cPtr->entry);
+	    *valuePtrPtr = ePtr->value;
 	}
     }
     return TCL_OK;
@@ -1205,7 +2346,9 @@ Tcl_DictObjNext(
 				 * values in the dictionary, or a 0
 				 * otherwise. */
 {
-    ChainEntry *cPtr;
+    Dict *dict;
+    DictEntry *ePtr;
+    Tcl_Size pos;
 
     /*
      * If the search is done; we do no work.
@@ -1221,25 +2364,26 @@ Tcl_DictObjNext(
      * removed. This *shouldn't* happen, but...
      */
 
-    if (((Dict *)searchPtr->dictionaryPtr)->epoch != searchPtr->epoch) {
+    dict = (Dict *)searchPtr->dictionaryPtr;
+    if (dict->epoch != searchPtr->epoch) {
 	Tcl_Panic("concurrent dictionary modification and search");
     }
 
-    cPtr = (ChainEntry *)searchPtr->next;
-    if (cPtr == NULL) {
+    pos = PTR2INT(searchPtr->next);
+    ePtr = NextDictEntry(dict, &pos);
+    if (ePtr == NULL) {
 	Tcl_DictObjDone(searchPtr);
 	*donePtr = 1;
 	return;
     }
 
-    searchPtr->next = cPtr->nextPtr;
+    searchPtr->next = INT2PTR(pos + 1);
     *donePtr = 0;
     if (keyPtrPtr != NULL) {
-	*keyPtrPtr = (Tcl_Obj *)Tcl_GetHashKey(
-		&((Dict *)searchPtr->dictionaryPtr)->table, &cPtr->entry);
+	*keyPtrPtr = ePtr->key;
     }
     if (valuePtrPtr != NULL) {
-	*valuePtrPtr = (Tcl_Obj *)Tcl_GetHashValue(&cPtr->entry);
+	*valuePtrPtr = ePtr->value;
     }
 }
 
@@ -1306,8 +2450,6 @@ Tcl_DictObjPutKeyList(
     Tcl_Obj *valuePtr)
 {
     Dict *dict;
-    Tcl_HashEntry *hPtr;
-    int isNew;
 
     if (Tcl_IsShared(dictPtr)) {
 	Tcl_Panic("%s called with shared object", "Tcl_DictObjPutKeyList");
@@ -1323,14 +2465,7 @@ Tcl_DictObjPutKeyList(
 
     DictGetInternalRep(dictPtr, dict);
     assert(dict != NULL);
-    hPtr = CreateChainEntry(dict, keyv[keyc-1], &isNew);
-    Tcl_IncrRefCount(valuePtr);
-    if (!isNew) {
-	Tcl_Obj *oldValuePtr = (Tcl_Obj *)Tcl_GetHashValue(hPtr);
-
-	TclDecrRefCount(oldValuePtr);
-    }
-    Tcl_SetHashValue(hPtr, valuePtr);
+    DictPutValue(dict, keyv[keyc-1], valuePtr);
     InvalidateDictChain(dictPtr);
 
     return TCL_OK;
@@ -1381,7 +2516,7 @@ Tcl_DictObjRemoveKeyList(
 
     DictGetInternalRep(dictPtr, dict);
     assert(dict != NULL);
-    DeleteChainEntry(dict, keyv[keyc-1]);
+    DeleteDictEntry(dict, keyv[keyc-1]);
     InvalidateDictChain(dictPtr);
     return TCL_OK;
 }
@@ -1422,7 +2557,7 @@ Tcl_NewDictObj(void)
     TclNewObj(dictPtr);
     TclInvalidateStringRep(dictPtr);
     dict = (Dict *)Tcl_Alloc(sizeof(Dict));
-    InitChainTable(dict);
+    InitDictTable(dict, 0);
     dict->epoch = 1;
     dict->chain = NULL;
     dict->refCount = 1;
@@ -1470,7 +2605,7 @@ Tcl_DbNewDictObj(
     TclDbNewObj(dictPtr, file, line);
     TclInvalidateStringRep(dictPtr);
     dict = (Dict *)Tcl_Alloc(sizeof(Dict));
-    InitChainTable(dict);
+    InitDictTable(dict, 0);
     dict->epoch = 1;
     dict->chain = NULL;
     dict->refCount = 1;
@@ -2126,7 +3261,9 @@ DictInfoCmd(
     Tcl_Obj *const *objv)
 {
     Dict *dict;
-    char *statsStr;
+    Tcl_Obj *statsObj;
+    Tcl_Size i, slot, probes = 0;
+    TCL_HASH_TYPE perturb;
 
     if (objc != 2) {
 	Tcl_WrongNumArgs(interp, 1, objv, "dictionary");
@@ -2138,9 +3275,52 @@ DictInfoCmd(
 	return TCL_ERROR;
     }
 
-    statsStr = Tcl_HashStats(&dict->table);
-    Tcl_SetObjResult(interp, Tcl_NewStringObj(statsStr, -1));
-    Tcl_Free(statsStr);
+    if (dict->persist != NULL) {
+	Tcl_Size numNodes = 0;
+	int depth = 0;
+
+	if (dict->persist->hamt != NULL) {
+	    HamtStats(dict->persist->hamt, 1, &numNodes, &depth);
+	}
+	statsObj = Tcl_ObjPrintf(
+		"%" TCL_SIZE_MODIFIER "d entries in table, %" TCL_SIZE_MODIFIER
+		"d positions used\n"
+		"persistent: %" TCL_SIZE_MODIFIER "d key trie nodes, "
+		"maximum depth %d\n",
+		dict->numEntries, dict->used, numNodes, depth);
+	Tcl_SetObjResult(interp, statsObj);
+	return TCL_OK;
+    }
+
+    statsObj = Tcl_ObjPrintf(
+	    "%" TCL_SIZE_MODIFIER "d entries in table, %" TCL_SIZE_MODIFIER
+	    "d slots used of %" TCL_SIZE_MODIFIER "d\n",
+	    dict->numEntries, dict->used, dict->capacity);
+    if (dict->indexMask == 0) {
+	Tcl_AppendToObj(statsObj, "no index (linear search)\n", -1);
+    } else {
+	/*
+	 * Count how many index slots have to be examined to find each entry.
+	 */
+
+	for (i=0 ; i<dict->used ; i++) {
+	    if (dict->entries[i].key == NULL) {
+		continue;
+	    }
+	    IndexProbeStart(dict, dict->entries[i].hash, slot, perturb);
+	    probes++;
+	    while (IndexGet(dict, slot) != i + 1) {
+		IndexProbeNext(dict, slot, perturb);
+		probes++;
+	    }
+	}
+	Tcl_AppendPrintfToObj(statsObj,
+		"%" TCL_SIZE_MODIFIER "d index slots of %d bits\n"
+		"average search distance for entry: %.1f\n",
+		dict->indexMask + 1, dict->indexWidth * 8,
+		dict->numEntries ? (double) probes / dict->numEntries : 0.0);
+    }
+    Tcl_SetObjResult(interp, statsObj);
     return TCL_OK;
 }
 
@@ -941,7 +941,7 @@ DisassembleByteCodeAsDicts(
 {
     ByteCode *codePtr;
     Tcl_Obj *description, *literals, *variables, *instructions, *inst;
-    Tcl_Obj *aux, *exn, *commands, *file;
+    Tcl_Obj *aux, *exn, *commands, *invokes, *file;
     unsigned char *pc, *opnd, *codeOffPtr, *codeLenPtr, *srcOffPtr, *srcLenPtr;
     int codeOffset, codeLength, sourceOffset, sourceLength;
     int i, val, line;
@@ -1211,6 +1211,42 @@ DisassembleByteCodeAsDicts(
 
 #undef Decode
 
+    /*
+     * Get the inline cache of command invocations, if the code has been run:
+     * the command name each invocation instruction last resolved and how
+     * often the cached resolution was used (hits) or not (misses).
+     */
+
+    TclNewObj(invokes);
+    if (codePtr->invokeCachePtr) {
+	InvokeCache *icPtr = codePtr->invokeCachePtr;
+
+	for (pc=codePtr->codeStart; pc<codePtr->codeStart+codePtr->numCodeBytes;
+		pc+=tclInstructionTable[*pc].numBytes){
+	    InvokeCacheEntry *entryPtr;
+	    Tcl_Obj *invoke;
+	    Tcl_Size offset = pc - codePtr->codeStart, slot;
+
+	    if (*pc != INST_INVOKE_STK1 && *pc != INST_INVOKE_STK4) {
+		continue;
+	    }
+	    for (slot = offset & icPtr->mask ;
+		    icPtr->entries[slot].pcOffset != offset ;
+		    slot = (slot + 1) & icPtr->mask) {
+		/* Empty loop body. */
+	    }
+	    entryPtr = &icPtr->entries[slot];
+	    TclNewObj(invoke);
+	    Tcl_DictObjPut(NULL, invoke, Tcl_NewStringObj("command", -1),
+		    entryPtr->namePtr ? entryPtr->namePtr : Tcl_NewObj());
+	    Tcl_DictObjPut(NULL, invoke, Tcl_NewStringObj("hits", -1),
+		    Tcl_NewWideIntObj((Tcl_WideInt) entryPtr->hits));
+	    Tcl_DictObjPut(NULL, invoke, Tcl_NewStringObj("misses", -1),
+		    Tcl_NewWideIntObj((Tcl_WideInt) entryPtr->misses));
+	    Tcl_DictObjPut(NULL, invokes, Tcl_NewWideIntObj(offset), invoke);
+	}
+    }
+
     /*
      * Get the source file and line number information from the CmdFrame
      * system if it is available.
@@ -1241,6 +1277,8 @@ DisassembleByteCodeAsDicts(
 	    Tcl_NewWideIntObj(codePtr->maxStackDepth));
     Tcl_DictObjPut(NULL, description, Tcl_NewStringObj("exceptdepth", -1),
 	    Tcl_NewWideIntObj(codePtr->maxExceptDepth));
+    Tcl_DictObjPut(NULL, description, Tcl_NewStringObj("invokecache", -1),
+	    invokes);
     if (line >= 0) {
 	Tcl_DictObjPut(NULL, description,
 		Tcl_NewStringObj("initiallinenumber", -1),
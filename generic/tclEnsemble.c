@@ -3167,6 +3167,9 @@ TclCompileEnsemble(
     oldCmdPtr = cmdPtr;
     Tcl_IncrRefCount(targetCmdObj);
     newCmdPtr = (Command *) Tcl_GetCommandFromObj(interp, targetCmdObj);
+    if (envPtr->cmdDepsPtr != NULL) {
+	Tcl_ListObjAppendElement(NULL, envPtr->cmdDepsPtr, targetCmdObj);
+    }
     TclDecrRefCount(targetCmdObj);
     if (newCmdPtr == NULL || Tcl_IsSafe(interp)
 	    || newCmdPtr->nsPtr->flags & NS_SUPPRESS_COMPILATION
@@ -1112,6 +1112,9 @@ static const struct {
 #ifdef STATIC_BUILD
 	    ".static"
 #endif
+#ifdef TCL_THREADED_DISPATCH
+	    ".threaded-dispatch"
+#endif
 #if TCL_UTF_MAX < 4
 	    ".utf-16"
 #endif
@@ -1247,6 +1250,7 @@ Tcl_Finalize(void)
 
     TclFinalizeEvaluation();
     TclFinalizeExecution();
+    TclFinalizeByteCodeCache();
     TclFinalizeEnvironment();
 
     /*
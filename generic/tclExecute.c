@@ -20,6 +20,8 @@
 #include "tclOOInt.h"
 #include "tclTomMath.h"
 #include "tclArithSeries.h"
+#include "tclPackedList.h"
+#include "tclListView.h"
 #include <math.h>
 #include <assert.h>
 
@@ -44,6 +46,26 @@
 #   define ASYNC_CHECK_COUNT	64
 #endif /* !ASYNC_CHECK_COUNT */
 
+/*
+ * Selects how TEBCresume gets from one instruction to the next. By default
+ * every instruction ends by jumping back to a shared tail that selects the
+ * next handler with one big switch, so all dispatches go through a single
+ * indirect branch. When built with TCL_THREADED_DISPATCH on a compiler that
+ * supports labels-as-values, the tail's fast path is instead replicated at
+ * the end of each instruction and jumps through a table of handler
+ * addresses (threaded code), giving every handler its own indirect branch
+ * to predict. The debugging and statistics builds, which need a hook on
+ * every instruction, always use the switch. While the execution statistics
+ * of [tcl::unsupported::execstats] are collected, the threaded code jumps
+ * through a second table that sends every opcode to a handler counting it
+ * first, so counting costs nothing when it is off.
+ */
+
+#if defined(TCL_THREADED_DISPATCH) && defined(__GNUC__) \
+	&& !defined(TCL_COMPILE_DEBUG) && !defined(TCL_COMPILE_STATS)
+#   define TEBC_THREADED_DISPATCH
+#endif
+
 /*
  * Boolean flag indicating whether the Tcl bytecode interpreter has been
  * initialized.
@@ -203,6 +225,66 @@ VarHashCreateVar(
 #define CHECK_STACK()
 #endif
 
+/*
+ * Continue with the instruction at pc once the stack has been cleaned up.
+ * With threaded dispatch the periodic async check is only entered (through
+ * cleanup0) when its counter runs out; otherwise we jump straight to the
+ * next handler. TEBC_CASE labels each handler of the switch so that the
+ * dispatch table can refer to it.
+ */
+
+#ifdef TEBC_THREADED_DISPATCH
+#define DISPATCH_NEXT()						\
+    do {							\
+	if (interruptCounter > 1) {				\
+	    interruptCounter--;					\
+	    inst = *pc;						\
+	    TCL_DTRACE_INST_NEXT();				\
+	    goto *dispatchPtr[inst];				\
+	}							\
+	goto cleanup0;						\
+    } while (0)
+#define DISPATCH_PEEPHOLE()					\
+    do {							\
+	TCL_DTRACE_INST_NEXT();					\
+	goto *dispatchPtr[inst];				\
+    } while (0)
+#define TEBC_CASE(op)	case op: lbl_##op
+#else
+#define DISPATCH_NEXT()		goto cleanup0
+#define DISPATCH_PEEPHOLE()	goto peepholeStart
+#define TEBC_CASE(op)	case op
+#endif
+
+/*
+ * Rewrite the current instruction in place, for the type feedback of the
+ * arithmetic and comparison instructions (see INST_ADD_INT and friends).
+ */
+
+#define REWRITE_INST(opcode) \
+    (*(unsigned char *) pc = (unsigned char) (opcode))
+
+/*
+ * A specialized instruction whose guard fails turns back into the generic one
+ * for good: the site is marked so that operands of alternating types do not
+ * rewrite it back and forth on every execution. Code shared with other
+ * interpreters (see ByteCodeBody) is never rewritten: all its sites count as
+ * generic.
+ */
+
+#define DEOPT_INST(opcode) \
+    do {								\
+	if (codePtr->bodyPtr == NULL) {					\
+	    REWRITE_INST(opcode);					\
+	    MarkGenericSite(codePtr, pc);				\
+	}								\
+    } while (0)
+#define IS_GENERIC_SITE() \
+    (codePtr->bodyPtr != NULL						\
+	    || (codePtr->genericSites != NULL				\
+	    && (codePtr->genericSites[(pc - codePtr->codeStart) >> 3]	\
+		    & (1 << ((pc - codePtr->codeStart) & 7)))))
+
 #define NEXT_INST_F(pcAdjustment, nCleanup, resultHandling)	\
     do {							\
 	TCL_CT_ASSERT((nCleanup >= 0) && (nCleanup <= 2));	\
@@ -216,7 +298,7 @@ VarHashCreateVar(
 		}						\
 	    }							\
 	    pc += (pcAdjustment);				\
-	    goto cleanup0;					\
+	    DISPATCH_NEXT();					\
 	} else if (resultHandling != 0) {			\
 	    if ((resultHandling) > 0) {				\
 		Tcl_IncrRefCount(objResultPtr);			\
@@ -631,8 +713,14 @@ static Tcl_Obj *	ExecuteExtendedBinaryMathOp(Tcl_Interp *interp,
 static Tcl_Obj *	ExecuteExtendedUnaryMathOp(int opcode,
 			    Tcl_Obj *valuePtr);
 static void		FreeExprCodeInternalRep(Tcl_Obj *objPtr);
+static void		MarkGenericSite(ByteCode *codePtr,
+			    const unsigned char *pc);
+static Command *	GetCachedCommand(Interp *iPtr, ByteCode *codePtr,
+			    const unsigned char *pc, Tcl_Obj *namePtr);
 static ExceptionRange *	GetExceptRangeForPc(const unsigned char *pc,
 			    int searchMode, ByteCode *codePtr);
+static const unsigned char *GetLastInstruction(const unsigned char *pc,
+			    ByteCode *codePtr);
 static const char *	GetSrcInfoForPc(const unsigned char *pc,
 			    ByteCode *codePtr, Tcl_Size *lengthPtr,
 			    const unsigned char **pcBeg, int *cmdIdxPtr);
@@ -1823,6 +1911,122 @@ TclIncrObj(
     return TCL_OK;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * MarkGenericSite --
+ *
+ *	Records that the type-specialized instruction at pc turned back into
+ *	the generic one, so that it is not specialized again.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	May allocate the ByteCode's bit map of generic sites.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+MarkGenericSite(
+    ByteCode *codePtr,
+    const unsigned char *pc)
+{
+    size_t offset = pc - codePtr->codeStart;
+
+    if (codePtr->genericSites == NULL) {
+	size_t size = (codePtr->numCodeBytes + 7) / 8;
+
+	codePtr->genericSites = (unsigned char *)Tcl_Alloc(size);
+	memset(codePtr->genericSites, 0, size);
+    }
+    codePtr->genericSites[offset >> 3] |= 1 << (offset & 7);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetCachedCommand --
+ *
+ *	Procedure that implements the inline cache of command invocations: it
+ *	returns the command that the name invoked by the instruction at pc
+ *	resolves to, from the cache entry of that instruction when that is
+ *	still valid, and otherwise by looking it up (and filling the entry).
+ *	Validity is judged as for the cmdName type: the command's epoch, that
+ *	it is neither deleted nor from another interpreter, and the id and
+ *	command reference epoch of the namespace the name is resolved in. The
+ *	name value itself must be the same object.
+ *
+ * Results:
+ *	The Command, or NULL when it cannot be used directly: when there is
+ *	no such command or it has execution traces. Then the caller resolves
+ *	the name the normal way.
+ *
+ * Side effects:
+ *	May create the ByteCode's cache, and updates its hit/miss counters.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Command *
+GetCachedCommand(
+    Interp *iPtr,
+    ByteCode *codePtr,
+    const unsigned char *pc,
+    Tcl_Obj *namePtr)
+{
+    InvokeCache *cachePtr = codePtr->invokeCachePtr;
+    InvokeCacheEntry *entryPtr;
+    Namespace *nsPtr = iPtr->varFramePtr->nsPtr;
+    Command *cmdPtr;
+    Tcl_Size offset = pc - codePtr->codeStart, i;
+
+    if (cachePtr == NULL) {
+	cachePtr = codePtr->invokeCachePtr = TclCreateInvokeCache(codePtr);
+    }
+    for (i = offset & cachePtr->mask ; ; i = (i + 1) & cachePtr->mask) {
+	entryPtr = &cachePtr->entries[i];
+	if (entryPtr->pcOffset == offset) {
+	    break;
+	} else if (entryPtr->pcOffset == TCL_INDEX_NONE) {
+	    return NULL;
+	}
+    }
+
+    cmdPtr = entryPtr->cmdPtr;
+    if ((entryPtr->namePtr == namePtr)
+	    && (cmdPtr->cmdEpoch == entryPtr->cmdEpoch)
+	    && !(cmdPtr->flags & CMD_DEAD)
+	    && (cmdPtr->nsPtr->interp == (Tcl_Interp *) iPtr)
+	    && (nsPtr == entryPtr->refNsPtr)
+	    && (nsPtr->nsId == entryPtr->refNsId)
+	    && (nsPtr->cmdRefEpoch == entryPtr->refNsCmdEpoch)
+	    && !(cmdPtr->nsPtr->flags & NS_DYING)) {
+	entryPtr->hits++;
+	return (cmdPtr->flags & CMD_HAS_EXEC_TRACES) ? NULL : cmdPtr;
+    }
+
+    entryPtr->misses++;
+    cmdPtr = (Command *) Tcl_GetCommandFromObj((Tcl_Interp *) iPtr, namePtr);
+    if (cmdPtr == NULL) {
+	return NULL;
+    }
+    cmdPtr->refCount++;
+    Tcl_IncrRefCount(namePtr);
+    if (entryPtr->namePtr) {
+	Tcl_DecrRefCount(entryPtr->namePtr);
+	TclCleanupCommandMacro(entryPtr->cmdPtr);
+    }
+    entryPtr->namePtr = namePtr;
+    entryPtr->cmdPtr = cmdPtr;
+    entryPtr->refNsPtr = nsPtr;
+    entryPtr->refNsId = nsPtr->nsId;
+    entryPtr->refNsCmdEpoch = nsPtr->cmdRefEpoch;
+    entryPtr->cmdEpoch = cmdPtr->cmdEpoch;
+    return (cmdPtr->flags & CMD_HAS_EXEC_TRACES) ? NULL : cmdPtr;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2051,10 +2255,247 @@ TEBCresume(
     Tcl_Size length, objc = 0;
     int opnd, pcAdjustment;
     Var *varPtr, *arrayPtr;
+    Command *cmdPtr;
 #ifdef TCL_COMPILE_DEBUG
     char cmdNameBuf[21];
 #endif
 
+#ifdef TEBC_THREADED_DISPATCH
+    /*
+     * Handler address for each opcode; see TEBC_CASE. Opcodes this version
+     * of the engine doesn't know about go to the panic in the switch's
+     * default branch.
+     */
+
+    static const void *const dispatchTable[256] = {
+	[INST_DONE] = &&lbl_INST_DONE,
+	[INST_PUSH1] = &&instPush1,
+	[INST_PUSH4] = &&lbl_INST_PUSH4,
+	[INST_POP] = &&lbl_INST_POP,
+	[INST_DUP] = &&lbl_INST_DUP,
+	[INST_STR_CONCAT1] = &&lbl_INST_STR_CONCAT1,
+	[INST_INVOKE_STK1] = &&lbl_INST_INVOKE_STK1,
+	[INST_INVOKE_STK4] = &&lbl_INST_INVOKE_STK4,
+	[INST_EVAL_STK] = &&lbl_INST_EVAL_STK,
+	[INST_EXPR_STK] = &&lbl_INST_EXPR_STK,
+	[INST_LOAD_SCALAR1] = &&instLoadScalar1,
+	[INST_LOAD_SCALAR4] = &&lbl_INST_LOAD_SCALAR4,
+	[INST_LOAD_SCALAR_STK] = &&lbl_INST_LOAD_SCALAR_STK,
+	[INST_LOAD_ARRAY1] = &&lbl_INST_LOAD_ARRAY1,
+	[INST_LOAD_ARRAY4] = &&lbl_INST_LOAD_ARRAY4,
+	[INST_LOAD_ARRAY_STK] = &&lbl_INST_LOAD_ARRAY_STK,
+	[INST_LOAD_STK] = &&lbl_INST_LOAD_STK,
+	[INST_STORE_SCALAR1] = &&lbl_INST_STORE_SCALAR1,
+	[INST_STORE_SCALAR4] = &&lbl_INST_STORE_SCALAR4,
+	[INST_STORE_SCALAR_STK] = &&lbl_INST_STORE_SCALAR_STK,
+	[INST_STORE_ARRAY1] = &&lbl_INST_STORE_ARRAY1,
+	[INST_STORE_ARRAY4] = &&lbl_INST_STORE_ARRAY4,
+	[INST_STORE_ARRAY_STK] = &&lbl_INST_STORE_ARRAY_STK,
+	[INST_STORE_STK] = &&lbl_INST_STORE_STK,
+	[INST_INCR_SCALAR1] = &&lbl_INST_INCR_SCALAR1,
+	[INST_INCR_SCALAR_STK] = &&lbl_INST_INCR_SCALAR_STK,
+	[INST_INCR_ARRAY1] = &&lbl_INST_INCR_ARRAY1,
+	[INST_INCR_ARRAY_STK] = &&lbl_INST_INCR_ARRAY_STK,
+	[INST_INCR_STK] = &&lbl_INST_INCR_STK,
+	[INST_INCR_SCALAR1_IMM] = &&lbl_INST_INCR_SCALAR1_IMM,
+	[INST_INCR_SCALAR_STK_IMM] = &&lbl_INST_INCR_SCALAR_STK_IMM,
+	[INST_INCR_ARRAY1_IMM] = &&lbl_INST_INCR_ARRAY1_IMM,
+	[INST_INCR_ARRAY_STK_IMM] = &&lbl_INST_INCR_ARRAY_STK_IMM,
+	[INST_INCR_STK_IMM] = &&lbl_INST_INCR_STK_IMM,
+	[INST_JUMP1] = &&lbl_INST_JUMP1,
+	[INST_JUMP4] = &&lbl_INST_JUMP4,
+	[INST_JUMP_TRUE1] = &&lbl_INST_JUMP_TRUE1,
+	[INST_JUMP_TRUE4] = &&lbl_INST_JUMP_TRUE4,
+	[INST_JUMP_FALSE1] = &&lbl_INST_JUMP_FALSE1,
+	[INST_JUMP_FALSE4] = &&lbl_INST_JUMP_FALSE4,
+	[INST_BITOR] = &&lbl_INST_BITOR,
+	[INST_BITXOR] = &&lbl_INST_BITXOR,
+	[INST_BITAND] = &&lbl_INST_BITAND,
+	[INST_EQ] = &&lbl_INST_EQ,
+	[INST_NEQ] = &&lbl_INST_NEQ,
+	[INST_LT] = &&lbl_INST_LT,
+	[INST_GT] = &&lbl_INST_GT,
+	[INST_LE] = &&lbl_INST_LE,
+	[INST_GE] = &&lbl_INST_GE,
+	[INST_LSHIFT] = &&lbl_INST_LSHIFT,
+	[INST_RSHIFT] = &&lbl_INST_RSHIFT,
+	[INST_ADD] = &&lbl_INST_ADD,
+	[INST_SUB] = &&lbl_INST_SUB,
+	[INST_MULT] = &&lbl_INST_MULT,
+	[INST_DIV] = &&lbl_INST_DIV,
+	[INST_MOD] = &&lbl_INST_MOD,
+	[INST_UPLUS] = &&lbl_INST_UPLUS,
+	[INST_UMINUS] = &&lbl_INST_UMINUS,
+	[INST_BITNOT] = &&lbl_INST_BITNOT,
+	[INST_LNOT] = &&lbl_INST_LNOT,
+	[INST_TRY_CVT_TO_NUMERIC] = &&lbl_INST_TRY_CVT_TO_NUMERIC,
+	[INST_BREAK] = &&lbl_INST_BREAK,
+	[INST_CONTINUE] = &&lbl_INST_CONTINUE,
+	[INST_BEGIN_CATCH4] = &&lbl_INST_BEGIN_CATCH4,
+	[INST_END_CATCH] = &&lbl_INST_END_CATCH,
+	[INST_PUSH_RESULT] = &&lbl_INST_PUSH_RESULT,
+	[INST_PUSH_RETURN_CODE] = &&lbl_INST_PUSH_RETURN_CODE,
+	[INST_STR_EQ] = &&lbl_INST_STR_EQ,
+	[INST_STR_NEQ] = &&lbl_INST_STR_NEQ,
+	[INST_STR_CMP] = &&lbl_INST_STR_CMP,
+	[INST_STR_LEN] = &&lbl_INST_STR_LEN,
+	[INST_STR_INDEX] = &&lbl_INST_STR_INDEX,
+	[INST_STR_MATCH] = &&lbl_INST_STR_MATCH,
+	[INST_LIST] = &&lbl_INST_LIST,
+	[INST_LIST_INDEX] = &&lbl_INST_LIST_INDEX,
+	[INST_LIST_LENGTH] = &&lbl_INST_LIST_LENGTH,
+	[INST_APPEND_SCALAR1] = &&lbl_INST_APPEND_SCALAR1,
+	[INST_APPEND_SCALAR4] = &&lbl_INST_APPEND_SCALAR4,
+	[INST_APPEND_ARRAY1] = &&lbl_INST_APPEND_ARRAY1,
+	[INST_APPEND_ARRAY4] = &&lbl_INST_APPEND_ARRAY4,
+	[INST_APPEND_ARRAY_STK] = &&lbl_INST_APPEND_ARRAY_STK,
+	[INST_APPEND_STK] = &&lbl_INST_APPEND_STK,
+	[INST_LAPPEND_SCALAR1] = &&lbl_INST_LAPPEND_SCALAR1,
+	[INST_LAPPEND_SCALAR4] = &&lbl_INST_LAPPEND_SCALAR4,
+	[INST_LAPPEND_ARRAY1] = &&lbl_INST_LAPPEND_ARRAY1,
+	[INST_LAPPEND_ARRAY4] = &&lbl_INST_LAPPEND_ARRAY4,
+	[INST_LAPPEND_ARRAY_STK] = &&lbl_INST_LAPPEND_ARRAY_STK,
+	[INST_LAPPEND_STK] = &&lbl_INST_LAPPEND_STK,
+	[INST_LIST_INDEX_MULTI] = &&lbl_INST_LIST_INDEX_MULTI,
+	[INST_OVER] = &&lbl_INST_OVER,
+	[INST_LSET_LIST] = &&lbl_INST_LSET_LIST,
+	[INST_LSET_FLAT] = &&lbl_INST_LSET_FLAT,
+	[INST_RETURN_IMM] = &&lbl_INST_RETURN_IMM,
+	[INST_EXPON] = &&lbl_INST_EXPON,
+	[INST_EXPAND_START] = &&lbl_INST_EXPAND_START,
+	[INST_EXPAND_STKTOP] = &&lbl_INST_EXPAND_STKTOP,
+	[INST_INVOKE_EXPANDED] = &&lbl_INST_INVOKE_EXPANDED,
+	[INST_LIST_INDEX_IMM] = &&lbl_INST_LIST_INDEX_IMM,
+	[INST_LIST_RANGE_IMM] = &&lbl_INST_LIST_RANGE_IMM,
+	[INST_START_CMD] = &&instStartCmd,
+	[INST_LIST_IN] = &&lbl_INST_LIST_IN,
+	[INST_LIST_NOT_IN] = &&lbl_INST_LIST_NOT_IN,
+	[INST_PUSH_RETURN_OPTIONS] = &&lbl_INST_PUSH_RETURN_OPTIONS,
+	[INST_RETURN_STK] = &&lbl_INST_RETURN_STK,
+	[INST_DICT_GET] = &&lbl_INST_DICT_GET,
+	[INST_DICT_SET] = &&lbl_INST_DICT_SET,
+	[INST_DICT_UNSET] = &&lbl_INST_DICT_UNSET,
+	[INST_DICT_INCR_IMM] = &&lbl_INST_DICT_INCR_IMM,
+	[INST_DICT_APPEND] = &&lbl_INST_DICT_APPEND,
+	[INST_DICT_LAPPEND] = &&lbl_INST_DICT_LAPPEND,
+	[INST_DICT_FIRST] = &&lbl_INST_DICT_FIRST,
+	[INST_DICT_NEXT] = &&lbl_INST_DICT_NEXT,
+	[INST_DICT_UPDATE_START] = &&lbl_INST_DICT_UPDATE_START,
+	[INST_DICT_UPDATE_END] = &&lbl_INST_DICT_UPDATE_END,
+	[INST_JUMP_TABLE] = &&lbl_INST_JUMP_TABLE,
+	[INST_UPVAR] = &&lbl_INST_UPVAR,
+	[INST_NSUPVAR] = &&lbl_INST_NSUPVAR,
+	[INST_VARIABLE] = &&lbl_INST_VARIABLE,
+	[INST_SYNTAX] = &&lbl_INST_SYNTAX,
+	[INST_REVERSE] = &&lbl_INST_REVERSE,
+	[INST_REGEXP] = &&lbl_INST_REGEXP,
+	[INST_EXIST_SCALAR] = &&lbl_INST_EXIST_SCALAR,
+	[INST_EXIST_ARRAY] = &&lbl_INST_EXIST_ARRAY,
+	[INST_EXIST_ARRAY_STK] = &&lbl_INST_EXIST_ARRAY_STK,
+	[INST_EXIST_STK] = &&lbl_INST_EXIST_STK,
+	[INST_NOP] = &&instNop,
+	[INST_RETURN_CODE_BRANCH] = &&lbl_INST_RETURN_CODE_BRANCH,
+	[INST_UNSET_SCALAR] = &&lbl_INST_UNSET_SCALAR,
+	[INST_UNSET_ARRAY] = &&lbl_INST_UNSET_ARRAY,
+	[INST_UNSET_ARRAY_STK] = &&lbl_INST_UNSET_ARRAY_STK,
+	[INST_UNSET_STK] = &&lbl_INST_UNSET_STK,
+	[INST_DICT_EXPAND] = &&lbl_INST_DICT_EXPAND,
+	[INST_DICT_RECOMBINE_STK] = &&lbl_INST_DICT_RECOMBINE_STK,
+	[INST_DICT_RECOMBINE_IMM] = &&lbl_INST_DICT_RECOMBINE_IMM,
+	[INST_DICT_EXISTS] = &&lbl_INST_DICT_EXISTS,
+	[INST_DICT_VERIFY] = &&lbl_INST_DICT_VERIFY,
+	[INST_STR_MAP] = &&lbl_INST_STR_MAP,
+	[INST_STR_FIND] = &&lbl_INST_STR_FIND,
+	[INST_STR_FIND_LAST] = &&lbl_INST_STR_FIND_LAST,
+	[INST_STR_RANGE_IMM] = &&lbl_INST_STR_RANGE_IMM,
+	[INST_STR_RANGE] = &&lbl_INST_STR_RANGE,
+	[INST_YIELD] = &&lbl_INST_YIELD,
+	[INST_COROUTINE_NAME] = &&lbl_INST_COROUTINE_NAME,
+	[INST_TAILCALL] = &&lbl_INST_TAILCALL,
+	[INST_NS_CURRENT] = &&lbl_INST_NS_CURRENT,
+	[INST_INFO_LEVEL_NUM] = &&lbl_INST_INFO_LEVEL_NUM,
+	[INST_INFO_LEVEL_ARGS] = &&lbl_INST_INFO_LEVEL_ARGS,
+	[INST_RESOLVE_COMMAND] = &&lbl_INST_RESOLVE_COMMAND,
+	[INST_TCLOO_SELF] = &&lbl_INST_TCLOO_SELF,
+	[INST_TCLOO_CLASS] = &&lbl_INST_TCLOO_CLASS,
+	[INST_TCLOO_NS] = &&lbl_INST_TCLOO_NS,
+	[INST_TCLOO_IS_OBJECT] = &&lbl_INST_TCLOO_IS_OBJECT,
+	[INST_ARRAY_EXISTS_STK] = &&lbl_INST_ARRAY_EXISTS_STK,
+	[INST_ARRAY_EXISTS_IMM] = &&lbl_INST_ARRAY_EXISTS_IMM,
+	[INST_ARRAY_MAKE_STK] = &&lbl_INST_ARRAY_MAKE_STK,
+	[INST_ARRAY_MAKE_IMM] = &&lbl_INST_ARRAY_MAKE_IMM,
+	[INST_INVOKE_REPLACE] = &&lbl_INST_INVOKE_REPLACE,
+	[INST_LIST_CONCAT] = &&lbl_INST_LIST_CONCAT,
+	[INST_EXPAND_DROP] = &&lbl_INST_EXPAND_DROP,
+	[INST_FOREACH_START] = &&lbl_INST_FOREACH_START,
+	[INST_FOREACH_STEP] = &&lbl_INST_FOREACH_STEP,
+	[INST_FOREACH_END] = &&lbl_INST_FOREACH_END,
+	[INST_LMAP_COLLECT] = &&lbl_INST_LMAP_COLLECT,
+	[INST_STR_TRIM] = &&lbl_INST_STR_TRIM,
+	[INST_STR_TRIM_LEFT] = &&lbl_INST_STR_TRIM_LEFT,
+	[INST_STR_TRIM_RIGHT] = &&lbl_INST_STR_TRIM_RIGHT,
+	[INST_CONCAT_STK] = &&lbl_INST_CONCAT_STK,
+	[INST_STR_UPPER] = &&lbl_INST_STR_UPPER,
+	[INST_STR_LOWER] = &&lbl_INST_STR_LOWER,
+	[INST_STR_TITLE] = &&lbl_INST_STR_TITLE,
+	[INST_STR_REPLACE] = &&lbl_INST_STR_REPLACE,
+	[INST_ORIGIN_COMMAND] = &&lbl_INST_ORIGIN_COMMAND,
+	[INST_TCLOO_NEXT] = &&lbl_INST_TCLOO_NEXT,
+	[INST_TCLOO_NEXT_CLASS] = &&lbl_INST_TCLOO_NEXT_CLASS,
+	[INST_YIELD_TO_INVOKE] = &&lbl_INST_YIELD_TO_INVOKE,
+	[INST_NUM_TYPE] = &&lbl_INST_NUM_TYPE,
+	[INST_TRY_CVT_TO_BOOLEAN] = &&lbl_INST_TRY_CVT_TO_BOOLEAN,
+	[INST_STR_CLASS] = &&lbl_INST_STR_CLASS,
+	[INST_LAPPEND_LIST] = &&lbl_INST_LAPPEND_LIST,
+	[INST_LAPPEND_LIST_ARRAY] = &&lbl_INST_LAPPEND_LIST_ARRAY,
+	[INST_LAPPEND_LIST_ARRAY_STK] = &&lbl_INST_LAPPEND_LIST_ARRAY_STK,
+	[INST_LAPPEND_LIST_STK] = &&lbl_INST_LAPPEND_LIST_STK,
+	[INST_CLOCK_READ] = &&lbl_INST_CLOCK_READ,
+	[INST_DICT_GET_DEF] = &&lbl_INST_DICT_GET_DEF,
+	[INST_STR_LT] = &&lbl_INST_STR_LT,
+	[INST_STR_GT] = &&lbl_INST_STR_GT,
+	[INST_STR_LE] = &&lbl_INST_STR_LE,
+	[INST_STR_GE] = &&lbl_INST_STR_GE,
+	[INST_LREPLACE4] = &&lbl_INST_LREPLACE4,
+	[INST_INLINE_GUARD] = &&lbl_INST_INLINE_GUARD,
+	[INST_ADD_SCALAR_LIT1] = &&lbl_INST_ADD_SCALAR_LIT1,
+	[INST_ADD_SCALAR_SCALAR1] = &&lbl_INST_ADD_SCALAR_SCALAR1,
+	[INST_LIST_INDEX_SCALAR1] = &&lbl_INST_LIST_INDEX_SCALAR1,
+	[INST_EQ_JUMP] = &&lbl_INST_EQ_JUMP,
+	[INST_NEQ_JUMP] = &&lbl_INST_NEQ_JUMP,
+	[INST_LT_JUMP] = &&lbl_INST_LT_JUMP,
+	[INST_GT_JUMP] = &&lbl_INST_GT_JUMP,
+	[INST_LE_JUMP] = &&lbl_INST_LE_JUMP,
+	[INST_GE_JUMP] = &&lbl_INST_GE_JUMP,
+	[INST_EQ_INT] = &&lbl_INST_EQ_INT,
+	[INST_NEQ_INT] = &&lbl_INST_NEQ_INT,
+	[INST_LT_INT] = &&lbl_INST_LT_INT,
+	[INST_GT_INT] = &&lbl_INST_GT_INT,
+	[INST_LE_INT] = &&lbl_INST_LE_INT,
+	[INST_GE_INT] = &&lbl_INST_GE_INT,
+	[INST_ADD_INT] = &&lbl_INST_ADD_INT,
+	[INST_SUB_INT] = &&lbl_INST_SUB_INT,
+	[INST_MULT_INT] = &&lbl_INST_MULT_INT,
+	[INST_EQ_DBL] = &&lbl_INST_EQ_DBL,
+	[INST_NEQ_DBL] = &&lbl_INST_NEQ_DBL,
+	[INST_LT_DBL] = &&lbl_INST_LT_DBL,
+	[INST_GT_DBL] = &&lbl_INST_GT_DBL,
+	[INST_LE_DBL] = &&lbl_INST_LE_DBL,
+	[INST_GE_DBL] = &&lbl_INST_GE_DBL,
+	[INST_ADD_DBL] = &&lbl_INST_ADD_DBL,
+	[INST_SUB_DBL] = &&lbl_INST_SUB_DBL,
+	[INST_MULT_DBL] = &&lbl_INST_MULT_DBL,
+	[INST_DIV_DBL] = &&lbl_INST_DIV_DBL,
+	[LAST_INST_OPCODE ... 255] = &&instUnknown
+    };
+    static const void *const countingTable[256] = {
+	[0 ... 255] = &&instCount
+    };
+    const void *const *dispatchPtr;
+#endif /* TEBC_THREADED_DISPATCH */
+    size_t *instCounts;		/* Where to count the instructions executed,
+				 * or NULL if they are not counted. */
+
 #ifdef TCL_COMPILE_DEBUG
     int starting = 1;
     traceInstructions = (tclTraceExec == 3);
@@ -2062,6 +2503,11 @@ TEBCresume(
 
     TEBC_DATA_DIG();
 
+    instCounts = (iPtr->execStatsPtr ? iPtr->execStatsPtr->instCounts : NULL);
+#ifdef TEBC_THREADED_DISPATCH
+    dispatchPtr = (instCounts ? countingTable : dispatchTable);
+#endif
+
 #ifdef TCL_COMPILE_DEBUG
     if (!pc && (tclTraceExec >= 2)) {
 	PrintByteCodeInfo(codePtr);
@@ -2183,7 +2629,7 @@ TEBCresume(
 	TclDecrRefCount(objPtr);
     }
     OBJ_AT_TOS = objResultPtr;
-    goto cleanup0;
+    DISPATCH_NEXT();
 
   cleanupV:
     switch (cleanup) {
@@ -2212,6 +2658,8 @@ TEBCresume(
 
 	break;
     }
+    DISPATCH_NEXT();
+
   cleanup0:
 
     /*
@@ -2223,7 +2671,18 @@ TEBCresume(
 	interruptCounter = ASYNC_CHECK_COUNT;
 	DECACHE_STACK_INFO();
 	if (TclAsyncReady(iPtr)) {
+	    /*
+	     * Expose the current command to the handlers, e.g. to the
+	     * profiler (see tclProfile.c). The pc has already moved past the
+	     * instruction that was executed last, which may have been the last
+	     * one of a command; that instruction is the one to report.
+	     */
+
+	    bcFramePtr->data.tebc.pc = (char *)
+		    GetLastInstruction(pc, codePtr);
+	    iPtr->cmdFramePtr = bcFramePtr;
 	    result = Tcl_AsyncInvoke(interp, result);
+	    iPtr->cmdFramePtr = bcFramePtr->nextPtr;
 	    if (result == TCL_ERROR) {
 		CACHE_STACK_INFO();
 		goto gotError;
@@ -2257,10 +2716,17 @@ TEBCresume(
 
     inst = *pc;
 
+#ifndef TEBC_THREADED_DISPATCH
     peepholeStart:
+#endif
 #ifdef TCL_COMPILE_STATS
     iPtr->stats.instructionCount[*pc]++;
 #endif
+#ifndef TEBC_THREADED_DISPATCH
+    if (instCounts) {
+	instCounts[inst]++;
+    }
+#endif
 
 #ifdef TCL_COMPILE_DEBUG
     /*
@@ -2277,14 +2743,34 @@ TEBCresume(
 
     TCL_DTRACE_INST_NEXT();
 
+#ifdef TEBC_THREADED_DISPATCH
+    goto *dispatchPtr[inst];
+
+  instCount:
+    instCounts[inst]++;
+    goto *dispatchTable[inst];
+#else
     if (inst == INST_LOAD_SCALAR1) {
 	goto instLoadScalar1;
     } else if (inst == INST_PUSH1) {
+	goto instPush1;
+    } else if (inst == INST_START_CMD) {
+	goto instStartCmd;
+    } else if (inst == INST_NOP) {
+	goto instNop;
+    }
+#endif /* TEBC_THREADED_DISPATCH */
+
+    switch (inst) {
+    case INST_PUSH1:
+    instPush1:
 	PUSH_OBJECT(codePtr->objArrayPtr[TclGetUInt1AtPtr(pc+1)]);
 	TRACE_WITH_OBJ(("%u => ", TclGetUInt1AtPtr(pc+1)), OBJ_AT_TOS);
 	inst = *(pc += 2);
-	goto peepholeStart;
-    } else if (inst == INST_START_CMD) {
+	DISPATCH_PEEPHOLE();
+
+    case INST_START_CMD:
+    instStartCmd:
 	/*
 	 * Peephole: do not run INST_START_CMD, just skip it
 	 */
@@ -2299,20 +2785,20 @@ TEBCresume(
 	    checkInterp = 0;
 	}
 	inst = *(pc += 9);
-	goto peepholeStart;
-    } else if (inst == INST_NOP) {
+	DISPATCH_PEEPHOLE();
+
+    case INST_NOP:
+    instNop:
 #ifndef TCL_COMPILE_DEBUG
 	while (inst == INST_NOP)
 #endif
 	{
 	    inst = *++pc;
 	}
-	goto peepholeStart;
-    }
+	DISPATCH_PEEPHOLE();
 
-    switch (inst) {
-    case INST_SYNTAX:
-    case INST_RETURN_IMM: {
+    TEBC_CASE(INST_SYNTAX):
+    TEBC_CASE(INST_RETURN_IMM): {
 	int code = TclGetInt4AtPtr(pc+1);
 	int level = TclGetUInt4AtPtr(pc+5);
 
@@ -2336,7 +2822,7 @@ TEBCresume(
 	goto processExceptionReturn;
     }
 
-    case INST_RETURN_STK:
+    TEBC_CASE(INST_RETURN_STK):
 	TRACE(("=> "));
 	objResultPtr = POP_OBJECT();
 	result = Tcl_SetReturnOptions(interp, OBJ_AT_TOS);
@@ -2370,7 +2856,7 @@ TEBCresume(
 	CoroutineData *corPtr;
 	void *yieldParameter;
 
-    case INST_YIELD:
+    TEBC_CASE(INST_YIELD):
 	corPtr = iPtr->execEnvPtr->corPtr;
 	TRACE(("%.30s => ", O2S(OBJ_AT_TOS)));
 	if (!corPtr) {
@@ -2400,7 +2886,7 @@ TEBCresume(
 	Tcl_SetObjResult(interp, OBJ_AT_TOS);
 	goto doYield;
 
-    case INST_YIELD_TO_INVOKE:
+    TEBC_CASE(INST_YIELD_TO_INVOKE):
 	corPtr = iPtr->execEnvPtr->corPtr;
 	valuePtr = OBJ_AT_TOS;
 	if (!corPtr) {
@@ -2473,7 +2959,7 @@ TEBCresume(
 	return TCL_OK;
     }
 
-    case INST_TAILCALL: {
+    TEBC_CASE(INST_TAILCALL): {
 	Tcl_Obj *listPtr, *nsObjPtr;
 
 	opnd = TclGetUInt1AtPtr(pc+1);
@@ -2522,7 +3008,7 @@ TEBCresume(
 	goto processExceptionReturn;
     }
 
-    case INST_DONE:
+    TEBC_CASE(INST_DONE):
 	if (tosPtr > initTosPtr) {
 
 	    if ((curEvalFlags & TCL_EVAL_DISCARD_RESULT) && (result == TCL_OK)) {
@@ -2552,33 +3038,33 @@ TEBCresume(
 	(void) POP_OBJECT();
 	goto abnormalReturn;
 
-    case INST_PUSH4:
+    TEBC_CASE(INST_PUSH4):
 	objResultPtr = codePtr->objArrayPtr[TclGetUInt4AtPtr(pc+1)];
 	TRACE_WITH_OBJ(("%u => ", TclGetUInt4AtPtr(pc+1)), objResultPtr);
 	NEXT_INST_F(5, 0, 1);
     break;
 
-    case INST_POP:
+    TEBC_CASE(INST_POP):
 	TRACE_WITH_OBJ(("=> discarding "), OBJ_AT_TOS);
 	objPtr = POP_OBJECT();
 	TclDecrRefCount(objPtr);
 	NEXT_INST_F(1, 0, 0);
     break;
 
-    case INST_DUP:
+    TEBC_CASE(INST_DUP):
 	objResultPtr = OBJ_AT_TOS;
 	TRACE_WITH_OBJ(("=> "), objResultPtr);
 	NEXT_INST_F(1, 0, 1);
     break;
 
-    case INST_OVER:
+    TEBC_CASE(INST_OVER):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	objResultPtr = OBJ_AT_DEPTH(opnd);
 	TRACE_WITH_OBJ(("%u => ", opnd), objResultPtr);
 	NEXT_INST_F(5, 0, 1);
     break;
 
-    case INST_REVERSE: {
+    TEBC_CASE(INST_REVERSE): {
 	Tcl_Obj **a, **b;
 
 	opnd = TclGetUInt4AtPtr(pc+1);
@@ -2595,7 +3081,7 @@ TEBCresume(
     }
     break;
 
-    case INST_STR_CONCAT1:
+    TEBC_CASE(INST_STR_CONCAT1):
 
 	opnd = TclGetUInt1AtPtr(pc+1);
 	objResultPtr = TclStringCat(interp, opnd, &OBJ_AT_DEPTH(opnd-1),
@@ -2609,7 +3095,7 @@ TEBCresume(
 	NEXT_INST_V(2, opnd, 1);
     break;
 
-    case INST_CONCAT_STK:
+    TEBC_CASE(INST_CONCAT_STK):
 	/*
 	 * Pop the opnd (objc) top stack elements, run through Tcl_ConcatObj,
 	 * and then decrement their ref counts.
@@ -2621,7 +3107,7 @@ TEBCresume(
 	NEXT_INST_V(5, opnd, 1);
     break;
 
-    case INST_EXPAND_START:
+    TEBC_CASE(INST_EXPAND_START):
 	/*
 	 * Push an element to the auxObjList. This records the current
 	 * stack depth - i.e., the point in the stack where the expanded
@@ -2643,7 +3129,7 @@ TEBCresume(
 	NEXT_INST_F(1, 0, 0);
     break;
 
-    case INST_EXPAND_DROP:
+    TEBC_CASE(INST_EXPAND_DROP):
 	/*
 	 * Drops an element of the auxObjList, popping stack elements to
 	 * restore the stack to the state before the point where the aux
@@ -2660,7 +3146,7 @@ TEBCresume(
 	TRACE(("=> drop %" TCL_SIZE_MODIFIER "d items\n", objc));
 	NEXT_INST_V(1, objc, 0);
 
-    case INST_EXPAND_STKTOP: {
+    TEBC_CASE(INST_EXPAND_STKTOP): {
 	Tcl_Size i;
 	TEBCdata *newTD;
 	ptrdiff_t oldCatchTopOff, oldTosPtrOff;
@@ -2725,7 +3211,7 @@ TEBCresume(
     }
     break;
 
-    case INST_EXPR_STK: {
+    TEBC_CASE(INST_EXPR_STK): {
 	ByteCode *newCodePtr;
 
 	bcFramePtr->data.tebc.pc = (char *) pc;
@@ -2743,7 +3229,7 @@ TEBCresume(
 	 * INVOCATION BLOCK
 	 */
 
-    case INST_EVAL_STK:
+    TEBC_CASE(INST_EVAL_STK):
     instEvalStk:
 	bcFramePtr->data.tebc.pc = (char *) pc;
 	iPtr->cmdFramePtr = bcFramePtr;
@@ -2756,7 +3242,7 @@ TEBCresume(
 	return TclNRExecuteByteCode(interp,
 		    TclCompileObj(interp, OBJ_AT_TOS, NULL, 0));
 
-    case INST_INVOKE_EXPANDED:
+    TEBC_CASE(INST_INVOKE_EXPANDED):
 	CLANG_ASSERT(auxObjList);
 	objc = CURR_DEPTH - PTR2INT(auxObjList->internalRep.twoPtrValue.ptr2);
 	POP_TAUX_OBJ();
@@ -2773,12 +3259,43 @@ TEBCresume(
 	NEXT_INST_F(1, 0, 1);
     break;
 
-    case INST_INVOKE_STK4:
+    TEBC_CASE(INST_INLINE_GUARD): {
+	InlinedProcInfo *infoPtr = (InlinedProcInfo *)
+		codePtr->auxDataArrayPtr[TclGetUInt4AtPtr(pc+5)].clientData;
+
+	/*
+	 * The body of the procedure invoked by the words on the stack has been
+	 * inlined after this instruction. It may run only while the name still
+	 * resolves to that very procedure, and while nothing would notice the
+	 * missing call: no traces, no lookup namespace given, no recompile
+	 * pending. Otherwise jump to the normal invocation.
+	 */
+
+	objPtr = OBJ_AT_DEPTH(infoPtr->numWords - 1);
+	if ((iPtr->tracePtr == NULL) && (iPtr->lookupNsPtr == NULL)
+		&& (codePtr->compileEpoch == iPtr->compileEpoch)) {
+	    cmdPtr = (Command *) Tcl_GetCommandFromObj(interp, objPtr);
+	    if ((cmdPtr == infoPtr->cmdPtr)
+		    && (cmdPtr->cmdEpoch == infoPtr->cmdEpoch)
+		    && (cmdPtr->objClientData == infoPtr->procPtr)
+		    && !(cmdPtr->flags & CMD_HAS_EXEC_TRACES)) {
+		TRACE(("\"%.30s\" => inlined\n", O2S(objPtr)));
+		NEXT_INST_F(9, 0, 0);
+	    }
+	}
+	opnd = TclGetInt4AtPtr(pc+1);
+	TRACE(("\"%.30s\" => not inlined, new pc %" TCL_Z_MODIFIER "u\n",
+		O2S(objPtr), (size_t)(pc + opnd - codePtr->codeStart)));
+	NEXT_INST_F(opnd, 0, 0);
+    }
+    break;
+
+    TEBC_CASE(INST_INVOKE_STK4):
 	objc = TclGetUInt4AtPtr(pc+1);
 	pcAdjustment = 5;
 	goto doInvocation;
 
-    case INST_INVOKE_STK1:
+    TEBC_CASE(INST_INVOKE_STK1):
 	objc = TclGetUInt1AtPtr(pc+1);
 	pcAdjustment = 2;
 
@@ -2822,16 +3339,29 @@ TEBCresume(
 
 	DECACHE_STACK_INFO();
 
+	/*
+	 * Inline cache: hand the command this site resolves to over to
+	 * TclNREvalObjv, which then need not look it up. Not with traces
+	 * around, nor when someone asked for another lookup namespace; that
+	 * is all done the normal way.
+	 */
+
+	if ((iPtr->tracePtr == NULL) && (iPtr->lookupNsPtr == NULL)) {
+	    cmdPtr = GetCachedCommand(iPtr, codePtr, pc, objv[0]);
+	} else {
+	    cmdPtr = NULL;
+	}
+
 	pc += pcAdjustment;
 	TEBC_YIELD();
 	if (objc > INT_MAX) {
 	    return TclCommandWordLimitError(interp, objc);
 	} else {
 	    return TclNREvalObjv(interp, objc, objv,
-		TCL_EVAL_NOERR | TCL_EVAL_SOURCE_IN_FRAME, NULL);
+		TCL_EVAL_NOERR | TCL_EVAL_SOURCE_IN_FRAME, cmdPtr);
 	}
 
-    case INST_INVOKE_REPLACE:
+    TEBC_CASE(INST_INVOKE_REPLACE):
 	objc = TclGetUInt4AtPtr(pc+1);
 	opnd = TclGetUInt1AtPtr(pc+5);
 	objPtr = POP_OBJECT();
@@ -2925,7 +3455,7 @@ TEBCresume(
 	part1Ptr = part2Ptr = NULL;
 	goto doCallPtrGetVar;
 
-    case INST_LOAD_SCALAR4:
+    TEBC_CASE(INST_LOAD_SCALAR4):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	varPtr = LOCAL(opnd);
 	while (TclIsVarLink(varPtr)) {
@@ -2947,12 +3477,12 @@ TEBCresume(
 	part1Ptr = part2Ptr = NULL;
 	goto doCallPtrGetVar;
 
-    case INST_LOAD_ARRAY4:
+    TEBC_CASE(INST_LOAD_ARRAY4):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	pcAdjustment = 5;
 	goto doLoadArray;
 
-    case INST_LOAD_ARRAY1:
+    TEBC_CASE(INST_LOAD_ARRAY1):
 	opnd = TclGetUInt1AtPtr(pc+1);
 	pcAdjustment = 2;
 
@@ -2985,15 +3515,15 @@ TEBCresume(
 	cleanup = 1;
 	goto doCallPtrGetVar;
 
-    case INST_LOAD_ARRAY_STK:
+    TEBC_CASE(INST_LOAD_ARRAY_STK):
 	cleanup = 2;
 	part2Ptr = OBJ_AT_TOS;		/* element name */
 	objPtr = OBJ_UNDER_TOS;		/* array name */
 	TRACE(("\"%.30s(%.30s)\" => ", O2S(objPtr), O2S(part2Ptr)));
 	goto doLoadStk;
 
-    case INST_LOAD_STK:
-    case INST_LOAD_SCALAR_STK:
+    TEBC_CASE(INST_LOAD_STK):
+    TEBC_CASE(INST_LOAD_SCALAR_STK):
 	cleanup = 1;
 	part2Ptr = NULL;
 	objPtr = OBJ_AT_TOS;		/* variable name */
@@ -3052,12 +3582,12 @@ TEBCresume(
 	int storeFlags;
 	Tcl_Size len;
 
-    case INST_STORE_ARRAY4:
+    TEBC_CASE(INST_STORE_ARRAY4):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	pcAdjustment = 5;
 	goto doStoreArrayDirect;
 
-    case INST_STORE_ARRAY1:
+    TEBC_CASE(INST_STORE_ARRAY1):
 	opnd = TclGetUInt1AtPtr(pc+1);
 	pcAdjustment = 2;
 
@@ -3084,12 +3614,12 @@ TEBCresume(
 	part1Ptr = NULL;
 	goto doStoreArrayDirectFailed;
 
-    case INST_STORE_SCALAR4:
+    TEBC_CASE(INST_STORE_SCALAR4):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	pcAdjustment = 5;
 	goto doStoreScalarDirect;
 
-    case INST_STORE_SCALAR1:
+    TEBC_CASE(INST_STORE_SCALAR1):
 	opnd = TclGetUInt1AtPtr(pc+1);
 	pcAdjustment = 2;
 
@@ -3130,40 +3660,40 @@ TEBCresume(
 	Tcl_IncrRefCount(objResultPtr);
 	NEXT_INST_F(pcAdjustment, 0, 0);
 
-    case INST_LAPPEND_STK:
+    TEBC_CASE(INST_LAPPEND_STK):
 	valuePtr = OBJ_AT_TOS; /* value to append */
 	part2Ptr = NULL;
 	storeFlags = (TCL_LEAVE_ERR_MSG | TCL_APPEND_VALUE
 		| TCL_LIST_ELEMENT);
 	goto doStoreStk;
 
-    case INST_LAPPEND_ARRAY_STK:
+    TEBC_CASE(INST_LAPPEND_ARRAY_STK):
 	valuePtr = OBJ_AT_TOS; /* value to append */
 	part2Ptr = OBJ_UNDER_TOS;
 	storeFlags = (TCL_LEAVE_ERR_MSG | TCL_APPEND_VALUE
 		| TCL_LIST_ELEMENT);
 	goto doStoreStk;
 
-    case INST_APPEND_STK:
+    TEBC_CASE(INST_APPEND_STK):
 	valuePtr = OBJ_AT_TOS; /* value to append */
 	part2Ptr = NULL;
 	storeFlags = (TCL_LEAVE_ERR_MSG | TCL_APPEND_VALUE);
 	goto doStoreStk;
 
-    case INST_APPEND_ARRAY_STK:
+    TEBC_CASE(INST_APPEND_ARRAY_STK):
 	valuePtr = OBJ_AT_TOS; /* value to append */
 	part2Ptr = OBJ_UNDER_TOS;
 	storeFlags = (TCL_LEAVE_ERR_MSG | TCL_APPEND_VALUE);
 	goto doStoreStk;
 
-    case INST_STORE_ARRAY_STK:
+    TEBC_CASE(INST_STORE_ARRAY_STK):
 	valuePtr = OBJ_AT_TOS;
 	part2Ptr = OBJ_UNDER_TOS;
 	storeFlags = TCL_LEAVE_ERR_MSG;
 	goto doStoreStk;
 
-    case INST_STORE_STK:
-    case INST_STORE_SCALAR_STK:
+    TEBC_CASE(INST_STORE_STK):
+    TEBC_CASE(INST_STORE_SCALAR_STK):
 	valuePtr = OBJ_AT_TOS;
 	part2Ptr = NULL;
 	storeFlags = TCL_LEAVE_ERR_MSG;
@@ -3190,27 +3720,27 @@ TEBCresume(
 	opnd = -1;
 	goto doCallPtrSetVar;
 
-    case INST_LAPPEND_ARRAY4:
+    TEBC_CASE(INST_LAPPEND_ARRAY4):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	pcAdjustment = 5;
 	storeFlags = (TCL_LEAVE_ERR_MSG | TCL_APPEND_VALUE
 		| TCL_LIST_ELEMENT);
 	goto doStoreArray;
 
-    case INST_LAPPEND_ARRAY1:
+    TEBC_CASE(INST_LAPPEND_ARRAY1):
 	opnd = TclGetUInt1AtPtr(pc+1);
 	pcAdjustment = 2;
 	storeFlags = (TCL_LEAVE_ERR_MSG | TCL_APPEND_VALUE
 		| TCL_LIST_ELEMENT);
 	goto doStoreArray;
 
-    case INST_APPEND_ARRAY4:
+    TEBC_CASE(INST_APPEND_ARRAY4):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	pcAdjustment = 5;
 	storeFlags = (TCL_LEAVE_ERR_MSG | TCL_APPEND_VALUE);
 	goto doStoreArray;
 
-    case INST_APPEND_ARRAY1:
+    TEBC_CASE(INST_APPEND_ARRAY1):
 	opnd = TclGetUInt1AtPtr(pc+1);
 	pcAdjustment = 2;
 	storeFlags = (TCL_LEAVE_ERR_MSG | TCL_APPEND_VALUE);
@@ -3237,27 +3767,27 @@ TEBCresume(
 	}
 	goto doCallPtrSetVar;
 
-    case INST_LAPPEND_SCALAR4:
+    TEBC_CASE(INST_LAPPEND_SCALAR4):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	pcAdjustment = 5;
 	storeFlags = (TCL_LEAVE_ERR_MSG | TCL_APPEND_VALUE
 		| TCL_LIST_ELEMENT);
 	goto doStoreScalar;
 
-    case INST_LAPPEND_SCALAR1:
+    TEBC_CASE(INST_LAPPEND_SCALAR1):
 	opnd = TclGetUInt1AtPtr(pc+1);
 	pcAdjustment = 2;
 	storeFlags = (TCL_LEAVE_ERR_MSG | TCL_APPEND_VALUE
 		| TCL_LIST_ELEMENT);
 	goto doStoreScalar;
 
-    case INST_APPEND_SCALAR4:
+    TEBC_CASE(INST_APPEND_SCALAR4):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	pcAdjustment = 5;
 	storeFlags = (TCL_LEAVE_ERR_MSG | TCL_APPEND_VALUE);
 	goto doStoreScalar;
 
-    case INST_APPEND_SCALAR1:
+    TEBC_CASE(INST_APPEND_SCALAR1):
 	opnd = TclGetUInt1AtPtr(pc+1);
 	pcAdjustment = 2;
 	storeFlags = (TCL_LEAVE_ERR_MSG | TCL_APPEND_VALUE);
@@ -3291,7 +3821,7 @@ TEBCresume(
 	TRACE_APPEND(("%.30s\n", O2S(objResultPtr)));
 	NEXT_INST_V(pcAdjustment, cleanup, 1);
 
-    case INST_LAPPEND_LIST:
+    TEBC_CASE(INST_LAPPEND_LIST):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	valuePtr = OBJ_AT_TOS;
 	varPtr = LOCAL(opnd);
@@ -3314,7 +3844,7 @@ TEBCresume(
 	part1Ptr = part2Ptr = NULL;
 	goto lappendListPtr;
 
-    case INST_LAPPEND_LIST_ARRAY:
+    TEBC_CASE(INST_LAPPEND_LIST_ARRAY):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	valuePtr = OBJ_AT_TOS;
 	part1Ptr = NULL;
@@ -3348,7 +3878,7 @@ TEBCresume(
 	}
 	goto lappendListPtr;
 
-    case INST_LAPPEND_LIST_ARRAY_STK:
+    TEBC_CASE(INST_LAPPEND_LIST_ARRAY_STK):
 	pcAdjustment = 1;
 	cleanup = 3;
 	valuePtr = OBJ_AT_TOS;
@@ -3358,7 +3888,7 @@ TEBCresume(
 		O2S(part1Ptr), O2S(part2Ptr), O2S(valuePtr)));
 	goto lappendList;
 
-    case INST_LAPPEND_LIST_STK:
+    TEBC_CASE(INST_LAPPEND_LIST_STK):
 	pcAdjustment = 1;
 	cleanup = 2;
 	valuePtr = OBJ_AT_TOS;
@@ -3374,8 +3904,9 @@ TEBCresume(
 	    goto gotError;
 	}
 	if (Tcl_IsShared(objResultPtr)) {
-	    Tcl_Obj *newValue = TclDuplicatePureObj(
-		    interp, objResultPtr, &tclListType.objType);
+	    Tcl_Obj *newValue = TclDuplicatePureObj(interp, objResultPtr,
+		    TclHasInternalRep(objResultPtr, &tclPackedListType.objType)
+		    ? &tclPackedListType.objType : &tclListType.objType);
 	    if (!newValue) {
 		TRACE_ERROR(interp);
 		goto gotError;
@@ -3438,8 +3969,10 @@ TEBCresume(
 		goto gotError;
 	    } else {
 		if (Tcl_IsShared(objResultPtr)) {
-		    valueToAssign = TclDuplicatePureObj(
-			interp, objResultPtr, &tclListType.objType);
+		    valueToAssign = TclDuplicatePureObj(interp, objResultPtr,
+			    TclHasInternalRep(objResultPtr,
+				    &tclPackedListType.objType)
+			    ? &tclPackedListType.objType : &tclListType.objType);
 		    if (!valueToAssign) {
 			goto errorInLappendListPtr;
 		    }
@@ -3486,11 +4019,11 @@ TEBCresume(
 	Tcl_WideInt w;
 	long increment;
 
-    case INST_INCR_SCALAR1:
-    case INST_INCR_ARRAY1:
-    case INST_INCR_ARRAY_STK:
-    case INST_INCR_SCALAR_STK:
-    case INST_INCR_STK:
+    TEBC_CASE(INST_INCR_SCALAR1):
+    TEBC_CASE(INST_INCR_ARRAY1):
+    TEBC_CASE(INST_INCR_ARRAY_STK):
+    TEBC_CASE(INST_INCR_SCALAR_STK):
+    TEBC_CASE(INST_INCR_STK):
 	opnd = TclGetUInt1AtPtr(pc+1);
 	incrPtr = POP_OBJECT();
 	switch (*pc) {
@@ -3505,9 +4038,9 @@ TEBCresume(
 	    goto doIncrStk;
 	}
 
-    case INST_INCR_ARRAY_STK_IMM:
-    case INST_INCR_SCALAR_STK_IMM:
-    case INST_INCR_STK_IMM:
+    TEBC_CASE(INST_INCR_ARRAY_STK_IMM):
+    TEBC_CASE(INST_INCR_SCALAR_STK_IMM):
+    TEBC_CASE(INST_INCR_STK_IMM):
 	increment = TclGetInt1AtPtr(pc+1);
 	TclNewIntObj(incrPtr, increment);
 	Tcl_IncrRefCount(incrPtr);
@@ -3541,7 +4074,7 @@ TEBCresume(
 	cleanup = ((part2Ptr == NULL)? 1 : 2);
 	goto doIncrVar;
 
-    case INST_INCR_ARRAY1_IMM:
+    TEBC_CASE(INST_INCR_ARRAY1_IMM):
 	opnd = TclGetUInt1AtPtr(pc+1);
 	increment = TclGetInt1AtPtr(pc+2);
 	TclNewIntObj(incrPtr, increment);
@@ -3566,7 +4099,7 @@ TEBCresume(
 	}
 	goto doIncrVar;
 
-    case INST_INCR_SCALAR1_IMM:
+    TEBC_CASE(INST_INCR_SCALAR1_IMM):
 	opnd = TclGetUInt1AtPtr(pc+1);
 	increment = TclGetInt1AtPtr(pc+2);
 	pcAdjustment = 3;
@@ -3705,7 +4238,7 @@ TEBCresume(
      *	   Start of INST_EXIST instructions.
      */
 
-    case INST_EXIST_SCALAR:
+    TEBC_CASE(INST_EXIST_SCALAR):
 	cleanup = 0;
 	pcAdjustment = 5;
 	opnd = TclGetUInt4AtPtr(pc+1);
@@ -3726,7 +4259,7 @@ TEBCresume(
 	}
 	goto afterExistsPeephole;
 
-    case INST_EXIST_ARRAY:
+    TEBC_CASE(INST_EXIST_ARRAY):
 	cleanup = 1;
 	pcAdjustment = 5;
 	opnd = TclGetUInt4AtPtr(pc+1);
@@ -3758,7 +4291,7 @@ TEBCresume(
 	}
 	goto afterExistsPeephole;
 
-    case INST_EXIST_ARRAY_STK:
+    TEBC_CASE(INST_EXIST_ARRAY_STK):
 	cleanup = 2;
 	pcAdjustment = 1;
 	part2Ptr = OBJ_AT_TOS;		/* element name */
@@ -3766,7 +4299,7 @@ TEBCresume(
 	TRACE(("\"%.30s(%.30s)\" => ", O2S(part1Ptr), O2S(part2Ptr)));
 	goto doExistStk;
 
-    case INST_EXIST_STK:
+    TEBC_CASE(INST_EXIST_STK):
 	cleanup = 1;
 	pcAdjustment = 1;
 	part2Ptr = NULL;
@@ -3809,7 +4342,7 @@ TEBCresume(
     {
 	int flags;
 
-    case INST_UNSET_SCALAR:
+    TEBC_CASE(INST_UNSET_SCALAR):
 	flags = TclGetUInt1AtPtr(pc+1) ? TCL_LEAVE_ERR_MSG : 0;
 	opnd = TclGetUInt4AtPtr(pc+2);
 	varPtr = LOCAL(opnd);
@@ -3842,7 +4375,7 @@ TEBCresume(
 	CACHE_STACK_INFO();
 	NEXT_INST_F(6, 0, 0);
 
-    case INST_UNSET_ARRAY:
+    TEBC_CASE(INST_UNSET_ARRAY):
 	flags = TclGetUInt1AtPtr(pc+1) ? TCL_LEAVE_ERR_MSG : 0;
 	opnd = TclGetUInt4AtPtr(pc+2);
 	part2Ptr = OBJ_AT_TOS;
@@ -3895,7 +4428,7 @@ TEBCresume(
 	CACHE_STACK_INFO();
 	NEXT_INST_F(6, 1, 0);
 
-    case INST_UNSET_ARRAY_STK:
+    TEBC_CASE(INST_UNSET_ARRAY_STK):
 	flags = TclGetUInt1AtPtr(pc+1) ? TCL_LEAVE_ERR_MSG : 0;
 	cleanup = 2;
 	part2Ptr = OBJ_AT_TOS;		/* element name */
@@ -3904,7 +4437,7 @@ TEBCresume(
 		O2S(part1Ptr), O2S(part2Ptr)));
 	goto doUnsetStk;
 
-    case INST_UNSET_STK:
+    TEBC_CASE(INST_UNSET_STK):
 	flags = TclGetUInt1AtPtr(pc+1) ? TCL_LEAVE_ERR_MSG : 0;
 	cleanup = 1;
 	part2Ptr = NULL;
@@ -3935,7 +4468,7 @@ TEBCresume(
      *	   Start of INST_ARRAY instructions.
      */
 
-    case INST_ARRAY_EXISTS_IMM:
+    TEBC_CASE(INST_ARRAY_EXISTS_IMM):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	pcAdjustment = 5;
 	cleanup = 0;
@@ -3947,7 +4480,7 @@ TEBCresume(
 	    varPtr = varPtr->value.linkPtr;
 	}
 	goto doArrayExists;
-    case INST_ARRAY_EXISTS_STK:
+    TEBC_CASE(INST_ARRAY_EXISTS_STK):
 	opnd = -1;
 	pcAdjustment = 1;
 	cleanup = 1;
@@ -3971,7 +4504,7 @@ TEBCresume(
 	TRACE_APPEND(("%.30s\n", O2S(objResultPtr)));
 	NEXT_INST_V(pcAdjustment, cleanup, 1);
 
-    case INST_ARRAY_MAKE_IMM:
+    TEBC_CASE(INST_ARRAY_MAKE_IMM):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	pcAdjustment = 5;
 	cleanup = 0;
@@ -3983,7 +4516,7 @@ TEBCresume(
 	    varPtr = varPtr->value.linkPtr;
 	}
 	goto doArrayMake;
-    case INST_ARRAY_MAKE_STK:
+    TEBC_CASE(INST_ARRAY_MAKE_STK):
 	opnd = -1;
 	pcAdjustment = 1;
 	cleanup = 1;
@@ -4031,7 +4564,7 @@ TEBCresume(
 	Tcl_Namespace *nsPtr;
 	Namespace *savedNsPtr;
 
-    case INST_UPVAR:
+    TEBC_CASE(INST_UPVAR):
 	TRACE(("%d %.30s %.30s => ", TclGetInt4AtPtr(pc+1),
 		O2S(OBJ_UNDER_TOS), O2S(OBJ_AT_TOS)));
 
@@ -4056,7 +4589,7 @@ TEBCresume(
 	}
 	goto doLinkVars;
 
-    case INST_NSUPVAR:
+    TEBC_CASE(INST_NSUPVAR):
 	TRACE(("%d %.30s %.30s => ", TclGetInt4AtPtr(pc+1),
 		O2S(OBJ_UNDER_TOS), O2S(OBJ_AT_TOS)));
 	if (TclGetNamespaceFromObj(interp, OBJ_UNDER_TOS, &nsPtr) != TCL_OK) {
@@ -4080,7 +4613,7 @@ TEBCresume(
 	}
 	goto doLinkVars;
 
-    case INST_VARIABLE:
+    TEBC_CASE(INST_VARIABLE):
 	TRACE(("%d, %.30s => ", TclGetInt4AtPtr(pc+1), O2S(OBJ_AT_TOS)));
 	otherPtr = TclObjLookupVarEx(interp, OBJ_AT_TOS, NULL,
 		(TCL_NAMESPACE_ONLY | TCL_LEAVE_ERR_MSG), "access",
@@ -4152,14 +4685,14 @@ TEBCresume(
      * -----------------------------------------------------------------
      */
 
-    case INST_JUMP1:
+    TEBC_CASE(INST_JUMP1):
 	opnd = TclGetInt1AtPtr(pc+1);
 	TRACE(("%d => new pc %" TCL_Z_MODIFIER "u\n", opnd,
 		(size_t)(pc + opnd - codePtr->codeStart)));
 	NEXT_INST_F(opnd, 0, 0);
     break;
 
-    case INST_JUMP4:
+    TEBC_CASE(INST_JUMP4):
 	opnd = TclGetInt4AtPtr(pc+1);
 	TRACE(("%d => new pc %" TCL_Z_MODIFIER "u\n", opnd,
 		(size_t)(pc + opnd - codePtr->codeStart)));
@@ -4170,22 +4703,22 @@ TEBCresume(
 
 	/* TODO: consider rewrite so we don't compute the offset we're not
 	 * going to take. */
-    case INST_JUMP_FALSE4:
+    TEBC_CASE(INST_JUMP_FALSE4):
 	jmpOffset[0] = TclGetInt4AtPtr(pc+1);	/* FALSE offset */
 	jmpOffset[1] = 5;			/* TRUE offset */
 	goto doCondJump;
 
-    case INST_JUMP_TRUE4:
+    TEBC_CASE(INST_JUMP_TRUE4):
 	jmpOffset[0] = 5;
 	jmpOffset[1] = TclGetInt4AtPtr(pc+1);
 	goto doCondJump;
 
-    case INST_JUMP_FALSE1:
+    TEBC_CASE(INST_JUMP_FALSE1):
 	jmpOffset[0] = TclGetInt1AtPtr(pc+1);
 	jmpOffset[1] = 2;
 	goto doCondJump;
 
-    case INST_JUMP_TRUE1:
+    TEBC_CASE(INST_JUMP_TRUE1):
 	jmpOffset[0] = 2;
 	jmpOffset[1] = TclGetInt1AtPtr(pc+1);
 
@@ -4222,7 +4755,7 @@ TEBCresume(
     }
     break;
 
-    case INST_JUMP_TABLE: {
+    TEBC_CASE(INST_JUMP_TABLE): {
 	Tcl_HashEntry *hPtr;
 	JumptableInfo *jtPtr;
 
@@ -4253,7 +4786,7 @@ TEBCresume(
      *	   Start of general introspector instructions.
      */
 
-    case INST_NS_CURRENT: {
+    TEBC_CASE(INST_NS_CURRENT): {
 	Namespace *currNsPtr = (Namespace *) TclGetCurrentNamespace(interp);
 
 	if (currNsPtr == (Namespace *) TclGetGlobalNamespace(interp)) {
@@ -4266,7 +4799,7 @@ TEBCresume(
 	NEXT_INST_F(1, 0, 1);
     }
     break;
-    case INST_COROUTINE_NAME: {
+    TEBC_CASE(INST_COROUTINE_NAME): {
 	CoroutineData *corPtr = iPtr->execEnvPtr->corPtr;
 
 	TclNewObj(objResultPtr);
@@ -4278,12 +4811,12 @@ TEBCresume(
 	NEXT_INST_F(1, 0, 1);
     }
     break;
-    case INST_INFO_LEVEL_NUM:
+    TEBC_CASE(INST_INFO_LEVEL_NUM):
 	TclNewIntObj(objResultPtr, (int)iPtr->varFramePtr->level);
 	TRACE_WITH_OBJ(("=> "), objResultPtr);
 	NEXT_INST_F(1, 0, 1);
     break;
-    case INST_INFO_LEVEL_ARGS: {
+    TEBC_CASE(INST_INFO_LEVEL_ARGS): {
 	int level;
 	CallFrame *framePtr = iPtr->varFramePtr;
 	CallFrame *rootFramePtr = iPtr->rootFramePtr;
@@ -4317,7 +4850,7 @@ TEBCresume(
     {
 	Tcl_Command cmd, origCmd;
 
-    case INST_RESOLVE_COMMAND:
+    TEBC_CASE(INST_RESOLVE_COMMAND):
 	cmd = Tcl_GetCommandFromObj(interp, OBJ_AT_TOS);
 	TclNewObj(objResultPtr);
 	if (cmd != NULL) {
@@ -4326,7 +4859,7 @@ TEBCresume(
 	TRACE_WITH_OBJ(("\"%.20s\" => ", O2S(OBJ_AT_TOS)), objResultPtr);
 	NEXT_INST_F(1, 1, 1);
 
-    case INST_ORIGIN_COMMAND:
+    TEBC_CASE(INST_ORIGIN_COMMAND):
 	TRACE(("\"%.30s\" => ", O2S(OBJ_AT_TOS)));
 	cmd = Tcl_GetCommandFromObj(interp, OBJ_AT_TOS);
 	if (cmd == NULL) {
@@ -4366,7 +4899,7 @@ TEBCresume(
 	CallContext *contextPtr;
 	Tcl_Size skip, newDepth;
 
-    case INST_TCLOO_SELF:
+    TEBC_CASE(INST_TCLOO_SELF):
 	framePtr = iPtr->varFramePtr;
 	if (framePtr == NULL ||
 		!(framePtr->isProcCallFrame & FRAME_IS_METHOD)) {
@@ -4389,7 +4922,7 @@ TEBCresume(
 	TRACE_WITH_OBJ(("=> "), objResultPtr);
 	NEXT_INST_F(1, 0, 1);
 
-    case INST_TCLOO_NEXT_CLASS:
+    TEBC_CASE(INST_TCLOO_NEXT_CLASS):
 	opnd = TclGetUInt1AtPtr(pc+1);
 	framePtr = iPtr->varFramePtr;
 	valuePtr = OBJ_AT_DEPTH(opnd - 2);
@@ -4489,7 +5022,7 @@ TEBCresume(
 	    goto gotError;
 	}
 
-    case INST_TCLOO_NEXT:
+    TEBC_CASE(INST_TCLOO_NEXT):
 	opnd = TclGetUInt1AtPtr(pc+1);
 	objv = &OBJ_AT_DEPTH(opnd - 1);
 	framePtr = iPtr->varFramePtr;
@@ -4600,12 +5133,12 @@ TEBCresume(
 		    (Tcl_ObjectContext) contextPtr, opnd, objv);
 	}
 
-    case INST_TCLOO_IS_OBJECT:
+    TEBC_CASE(INST_TCLOO_IS_OBJECT):
 	oPtr = (Object *) Tcl_GetObjectFromObj(interp, OBJ_AT_TOS);
 	objResultPtr = TCONST(oPtr != NULL ? 1 : 0);
 	TRACE_WITH_OBJ(("%.30s => ", O2S(OBJ_AT_TOS)), objResultPtr);
 	NEXT_INST_F(1, 1, 1);
-    case INST_TCLOO_CLASS:
+    TEBC_CASE(INST_TCLOO_CLASS):
 	oPtr = (Object *) Tcl_GetObjectFromObj(interp, OBJ_AT_TOS);
 	if (oPtr == NULL) {
 	    TRACE(("%.30s => ERROR: not object\n", O2S(OBJ_AT_TOS)));
@@ -4614,7 +5147,7 @@ TEBCresume(
 	objResultPtr = TclOOObjectName(interp, oPtr->selfCls->thisPtr);
 	TRACE_WITH_OBJ(("%.30s => ", O2S(OBJ_AT_TOS)), objResultPtr);
 	NEXT_INST_F(1, 1, 1);
-    case INST_TCLOO_NS:
+    TEBC_CASE(INST_TCLOO_NS):
 	oPtr = (Object *) Tcl_GetObjectFromObj(interp, OBJ_AT_TOS);
 	if (oPtr == NULL) {
 	    TRACE(("%.30s => ERROR: not object\n", O2S(OBJ_AT_TOS)));
@@ -4642,7 +5175,7 @@ TEBCresume(
 	Tcl_Size slength, length2, fromIdx, toIdx, index, s1len, s2len;
 	const char *s1, *s2;
 
-    case INST_LIST:
+    TEBC_CASE(INST_LIST):
 	/*
 	 * Pop the opnd (objc) top stack elements into a new list obj and then
 	 * decrement their ref counts.
@@ -4653,7 +5186,7 @@ TEBCresume(
 	TRACE_WITH_OBJ(("%u => ", opnd), objResultPtr);
 	NEXT_INST_V(5, opnd, 1);
 
-    case INST_LIST_LENGTH:
+    TEBC_CASE(INST_LIST_LENGTH):
 	TRACE(("\"%.30s\" => ", O2S(OBJ_AT_TOS)));
 	if (TclListObjLengthM(interp, OBJ_AT_TOS, &length) != TCL_OK) {
 	    TRACE_ERROR(interp);
@@ -4663,7 +5196,7 @@ TEBCresume(
 	TRACE_APPEND(("%" TCL_SIZE_MODIFIER "d\n", length));
 	NEXT_INST_F(1, 1, 1);
 
-    case INST_LIST_INDEX:	/* lindex with objc == 3 */
+    TEBC_CASE(INST_LIST_INDEX):	/* lindex with objc == 3 */
 	value2Ptr = OBJ_AT_TOS;
 	valuePtr = OBJ_UNDER_TOS;
 	TRACE(("\"%.30s\" \"%.30s\" => ", O2S(valuePtr), O2S(value2Ptr)));
@@ -4687,6 +5220,48 @@ TEBCresume(
 	    goto lindexDone;
 	}
 
+	/*
+	 * A packed list only boxes the element asked for. Indexing a list by
+	 * itself could shimmer it while the index is read.
+	 */
+
+	if (TclHasInternalRep(valuePtr,&tclPackedListType.objType)
+		&& valuePtr != value2Ptr) {
+	    length = ABSTRACTLIST_PROC(valuePtr, lengthProc)(valuePtr);
+	    DECACHE_STACK_INFO();
+	    if (TclGetIntForIndexM(interp, value2Ptr, length-1, &index)!=TCL_OK) {
+		CACHE_STACK_INFO();
+		TRACE_ERROR(interp);
+		goto gotError;
+	    }
+	    CACHE_STACK_INFO();
+	    objResultPtr = TclPackedListObjIndex(valuePtr, index);
+	    Tcl_IncrRefCount(objResultPtr);
+	    goto lindexDone;
+	}
+
+	/*
+	 * A list view gives its element without making its element array.
+	 */
+
+	if (TclHasInternalRep(valuePtr,&tclListViewType.objType)
+		&& valuePtr != value2Ptr) {
+	    length = ABSTRACTLIST_PROC(valuePtr, lengthProc)(valuePtr);
+	    DECACHE_STACK_INFO();
+	    if (TclGetIntForIndexM(interp, value2Ptr, length-1, &index)!=TCL_OK) {
+		CACHE_STACK_INFO();
+		TRACE_ERROR(interp);
+		goto gotError;
+	    }
+	    CACHE_STACK_INFO();
+	    objResultPtr = TclListViewObjIndex(valuePtr, index);
+	    if (objResultPtr == NULL) {
+		TclNewObj(objResultPtr);
+	    }
+	    Tcl_IncrRefCount(objResultPtr);
+	    goto lindexDone;
+	}
+
 	/*
 	 * Extract the desired list element.
 	 */
@@ -4743,7 +5318,38 @@ TEBCresume(
 	TRACE_APPEND(("\"%.30s\"\n", O2S(objResultPtr)));
 	NEXT_INST_F(1, 2, -1);	/* Already has the correct refCount */
 
-    case INST_LIST_INDEX_IMM:	/* lindex with objc==3 and index in bytecode
+    TEBC_CASE(INST_LIST_INDEX_SCALAR1): {
+	Tcl_WideInt wIndex;
+
+	/*
+	 * Superinstruction covering loadScalar1 + listIndex: a list indexed by
+	 * an integer held in a local variable. Anything out of the ordinary
+	 * runs the covered instructions instead.
+	 */
+
+	varPtr = LOCAL(TclGetUInt1AtPtr(pc+1));
+	while (TclIsVarLink(varPtr)) {
+	    varPtr = varPtr->value.linkPtr;
+	}
+	valuePtr = OBJ_AT_TOS;
+	if (!TclIsVarDirectReadable(varPtr)
+		|| !TclHasInternalRep(varPtr->value.objPtr, &tclIntType.objType)
+		|| !TclHasInternalRep(valuePtr, &tclListType.objType)) {
+	    goto instLoadScalar1;
+	}
+	wIndex = varPtr->value.objPtr->internalRep.wideValue;
+	ListObjGetElements(valuePtr, objc, objv);
+	TRACE(("\"%.30s\" %" TCL_LL_MODIFIER "d => ", O2S(valuePtr), wIndex));
+	if (wIndex >= 0 && wIndex < objc) {
+	    objResultPtr = objv[wIndex];
+	} else {
+	    TclNewObj(objResultPtr);
+	}
+	TRACE_APPEND(("\"%.30s\"\n", O2S(objResultPtr)));
+	NEXT_INST_F(3, 1, 1);
+    }
+
+    TEBC_CASE(INST_LIST_INDEX_IMM):	/* lindex with objc==3 and index in bytecode
 				 * stream */
 
 	/*
@@ -4776,6 +5382,23 @@ TEBCresume(
 	    pcAdjustment = 5;
 	    goto lindexFastPath2;
 	}
+	if (TclHasInternalRep(valuePtr,&tclPackedListType.objType)) {
+	    length = ABSTRACTLIST_PROC(valuePtr, lengthProc)(valuePtr);
+	    index = TclIndexDecode(opnd, length-1);
+	    objResultPtr = TclPackedListObjIndex(valuePtr, index);
+	    pcAdjustment = 5;
+	    goto lindexFastPath2;
+	}
+	if (TclHasInternalRep(valuePtr,&tclListViewType.objType)) {
+	    length = ABSTRACTLIST_PROC(valuePtr, lengthProc)(valuePtr);
+	    index = TclIndexDecode(opnd, length-1);
+	    objResultPtr = TclListViewObjIndex(valuePtr, index);
+	    if (objResultPtr == NULL) {
+		TclNewObj(objResultPtr);
+	    }
+	    pcAdjustment = 5;
+	    goto lindexFastPath2;
+	}
 
 	/*
 	 * Get the contents of the list, making sure that it really is a list
@@ -4804,7 +5427,7 @@ TEBCresume(
 	TRACE_APPEND(("\"%.30s\"\n", O2S(objResultPtr)));
 	NEXT_INST_F(pcAdjustment, 1, 1);
 
-    case INST_LIST_INDEX_MULTI:	/* 'lindex' with multiple index args */
+    TEBC_CASE(INST_LIST_INDEX_MULTI):	/* 'lindex' with multiple index args */
 	/*
 	 * Determine the count of index args.
 	 */
@@ -4831,7 +5454,7 @@ TEBCresume(
 	TRACE_APPEND(("\"%.30s\"\n", O2S(objResultPtr)));
 	NEXT_INST_V(5, opnd, -1);
 
-    case INST_LSET_FLAT:
+    TEBC_CASE(INST_LSET_FLAT):
 	/*
 	 * Lset with 3, 5, or more args. Get the number of index args.
 	 */
@@ -4868,7 +5491,7 @@ TEBCresume(
 	TRACE_APPEND(("\"%.30s\"\n", O2S(objResultPtr)));
 	NEXT_INST_V(5, numIndices+1, -1);
 
-    case INST_LSET_LIST:	/* 'lset' with 4 args */
+    TEBC_CASE(INST_LSET_LIST):	/* 'lset' with 4 args */
 	/*
 	 * Get the old value of variable, and remove the stack ref. This is
 	 * safe because the variable still references the object; the ref
@@ -4905,7 +5528,7 @@ TEBCresume(
 	TRACE_APPEND(("\"%.30s\"\n", O2S(objResultPtr)));
 	NEXT_INST_F(1, 2, -1);
 
-    case INST_LIST_RANGE_IMM:	/* lrange with objc==4 and both indices in
+    TEBC_CASE(INST_LIST_RANGE_IMM):	/* lrange with objc==4 and both indices in
 				 * bytecode stream */
 
 	/*
@@ -4978,6 +5601,10 @@ TEBCresume(
 
 	if (TclHasInternalRep(valuePtr,&tclArithSeriesType.objType)) {
 	    objResultPtr = TclArithSeriesObjRange(interp, valuePtr, fromIdx, toIdx);
+	} else if (TclHasInternalRep(valuePtr,&tclPackedListType.objType)) {
+	    objResultPtr = TclPackedListObjRange(valuePtr, fromIdx, toIdx);
+	} else if (TclHasInternalRep(valuePtr,&tclListViewType.objType)) {
+	    objResultPtr = TclListViewObjRange(valuePtr, fromIdx, toIdx);
 	} else {
 	    objResultPtr = TclListObjRange(interp, valuePtr, fromIdx, toIdx);
 	}
@@ -4989,8 +5616,8 @@ TEBCresume(
 	TRACE_APPEND(("\"%.30s\"", O2S(objResultPtr)));
 	NEXT_INST_F(9, 1, 1);
 
-    case INST_LIST_IN:
-    case INST_LIST_NOT_IN:	/* Basic list containment operators. */
+    TEBC_CASE(INST_LIST_IN):
+    TEBC_CASE(INST_LIST_NOT_IN):	/* Basic list containment operators. */
 	value2Ptr = OBJ_AT_TOS;
 	valuePtr = OBJ_UNDER_TOS;
 
@@ -5001,34 +5628,41 @@ TEBCresume(
 	    goto gotError;
 	}
 	match = 0;
-	if (length > 0) {
+	if (TclHasInternalRep(value2Ptr,&tclPackedListType.objType)) {
+	    match = (TclPackedListObjFind(value2Ptr, valuePtr) != TCL_INDEX_NONE);
+	} else if (length > 0) {
 	    Tcl_Size i = 0;
 	    Tcl_Obj *o;
 	    int isArithSeries = TclHasInternalRep(value2Ptr,&tclArithSeriesType.objType);
 	    /*
-	     * An empty list doesn't match anything.
+	     * An empty list doesn't match anything. A list that is searched
+	     * repeatedly is looked up in its search index.
 	     */
 
-	    do {
-		if (isArithSeries) {
-		    o = TclArithSeriesObjIndex(NULL, value2Ptr, i);
-		} else {
-		    Tcl_ListObjIndex(NULL, value2Ptr, i, &o);
-		}
-		if (o != NULL) {
-		    s2 = Tcl_GetStringFromObj(o, &s2len);
-		} else {
-		    s2 = "";
-		    s2len = 0;
-		}
-		if (s1len == s2len) {
-		    match = (memcmp(s1, s2, s1len) == 0);
-		}
-		if (isArithSeries) {
-		    TclDecrRefCount(o);
-		}
-		i++;
-	    } while (i < length && match == 0);
+	    if (TclListObjIndexedFind(value2Ptr, valuePtr, 0, &i)) {
+		match = (i >= 0);
+	    } else {
+		do {
+		    if (isArithSeries) {
+			o = TclArithSeriesObjIndex(NULL, value2Ptr, i);
+		    } else {
+			Tcl_ListObjIndex(NULL, value2Ptr, i, &o);
+		    }
+		    if (o != NULL) {
+			s2 = Tcl_GetStringFromObj(o, &s2len);
+		    } else {
+			s2 = "";
+			s2len = 0;
+		    }
+		    if (s1len == s2len) {
+			match = (memcmp(s1, s2, s1len) == 0);
+		    }
+		    if (isArithSeries) {
+			TclDecrRefCount(o);
+		    }
+		    i++;
+		} while (i < length && match == 0);
+	    }
 	}
 
 	if (*pc == INST_LIST_NOT_IN) {
@@ -5045,7 +5679,7 @@ TEBCresume(
 
 	JUMP_PEEPHOLE_F(match, 1, 2);
 
-    case INST_LIST_CONCAT:
+    TEBC_CASE(INST_LIST_CONCAT):
 	value2Ptr = OBJ_AT_TOS;
 	valuePtr = OBJ_UNDER_TOS;
 	TRACE(("\"%.30s\" \"%.30s\" => ", O2S(valuePtr), O2S(value2Ptr)));
@@ -5068,7 +5702,7 @@ TEBCresume(
 	    NEXT_INST_F(1, 1, 0);
 	}
 
-    case INST_LREPLACE4:
+    TEBC_CASE(INST_LREPLACE4):
 	{
 	TCL_HASH_TYPE numToDelete, numNewElems;
 	int end_indicator;
@@ -5165,20 +5799,20 @@ TEBCresume(
 	 *	   Start of string-related instructions.
 	 */
 
-    case INST_STR_EQ:
-    case INST_STR_NEQ:		/* String (in)equality check */
-    case INST_STR_CMP:		/* String compare. */
-    case INST_STR_LT:
-    case INST_STR_GT:
-    case INST_STR_LE:
-    case INST_STR_GE:
+    TEBC_CASE(INST_STR_EQ):
+    TEBC_CASE(INST_STR_NEQ):		/* String (in)equality check */
+    TEBC_CASE(INST_STR_CMP):		/* String compare. */
+    TEBC_CASE(INST_STR_LT):
+    TEBC_CASE(INST_STR_GT):
+    TEBC_CASE(INST_STR_LE):
+    TEBC_CASE(INST_STR_GE):
     stringCompare:
 	value2Ptr = OBJ_AT_TOS;
 	valuePtr = OBJ_UNDER_TOS;
 
 	{
-	    int checkEq = ((*pc == INST_EQ) || (*pc == INST_NEQ)
-		    || (*pc == INST_STR_EQ) || (*pc == INST_STR_NEQ));
+	    int checkEq = ((inst == INST_EQ) || (inst == INST_NEQ)
+		    || (inst == INST_STR_EQ) || (inst == INST_STR_NEQ));
 	    match = TclStringCmp(valuePtr, value2Ptr, checkEq, 0, -1);
 	}
 
@@ -5187,12 +5821,12 @@ TEBCresume(
 	 * TODO: consider peephole opt.
 	 */
 
-	if (*pc != INST_STR_CMP) {
+	if (inst != INST_STR_CMP) {
 	    /*
 	     * Take care of the opcodes that goto'ed into here.
 	     */
 
-	    switch (*pc) {
+	    switch (inst) {
 	    case INST_STR_EQ:
 	    case INST_EQ:
 		match = (match == 0);
@@ -5224,14 +5858,14 @@ TEBCresume(
 		(match < 0 ? -1 : match > 0 ? 1 : 0)));
 	JUMP_PEEPHOLE_F(match, 1, 2);
 
-    case INST_STR_LEN:
+    TEBC_CASE(INST_STR_LEN):
 	valuePtr = OBJ_AT_TOS;
 	slength = Tcl_GetCharLength(valuePtr);
 	TclNewIntObj(objResultPtr, slength);
 	TRACE(("\"%.20s\" => %" TCL_Z_MODIFIER "u\n", O2S(valuePtr), slength));
 	NEXT_INST_F(1, 1, 1);
 
-    case INST_STR_UPPER:
+    TEBC_CASE(INST_STR_UPPER):
 	valuePtr = OBJ_AT_TOS;
 	TRACE(("\"%.20s\" => ", O2S(valuePtr)));
 	if (Tcl_IsShared(valuePtr)) {
@@ -5248,7 +5882,7 @@ TEBCresume(
 	    TRACE_APPEND(("\"%.20s\"\n", O2S(valuePtr)));
 	    NEXT_INST_F(1, 0, 0);
 	}
-    case INST_STR_LOWER:
+    TEBC_CASE(INST_STR_LOWER):
 	valuePtr = OBJ_AT_TOS;
 	TRACE(("\"%.20s\" => ", O2S(valuePtr)));
 	if (Tcl_IsShared(valuePtr)) {
@@ -5265,7 +5899,7 @@ TEBCresume(
 	    TRACE_APPEND(("\"%.20s\"\n", O2S(valuePtr)));
 	    NEXT_INST_F(1, 0, 0);
 	}
-    case INST_STR_TITLE:
+    TEBC_CASE(INST_STR_TITLE):
 	valuePtr = OBJ_AT_TOS;
 	TRACE(("\"%.20s\" => ", O2S(valuePtr)));
 	if (Tcl_IsShared(valuePtr)) {
@@ -5283,7 +5917,7 @@ TEBCresume(
 	    NEXT_INST_F(1, 0, 0);
 	}
 
-    case INST_STR_INDEX:
+    TEBC_CASE(INST_STR_INDEX):
 	value2Ptr = OBJ_AT_TOS;
 	valuePtr = OBJ_UNDER_TOS;
 	TRACE(("\"%.20s\" %.20s => ", O2S(valuePtr), O2S(value2Ptr)));
@@ -5334,7 +5968,7 @@ TEBCresume(
 	TRACE_APPEND(("\"%s\"\n", O2S(objResultPtr)));
 	NEXT_INST_F(1, 2, 1);
 
-    case INST_STR_RANGE:
+    TEBC_CASE(INST_STR_RANGE):
 	TRACE(("\"%.20s\" %.20s %.20s =>",
 		O2S(OBJ_AT_DEPTH(2)), O2S(OBJ_UNDER_TOS), O2S(OBJ_AT_TOS)));
 	slength = Tcl_GetCharLength(OBJ_AT_DEPTH(2)) - 1;
@@ -5362,7 +5996,7 @@ TEBCresume(
 	TRACE_APPEND(("\"%.30s\"\n", O2S(objResultPtr)));
 	NEXT_INST_V(1, 3, 1);
 
-    case INST_STR_RANGE_IMM:
+    TEBC_CASE(INST_STR_RANGE_IMM):
 	valuePtr = OBJ_AT_TOS;
 	fromIdx = TclGetInt4AtPtr(pc+1);
 	toIdx = TclGetInt4AtPtr(pc+5);
@@ -5392,7 +6026,7 @@ TEBCresume(
 	Tcl_Size length3;
 	Tcl_Obj *value3Ptr;
 
-    case INST_STR_REPLACE:
+    TEBC_CASE(INST_STR_REPLACE):
 	value3Ptr = POP_OBJECT();
 	valuePtr = OBJ_AT_DEPTH(2);
 	slength = Tcl_GetCharLength(valuePtr) - 1;
@@ -5451,7 +6085,7 @@ TEBCresume(
 	TRACE_APPEND(("\"%.30s\"\n", O2S(objResultPtr)));
 	NEXT_INST_F(1, 1, 1);
 
-    case INST_STR_MAP:
+    TEBC_CASE(INST_STR_MAP):
 	valuePtr = OBJ_AT_TOS;		/* "Main" string. */
 	value3Ptr = OBJ_UNDER_TOS;	/* "Target" string. */
 	value2Ptr = OBJ_AT_DEPTH(2);	/* "Source" string. */
@@ -5513,21 +6147,21 @@ TEBCresume(
 		O2S(value2Ptr), O2S(value3Ptr), O2S(valuePtr)), objResultPtr);
 	NEXT_INST_V(1, 3, 1);
 
-    case INST_STR_FIND:
+    TEBC_CASE(INST_STR_FIND):
 	objResultPtr = TclStringFirst(OBJ_UNDER_TOS, OBJ_AT_TOS, 0);
 
 	TRACE(("%.20s %.20s => %s\n",
 		O2S(OBJ_UNDER_TOS), O2S(OBJ_AT_TOS), O2S(objResultPtr)));
 	NEXT_INST_F(1, 2, 1);
 
-    case INST_STR_FIND_LAST:
+    TEBC_CASE(INST_STR_FIND_LAST):
 	objResultPtr = TclStringLast(OBJ_UNDER_TOS, OBJ_AT_TOS, TCL_SIZE_MAX - 1);
 
 	TRACE(("%.20s %.20s => %s\n",
 		O2S(OBJ_UNDER_TOS), O2S(OBJ_AT_TOS), O2S(objResultPtr)));
 	NEXT_INST_F(1, 2, 1);
 
-    case INST_STR_CLASS:
+    TEBC_CASE(INST_STR_CLASS):
 	opnd = TclGetInt1AtPtr(pc+1);
 	valuePtr = OBJ_AT_TOS;
 	TRACE(("%s \"%.30s\" => ", tclStringClassTable[opnd].name,
@@ -5549,17 +6183,25 @@ TEBCresume(
 	JUMP_PEEPHOLE_F(match, 2, 1);
     }
 
-    case INST_STR_MATCH:
+    TEBC_CASE(INST_STR_MATCH):
 	nocase = TclGetInt1AtPtr(pc+1);
 	valuePtr = OBJ_AT_TOS;		/* String */
 	value2Ptr = OBJ_UNDER_TOS;	/* Pattern */
 
 	/*
-	 * Check that at least one of the objects is Unicode before promoting
-	 * both.
+	 * Literal patterns are matched against the UTF-8 bytes directly.
+	 * Otherwise check that at least one of the objects is Unicode before
+	 * promoting both.
 	 */
 
-	if (TclHasInternalRep(valuePtr, &tclStringType)
+	match = -1;
+	if (!nocase && (valuePtr->bytes != NULL)) {
+	    match = TclStringMatchLiteral(valuePtr->bytes, valuePtr->length,
+		    TclGetString(value2Ptr));
+	}
+	if (match >= 0) {
+	    /* Matched as a literal. */
+	} else if (TclHasInternalRep(valuePtr, &tclStringType)
 		|| TclHasInternalRep(value2Ptr, &tclStringType)) {
 	    Tcl_UniChar *ustring1, *ustring2;
 
@@ -5596,7 +6238,7 @@ TEBCresume(
 	const char *string1, *string2;
 	Tcl_Size trim1, trim2;
 
-    case INST_STR_TRIM_LEFT:
+    TEBC_CASE(INST_STR_TRIM_LEFT):
 	valuePtr = OBJ_UNDER_TOS;	/* String */
 	value2Ptr = OBJ_AT_TOS;		/* TrimSet */
 	string2 = Tcl_GetStringFromObj(value2Ptr, &length2);
@@ -5604,7 +6246,7 @@ TEBCresume(
 	trim1 = TclTrimLeft(string1, slength, string2, length2);
 	trim2 = 0;
 	goto createTrimmedString;
-    case INST_STR_TRIM_RIGHT:
+    TEBC_CASE(INST_STR_TRIM_RIGHT):
 	valuePtr = OBJ_UNDER_TOS;	/* String */
 	value2Ptr = OBJ_AT_TOS;		/* TrimSet */
 	string2 = Tcl_GetStringFromObj(value2Ptr, &length2);
@@ -5612,7 +6254,7 @@ TEBCresume(
 	trim2 = TclTrimRight(string1, slength, string2, length2);
 	trim1 = 0;
 	goto createTrimmedString;
-    case INST_STR_TRIM:
+    TEBC_CASE(INST_STR_TRIM):
 	valuePtr = OBJ_UNDER_TOS;	/* String */
 	value2Ptr = OBJ_AT_TOS;		/* TrimSet */
 	string2 = Tcl_GetStringFromObj(value2Ptr, &length2);
@@ -5651,7 +6293,7 @@ TEBCresume(
 	}
     }
 
-    case INST_REGEXP:
+    TEBC_CASE(INST_REGEXP):
 	cflags = TclGetInt1AtPtr(pc+1); /* RE compile flages like NOCASE */
 	valuePtr = OBJ_AT_TOS;		/* String */
 	value2Ptr = OBJ_UNDER_TOS;	/* Pattern */
@@ -5697,7 +6339,7 @@ TEBCresume(
 	int type1, type2;
 	Tcl_WideInt w1, w2, wResult;
 
-    case INST_NUM_TYPE:
+    TEBC_CASE(INST_NUM_TYPE):
 	if (GetNumberFromObj(NULL, OBJ_AT_TOS, &ptr1, &type1) != TCL_OK) {
 	    type1 = 0;
 	}
@@ -5705,12 +6347,13 @@ TEBCresume(
 	TRACE(("\"%.20s\" => %d\n", O2S(OBJ_AT_TOS), type1));
 	NEXT_INST_F(1, 1, 1);
 
-    case INST_EQ:
-    case INST_NEQ:
-    case INST_LT:
-    case INST_GT:
-    case INST_LE:
-    case INST_GE: {
+    TEBC_CASE(INST_EQ):
+    TEBC_CASE(INST_NEQ):
+    TEBC_CASE(INST_LT):
+    TEBC_CASE(INST_GT):
+    TEBC_CASE(INST_LE):
+    TEBC_CASE(INST_GE):
+    compareValues: {
 	int iResult = 0, compare = 0;
 
 	value2Ptr = OBJ_AT_TOS;
@@ -5737,9 +6380,23 @@ TEBCresume(
 	     * NaN arg: NaN != to everything, other compares are false.
 	     */
 
-	    iResult = (*pc == INST_NEQ);
+	    iResult = (inst == INST_NEQ);
 	    goto foundResult;
 	}
+
+	/*
+	 * Type feedback: a comparison that sees two integers or two doubles
+	 * turns itself into the specialized instruction for them. The fused
+	 * compare-and-jump instructions handing over to us keep their opcode.
+	 */
+
+	if ((type1 == type2) && (*pc == inst) && !IS_GENERIC_SITE()) {
+	    if (type1 == TCL_NUMBER_INT) {
+		REWRITE_INST(inst + (INST_EQ_INT - INST_EQ));
+	    } else if (type1 == TCL_NUMBER_DOUBLE) {
+		REWRITE_INST(inst + (INST_EQ_DBL - INST_EQ));
+	    }
+	}
 	if (valuePtr == value2Ptr) {
 	    compare = MP_EQ;
 	    goto convertComparison;
@@ -5757,7 +6414,7 @@ TEBCresume(
 	 */
 
     convertComparison:
-	switch (*pc) {
+	switch (inst) {
 	case INST_EQ:
 	    iResult = (compare == MP_EQ);
 	    break;
@@ -5788,12 +6445,198 @@ TEBCresume(
 	JUMP_PEEPHOLE_F(iResult, 1, 2);
     }
 
-    case INST_MOD:
-    case INST_LSHIFT:
-    case INST_RSHIFT:
-    case INST_BITOR:
-    case INST_BITXOR:
-    case INST_BITAND:
+    TEBC_CASE(INST_EQ_JUMP):
+    TEBC_CASE(INST_NEQ_JUMP):
+    TEBC_CASE(INST_LT_JUMP):
+    TEBC_CASE(INST_GT_JUMP):
+    TEBC_CASE(INST_LE_JUMP):
+    TEBC_CASE(INST_GE_JUMP):
+    TEBC_CASE(INST_EQ_INT):
+    TEBC_CASE(INST_NEQ_INT):
+    TEBC_CASE(INST_LT_INT):
+    TEBC_CASE(INST_GT_INT):
+    TEBC_CASE(INST_LE_INT):
+    TEBC_CASE(INST_GE_INT): {
+	int iResult = 0;
+
+	/*
+	 * Superinstructions covering a comparison and the conditional jump
+	 * that follows it, and comparisons specialized for integers. Two
+	 * integers are compared right here; everything else is handed to the
+	 * generic comparison (which also does the jump), posing as the covered
+	 * comparison instruction. A specialized instruction whose guard fails
+	 * turns back into the generic one.
+	 */
+
+	value2Ptr = OBJ_AT_TOS;
+	valuePtr = OBJ_UNDER_TOS;
+	if (!TclHasInternalRep(valuePtr, &tclIntType.objType)
+		|| !TclHasInternalRep(value2Ptr, &tclIntType.objType)) {
+	    if (inst >= INST_EQ_INT) {
+		inst -= INST_EQ_INT - INST_EQ;
+		DEOPT_INST(inst);
+	    } else {
+		inst -= INST_EQ_JUMP - INST_EQ;
+	    }
+	    goto compareValues;
+	}
+	w1 = valuePtr->internalRep.wideValue;
+	w2 = value2Ptr->internalRep.wideValue;
+	switch (inst) {
+	case INST_EQ_JUMP:
+	case INST_EQ_INT:
+	    iResult = (w1 == w2);
+	    break;
+	case INST_NEQ_JUMP:
+	case INST_NEQ_INT:
+	    iResult = (w1 != w2);
+	    break;
+	case INST_LT_JUMP:
+	case INST_LT_INT:
+	    iResult = (w1 < w2);
+	    break;
+	case INST_GT_JUMP:
+	case INST_GT_INT:
+	    iResult = (w1 > w2);
+	    break;
+	case INST_LE_JUMP:
+	case INST_LE_INT:
+	    iResult = (w1 <= w2);
+	    break;
+	case INST_GE_JUMP:
+	case INST_GE_INT:
+	    iResult = (w1 >= w2);
+	    break;
+	}
+	TRACE(("\"%.20s\" \"%.20s\" => %d\n", O2S(valuePtr), O2S(value2Ptr),
+		iResult));
+	JUMP_PEEPHOLE_F(iResult, 1, 2);
+    }
+
+    TEBC_CASE(INST_EQ_DBL):
+    TEBC_CASE(INST_NEQ_DBL):
+    TEBC_CASE(INST_LT_DBL):
+    TEBC_CASE(INST_GT_DBL):
+    TEBC_CASE(INST_LE_DBL):
+    TEBC_CASE(INST_GE_DBL): {
+	int iResult = 0;
+	double d1, d2;
+
+	/*
+	 * Comparisons specialized for doubles. The C comparison operators
+	 * treat NaN just as Tcl does: unequal to everything.
+	 */
+
+	value2Ptr = OBJ_AT_TOS;
+	valuePtr = OBJ_UNDER_TOS;
+	if (!TclHasInternalRep(valuePtr, &tclDoubleType.objType)
+		|| !TclHasInternalRep(value2Ptr, &tclDoubleType.objType)) {
+	    inst -= INST_EQ_DBL - INST_EQ;
+	    DEOPT_INST(inst);
+	    goto compareValues;
+	}
+	d1 = valuePtr->internalRep.doubleValue;
+	d2 = value2Ptr->internalRep.doubleValue;
+	switch (inst) {
+	case INST_EQ_DBL:
+	    iResult = (d1 == d2);
+	    break;
+	case INST_NEQ_DBL:
+	    iResult = (d1 != d2);
+	    break;
+	case INST_LT_DBL:
+	    iResult = (d1 < d2);
+	    break;
+	case INST_GT_DBL:
+	    iResult = (d1 > d2);
+	    break;
+	case INST_LE_DBL:
+	    iResult = (d1 <= d2);
+	    break;
+	case INST_GE_DBL:
+	    iResult = (d1 >= d2);
+	    break;
+	}
+	TRACE(("\"%.20s\" \"%.20s\" => %d\n", O2S(valuePtr), O2S(value2Ptr),
+		iResult));
+	JUMP_PEEPHOLE_F(iResult, 1, 2);
+    }
+
+    TEBC_CASE(INST_ADD_SCALAR_LIT1):
+	value2Ptr = codePtr->objArrayPtr[TclGetUInt1AtPtr(pc+3)];
+	goto doAddScalar;
+
+    TEBC_CASE(INST_ADD_SCALAR_SCALAR1):
+	varPtr = LOCAL(TclGetUInt1AtPtr(pc+3));
+	while (TclIsVarLink(varPtr)) {
+	    varPtr = varPtr->value.linkPtr;
+	}
+	if (!TclIsVarDirectReadable(varPtr)) {
+	    goto instLoadScalar1;
+	}
+	value2Ptr = varPtr->value.objPtr;
+
+	/*
+	 * Superinstructions covering loadScalar1 + (push1 | loadScalar1) +
+	 * add + storeScalar1, that is [set v [expr {$a + b}]]. The integer
+	 * sum of untraced local variables is done here; anything else
+	 * (including overflow) runs the covered instructions instead.
+	 */
+
+    doAddScalar:
+	varPtr = LOCAL(TclGetUInt1AtPtr(pc+1));
+	while (TclIsVarLink(varPtr)) {
+	    varPtr = varPtr->value.linkPtr;
+	}
+	if (!TclIsVarDirectReadable(varPtr)) {
+	    goto instLoadScalar1;
+	}
+	valuePtr = varPtr->value.objPtr;
+	if (!TclHasInternalRep(valuePtr, &tclIntType.objType)
+		|| !TclHasInternalRep(value2Ptr, &tclIntType.objType)) {
+	    goto instLoadScalar1;
+	}
+	w1 = valuePtr->internalRep.wideValue;
+	w2 = value2Ptr->internalRep.wideValue;
+	wResult = (Tcl_WideInt)((Tcl_WideUInt)w1 + (Tcl_WideUInt)w2);
+	if (Overflowing(w1, w2, wResult)) {
+	    goto instLoadScalar1;
+	}
+	varPtr = LOCAL(TclGetUInt1AtPtr(pc+6));
+	while (TclIsVarLink(varPtr)) {
+	    varPtr = varPtr->value.linkPtr;
+	}
+	if (!TclIsVarDirectWritable(varPtr)) {
+	    goto instLoadScalar1;
+	}
+	TRACE(("%u <- %" TCL_LL_MODIFIER "d + %" TCL_LL_MODIFIER "d => ",
+		TclGetUInt1AtPtr(pc+6), w1, w2));
+	objPtr = varPtr->value.objPtr;
+	if (objPtr != NULL && !Tcl_IsShared(objPtr)) {
+	    TclSetIntObj(objPtr, wResult);
+	    objResultPtr = objPtr;
+	} else {
+	    TclNewIntObj(objResultPtr, wResult);
+	    Tcl_IncrRefCount(objResultPtr);
+	    varPtr->value.objPtr = objResultPtr;
+	    if (objPtr != NULL) {
+		TclDecrRefCount(objPtr);
+	    }
+	}
+	TRACE_APPEND(("%.30s\n", O2S(objResultPtr)));
+#ifndef TCL_COMPILE_DEBUG
+	if (*(pc+7) == INST_POP) {
+	    NEXT_INST_F(8, 0, 0);
+	}
+#endif
+	NEXT_INST_F(7, 0, 1);
+
+    TEBC_CASE(INST_MOD):
+    TEBC_CASE(INST_LSHIFT):
+    TEBC_CASE(INST_RSHIFT):
+    TEBC_CASE(INST_BITOR):
+    TEBC_CASE(INST_BITXOR):
+    TEBC_CASE(INST_BITAND):
 	value2Ptr = OBJ_AT_TOS;
 	valuePtr = OBJ_UNDER_TOS;
 
@@ -6010,11 +6853,12 @@ TEBCresume(
 	    NEXT_INST_F(1, 2, 1);
 	}
 
-    case INST_EXPON:
-    case INST_ADD:
-    case INST_SUB:
-    case INST_DIV:
-    case INST_MULT:
+    TEBC_CASE(INST_EXPON):
+    TEBC_CASE(INST_ADD):
+    TEBC_CASE(INST_SUB):
+    TEBC_CASE(INST_DIV):
+    TEBC_CASE(INST_MULT):
+    arithmeticValues:
 	value2Ptr = OBJ_AT_TOS;
 	valuePtr = OBJ_UNDER_TOS;
 
@@ -6061,6 +6905,19 @@ TEBCresume(
 	}
 #endif
 
+	/*
+	 * Type feedback: an operation that sees two integers or two doubles
+	 * turns itself into the specialized instruction for them.
+	 */
+
+	if ((type1 == type2) && (inst != INST_EXPON) && !IS_GENERIC_SITE()) {
+	    if ((type1 == TCL_NUMBER_INT) && (inst != INST_DIV)) {
+		REWRITE_INST(inst + (INST_ADD_INT - INST_ADD));
+	    } else if (type1 == TCL_NUMBER_DOUBLE) {
+		REWRITE_INST(inst + (INST_ADD_DBL - INST_ADD));
+	    }
+	}
+
 	/*
 	 * Handle (long,long) arithmetic as best we can without going out to
 	 * an external function.
@@ -6070,7 +6927,7 @@ TEBCresume(
 	    w1 = *((const Tcl_WideInt *)ptr1);
 	    w2 = *((const Tcl_WideInt *)ptr2);
 
-	    switch (*pc) {
+	    switch (inst) {
 	    case INST_ADD:
 		wResult = (Tcl_WideInt)((Tcl_WideUInt)w1 + (Tcl_WideUInt)w2);
 		/*
@@ -6154,7 +7011,7 @@ TEBCresume(
 
     overflow:
 	TRACE(("%s %s => ", O2S(valuePtr), O2S(value2Ptr)));
-	objResultPtr = ExecuteExtendedBinaryMathOp(interp, *pc, &TCONST(0),
+	objResultPtr = ExecuteExtendedBinaryMathOp(interp, inst, &TCONST(0),
 		valuePtr, value2Ptr);
 	if (objResultPtr == DIVIDED_BY_ZERO) {
 	    TRACE_APPEND(("DIVIDE BY ZERO\n"));
@@ -6176,7 +7033,116 @@ TEBCresume(
 	    NEXT_INST_F(1, 2, 1);
 	}
 
-    case INST_LNOT: {
+    TEBC_CASE(INST_ADD_INT):
+    TEBC_CASE(INST_SUB_INT):
+    TEBC_CASE(INST_MULT_INT):
+	/*
+	 * Arithmetic specialized for integers. Anything else, including
+	 * results that would not fit, turns the instruction back into the
+	 * generic one, which then does the work.
+	 */
+
+	value2Ptr = OBJ_AT_TOS;
+	valuePtr = OBJ_UNDER_TOS;
+	if (!TclHasInternalRep(valuePtr, &tclIntType.objType)
+		|| !TclHasInternalRep(value2Ptr, &tclIntType.objType)) {
+	    goto deoptIntArithmetic;
+	}
+	w1 = valuePtr->internalRep.wideValue;
+	w2 = value2Ptr->internalRep.wideValue;
+	switch (inst) {
+	case INST_ADD_INT:
+	    wResult = (Tcl_WideInt)((Tcl_WideUInt)w1 + (Tcl_WideUInt)w2);
+	    if (Overflowing(w1, w2, wResult)) {
+		goto deoptIntArithmetic;
+	    }
+	    break;
+	case INST_SUB_INT:
+	    wResult = (Tcl_WideInt)((Tcl_WideUInt)w1 - (Tcl_WideUInt)w2);
+	    if (Overflowing(w1, ~w2, wResult)) {
+		goto deoptIntArithmetic;
+	    }
+	    break;
+	default:
+	    if ((w1 > INT_MAX) || (w1 < INT_MIN)
+		    || (w2 > INT_MAX) || (w2 < INT_MIN)) {
+		goto deoptIntArithmetic;
+	    }
+	    wResult = w1 * w2;
+	    break;
+	}
+	TRACE(("%s %s => ", O2S(valuePtr), O2S(value2Ptr)));
+	if (Tcl_IsShared(valuePtr)) {
+	    TclNewIntObj(objResultPtr, wResult);
+	    TRACE_APPEND(("%s\n", O2S(objResultPtr)));
+	    NEXT_INST_F(1, 2, 1);
+	}
+	TclSetIntObj(valuePtr, wResult);
+	TRACE_APPEND(("%s\n", O2S(valuePtr)));
+	NEXT_INST_F(1, 1, 0);
+
+    deoptIntArithmetic:
+	inst -= INST_ADD_INT - INST_ADD;
+	DEOPT_INST(inst);
+	goto arithmeticValues;
+
+    TEBC_CASE(INST_ADD_DBL):
+    TEBC_CASE(INST_SUB_DBL):
+    TEBC_CASE(INST_MULT_DBL):
+    TEBC_CASE(INST_DIV_DBL): {
+	double d1, d2, dResult;
+
+	/*
+	 * Arithmetic specialized for doubles. Anything else, including
+	 * division by zero and NaN results (errors), turns the instruction
+	 * back into the generic one, which then does the work.
+	 */
+
+	value2Ptr = OBJ_AT_TOS;
+	valuePtr = OBJ_UNDER_TOS;
+	if (!TclHasInternalRep(valuePtr, &tclDoubleType.objType)
+		|| !TclHasInternalRep(value2Ptr, &tclDoubleType.objType)) {
+	    goto deoptDoubleArithmetic;
+	}
+	d1 = valuePtr->internalRep.doubleValue;
+	d2 = value2Ptr->internalRep.doubleValue;
+	switch (inst) {
+	case INST_ADD_DBL:
+	    dResult = d1 + d2;
+	    break;
+	case INST_SUB_DBL:
+	    dResult = d1 - d2;
+	    break;
+	case INST_MULT_DBL:
+	    dResult = d1 * d2;
+	    break;
+	default:
+	    if (d2 == 0.0) {
+		goto deoptDoubleArithmetic;
+	    }
+	    dResult = d1 / d2;
+	    break;
+	}
+	if (isnan(dResult)) {
+	    goto deoptDoubleArithmetic;
+	}
+	TRACE(("%s %s => ", O2S(valuePtr), O2S(value2Ptr)));
+	if (Tcl_IsShared(valuePtr)) {
+	    TclNewDoubleObj(objResultPtr, dResult);
+	    TRACE_APPEND(("%s\n", O2S(objResultPtr)));
+	    NEXT_INST_F(1, 2, 1);
+	}
+	TclSetDoubleObj(valuePtr, dResult);
+	TRACE_APPEND(("%s\n", O2S(valuePtr)));
+	NEXT_INST_F(1, 1, 0);
+    }
+
+    deoptDoubleArithmetic:
+	inst -= INST_ADD_DBL - INST_ADD;
+	DEOPT_INST(inst);
+	goto arithmeticValues;
+
+    TEBC_CASE(INST_LNOT): {
 	int b;
 
 	valuePtr = OBJ_AT_TOS;
@@ -6197,7 +7163,7 @@ TEBCresume(
 	NEXT_INST_F(1, 1, 1);
     }
 
-    case INST_BITNOT:
+    TEBC_CASE(INST_BITNOT):
 	valuePtr = OBJ_AT_TOS;
 	TRACE(("\"%.20s\" => ", O2S(valuePtr)));
 	if ((GetNumberFromObj(NULL, valuePtr, &ptr1, &type1) != TCL_OK)
@@ -6233,7 +7199,7 @@ TEBCresume(
 	    NEXT_INST_F(1, 0, 0);
 	}
 
-    case INST_UMINUS:
+    TEBC_CASE(INST_UMINUS):
 	valuePtr = OBJ_AT_TOS;
 	TRACE(("\"%.20s\" => ", O2S(valuePtr)));
 	if ((GetNumberFromObj(NULL, valuePtr, &ptr1, &type1) != TCL_OK)
@@ -6274,8 +7240,8 @@ TEBCresume(
 	    NEXT_INST_F(1, 0, 0);
 	}
 
-    case INST_UPLUS:
-    case INST_TRY_CVT_TO_NUMERIC:
+    TEBC_CASE(INST_UPLUS):
+    TEBC_CASE(INST_TRY_CVT_TO_NUMERIC):
 	/*
 	 * Try to convert the topmost stack object to numeric object. This is
 	 * done in order to support [expr]'s policy of interpreting operands
@@ -6366,7 +7332,7 @@ TEBCresume(
      * -----------------------------------------------------------------
      */
 
-    case INST_TRY_CVT_TO_BOOLEAN:
+    TEBC_CASE(INST_TRY_CVT_TO_BOOLEAN):
 	valuePtr = OBJ_AT_TOS;
 	if (TclHasInternalRep(valuePtr,  &tclBooleanType.objType)) {
 	    objResultPtr = TCONST(1);
@@ -6378,7 +7344,7 @@ TEBCresume(
 	NEXT_INST_F(1, 0, 1);
     break;
 
-    case INST_BREAK:
+    TEBC_CASE(INST_BREAK):
 	/*
 	DECACHE_STACK_INFO();
 	Tcl_ResetResult(interp);
@@ -6389,7 +7355,7 @@ TEBCresume(
 	TRACE(("=> BREAK!\n"));
 	goto processExceptionReturn;
 
-    case INST_CONTINUE:
+    TEBC_CASE(INST_CONTINUE):
 	/*
 	DECACHE_STACK_INFO();
 	Tcl_ResetResult(interp);
@@ -6408,7 +7374,7 @@ TEBCresume(
 	Tcl_Size iterNum, iterMax, iterTmp;
 	Tcl_Size varIndex, valIndex, i, j;
 
-    case INST_FOREACH_START:
+    TEBC_CASE(INST_FOREACH_START):
 	/*
 	 * Initialize the data for the looping construct, pushing the
 	 * corresponding Tcl_Objs to the stack.
@@ -6480,7 +7446,7 @@ TEBCresume(
 
 	pc += 5 - infoPtr->loopCtTemp;
 
-    case INST_FOREACH_STEP:
+    TEBC_CASE(INST_FOREACH_STEP):
 	/*
 	 * "Step" a foreach loop (i.e., begin its next iteration) by assigning
 	 * the next value list element to each loop var.
@@ -6515,10 +7481,23 @@ TEBCresume(
 		numVars = varListPtr->numVars;
 
 		listPtr = OBJ_AT_DEPTH(listTmpDepth);
-		status = TclListObjGetElementsM(
-		    interp, listPtr, &listLen, &elements);
-		if (status != TCL_OK) {
-		    goto gotError;
+		if (TclHasInternalRep(listPtr, &tclPackedListType.objType)
+			|| TclHasInternalRep(listPtr,
+				&tclListViewType.objType)) {
+		    /*
+		     * Box the elements of a packed list one at a time, and
+		     * step through a list view without making its element
+		     * array.
+		     */
+
+		    listLen = ABSTRACTLIST_PROC(listPtr, lengthProc)(listPtr);
+		    elements = NULL;
+		} else {
+		    status = TclListObjGetElementsM(
+			interp, listPtr, &listLen, &elements);
+		    if (status != TCL_OK) {
+			goto gotError;
+		    }
 		}
 
 
@@ -6526,8 +7505,13 @@ TEBCresume(
 		for (j = 0;  j < numVars;  j++) {
 		    if (valIndex >= listLen) {
 			TclNewObj(valuePtr);
-		    } else {
+		    } else if (elements != NULL) {
 			valuePtr = elements[valIndex];
+		    } else if (TclHasInternalRep(listPtr,
+			    &tclListViewType.objType)) {
+			valuePtr = TclListViewObjIndex(listPtr, valIndex);
+		    } else {
+			valuePtr = TclPackedListObjIndex(listPtr, valIndex);
 		    }
 
 		    varIndex = varListPtr->varIndexes[j];
@@ -6574,7 +7558,7 @@ TEBCresume(
 	pc++;
 #endif
 
-    case INST_FOREACH_END:
+    TEBC_CASE(INST_FOREACH_END):
 	/* THIS INSTRUCTION IS ONLY CALLED AS A BREAK TARGET */
 	tmpPtr = OBJ_AT_TOS;
 	infoPtr = (ForeachInfo *)tmpPtr->internalRep.twoPtrValue.ptr1;
@@ -6582,7 +7566,7 @@ TEBCresume(
 	TRACE(("=> loop terminated\n"));
 	NEXT_INST_V(1, numLists+2, 0);
 
-    case INST_LMAP_COLLECT:
+    TEBC_CASE(INST_LMAP_COLLECT):
 	/*
 	 * This instruction is only issued by lmap. The stack is:
 	 *   - result
@@ -6599,12 +7583,14 @@ TEBCresume(
 	TRACE_APPEND(("=> appending to list at depth %" TCL_SIZE_MODIFIER "d\n", 3 + numLists));
 
 	objPtr = OBJ_AT_DEPTH(3 + numLists);
-	Tcl_ListObjAppendElement(NULL, objPtr, OBJ_AT_TOS);
+	if (!TclPackedListObjAppend(objPtr, 1, &OBJ_AT_TOS)) {
+	    Tcl_ListObjAppendElement(NULL, objPtr, OBJ_AT_TOS);
+	}
 	NEXT_INST_F(1, 1, 0);
     }
     break;
 
-    case INST_BEGIN_CATCH4:
+    TEBC_CASE(INST_BEGIN_CATCH4):
 	/*
 	 * Record start of the catch command with exception range index equal
 	 * to the operand. Push the current stack depth onto the special catch
@@ -6618,7 +7604,7 @@ TEBCresume(
 	NEXT_INST_F(5, 0, 0);
     break;
 
-    case INST_END_CATCH:
+    TEBC_CASE(INST_END_CATCH):
 	catchTop--;
 	DECACHE_STACK_INFO();
 	Tcl_ResetResult(interp);
@@ -6628,7 +7614,7 @@ TEBCresume(
 	NEXT_INST_F(1, 0, 0);
     break;
 
-    case INST_PUSH_RESULT:
+    TEBC_CASE(INST_PUSH_RESULT):
 	objResultPtr = Tcl_GetObjResult(interp);
 	TRACE_WITH_OBJ(("=> "), objResultPtr);
 
@@ -6642,13 +7628,13 @@ TEBCresume(
 	NEXT_INST_F(1, 0, -1);
     break;
 
-    case INST_PUSH_RETURN_CODE:
+    TEBC_CASE(INST_PUSH_RETURN_CODE):
 	TclNewIntObj(objResultPtr, result);
 	TRACE(("=> %u\n", result));
 	NEXT_INST_F(1, 0, 1);
     break;
 
-    case INST_PUSH_RETURN_OPTIONS:
+    TEBC_CASE(INST_PUSH_RETURN_OPTIONS):
 	DECACHE_STACK_INFO();
 	objResultPtr = Tcl_GetReturnOptions(interp, result);
 	CACHE_STACK_INFO();
@@ -6656,7 +7642,7 @@ TEBCresume(
 	NEXT_INST_F(1, 0, 1);
     break;
 
-    case INST_RETURN_CODE_BRANCH: {
+    TEBC_CASE(INST_RETURN_CODE_BRANCH): {
 	int code;
 
 	if (TclGetIntFromObj(NULL, OBJ_AT_TOS, &code) != TCL_OK) {
@@ -6685,7 +7671,7 @@ TEBCresume(
 	Tcl_DictSearch *searchPtr;
 	DictUpdateInfo *duiPtr;
 
-    case INST_DICT_VERIFY: {
+    TEBC_CASE(INST_DICT_VERIFY): {
 	Tcl_Size size;
 	dictPtr = OBJ_AT_TOS;
 	TRACE(("\"%.30s\" => ", O2S(dictPtr)));
@@ -6699,7 +7685,7 @@ TEBCresume(
     }
     break;
 
-    case INST_DICT_EXISTS: {
+    TEBC_CASE(INST_DICT_EXISTS): {
 	int found;
 
 	opnd = TclGetUInt4AtPtr(pc+1);
@@ -6731,7 +7717,7 @@ TEBCresume(
 
 	JUMP_PEEPHOLE_V(found, 5, opnd+1);
     }
-    case INST_DICT_GET:
+    TEBC_CASE(INST_DICT_GET):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	TRACE(("%u => ", opnd));
 	dictPtr = OBJ_AT_DEPTH(opnd);
@@ -6765,7 +7751,7 @@ TEBCresume(
 	}
 	TRACE_APPEND(("%.30s\n", O2S(objResultPtr)));
 	NEXT_INST_V(5, opnd+1, 1);
-    case INST_DICT_GET_DEF:
+    TEBC_CASE(INST_DICT_GET_DEF):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	TRACE(("%u => ", opnd));
 	dictPtr = OBJ_AT_DEPTH(opnd+1);
@@ -6794,9 +7780,9 @@ TEBCresume(
 	TRACE_APPEND(("%.30s\n", O2S(objResultPtr)));
 	NEXT_INST_V(5, opnd+2, 1);
 
-    case INST_DICT_SET:
-    case INST_DICT_UNSET:
-    case INST_DICT_INCR_IMM:
+    TEBC_CASE(INST_DICT_SET):
+    TEBC_CASE(INST_DICT_UNSET):
+    TEBC_CASE(INST_DICT_INCR_IMM):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	opnd2 = TclGetUInt4AtPtr(pc+5);
 
@@ -6901,8 +7887,8 @@ TEBCresume(
 	TRACE_APPEND(("\"%.30s\"\n", O2S(objResultPtr)));
 	NEXT_INST_V(9, cleanup, 1);
 
-    case INST_DICT_APPEND:
-    case INST_DICT_LAPPEND:
+    TEBC_CASE(INST_DICT_APPEND):
+    TEBC_CASE(INST_DICT_LAPPEND):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	varPtr = LOCAL(opnd);
 	while (TclIsVarLink(varPtr)) {
@@ -7040,7 +8026,7 @@ TEBCresume(
 	TRACE_APPEND(("%.30s\n", O2S(objResultPtr)));
 	NEXT_INST_F(5, 2, 1);
 
-    case INST_DICT_FIRST:
+    TEBC_CASE(INST_DICT_FIRST):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	TRACE(("%u => ", opnd));
 	dictPtr = POP_OBJECT();
@@ -7077,7 +8063,7 @@ TEBCresume(
 	Tcl_IncrRefCount(statePtr);
 	goto pushDictIteratorResult;
 
-    case INST_DICT_NEXT:
+    TEBC_CASE(INST_DICT_NEXT):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	TRACE(("%u => ", opnd));
 	statePtr = (*LOCAL(opnd)).value.objPtr;
@@ -7113,7 +8099,7 @@ TEBCresume(
 
 	JUMP_PEEPHOLE_F(done, 5, 0);
 
-    case INST_DICT_UPDATE_START:
+    TEBC_CASE(INST_DICT_UPDATE_START):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	opnd2 = TclGetUInt4AtPtr(pc+5);
 	TRACE(("%u => ", opnd));
@@ -7173,7 +8159,7 @@ TEBCresume(
 	TRACE_APPEND(("OK\n"));
 	NEXT_INST_F(9, 0, 0);
 
-    case INST_DICT_UPDATE_END:
+    TEBC_CASE(INST_DICT_UPDATE_END):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	opnd2 = TclGetUInt4AtPtr(pc+5);
 	TRACE(("%u => ", opnd));
@@ -7250,7 +8236,7 @@ TEBCresume(
 	TRACE_APPEND(("written back\n"));
 	NEXT_INST_F(9, 1, 0);
 
-    case INST_DICT_EXPAND:
+    TEBC_CASE(INST_DICT_EXPAND):
 	dictPtr = OBJ_UNDER_TOS;
 	listPtr = OBJ_AT_TOS;
 	TRACE(("\"%.30s\" \"%.30s\" =>", O2S(dictPtr), O2S(listPtr)));
@@ -7266,7 +8252,7 @@ TEBCresume(
 	TRACE_APPEND(("\"%.30s\"\n", O2S(objResultPtr)));
 	NEXT_INST_F(1, 2, 1);
 
-    case INST_DICT_RECOMBINE_STK:
+    TEBC_CASE(INST_DICT_RECOMBINE_STK):
 	keysPtr = POP_OBJECT();
 	varNamePtr = OBJ_UNDER_TOS;
 	listPtr = OBJ_AT_TOS;
@@ -7296,7 +8282,7 @@ TEBCresume(
 	TRACE_APPEND(("OK\n"));
 	NEXT_INST_F(1, 2, 0);
 
-    case INST_DICT_RECOMBINE_IMM:
+    TEBC_CASE(INST_DICT_RECOMBINE_IMM):
 	opnd = TclGetUInt4AtPtr(pc+1);
 	listPtr = OBJ_UNDER_TOS;
 	keysPtr = OBJ_AT_TOS;
@@ -7328,7 +8314,7 @@ TEBCresume(
      * -----------------------------------------------------------------
      */
 
-    case INST_CLOCK_READ:
+    TEBC_CASE(INST_CLOCK_READ):
 	{			/* Read the wall clock */
 	    Tcl_WideInt wval;
 	    Tcl_Time now;
@@ -7362,6 +8348,9 @@ TEBCresume(
 	break;
 
     default:
+#ifdef TEBC_THREADED_DISPATCH
+    instUnknown:
+#endif
 	Tcl_Panic("TclNRExecuteByteCode: unrecognized opCode %u", *pc);
     } /* end of switch on opCode */
 
@@ -9351,6 +10340,47 @@ GetExceptRangeForPc(
     return NULL;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetLastInstruction --
+ *
+ *	Given the pc of the next instruction to execute, find the instruction
+ *	that was most probably executed just before it: the one that ends at
+ *	pc. This is only used when asynchronous handlers run, so it simply
+ *	walks the code from its start.
+ *
+ * Results:
+ *	The pc of the instruction that ends at pc. If there is none, or if it
+ *	is an unconditional jump, pc can only have been reached by a jump from
+ *	elsewhere and pc itself is returned.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static const unsigned char *
+GetLastInstruction(
+    const unsigned char *pc,	/* The pc of the next instruction. */
+    ByteCode *codePtr)		/* The bytecode that pc is in. */
+{
+    const unsigned char *lastPc = codePtr->codeStart;
+    const unsigned char *nextPc;
+
+    if (pc <= lastPc) {
+	return pc;
+    }
+    while ((nextPc = lastPc + tclInstructionTable[*lastPc].numBytes) < pc) {
+	lastPc = nextPc;
+    }
+    if ((nextPc != pc) || (*lastPc == INST_JUMP1) || (*lastPc == INST_JUMP4)) {
+	return pc;
+    }
+    return lastPc;
+}
+
 /*
  *----------------------------------------------------------------------
  *
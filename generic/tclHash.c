@@ -12,6 +12,9 @@
  */
 
 #include "tclInt.h"
+#ifdef _WIN32
+#   include <ntsecapi.h>
+#endif
 
 /*
  * When there are this many entries per bucket, on average, rebuild the hash
@@ -30,6 +33,41 @@
 #define RANDOM_INDEX(tablePtr, i) \
     ((((i)*(size_t)1103515245) >> (tablePtr)->downShift) & (tablePtr)->mask)
 
+/*
+ * Tables with at least this many buckets are not rebuilt all at once. The
+ * new bucket array is allocated, but the entries stay in the old one and are
+ * moved over REHASH_STEP old buckets at a time, each time an entry is added.
+ * This spreads the cost of growing a large table over later insertions
+ * rather than stopping one of them for a long time. Until all entries have
+ * been moved, an entry is in the old array when its old bucket has not been
+ * moved yet, and in the new array otherwise.
+ *
+ * The entries of old bucket i all go to new buckets 4i to 4i+3 when the
+ * index is randomized, or to buckets i + k*oldSize otherwise. Those new
+ * buckets are only initialized when old bucket i is moved, so a new bucket
+ * array is never cleared all at once either.
+ *
+ * While that is going on, the bucket array is never the static one, so the
+ * static buckets, which are then unused, hold the state of the move: the
+ * old bucket array, its mask, the number of old buckets already moved, and
+ * its downShift, or -1 if the index is not randomized.
+ */
+
+#define REHASH_MIN_BUCKETS	4096
+#define REHASH_STEP		4
+
+#define REHASH_PENDING(tablePtr) \
+    ((tablePtr)->buckets != (tablePtr)->staticBuckets \
+	    && (tablePtr)->staticBuckets[0] != NULL)
+#define REHASH_OLD_BUCKETS(tablePtr) \
+    ((Tcl_HashEntry **) (tablePtr)->staticBuckets[0])
+#define REHASH_OLD_MASK(tablePtr) \
+    PTR2UINT((tablePtr)->staticBuckets[1])
+#define REHASH_MOVED(tablePtr) \
+    PTR2UINT((tablePtr)->staticBuckets[2])
+#define REHASH_OLD_SHIFT(tablePtr) \
+    ((int) PTR2INT((tablePtr)->staticBuckets[3]))
+
 /*
  * Prototypes for the array hash key methods.
  */
@@ -58,6 +96,11 @@ static Tcl_HashEntry *	CreateHashEntry(Tcl_HashTable *tablePtr, const char *key,
 			    int *newPtr);
 static Tcl_HashEntry *	FindHashEntry(Tcl_HashTable *tablePtr, const char *key);
 static void		RebuildTable(Tcl_HashTable *tablePtr);
+static Tcl_HashEntry **	RehashBucket(Tcl_HashTable *tablePtr,
+			    TCL_HASH_TYPE hash, Tcl_HashEntry **bucketPtr);
+static int		RehashMoved(Tcl_HashTable *tablePtr, Tcl_Size index);
+static void		RehashStep(Tcl_HashTable *tablePtr,
+			    const Tcl_HashKeyType *typePtr, size_t count);
 
 const Tcl_HashKeyType tclArrayHashKeyType = {
     TCL_HASH_KEY_TYPE_VERSION,		/* version */
@@ -245,7 +288,7 @@ CreateHashEntry(
     int *newPtr)		/* Store info here telling whether a new entry
 				 * was created. */
 {
-    Tcl_HashEntry *hPtr;
+    Tcl_HashEntry *hPtr, **bucketPtr;
     const Tcl_HashKeyType *typePtr;
     TCL_HASH_TYPE hash, index;
 
@@ -271,6 +314,10 @@ CreateHashEntry(
 	hash = PTR2UINT(key);
 	index = RANDOM_INDEX(tablePtr, hash);
     }
+    bucketPtr = &tablePtr->buckets[index];
+    if (REHASH_PENDING(tablePtr)) {
+	bucketPtr = RehashBucket(tablePtr, hash, bucketPtr);
+    }
 
     /*
      * Search all of the entries in the appropriate bucket.
@@ -279,8 +326,7 @@ CreateHashEntry(
     if (typePtr->compareKeysProc) {
 	Tcl_CompareHashKeysProc *compareKeysProc = typePtr->compareKeysProc;
 
-	for (hPtr = tablePtr->buckets[index]; hPtr != NULL;
-		hPtr = hPtr->nextPtr) {
+	for (hPtr = *bucketPtr; hPtr != NULL; hPtr = hPtr->nextPtr) {
 	    if (hash != hPtr->hash) {
 		continue;
 	    }
@@ -295,8 +341,7 @@ CreateHashEntry(
 	    }
 	}
     } else {
-	for (hPtr = tablePtr->buckets[index]; hPtr != NULL;
-		hPtr = hPtr->nextPtr) {
+	for (hPtr = *bucketPtr; hPtr != NULL; hPtr = hPtr->nextPtr) {
 	    if (hash != hPtr->hash) {
 		continue;
 	    }
@@ -328,15 +373,18 @@ CreateHashEntry(
 
     hPtr->tablePtr = tablePtr;
     hPtr->hash = hash;
-    hPtr->nextPtr = tablePtr->buckets[index];
-    tablePtr->buckets[index] = hPtr;
+    hPtr->nextPtr = *bucketPtr;
+    *bucketPtr = hPtr;
     tablePtr->numEntries++;
 
     /*
-     * If the table has exceeded a decent size, rebuild it with many more
-     * buckets.
+     * Carry on moving entries to a new bucket array, or if the table has
+     * exceeded a decent size, rebuild it with many more buckets.
      */
 
+    if (REHASH_PENDING(tablePtr)) {
+	RehashStep(tablePtr, typePtr, REHASH_STEP);
+    }
     if (tablePtr->numEntries >= tablePtr->rebuildSize) {
 	RebuildTable(tablePtr);
     }
@@ -392,6 +440,9 @@ Tcl_DeleteHashEntry(
     }
 
     bucketPtr = &tablePtr->buckets[index];
+    if (REHASH_PENDING(tablePtr)) {
+	bucketPtr = RehashBucket(tablePtr, entryPtr->hash, bucketPtr);
+    }
 
     if (*bucketPtr == entryPtr) {
 	*bucketPtr = entryPtr->nextPtr;
@@ -452,9 +503,13 @@ Tcl_DeleteHashTable(
     }
 
     /*
-     * Free up all the entries in the table.
+     * Free up all the entries in the table, after moving any still in an old
+     * bucket array.
      */
 
+    if (REHASH_PENDING(tablePtr)) {
+	RehashStep(tablePtr, typePtr, REHASH_OLD_MASK(tablePtr) + 1);
+    }
     for (i = 0; i < tablePtr->numBuckets; i++) {
 	hPtr = tablePtr->buckets[i];
 	while (hPtr != NULL) {
@@ -532,7 +587,8 @@ Tcl_FirstHashEntry(
  *
  * Results:
  *	The return value is the next entry in the hash table being enumerated,
- *	or NULL if the end of the table is reached.
+ *	or NULL if the end of the table is reached. Entries not yet moved out
+ *	of an old bucket array come after all the others.
  *
  * Side effects:
  *	None.
@@ -552,11 +608,18 @@ Tcl_NextHashEntry(
     Tcl_HashTable *tablePtr = searchPtr->tablePtr;
 
     while (searchPtr->nextEntryPtr == NULL) {
-	if (searchPtr->nextIndex >= tablePtr->numBuckets) {
+	if (searchPtr->nextIndex < tablePtr->numBuckets) {
+	    if (RehashMoved(tablePtr, searchPtr->nextIndex)) {
+		searchPtr->nextEntryPtr =
+			tablePtr->buckets[searchPtr->nextIndex];
+	    }
+	} else if (REHASH_PENDING(tablePtr) && searchPtr->nextIndex
+		- tablePtr->numBuckets <= (Tcl_Size) REHASH_OLD_MASK(tablePtr)) {
+	    searchPtr->nextEntryPtr = REHASH_OLD_BUCKETS(tablePtr)[
+		    searchPtr->nextIndex - tablePtr->numBuckets];
+	} else {
 	    return NULL;
 	}
-	searchPtr->nextEntryPtr =
-		tablePtr->buckets[searchPtr->nextIndex];
 	searchPtr->nextIndex++;
     }
     hPtr = searchPtr->nextEntryPtr;
@@ -570,7 +633,8 @@ Tcl_NextHashEntry(
  * Tcl_HashStats --
  *
  *	Return statistics describing the layout of the hash table in its hash
- *	buckets.
+ *	buckets. Buckets of an old array that entries are still being moved
+ *	out of are counted too.
  *
  * Results:
  *	The return value is a malloc-ed string containing information about
@@ -587,12 +651,16 @@ Tcl_HashStats(
     Tcl_HashTable *tablePtr)	/* Table for which to produce stats. */
 {
 #define NUM_COUNTERS 10
-    Tcl_Size i;
+    Tcl_Size i, numBuckets = tablePtr->numBuckets, numOld = 0;
     TCL_HASH_TYPE count[NUM_COUNTERS], overflow, j;
     double average, tmp;
     Tcl_HashEntry *hPtr;
     char *result, *p;
 
+    if (REHASH_PENDING(tablePtr)) {
+	numOld = REHASH_OLD_MASK(tablePtr) + 1;
+    }
+
     /*
      * Compute a histogram of bucket usage.
      */
@@ -602,9 +670,16 @@ Tcl_HashStats(
     }
     overflow = 0;
     average = 0.0;
-    for (i = 0; i < tablePtr->numBuckets; i++) {
+    for (i = 0; i < numBuckets + numOld; i++) {
 	j = 0;
-	for (hPtr = tablePtr->buckets[i]; hPtr != NULL; hPtr = hPtr->nextPtr) {
+	if (i >= numBuckets) {
+	    hPtr = REHASH_OLD_BUCKETS(tablePtr)[i - numBuckets];
+	} else if (RehashMoved(tablePtr, i)) {
+	    hPtr = tablePtr->buckets[i];
+	} else {
+	    continue;
+	}
+	for (; hPtr != NULL; hPtr = hPtr->nextPtr) {
 	    j++;
 	}
 	if (j < NUM_COUNTERS) {
@@ -622,7 +697,7 @@ Tcl_HashStats(
      * Print out the histogram and a few other pieces of information.
      */
 
-    result = (char *)Tcl_Alloc((NUM_COUNTERS * 60) + 300);
+    result = (char *)Tcl_Alloc((NUM_COUNTERS * 60) + 360);
     snprintf(result, 60, "%" TCL_Z_MODIFIER "u entries in table, %" TCL_Z_MODIFIER "u buckets\n",
 	    tablePtr->numEntries, tablePtr->numBuckets);
     p = result + strlen(result);
@@ -635,6 +710,11 @@ Tcl_HashStats(
 	    NUM_COUNTERS, overflow);
     p += strlen(p);
     snprintf(p, 60, "average search distance for entry: %.1f", average);
+    if (numOld) {
+	p += strlen(p);
+	snprintf(p, 60, "\nold buckets still to be rehashed: %" TCL_Z_MODIFIER "u",
+		numOld - REHASH_MOVED(tablePtr));
+    }
     return result;
 }
 
@@ -819,47 +899,203 @@ HashStringKey(
     void *keyPtr)			/* Key from which to compute hash value. */
 {
     const char *string = (const char *)keyPtr;
-    TCL_HASH_TYPE result;
-    char c;
 
-    /*
-     * I tried a zillion different hash functions and asked many other people
-     * for advice. Many people had their own favorite functions, all
-     * different, but no-one had much idea why they were good ones. I chose
-     * the one below (multiply by 9 and add new character) because of the
-     * following reasons:
-     *
-     * 1. Multiplying by 10 is perfect for keys that are decimal strings, and
-     *    multiplying by 9 is just about as good.
-     * 2. Times-9 is (shift-left-3) plus (old). This means that each
-     *    character's bits hang around in the low-order bits of the hash value
-     *    for ever, plus they spread fairly rapidly up to the high-order bits
-     *    to fill out the hash value. This seems works well both for decimal
-     *    and non-decimal strings, but isn't strong against maliciously-chosen
-     *    keys.
-     *
-     * Note that this function is very weak against malicious strings; it's
-     * very easy to generate multiple keys that have the same hashcode. On the
-     * other hand, that hardly ever actually occurs and this function *is*
-     * very cheap, even by comparison with industry-standard hashes like FNV.
-     * If real strength of hash is required though, use a custom hash based on
-     * Bob Jenkins's lookup3(), but be aware that it's significantly slower.
-     * Since Tcl command and namespace names are usually reasonably-named (the
-     * main use for string hashes in modern Tcl) speed is far more important
-     * than strength.
-     *
-     * See also HashString in tclLiteral.c.
-     * See also TclObjHashKey in tclObj.c.
-     *
-     * See [tcl-Feature Request #2958832]
-     */
+    return TclHashBytes(string, strlen(string));
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclHashBytes --
+ *
+ *	Compute a one-word summary of a sequence of bytes. This is the hash of
+ *	string keys, of Tcl_Obj keys (on their string representation) and of
+ *	literals, so that all of them behave alike.
+ *
+ *	The function is a simplified wyhash: the bytes are read eight at a time
+ *	and folded together with 64x64->128 bit multiplications, which spread
+ *	every input bit over the whole result. Earlier versions multiplied by
+ *	9 and added each byte, which was cheap but made it very easy to
+ *	generate many keys with the same hash value, for instance from data
+ *	received over the network that ends up as array keys. The hash is
+ *	seeded with random bytes read once per process, so colliding keys
+ *	cannot be computed in advance. As a consequence the order in which
+ *	[array names] and the like return their results changes from run to
+ *	run; setting the TCL_HASH_SEED environment variable to an integer
+ *	fixes the seed to that integer instead.
+ *
+ *	Hash values are only ever compared within one process; they are not
+ *	stored or transferred anywhere.
+ *
+ * Results:
+ *	The return value is a one-word summary of the bytes.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+#define HASH_P0 0xa0761d6478bd642fULL
+#define HASH_P1 0xe7037ed1a0b428dbULL
+#define HASH_P2 0x8ebc6af09c88c6e3ULL
+
+/*
+ * The seed used by TclHashBytes, set by HashSeed the first time anything is
+ * hashed.
+ */
+
+static Tcl_WideUInt hashSeed = 0;
+static int hashSeeded = 0;
+TCL_DECLARE_MUTEX(hashSeedMutex)
 
-    if ((result = UCHAR(*string)) != 0) {
-	while ((c = *++string) != 0) {
-	    result += (result << 3) + UCHAR(c);
+static inline Tcl_WideUInt
+HashMix(
+    Tcl_WideUInt a,
+    Tcl_WideUInt b)
+{
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 r = (unsigned __int128) a * b;
+
+    return (Tcl_WideUInt) r ^ (Tcl_WideUInt) (r >> 64);
+#else
+    Tcl_WideUInt ah = a >> 32, al = a & 0xFFFFFFFF;
+    Tcl_WideUInt bh = b >> 32, bl = b & 0xFFFFFFFF;
+    Tcl_WideUInt hh = ah * bh, hl = ah * bl, lh = al * bh, ll = al * bl;
+    Tcl_WideUInt mid = (ll >> 32) + (hl & 0xFFFFFFFF) + (lh & 0xFFFFFFFF);
+
+    return ((ll & 0xFFFFFFFF) | (mid << 32))
+	    ^ (hh + (hl >> 32) + (lh >> 32) + (mid >> 32));
+#endif
+}
+
+static inline Tcl_WideUInt
+HashRead8(
+    const unsigned char *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline Tcl_WideUInt
+HashRead4(
+    const unsigned char *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * HashSeed --
+ *
+ *	Chooses the seed of TclHashBytes: the value of the TCL_HASH_SEED
+ *	environment variable if that is an integer, random bytes otherwise.
+ *	The random bytes come from RtlGenRandom on Windows and /dev/urandom
+ *	elsewhere. They are mixed with the time and the address of hashSeed,
+ *	which also stand in for them should the random source fail.
+ *
+ *	This cannot use the Tcl channel, environment or clock machinery, which
+ *	hash strings or may not be set up yet.
+ *
+ * Results:
+ *	The seed.
+ *
+ * Side effects:
+ *	Sets hashSeed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_WideUInt
+HashSeed(void)
+{
+    const char *value;
+    char *end;
+    Tcl_WideUInt seed, bytes;
+#ifndef _WIN32
+    int fd;
+#endif
+
+    Tcl_MutexLock(&hashSeedMutex);
+    if (hashSeeded) {
+	Tcl_MutexUnlock(&hashSeedMutex);
+	return hashSeed;
+    }
+    value = getenv("TCL_HASH_SEED");
+    if ((value != NULL) && (*value != '\0')) {
+	errno = 0;
+	seed = strtoull(value, &end, 0);
+	if ((errno == 0) && (*end == '\0')) {
+	    goto done;
 	}
     }
-    return result;
+
+    seed = ((Tcl_WideUInt) time(NULL) << 32) ^ (Tcl_WideUInt) clock()
+	    ^ (Tcl_WideUInt) PTR2UINT(&hashSeed);
+#ifdef _WIN32
+    if (RtlGenRandom(&bytes, sizeof(bytes))) {
+	seed ^= bytes;
+    }
+#else
+    fd = open("/dev/urandom", O_RDONLY);
+    if (fd >= 0) {
+	if (read(fd, &bytes, sizeof(bytes)) == (ssize_t) sizeof(bytes)) {
+	    seed ^= bytes;
+	}
+	close(fd);
+    }
+#endif /* _WIN32 */
+    seed = HashMix(seed ^ HASH_P0, HASH_P1);
+
+  done:
+    hashSeed = seed;
+    hashSeeded = 1;
+    Tcl_MutexUnlock(&hashSeedMutex);
+    return seed;
+}
+
+TCL_HASH_TYPE
+TclHashBytes(
+    const char *bytes,		/* Bytes to compute the hash value of. */
+    size_t length)		/* Number of bytes. */
+{
+    const unsigned char *p = (const unsigned char *) bytes;
+    Tcl_WideUInt seed = hashSeeded ? hashSeed : HashSeed();
+    Tcl_WideUInt a, b;
+
+    if (length <= 16) {
+	if (length >= 4) {
+	    size_t mid = (length >> 3) << 2;
+
+	    a = (HashRead4(p) << 32) | HashRead4(p + mid);
+	    b = (HashRead4(p + length - 4) << 32)
+		    | HashRead4(p + length - 4 - mid);
+	} else if (length > 0) {
+	    a = ((Tcl_WideUInt) p[0] << 16) | ((Tcl_WideUInt) p[length >> 1] << 8)
+		    | p[length - 1];
+	    b = 0;
+	} else {
+	    a = b = 0;
+	}
+    } else {
+	size_t i = length;
+
+	while (i > 16) {
+	    seed = HashMix(HashRead8(p) ^ HASH_P1, HashRead8(p + 8) ^ seed);
+	    p += 16;
+	    i -= 16;
+	}
+	a = HashRead8(p + i - 16);
+	b = HashRead8(p + i - 8);
+    }
+    return (TCL_HASH_TYPE) HashMix(HASH_P1 ^ length,
+	    HashMix(a ^ HASH_P1, b ^ seed ^ HASH_P2));
 }
 
 /*
@@ -922,7 +1158,8 @@ BogusCreate(
  *
  *	This function is invoked when the ratio of entries to hash buckets
  *	becomes too large. It creates a new table with a larger bucket array
- *	and moves all of the entries into the new table.
+ *	and moves all of the entries into the new table, or for a large table,
+ *	arranges for RehashStep to move them a few at a time.
  *
  * Results:
  *	None.
@@ -942,6 +1179,8 @@ RebuildTable(
     Tcl_HashEntry **oldChainPtr, **newChainPtr;
     Tcl_HashEntry *hPtr;
     const Tcl_HashKeyType *typePtr;
+    size_t oldMask = tablePtr->mask;
+    int oldDownShift = tablePtr->downShift;
 
     /* Avoid outgrowing capability of the memory allocators */
     if (oldSize > UINT_MAX / (4 * sizeof(Tcl_HashEntry *))) {
@@ -960,6 +1199,15 @@ RebuildTable(
 	typePtr = &tclArrayHashKeyType;
     }
 
+    /*
+     * Finish moving entries out of the array before this one, if that is
+     * still going on.
+     */
+
+    if (REHASH_PENDING(tablePtr)) {
+	RehashStep(tablePtr, typePtr, REHASH_OLD_MASK(tablePtr) + 1);
+    }
+
     /*
      * Allocate and initialize the new bucket array, and set up hashing
      * constants for new array size.
@@ -973,16 +1221,37 @@ RebuildTable(
 	tablePtr->buckets =
 		(Tcl_HashEntry **)Tcl_Alloc(tablePtr->numBuckets * sizeof(Tcl_HashEntry *));
     }
-    for (count = tablePtr->numBuckets, newChainPtr = tablePtr->buckets;
-	    count > 0; count--, newChainPtr++) {
-	*newChainPtr = NULL;
-    }
     tablePtr->rebuildSize *= 4;
     if (tablePtr->downShift > 1) {
 	tablePtr->downShift -= 2;
     }
     tablePtr->mask = (tablePtr->mask << 2) + 3;
 
+    /*
+     * Leave the entries of a large table where they are for RehashStep to
+     * move, unless the old array is empty or the randomized index cannot
+     * shift any further.
+     */
+
+    if (oldSize >= REHASH_MIN_BUCKETS && tablePtr->numEntries > 0) {
+	if (typePtr->hashKeyProc != NULL
+		&& !(typePtr->flags & TCL_HASH_KEY_RANDOMIZE_HASH)) {
+	    oldDownShift = -1;
+	}
+	if (oldDownShift != tablePtr->downShift) {
+	    tablePtr->staticBuckets[0] = (Tcl_HashEntry *) oldBuckets;
+	    tablePtr->staticBuckets[1] = (Tcl_HashEntry *) UINT2PTR(oldMask);
+	    tablePtr->staticBuckets[2] = (Tcl_HashEntry *) UINT2PTR(0);
+	    tablePtr->staticBuckets[3] =
+		    (Tcl_HashEntry *) INT2PTR(oldDownShift);
+	    return;
+	}
+    }
+    for (count = tablePtr->numBuckets, newChainPtr = tablePtr->buckets;
+	    count > 0; count--, newChainPtr++) {
+	*newChainPtr = NULL;
+    }
+
     /*
      * Rehash all of the existing entries into the new bucket array.
      */
@@ -1014,6 +1283,149 @@ RebuildTable(
     }
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * RehashBucket --
+ *
+ *	Find the bucket for a hash value in a table whose entries are being
+ *	moved to a new bucket array.
+ *
+ * Results:
+ *	The bucket in the old array if the entries of that bucket have not
+ *	been moved yet, otherwise bucketPtr, the bucket in the new array.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_HashEntry **
+RehashBucket(
+    Tcl_HashTable *tablePtr,	/* Table being rebuilt. */
+    TCL_HASH_TYPE hash,		/* Hash value to find the bucket of. */
+    Tcl_HashEntry **bucketPtr)	/* Bucket for the hash in the new array. */
+{
+    TCL_HASH_TYPE index;
+
+    if (REHASH_OLD_SHIFT(tablePtr) >= 0) {
+	index = ((hash * (size_t)1103515245) >> REHASH_OLD_SHIFT(tablePtr))
+		& REHASH_OLD_MASK(tablePtr);
+    } else {
+	index = hash & REHASH_OLD_MASK(tablePtr);
+    }
+    if (index < REHASH_MOVED(tablePtr)) {
+	return bucketPtr;
+    }
+    return &REHASH_OLD_BUCKETS(tablePtr)[index];
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * RehashMoved --
+ *
+ *	Tell whether a bucket of the current bucket array is in use, which it
+ *	is unless entries are being moved to the array and the old bucket
+ *	that feeds it has not been moved yet.
+ *
+ * Results:
+ *	1 if the bucket may be read, 0 if it is not initialized yet.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+RehashMoved(
+    Tcl_HashTable *tablePtr,	/* Table to check. */
+    Tcl_Size index)		/* Index in the current bucket array. */
+{
+    size_t oldIndex;
+
+    if (!REHASH_PENDING(tablePtr)) {
+	return 1;
+    }
+    if (REHASH_OLD_SHIFT(tablePtr) >= 0) {
+	oldIndex = (size_t) index >> 2;
+    } else {
+	oldIndex = (size_t) index & REHASH_OLD_MASK(tablePtr);
+    }
+    return oldIndex < REHASH_MOVED(tablePtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * RehashStep --
+ *
+ *	Move the entries of up to count more buckets of an old bucket array
+ *	into the current one, in bucket order, initializing the buckets they
+ *	go to first.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Entries get re-hashed to new buckets. When the last old bucket has
+ *	been emptied the old array is freed.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+RehashStep(
+    Tcl_HashTable *tablePtr,	/* Table being rebuilt. */
+    const Tcl_HashKeyType *typePtr,
+				/* Key type of the table. */
+    size_t count)		/* Number of old buckets to move. */
+{
+    Tcl_HashEntry **oldBuckets = REHASH_OLD_BUCKETS(tablePtr);
+    size_t moved = REHASH_MOVED(tablePtr);
+    size_t oldSize = REHASH_OLD_MASK(tablePtr) + 1;
+    TCL_HASH_TYPE index;
+    Tcl_HashEntry *hPtr;
+
+    for (; count > 0 && moved < oldSize; count--, moved++) {
+	if (REHASH_OLD_SHIFT(tablePtr) >= 0) {
+	    for (index = 0; index < 4; index++) {
+		tablePtr->buckets[4 * moved + index] = NULL;
+	    }
+	} else {
+	    for (index = moved; index < (size_t) tablePtr->numBuckets;
+		    index += oldSize) {
+		tablePtr->buckets[index] = NULL;
+	    }
+	}
+	while ((hPtr = oldBuckets[moved]) != NULL) {
+	    oldBuckets[moved] = hPtr->nextPtr;
+	    if (typePtr->hashKeyProc == NULL
+		    || typePtr->flags & TCL_HASH_KEY_RANDOMIZE_HASH) {
+		index = RANDOM_INDEX(tablePtr, hPtr->hash);
+	    } else {
+		index = hPtr->hash & tablePtr->mask;
+	    }
+	    hPtr->nextPtr = tablePtr->buckets[index];
+	    tablePtr->buckets[index] = hPtr;
+	}
+    }
+
+    if (moved < oldSize) {
+	tablePtr->staticBuckets[2] = (Tcl_HashEntry *) UINT2PTR(moved);
+	return;
+    }
+    if (typePtr->flags & TCL_HASH_KEY_SYSTEM_HASH) {
+	TclpSysFree((char *) oldBuckets);
+    } else {
+	Tcl_Free(oldBuckets);
+    }
+    tablePtr->staticBuckets[0] = tablePtr->staticBuckets[1] = NULL;
+    tablePtr->staticBuckets[2] = tablePtr->staticBuckets[3] = NULL;
+}
+
 /*
  * Local Variables:
  * mode: c
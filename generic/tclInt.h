@@ -1833,6 +1833,23 @@ typedef struct AllocCache {
     size_t numObjects;		/* Number of objects for thread. */
 } AllocCache;
 
+/*
+ *----------------------------------------------------------------
+ * The execution statistics collected for [tcl::unsupported::execstats]; see
+ * tclProfile.c. The bytecode engine counts the instructions it runs directly
+ * in instCounts.
+ *----------------------------------------------------------------
+ */
+
+typedef struct ExecStats {
+    size_t instCounts[256];	/* Number of executions of each opcode. */
+    Tcl_HashTable commands;	/* Maps each Command invoked (whose refCount
+				 * is held) to its number of invocations. */
+    Tcl_HashTable procs;	/* Maps the name of each procedure, method or
+				 * lambda called to its number of calls and
+				 * the time spent in them. */
+} ExecStats;
+
 /*
  *----------------------------------------------------------------
  * This structure defines an interpreter, which is a collection of commands
@@ -2207,6 +2224,9 @@ typedef struct Interp {
     Tcl_Obj *innerContext;	/* cached list for fast reallocation */
     int resetErrorStack;        /* controls cleaning up of ::errorStack */
 
+    ExecStats *execStatsPtr;	/* The execution statistics being collected,
+				 * or NULL if they are not. */
+
 #ifdef TCL_COMPILE_STATS
     /*
      * Statistical information about the bytecode compiler and interpreter's
@@ -2323,6 +2343,9 @@ typedef struct Interp {
  *			script in progress has been canceled thereby allowing
  *			the evaluation stack for the interp to be fully
  *			unwound.
+ * INLINE_PROCS:	Non-zero means that the bytecode compiler may inline
+ *			the bodies of small procedures at the places they are
+ *			called from (see CompileInlinedProc in tclCompile.c).
  *
  * WARNING: For the sake of some extensions that have made use of former
  * internal values, do not re-use the flag values 2 (formerly ERR_IN_PROGRESS)
@@ -2339,6 +2362,7 @@ typedef struct Interp {
 #define INTERP_ALTERNATE_WRONG_ARGS	 0x400
 #define ERR_LEGACY_COPY			 0x800
 #define CANCELED			0x1000
+#define INLINE_PROCS			0x2000
 
 /*
  * Maximum number of levels of nesting permitted in Tcl commands (used to
@@ -2476,6 +2500,8 @@ typedef struct ListStore {
     Tcl_Size numAllocated; /* Total number of slots[] array slots. */
     size_t refCount;           /* Number of references to this instance */
     int flags;              /* LISTSTORE_* flags */
+    struct ListIndex *indexPtr; /* Lookup index for repeated searches of
+				 * the slots, or NULL. See tclListObj.c */
     Tcl_Obj *slots[TCLFLEXARRAY];      /* Variable size array. Grown as needed */
 } ListStore;
 
@@ -2586,6 +2612,17 @@ typedef struct ListRep {
  */
 #define ListObjRepIsShared(listObj_) (ListObjStorePtr(listObj_)->refCount > 1)
 
+/*
+ * Discards any search index built on the ListStore of a list. Must be called
+ * by code that modifies the slots of an unshared ListStore in place.
+ */
+#define ListObjResetIndex(listObj_)					\
+    do {								\
+	if (ListObjStorePtr(listObj_)->indexPtr) {			\
+	    TclListStoreResetIndex(ListObjStorePtr(listObj_));		\
+	}								\
+    } while (0)
+
 /*
  * Certain commands like concat are optimized if an existing string
  * representation of a list object is known to be in canonical format (i.e.
@@ -2935,6 +2972,40 @@ static inline void *TclAttemptReallocEx(void *oldPtr, Tcl_Size numBytes, Tcl_Siz
     return TclAttemptReallocElemsEx(oldPtr, numBytes, 1, 0, capacityPtr);
 }
 
+/*
+ * A key sorted by TclSortKeys. Made with TclWideSortKey or TclDoubleSortKey,
+ * the unsigned order of keys is the numeric order of the values, with -0.0
+ * equal to 0.0. Complementing the keys gives the reverse order.
+ */
+
+typedef struct {
+    Tcl_WideUInt key;		/* Order preserving image of the value. */
+    size_t index;		/* Position of the value before sorting. */
+} TclSortKey;
+
+static inline Tcl_WideUInt
+TclWideSortKey(
+    Tcl_WideInt wideValue)
+{
+    return (Tcl_WideUInt) wideValue ^ ((Tcl_WideUInt) 1 << 63);
+}
+
+static inline Tcl_WideUInt
+TclDoubleSortKey(
+    double doubleValue)
+{
+    Tcl_WideUInt bits;
+
+    if (doubleValue == 0.0) {
+	doubleValue = 0.0;
+    }
+    memcpy(&bits, &doubleValue, sizeof(bits));
+    if (bits & ((Tcl_WideUInt) 1 << 63)) {
+	return ~bits;
+    }
+    return bits | ((Tcl_WideUInt) 1 << 63);
+}
+
 /*
  *----------------------------------------------------------------
  * Variables shared among Tcl modules but not used by the outside world.
@@ -2980,9 +3051,12 @@ MODULE_SCOPE const TclObjTypeWithAbstractList tclDoubleType;
 MODULE_SCOPE const TclObjTypeWithAbstractList tclIntType;
 MODULE_SCOPE const TclObjTypeWithAbstractList tclListType;
 MODULE_SCOPE const TclObjTypeWithAbstractList tclArithSeriesType;
+MODULE_SCOPE const TclObjTypeWithAbstractList tclPackedListType;
+MODULE_SCOPE const TclObjTypeWithAbstractList tclListViewType;
 MODULE_SCOPE const Tcl_ObjType tclDictType;
 MODULE_SCOPE const Tcl_ObjType tclProcBodyType;
 MODULE_SCOPE const Tcl_ObjType tclStringType;
+MODULE_SCOPE const Tcl_ObjType tclStringRopeType;
 MODULE_SCOPE const Tcl_ObjType tclEnsembleCmdType;
 MODULE_SCOPE const Tcl_ObjType tclRegexpType;
 MODULE_SCOPE Tcl_ObjType tclCmdNameType;
@@ -3216,6 +3290,7 @@ MODULE_SCOPE Tcl_Namespace *TclEnsureNamespace(Tcl_Interp *interp,
 			    Tcl_Namespace *namespacePtr);
 MODULE_SCOPE void	TclFinalizeAllocSubsystem(void);
 MODULE_SCOPE void	TclFinalizeAsync(void);
+MODULE_SCOPE void	TclFinalizeByteCodeCache(void);
 MODULE_SCOPE void	TclFinalizeDoubleConversion(void);
 MODULE_SCOPE void	TclFinalizeEncodingSubsystem(void);
 MODULE_SCOPE void	TclFinalizeEnvironment(void);
@@ -3270,6 +3345,7 @@ MODULE_SCOPE int	TclGetLoadedLibraries(Tcl_Interp *interp,
 				const char *packageName);
 MODULE_SCOPE int	TclGetWideBitsFromObj(Tcl_Interp *, Tcl_Obj *,
 				Tcl_WideInt *);
+MODULE_SCOPE TCL_HASH_TYPE TclHashBytes(const char *bytes, size_t length);
 MODULE_SCOPE int	TclIncrObj(Tcl_Interp *interp, Tcl_Obj *valuePtr,
 			    Tcl_Obj *incrPtr);
 MODULE_SCOPE Tcl_Obj *	TclIncrObjVar2(Tcl_Interp *interp, Tcl_Obj *part1Ptr,
@@ -3294,6 +3370,7 @@ MODULE_SCOPE void	TclInitObjSubsystem(void);
 MODULE_SCOPE int	TclInterpReady(Tcl_Interp *interp);
 MODULE_SCOPE int	TclIsDigitProc(int byte);
 MODULE_SCOPE int	TclIsBareword(int byte);
+MODULE_SCOPE int	TclIsPureMathFunc(Tcl_Interp *interp, Tcl_Obj *namePtr);
 MODULE_SCOPE Tcl_Obj *	TclJoinPath(Tcl_Size elements, Tcl_Obj * const objv[],
 			    int forceRelative);
 MODULE_SCOPE int	MakeTildeRelativePath(Tcl_Interp *interp, const char *user,
@@ -3315,8 +3392,18 @@ MODULE_SCOPE void	TclListLines(Tcl_Obj *listObj, Tcl_Size line, int n,
 MODULE_SCOPE int	TclListObjAppendElements(Tcl_Interp *interp,
 			    Tcl_Obj *toObj, Tcl_Size elemCount,
 			    Tcl_Obj *const elemObjv[]);
+MODULE_SCOPE void *	TclListObjGetCache(Tcl_Obj *listObj,
+			    Tcl_FreeProc *freeProc);
+MODULE_SCOPE int	TclListObjIndexedFind(Tcl_Obj *listObj,
+			    Tcl_Obj *valueObj, Tcl_Size start,
+			    Tcl_Size *indexPtr);
+MODULE_SCOPE Tcl_Size	TclListObjIndexedNext(Tcl_Obj *listObj,
+			    Tcl_Size index);
 MODULE_SCOPE Tcl_Obj *	TclListObjRange(Tcl_Interp *interp, Tcl_Obj *listPtr,
 			    Tcl_Size fromIdx, Tcl_Size toIdx);
+MODULE_SCOPE int	TclListObjSetCache(Tcl_Obj *listObj, void *cachePtr,
+			    Tcl_FreeProc *freeProc);
+MODULE_SCOPE void	TclListStoreResetIndex(ListStore *storePtr);
 MODULE_SCOPE Tcl_Obj *	TclLsetList(Tcl_Interp *interp, Tcl_Obj *listPtr,
 			    Tcl_Obj *indexPtr, Tcl_Obj *valuePtr);
 MODULE_SCOPE Tcl_Obj *	TclLsetFlat(Tcl_Interp *interp, Tcl_Obj *listPtr,
@@ -3466,9 +3553,12 @@ MODULE_SCOPE int	TclStringMatch(const char *str, Tcl_Size strLen,
 			    const char *pattern, int ptnLen, int flags);
 MODULE_SCOPE int	TclStringMatchObj(Tcl_Obj *stringObj,
 			    Tcl_Obj *patternObj, int flags);
+MODULE_SCOPE int	TclStringMatchLiteral(const char *str,
+			    Tcl_Size strLen, const char *pattern);
 MODULE_SCOPE void	TclSubstCompile(Tcl_Interp *interp, const char *bytes,
 			    Tcl_Size numBytes, int flags, Tcl_Size line,
 			    struct CompileEnv *envPtr);
+MODULE_SCOPE int	TclSortKeys(TclSortKey *keys, size_t numKeys);
 MODULE_SCOPE int	TclSubstOptions(Tcl_Interp *interp, Tcl_Size numOpts,
 			    Tcl_Obj *const opts[], int *flagPtr);
 MODULE_SCOPE void	TclSubstParse(Tcl_Interp *interp, const char *bytes,
@@ -3587,6 +3677,14 @@ MODULE_SCOPE int	TclDictWithFinish(Tcl_Interp *interp, Var *varPtr,
 MODULE_SCOPE Tcl_Obj *	TclDictWithInit(Tcl_Interp *interp, Tcl_Obj *dictPtr,
 			    Tcl_Size pathc, Tcl_Obj *const pathv[]);
 MODULE_SCOPE Tcl_ObjCmdProc Tcl_DisassembleObjCmd;
+MODULE_SCOPE Tcl_ObjCmdProc Tcl_ByteCodeCacheObjCmd;
+MODULE_SCOPE Tcl_ObjCmdProc Tcl_SharedByteCodeObjCmd;
+MODULE_SCOPE Tcl_ObjCmdProc Tcl_InlineProcsObjCmd;
+MODULE_SCOPE Tcl_ObjCmdProc Tcl_ProfileObjCmd;
+MODULE_SCOPE Tcl_ObjCmdProc Tcl_ExecStatsObjCmd;
+MODULE_SCOPE Tcl_ObjCmdProc Tcl_RegexpCacheObjCmd;
+MODULE_SCOPE void	TclCountCommand(Interp *iPtr, Command *cmdPtr);
+MODULE_SCOPE void	TclStartProcStats(Tcl_Interp *interp, Proc *procPtr);
 
 /* Assemble command function */
 MODULE_SCOPE Tcl_ObjCmdProc Tcl_AssembleObjCmd;
@@ -4120,6 +4218,9 @@ MODULE_SCOPE Tcl_Obj *	TclStringReplace(Tcl_Interp *interp, Tcl_Obj *objPtr,
 			    Tcl_Size first, Tcl_Size count, Tcl_Obj *insertPtr,
 			    int flags);
 MODULE_SCOPE Tcl_Obj *	TclStringReverse(Tcl_Obj *objPtr, int flags);
+MODULE_SCOPE const char *TclStringUtfAtIndex(Tcl_Obj *objPtr, Tcl_Size index);
+MODULE_SCOPE const unsigned char *TclStringCharBytes(Tcl_Obj *objPtr,
+			    Tcl_Size *lengthPtr);
 
 /* Flag values for the [string] ensemble functions. */
 
@@ -4192,6 +4293,18 @@ MODULE_SCOPE int TclUniCharNcasecmp(const Tcl_UniChar *ucs,
 				const Tcl_UniChar *uct, size_t numChars);
 MODULE_SCOPE int TclUniCharCaseMatch(const Tcl_UniChar *uniStr,
 				const Tcl_UniChar *uniPattern, int nocase);
+MODULE_SCOPE const Tcl_UniChar *TclUniCharFind(const Tcl_UniChar *haystack,
+				Tcl_Size lh, const Tcl_UniChar *needle,
+				Tcl_Size ln);
+MODULE_SCOPE const Tcl_UniChar *TclUniCharFindLast(
+				const Tcl_UniChar *haystack, Tcl_Size lh,
+				const Tcl_UniChar *needle, Tcl_Size ln);
+MODULE_SCOPE const unsigned char *TclFindBytes(const unsigned char *haystack,
+				Tcl_Size lh, const unsigned char *needle,
+				Tcl_Size ln);
+MODULE_SCOPE const unsigned char *TclFindLastBytes(
+				const unsigned char *haystack, Tcl_Size lh,
+				const unsigned char *needle, Tcl_Size ln);
 
 
 /*
@@ -13,6 +13,8 @@
 #include "tclInt.h"
 #include "tclTomMath.h"
 #include "tclArithSeries.h"
+#include "tclPackedList.h"
+#include "tclListView.h"
 
 /*
  * TODO - memmove is fast. Measure at what size we should prefer memmove
@@ -116,6 +118,64 @@
     (LISTREP_SPACE_FAVOR_FRONT | LISTREP_SPACE_FAVOR_BACK \
      | LISTREP_SPACE_ONLY_BACK)
 
+/*
+ * ListIndex --
+ *
+ * A lookup index attached to a ListStore that maps the string value of each
+ * in-use slot to its position, so that repeated exact searches of the same
+ * list (lsearch -exact, the "in" and "ni" operators) are hash lookups
+ * instead of linear scans. Positions are relative to the firstUsed slot of
+ * the store so that shifting the in-use slots does not disturb the index.
+ *
+ * The record is allocated on the first search of a store of at least
+ * LIST_INDEX_MIN_LENGTH slots, but the table itself is only built once
+ * LIST_INDEX_MIN_SEARCHES searches have been made without the store being
+ * modified in between. Appends extend a built index; any other in-place
+ * modification of the store resets it (see TclListStoreResetIndex).
+ *
+ * The record also holds data that commands derive from the elements of a
+ * list and keep for reuse, such as the automaton of [string map]. It is
+ * tied to the span of slots it was made from, so appends do not affect it,
+ * and is discarded along with the index.
+ */
+typedef struct ListIndex {
+    Tcl_Size numSearches;	/* Searches made since the last reset. */
+    Tcl_Size numIndexed;	/* Number of slots covered by the index. */
+    Tcl_Size numAllocated;	/* Allocated length of nextPos[]. */
+    Tcl_Size *nextPos;		/* For each covered slot, the position of
+				 * the next slot with the same string value
+				 * or -1. NULL if the index is not built. */
+    Tcl_HashTable table;	/* Maps element values to ListIndexEntry
+				 * records. */
+    Tcl_HashEntry *hintEntryPtr;/* Entry of the value last found by
+				 * TclListObjIndexedFind, or NULL. */
+    Tcl_Size hintPos;		/* Position at which it was found. Searches
+				 * for the same value from a later start
+				 * (e.g., lsearch -start in a loop) follow
+				 * the chain from there. */
+    void *cachePtr;		/* Data derived from the slots of the span
+				 * below, or NULL. */
+    Tcl_FreeProc *freeCacheProc;/* Frees cachePtr; also identifies what
+				 * kind of data it is. */
+    Tcl_Size cacheFirst;	/* Position of the first slot of the span. */
+    Tcl_Size cacheLength;	/* Number of slots in the span. */
+} ListIndex;
+
+#define LIST_INDEX_MIN_LENGTH	32
+#define LIST_INDEX_MIN_SEARCHES	4
+
+/*
+ * An entry of the table of a ListIndex, keyed by an element value as with
+ * TCL_OBJ_KEYS. The entry's value is the position of the first slot with the
+ * element value; the position of the last one is kept too so that appends
+ * extend the chain of nextPos in constant time.
+ */
+typedef struct {
+    Tcl_HashEntry entry;
+    Tcl_Size lastPos;		/* Position of the last slot with the
+				 * value. */
+} ListIndexEntry;
+
 /*
  * Prototypes for non-inline static functions defined later in this file:
  */
@@ -143,6 +203,20 @@ static void	FreeListInternalRep(Tcl_Obj *listPtr);
 static int	SetListFromAny(Tcl_Interp *interp, Tcl_Obj *objPtr);
 static void	UpdateStringOfList(Tcl_Obj *listPtr);
 static Tcl_Size ListLength(Tcl_Obj *listPtr);
+static ListIndex *ListIndexNew(ListStore *storePtr);
+static int	ListIndexBuild(ListStore *storePtr, ListIndex *indexPtr);
+static void	ListIndexAppend(ListStore *storePtr);
+static Tcl_HashEntry *AllocListIndexEntry(Tcl_HashTable *tablePtr,
+		    void *keyPtr);
+
+static const Tcl_HashKeyType listIndexKeyType = {
+    TCL_HASH_KEY_TYPE_VERSION,	/* version */
+    0,				/* flags */
+    TclHashObjKey,		/* hashKeyProc */
+    TclCompareObjKeys,		/* compareKeysProc */
+    AllocListIndexEntry,	/* allocEntryProc */
+    TclFreeObjEntry		/* freeEntryProc */
+};
 
 /*
  * The structure below defines the list Tcl object type by means of functions
@@ -352,6 +426,30 @@ ListRepFreeUnreferenced(const ListRep *repPtr)
 	ListRepUnsharedFreeUnreferenced(repPtr);
     }
 }
+
+/*
+ *------------------------------------------------------------------------
+ *
+ * ListStoreResetIndex --
+ *
+ *    Discards the search index of a ListStore, if any. Called whenever
+ *    slots in use are removed, replaced or reordered.
+ *
+ * Results:
+ *    None.
+ *
+ * Side effects:
+ *    See TclListStoreResetIndex.
+ *
+ *------------------------------------------------------------------------
+ */
+static inline void
+ListStoreResetIndex(ListStore *storePtr)
+{
+    if (storePtr->indexPtr) {
+	TclListStoreResetIndex(storePtr);
+    }
+}
 
 /*
  *------------------------------------------------------------------------
@@ -766,6 +864,7 @@ ListStoreNew(
 
     storePtr->refCount = 0;
     storePtr->flags = 0;
+    storePtr->indexPtr = NULL;
     storePtr->numAllocated = capacity;
     if (capacity == objc) {
 	storePtr->firstUsed = 0;
@@ -1014,6 +1113,7 @@ static void ListRepUnsharedFreeUnreferenced(const ListRep *repPtr)
     LIST_COUNT_ASSERT(count);
     if (count > 0) {
         /* T:listrep-1.5.1,6.{1:8} */
+	ListStoreResetIndex(storePtr);
 	ObjArrayDecrRefs(storePtr->slots, storePtr->firstUsed, count);
 	storePtr->firstUsed = spanPtr->spanStart;
 	LIST_ASSERT(storePtr->numUsed >= count);
@@ -1026,6 +1126,7 @@ static void ListRepUnsharedFreeUnreferenced(const ListRep *repPtr)
     LIST_COUNT_ASSERT(count);
     if (count > 0) {
         /* T:listrep-6.{1:8} */
+	ListStoreResetIndex(storePtr);
 	ObjArrayDecrRefs(
 	    storePtr->slots, spanPtr->spanStart + spanPtr->spanLength, count);
 	LIST_ASSERT(storePtr->numUsed >= count);
@@ -1416,6 +1517,7 @@ ListRepRange(
 	/* srcRepPtr->storePtr->firstUsed,numAllocated unchanged */
 	srcRepPtr->storePtr->numUsed = rangeLen;
 	srcRepPtr->storePtr->flags = 0;
+	ListStoreResetIndex(srcRepPtr->storePtr);
 	rangeRepPtr->storePtr = srcRepPtr->storePtr; /* Note no incr ref */
 	rangeRepPtr->spanPtr = NULL;
     } else if (ListSpanMerited(rangeLen,
@@ -1492,6 +1594,7 @@ ListRepRange(
 	srcRepPtr->storePtr->firstUsed = 0;
 	srcRepPtr->storePtr->numUsed = rangeLen;
 	srcRepPtr->storePtr->flags = 0;
+	ListStoreResetIndex(srcRepPtr->storePtr);
 	if (srcRepPtr->spanPtr) {
 	    /* In case the source has a span, update it for consistency */
             /* T:listrep-3.{15,17} */
@@ -1625,6 +1728,12 @@ Tcl_ListObjGetElements(
     if (TclHasInternalRep(objPtr,&tclArithSeriesType.objType)) {
 	return TclArithSeriesGetElements(interp, objPtr, objcPtr, objvPtr);
     }
+    if (TclHasInternalRep(objPtr,&tclPackedListType.objType)) {
+	return TclPackedListGetElements(objPtr, objcPtr, objvPtr);
+    }
+    if (TclHasInternalRep(objPtr,&tclListViewType.objType)) {
+	return TclListViewGetElements(objPtr, objcPtr, objvPtr);
+    }
 
     if (TclListObjGetRep(interp, objPtr, &listRep) != TCL_OK)
 	return TCL_ERROR;
@@ -1716,6 +1825,15 @@ Tcl_ListObjAppendList(
 	Tcl_Panic("%s called with shared object", "TclListObjAppendElements");
     }
 
+    /*
+     * A packed list stays packed as long as the new elements fit in it.
+     */
+
+    if (TclHasInternalRep(toObj, &tclPackedListType.objType)
+	    && TclPackedListObjAppend(toObj, elemCount, elemObjv)) {
+	return TCL_OK;
+    }
+
     if (TclListObjGetRep(interp, toObj, &listRep) != TCL_OK)
 	return TCL_ERROR; /* Cannot be converted to a list */
 
@@ -1781,6 +1899,9 @@ Tcl_ListObjAppendList(
 		     elemCount,
 		     elemObjv);
 	listRep.storePtr->numUsed = finalLen;
+	if (listRep.storePtr->indexPtr) {
+	    ListIndexAppend(listRep.storePtr);
+	}
 	if (listRep.spanPtr) {
             /* T:listrep-3.{4,5,6} */
 	    LIST_ASSERT(listRep.spanPtr->spanStart
@@ -1914,6 +2035,15 @@ Tcl_ListObjIndex(
 	return TCL_OK;
     }
 
+    if (TclHasInternalRep(listObj, &tclPackedListType.objType)) {
+	*objPtrPtr = TclPackedListObjElement(listObj, index);
+	return TCL_OK;
+    }
+    if (TclHasInternalRep(listObj, &tclListViewType.objType)) {
+	*objPtrPtr = TclListViewObjIndex(listObj, index);
+	return TCL_OK;
+    }
+
     if (TclListObjGetElementsM(interp, listObj, &numElems, &elemObjs)
 	!= TCL_OK) {
 	return TCL_ERROR;
@@ -2048,6 +2178,14 @@ Tcl_ListObjReplace(
 	Tcl_Panic("%s called with shared object", "Tcl_ListObjReplace");
     }
 
+    /* Appending to a packed list keeps it packed if the new elements fit */
+    if (numToDelete <= 0 && numToInsert > 0
+	    && TclHasInternalRep(listObj, &tclPackedListType.objType)
+	    && first >= ABSTRACTLIST_PROC(listObj, lengthProc)(listObj)
+	    && TclPackedListObjAppend(listObj, numToInsert, insertObjs)) {
+	return TCL_OK;
+    }
+
     if (TclListObjGetRep(interp, listObj, &listRep) != TCL_OK)
 	return TCL_ERROR; /* Cannot be converted to a list */
 
@@ -2157,6 +2295,7 @@ Tcl_ListObjReplace(
 	) {
 	    Tcl_Size newLen;
 	    LIST_ASSERT(numToInsert); /* Else would have returned above */
+	    ListStoreResetIndex(listRep.storePtr);
 	    listRep.storePtr->firstUsed -= numToInsert;
 	    ObjArrayCopy(&listRep.storePtr->slots[listRep.storePtr->firstUsed],
 			 numToInsert,
@@ -2462,6 +2601,7 @@ Tcl_ListObjReplace(
     listRep.storePtr->firstUsed += leadShift;
     listRep.storePtr->numUsed = origListLen + lenChange;
     listRep.storePtr->flags = 0;
+    ListStoreResetIndex(listRep.storePtr);
 
     if (listRep.spanPtr && listRep.spanPtr->refCount <= 1) {
 	/* An unshared span record, re-use it, even if not required */
@@ -2631,6 +2771,36 @@ TclLindexFlat(
 	return elemObj;
     }
 
+    /*
+     * Box only the selected element of a packed list, or pick the element
+     * out of a list view without making its element array, then carry on
+     * with any further indices as usual.
+     */
+
+    if (indexCount > 0
+	    && (TclHasInternalRep(listObj, &tclPackedListType.objType)
+	    || TclHasInternalRep(listObj, &tclListViewType.objType))) {
+	Tcl_Size index;
+	Tcl_Size listLen = ABSTRACTLIST_PROC(listObj, lengthProc)(listObj);
+
+	if (TclGetIntForIndexM(interp, indexArray[0], listLen - 1,
+		&index) != TCL_OK) {
+	    return NULL;
+	}
+	if (TclHasInternalRep(listObj, &tclPackedListType.objType)) {
+	    listObj = TclPackedListObjIndex(listObj, index);
+	    indexArray++;
+	    indexCount--;
+	} else if (TclHasInternalRep(listObj, &tclListViewType.objType)) {
+	    listObj = TclListViewObjIndex(listObj, index);
+	    if (listObj == NULL) {
+		TclNewObj(listObj);
+	    }
+	    indexArray++;
+	    indexCount--;
+	}
+    }
+
     Tcl_IncrRefCount(listObj);
 
     for (i=0 ; i<indexCount && listObj ; i++) {
@@ -2841,6 +3011,30 @@ TclLsetFlat(
 	return valueObj;
     }
 
+    /*
+     * Replacing one element of a packed list keeps it packed when the new
+     * value fits. Anything else is left to the general case below, which
+     * also reports the errors.
+     */
+
+    if (indexCount == 1 && valueObj != NULL && indexArray[0] != listObj
+	    && TclHasInternalRep(listObj, &tclPackedListType.objType)) {
+	len = ABSTRACTLIST_PROC(listObj, lengthProc)(listObj);
+	if (TclGetIntForIndexM(NULL, indexArray[0], len - 1, &index) == TCL_OK
+		&& index >= 0 && index < len) {
+	    subListObj = Tcl_IsShared(listObj) ? TclDuplicatePureObj(NULL,
+		    listObj, &tclPackedListType.objType) : listObj;
+	    if (subListObj != NULL && TclPackedListObjSetElement(subListObj,
+		    index, valueObj)) {
+		Tcl_IncrRefCount(subListObj);
+		return subListObj;
+	    }
+	    if (subListObj != NULL && subListObj != listObj) {
+		Tcl_DecrRefCount(subListObj);
+	    }
+	}
+    }
+
     /*
      * If the list is shared, make a copy to modify (copy-on-write). The string
      * representation and internal representation of listObj remains unchanged.
@@ -3139,6 +3333,7 @@ TclListObjSetElement(
 
     /* Retrieve element array AFTER potential cloning above */
     ListRepElements(&listRep, elemCount, elemPtrs);
+    ListStoreResetIndex(listRep.storePtr);
 
     /*
      * Add a reference to the new list element and remove from old before
@@ -3153,6 +3348,417 @@ TclListObjSetElement(
 
     return TCL_OK;
 }
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclListObjIndexedFind --
+ *
+ *	Looks up the first element at or after a given index of a list whose
+ *	string value is equal to that of valueObj, using the search index of
+ *	the list's ListStore. The index is created and built on demand (see
+ *	the comments for ListIndex), so for a list that is not searched
+ *	repeatedly this returns 0 and the caller does its own linear scan.
+ *
+ * Results:
+ *	Returns 1 if the lookup was done, with *indexPtr set to the index of
+ *	the matching element or -1 if there is none. Returns 0 if listObj is
+ *	not a list or has no usable index, in which case *indexPtr is not
+ *	modified.
+ *
+ * Side effects:
+ *	May allocate or build the search index of the list's ListStore.
+ *
+ *----------------------------------------------------------------------
+ */
+int
+TclListObjIndexedFind(
+    Tcl_Obj *listObj,		/* List to search. */
+    Tcl_Obj *valueObj,		/* Value to look for. */
+    Tcl_Size start,		/* Index of first element to consider. */
+    Tcl_Size *indexPtr)		/* Where to store the matching index. */
+{
+    ListRep listRep;
+    ListStore *storePtr;
+    ListIndex *listIndexPtr;
+    Tcl_HashEntry *hPtr;
+    Tcl_Size pos, first, end;
+
+    if (!TclHasInternalRep(listObj, &tclListType.objType)) {
+	return 0;
+    }
+    ListObjGetRep(listObj, &listRep);
+    storePtr = listRep.storePtr;
+    if (storePtr->numUsed < LIST_INDEX_MIN_LENGTH) {
+	return 0;
+    }
+
+    listIndexPtr = ListIndexNew(storePtr);
+    if (listIndexPtr == NULL) {
+	return 0;
+    }
+    if (listIndexPtr->nextPos == NULL) {
+	if (++listIndexPtr->numSearches < LIST_INDEX_MIN_SEARCHES
+		|| !ListIndexBuild(storePtr, listIndexPtr)) {
+	    return 0;
+	}
+    }
+    LIST_ASSERT(listIndexPtr->numIndexed == storePtr->numUsed);
+
+    /* Positions are relative to firstUsed, the span may be narrower */
+    first = ListRepStart(&listRep) - storePtr->firstUsed;
+    end = first + ListRepLength(&listRep);
+    hPtr = Tcl_FindHashEntry(&listIndexPtr->table, (char *) valueObj);
+    if (hPtr == NULL
+	    || ((ListIndexEntry *) hPtr)->lastPos < first + start) {
+	*indexPtr = -1;
+	return 1;
+    }
+    pos = PTR2INT(Tcl_GetHashValue(hPtr));
+    if (hPtr == listIndexPtr->hintEntryPtr && pos < listIndexPtr->hintPos
+	    && listIndexPtr->hintPos < first + start) {
+	pos = listIndexPtr->hintPos;
+    }
+    while (pos >= 0 && pos < first + start) {
+	pos = listIndexPtr->nextPos[pos];
+    }
+    if (pos >= 0) {
+	listIndexPtr->hintEntryPtr = hPtr;
+	listIndexPtr->hintPos = pos;
+    }
+    *indexPtr = (pos >= 0 && pos < end) ? pos - first : -1;
+    return 1;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclListObjIndexedNext --
+ *
+ *	Returns the index of the next element after a match found by
+ *	TclListObjIndexedFind with the same string value. The list must not
+ *	have been modified since.
+ *
+ * Results:
+ *	The index of the next matching element, or -1 if there is none.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+Tcl_Size
+TclListObjIndexedNext(
+    Tcl_Obj *listObj,		/* List searched by TclListObjIndexedFind. */
+    Tcl_Size index)		/* Index of the previous match. */
+{
+    ListRep listRep;
+    ListIndex *listIndexPtr;
+    Tcl_Size pos, first;
+
+    ListObjGetRep(listObj, &listRep);
+    listIndexPtr = listRep.storePtr->indexPtr;
+    LIST_ASSERT(listIndexPtr && listIndexPtr->nextPos);
+    first = ListRepStart(&listRep) - listRep.storePtr->firstUsed;
+    pos = listIndexPtr->nextPos[first + index];
+    if (pos < 0 || pos >= first + ListRepLength(&listRep)) {
+	return -1;
+    }
+    return pos - first;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclListObjGetCache, TclListObjSetCache --
+ *
+ *	Retrieve and attach data that a command has derived from the elements
+ *	of a list, kept with the search index of the list's ListStore so that
+ *	it lasts as long as the elements are unchanged. One item of data is
+ *	kept per store; freeProc tells apart the kinds of data.
+ *
+ * Results:
+ *	TclListObjGetCache returns the data attached with the same freeProc
+ *	for the same elements, or NULL. TclListObjSetCache returns 1 if the
+ *	data was attached, in which case the list owns it, or 0 if listObj
+ *	is not a list or memory is short, in which case the caller keeps it.
+ *
+ * Side effects:
+ *	TclListObjSetCache frees data attached before.
+ *
+ *----------------------------------------------------------------------
+ */
+void *
+TclListObjGetCache(
+    Tcl_Obj *listObj,		/* List to look up data for. */
+    Tcl_FreeProc *freeProc)	/* Kind of data wanted. */
+{
+    ListRep listRep;
+    ListIndex *listIndexPtr;
+
+    if (!TclHasInternalRep(listObj, &tclListType.objType)) {
+	return NULL;
+    }
+    ListObjGetRep(listObj, &listRep);
+    listIndexPtr = listRep.storePtr->indexPtr;
+    if (listIndexPtr == NULL || listIndexPtr->freeCacheProc != freeProc
+	    || listIndexPtr->cacheFirst
+		    != ListRepStart(&listRep) - listRep.storePtr->firstUsed
+	    || listIndexPtr->cacheLength != ListRepLength(&listRep)) {
+	return NULL;
+    }
+    return listIndexPtr->cachePtr;
+}
+
+int
+TclListObjSetCache(
+    Tcl_Obj *listObj,		/* List the data was derived from. */
+    void *cachePtr,		/* Data to attach. */
+    Tcl_FreeProc *freeProc)	/* Frees the data. */
+{
+    ListRep listRep;
+    ListIndex *listIndexPtr;
+
+    if (!TclHasInternalRep(listObj, &tclListType.objType)) {
+	return 0;
+    }
+    ListObjGetRep(listObj, &listRep);
+    listIndexPtr = ListIndexNew(listRep.storePtr);
+    if (listIndexPtr == NULL) {
+	return 0;
+    }
+    if (listIndexPtr->cachePtr != NULL) {
+	listIndexPtr->freeCacheProc(listIndexPtr->cachePtr);
+    }
+    listIndexPtr->cachePtr = cachePtr;
+    listIndexPtr->freeCacheProc = freeProc;
+    listIndexPtr->cacheFirst =
+	    ListRepStart(&listRep) - listRep.storePtr->firstUsed;
+    listIndexPtr->cacheLength = ListRepLength(&listRep);
+    return 1;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ListIndexNew --
+ *
+ *	Gives the search index record of a ListStore, allocating an empty one
+ *	if the store has none.
+ *
+ * Results:
+ *	The record, or NULL if memory could not be allocated.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+static ListIndex *
+ListIndexNew(
+    ListStore *storePtr)
+{
+    ListIndex *listIndexPtr = storePtr->indexPtr;
+
+    if (listIndexPtr == NULL) {
+	listIndexPtr = (ListIndex *)Tcl_AttemptAlloc(sizeof(ListIndex));
+	if (listIndexPtr == NULL) {
+	    return NULL;
+	}
+	listIndexPtr->numSearches = 0;
+	listIndexPtr->numIndexed = 0;
+	listIndexPtr->numAllocated = 0;
+	listIndexPtr->nextPos = NULL;
+	listIndexPtr->hintEntryPtr = NULL;
+	listIndexPtr->cachePtr = NULL;
+	listIndexPtr->freeCacheProc = NULL;
+	storePtr->indexPtr = listIndexPtr;
+    }
+    return listIndexPtr;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ListIndexBuild --
+ *
+ *	Builds the table of a ListStore's search index from the slots in use.
+ *
+ * Results:
+ *	Returns 1 on success, 0 if memory could not be allocated.
+ *
+ * Side effects:
+ *	The element objects are referenced from the table.
+ *
+ *----------------------------------------------------------------------
+ */
+static int
+ListIndexBuild(
+    ListStore *storePtr,
+    ListIndex *listIndexPtr)
+{
+    Tcl_Size pos, numUsed = storePtr->numUsed;
+    Tcl_Obj **elemPtrs = &storePtr->slots[storePtr->firstUsed];
+
+    listIndexPtr->nextPos = (Tcl_Size *)
+	    Tcl_AttemptAlloc(numUsed * sizeof(Tcl_Size));
+    if (listIndexPtr->nextPos == NULL) {
+	return 0;
+    }
+    listIndexPtr->numIndexed = numUsed;
+    listIndexPtr->numAllocated = numUsed;
+    Tcl_InitCustomHashTable(&listIndexPtr->table, TCL_CUSTOM_PTR_KEYS,
+	    &listIndexKeyType);
+
+    /* Walk backwards so that each chain of equal values is in list order */
+    for (pos = numUsed - 1; pos >= 0; pos--) {
+	int isNew;
+	Tcl_HashEntry *hPtr = Tcl_CreateHashEntry(&listIndexPtr->table,
+		(char *) elemPtrs[pos], &isNew);
+
+	if (isNew) {
+	    listIndexPtr->nextPos[pos] = -1;
+	    ((ListIndexEntry *) hPtr)->lastPos = pos;
+	} else {
+	    listIndexPtr->nextPos[pos] = PTR2INT(Tcl_GetHashValue(hPtr));
+	}
+	Tcl_SetHashValue(hPtr, INT2PTR(pos));
+    }
+    return 1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AllocListIndexEntry --
+ *
+ *	Allocates a ListIndexEntry for the table of a search index.
+ *
+ * Results:
+ *	The new entry.
+ *
+ * Side effects:
+ *	Increments the reference count of the key object.
+ *
+ *----------------------------------------------------------------------
+ */
+static Tcl_HashEntry *
+AllocListIndexEntry(
+    TCL_UNUSED(Tcl_HashTable *),
+    void *keyPtr)		/* Key to store in the hash table entry. */
+{
+    Tcl_Obj *objPtr = (Tcl_Obj *)keyPtr;
+    ListIndexEntry *entryPtr = (ListIndexEntry *)
+	    Tcl_Alloc(sizeof(ListIndexEntry));
+
+    entryPtr->entry.key.objPtr = objPtr;
+    Tcl_IncrRefCount(objPtr);
+    entryPtr->entry.clientData = NULL;
+    entryPtr->lastPos = -1;
+    return &entryPtr->entry;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ListIndexAppend --
+ *
+ *	Brings a ListStore's search index up to date after elements have
+ *	been appended to the store.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The new slots are added to a built index. If memory cannot be
+ *	allocated the index is reset instead.
+ *
+ *----------------------------------------------------------------------
+ */
+static void
+ListIndexAppend(
+    ListStore *storePtr)
+{
+    ListIndex *listIndexPtr = storePtr->indexPtr;
+    Tcl_Size pos, numUsed = storePtr->numUsed;
+    Tcl_Obj **elemPtrs = &storePtr->slots[storePtr->firstUsed];
+
+    if (listIndexPtr->nextPos == NULL) {
+	return;
+    }
+    if (numUsed > listIndexPtr->numAllocated) {
+	Tcl_Size *nextPos = (Tcl_Size *)TclAttemptReallocElemsEx(
+		listIndexPtr->nextPos, numUsed, sizeof(Tcl_Size), 0,
+		&listIndexPtr->numAllocated);
+
+	if (nextPos == NULL) {
+	    TclListStoreResetIndex(storePtr);
+	    return;
+	}
+	listIndexPtr->nextPos = nextPos;
+    }
+
+    for (pos = listIndexPtr->numIndexed; pos < numUsed; pos++) {
+	int isNew;
+	Tcl_HashEntry *hPtr = Tcl_CreateHashEntry(&listIndexPtr->table,
+		(char *) elemPtrs[pos], &isNew);
+
+	listIndexPtr->nextPos[pos] = -1;
+	if (isNew) {
+	    Tcl_SetHashValue(hPtr, INT2PTR(pos));
+	} else {
+	    listIndexPtr->nextPos[((ListIndexEntry *) hPtr)->lastPos] = pos;
+	}
+	((ListIndexEntry *) hPtr)->lastPos = pos;
+    }
+    listIndexPtr->numIndexed = numUsed;
+}
+
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclListStoreResetIndex --
+ *
+ *	Discards the table of a ListStore's search index and any data cached
+ *	with it, and restarts the count of searches made. The ListIndex record
+ *	itself is kept until the store is freed.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Releases the references the table holds on element objects.
+ *
+ *----------------------------------------------------------------------
+ */
+void
+TclListStoreResetIndex(
+    ListStore *storePtr)
+{
+    ListIndex *listIndexPtr = storePtr->indexPtr;
+
+    if (listIndexPtr->nextPos != NULL) {
+	Tcl_DeleteHashTable(&listIndexPtr->table);
+	Tcl_Free(listIndexPtr->nextPos);
+	listIndexPtr->nextPos = NULL;
+	listIndexPtr->hintEntryPtr = NULL;
+    }
+    if (listIndexPtr->cachePtr != NULL) {
+	listIndexPtr->freeCacheProc(listIndexPtr->cachePtr);
+	listIndexPtr->cachePtr = NULL;
+	listIndexPtr->freeCacheProc = NULL;
+    }
+    listIndexPtr->numSearches = 0;
+    listIndexPtr->numIndexed = 0;
+    listIndexPtr->numAllocated = 0;
+}
 
 /*
  *----------------------------------------------------------------------
@@ -3179,6 +3785,10 @@ FreeListInternalRep(
 
     ListObjGetRep(listObj, &listRep);
     if (listRep.storePtr->refCount-- <= 1) {
+	if (listRep.storePtr->indexPtr) {
+	    TclListStoreResetIndex(listRep.storePtr);
+	    Tcl_Free(listRep.storePtr->indexPtr);
+	}
 	ObjArrayDecrRefs(
 	    listRep.storePtr->slots,
 	    listRep.storePtr->firstUsed, listRep.storePtr->numUsed);
@@ -3289,6 +3899,30 @@ SetListFromAny(
 	    Tcl_IncrRefCount(valuePtr);
 	    Tcl_DictObjNext(&search, &keyPtr, &valuePtr, &done);
 	}
+    } else if (TclHasInternalRep(objPtr,&tclPackedListType.objType)) {
+	Tcl_Obj **elemObjs;
+	Tcl_Size size;
+
+	/*
+	 * A packed list is converted by boxing each of its elements.
+	 */
+
+	TclPackedListGetElements(objPtr, &size, &elemObjs);
+	if (ListRepInitAttempt(interp, size, elemObjs, &listRep) != TCL_OK) {
+	    return TCL_ERROR;
+	}
+    } else if (TclHasInternalRep(objPtr,&tclListViewType.objType)) {
+	Tcl_Obj **elemObjs;
+	Tcl_Size size;
+
+	/*
+	 * A list view is converted by copying the elements it presents.
+	 */
+
+	TclListViewGetElements(objPtr, &size, &elemObjs);
+	if (ListRepInitAttempt(interp, size, elemObjs, &listRep) != TCL_OK) {
+	    return TCL_ERROR;
+	}
     } else if (TclHasInternalRep(objPtr,&tclArithSeriesType.objType)) {
 	/*
 	 * Convertion from Arithmetic Series is a special case
@@ -0,0 +1,347 @@
+/*
+ * tclListView.c --
+ *
+ *	This file contains the list view representation. A list view presents
+ *	the elements of another list at a constant stride, which may be
+ *	negative, so that reversing a large list or taking a range of such a
+ *	reversal costs constant time and memory instead of a copy of the
+ *	element array.
+ *
+ * See the file "license.terms" for information on usage and redistribution of
+ * this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ */
+
+#include "tclInt.h"
+#include "tclListView.h"
+
+/*
+ * The internal representation of a list view. The viewed list is held in a
+ * private list value that nothing else refers to, so its elements cannot
+ * change under the view. Duplicated views share the representation.
+ */
+
+typedef struct {
+    size_t refCount;		/* Number of values using this view. */
+    Tcl_Obj *baseObj;		/* Private list value holding the elements. */
+    Tcl_Size start;		/* Index in baseObj of the first element. */
+    Tcl_Size stride;		/* Distance in baseObj between consecutive
+				 * elements of the view. Never 0 or 1. */
+    Tcl_Size length;		/* Number of elements in the view. */
+    Tcl_Obj **elements;		/* Array of the elements in view order, made
+				 * on demand, or NULL. The elements are kept
+				 * alive by baseObj. */
+} ListView;
+
+#define ListViewGetRep(objPtr) \
+    ((ListView *) (objPtr)->internalRep.twoPtrValue.ptr1)
+
+/*
+ * Prototypes for procedures defined later in this file:
+ */
+
+static void		DupListViewInternalRep(Tcl_Obj *srcPtr,
+			    Tcl_Obj *copyPtr);
+static void		FreeListViewInternalRep(Tcl_Obj *viewObj);
+static Tcl_Size		ListViewObjLength(Tcl_Obj *viewObj);
+static void		UpdateStringOfListView(Tcl_Obj *viewObj);
+
+/*
+ * The list view type. Like the arithmetic series it is an abstract list:
+ * it is not created from a string, but list operations that know about it
+ * work on it without converting it to an ordinary list.
+ */
+
+const TclObjTypeWithAbstractList tclListViewType = {
+    {"listview",			/* name */
+    FreeListViewInternalRep,		/* freeIntRepProc */
+    DupListViewInternalRep,		/* dupIntRepProc */
+    UpdateStringOfListView,		/* updateStringProc */
+    NULL,				/* setFromAnyProc */
+    TCL_OBJTYPE_V0_1(
+    ListViewObjLength
+    )}
+};
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ListViewSetRep, FreeListViewInternalRep, DupListViewInternalRep --
+ *
+ *	Attachment, release and duplication of the internal representation.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ListViewSetRep(
+    Tcl_Obj *viewObj,
+    ListView *viewPtr)
+{
+    viewPtr->refCount++;
+    viewObj->internalRep.twoPtrValue.ptr1 = viewPtr;
+    viewObj->internalRep.twoPtrValue.ptr2 = NULL;
+    viewObj->typePtr = &tclListViewType.objType;
+}
+
+static void
+FreeListViewInternalRep(
+    Tcl_Obj *viewObj)
+{
+    ListView *viewPtr = ListViewGetRep(viewObj);
+
+    if (viewPtr->refCount-- <= 1) {
+	if (viewPtr->elements != NULL) {
+	    Tcl_Free(viewPtr->elements);
+	}
+	Tcl_DecrRefCount(viewPtr->baseObj);
+	Tcl_Free(viewPtr);
+    }
+    viewObj->internalRep.twoPtrValue.ptr1 = NULL;
+}
+
+static void
+DupListViewInternalRep(
+    Tcl_Obj *srcPtr,
+    Tcl_Obj *copyPtr)
+{
+    ListViewSetRep(copyPtr, ListViewGetRep(srcPtr));
+}
+
+static Tcl_Size
+ListViewObjLength(
+    Tcl_Obj *viewObj)
+{
+    return ListViewGetRep(viewObj)->length;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * UpdateStringOfListView --
+ *
+ *	Generate the string representation, which is the one of an ordinary
+ *	list with the same elements.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+UpdateStringOfListView(
+    Tcl_Obj *viewObj)
+{
+    Tcl_Obj **elements, *listObj;
+    Tcl_Size objc, length;
+    const char *bytes;
+
+    TclListViewGetElements(viewObj, &objc, &elements);
+    listObj = Tcl_NewListObj(objc, elements);
+    Tcl_IncrRefCount(listObj);
+    bytes = Tcl_GetStringFromObj(listObj, &length);
+    TclInitStringRep(viewObj, bytes, length);
+    Tcl_DecrRefCount(listObj);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclNewListViewObj --
+ *
+ *	Create a view of length elements of a list, starting at index start
+ *	and stepping by stride. The list must be an ordinary list, for which
+ *	stride must not be 1, or a list view, and the indices must be within
+ *	it. A view of a view refers to the underlying list directly.
+ *
+ * Results:
+ *	A new value with refcount 0. When the resulting elements are
+ *	contiguous and in order, this is an ordinary list sharing the storage
+ *	of the viewed list.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_Obj *
+TclNewListViewObj(
+    Tcl_Obj *listObj,		/* List or view to take elements from. */
+    Tcl_Size start,		/* Index of the first element. */
+    Tcl_Size stride,		/* Step between elements, not 0. */
+    Tcl_Size length)		/* Number of elements, more than 0. */
+{
+    ListView *viewPtr;
+    Tcl_Obj *baseObj, *viewObj;
+
+    if (TclHasInternalRep(listObj, &tclListViewType.objType)) {
+	ListView *srcPtr = ListViewGetRep(listObj);
+
+	baseObj = srcPtr->baseObj;
+	start = srcPtr->start + start * srcPtr->stride;
+	stride *= srcPtr->stride;
+    } else {
+	baseObj = listObj;
+    }
+
+    if (stride == 1) {
+	/*
+	 * Keep the (possibly private) list shared while taking the range so
+	 * that it is not sliced in place.
+	 */
+
+	Tcl_IncrRefCount(baseObj);
+	viewObj = TclListObjRange(NULL, baseObj, start, start + length - 1);
+	Tcl_DecrRefCount(baseObj);
+	return viewObj;
+    }
+
+    if (baseObj == listObj) {
+	baseObj = TclDuplicatePureObj(NULL, listObj, &tclListType.objType);
+	if (baseObj == NULL) {
+	    return NULL;
+	}
+    }
+
+    viewPtr = (ListView *)Tcl_Alloc(sizeof(ListView));
+    viewPtr->refCount = 0;
+    viewPtr->baseObj = baseObj;
+    Tcl_IncrRefCount(baseObj);
+    viewPtr->start = start;
+    viewPtr->stride = stride;
+    viewPtr->length = length;
+    viewPtr->elements = NULL;
+
+    TclNewObj(viewObj);
+    TclInvalidateStringRep(viewObj);
+    ListViewSetRep(viewObj, viewPtr);
+    return viewObj;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclListViewObjIndex --
+ *
+ *	Give access to one element of a list view.
+ *
+ * Results:
+ *	The element, which the view keeps a reference to, or NULL if the
+ *	index is out of range.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_Obj *
+TclListViewObjIndex(
+    Tcl_Obj *viewObj,
+    Tcl_Size index)
+{
+    ListView *viewPtr = ListViewGetRep(viewObj);
+
+    if (index < 0 || index >= viewPtr->length) {
+	return NULL;
+    }
+    return TclListObjGetElement(viewPtr->baseObj,
+	    viewPtr->start + index * viewPtr->stride);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclListViewGetElements --
+ *
+ *	Give access to the elements of a list view as an array, as for an
+ *	ordinary list. The array is made the first time it is asked for.
+ *
+ * Results:
+ *	TCL_OK.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclListViewGetElements(
+    Tcl_Obj *viewObj,
+    Tcl_Size *objcPtr,
+    Tcl_Obj ***objvPtr)
+{
+    ListView *viewPtr = ListViewGetRep(viewObj);
+
+    if (viewPtr->elements == NULL) {
+	Tcl_Obj **baseElems, **elements;
+	Tcl_Size i, baseLen, pos = viewPtr->start;
+
+	TclListObjGetElementsM(NULL, viewPtr->baseObj, &baseLen, &baseElems);
+	elements = (Tcl_Obj **)
+		Tcl_Alloc(viewPtr->length * sizeof(Tcl_Obj *));
+	for (i = 0; i < viewPtr->length; i++, pos += viewPtr->stride) {
+	    elements[i] = baseElems[pos];
+	}
+	viewPtr->elements = elements;
+    }
+    *objcPtr = viewPtr->length;
+    *objvPtr = viewPtr->elements;
+    return TCL_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclListViewObjRange, TclListViewObjReverse --
+ *
+ *	Make a slice or a reversal of a list view. The indices of a range are
+ *	clamped to the view.
+ *
+ * Results:
+ *	A new value with refcount 0. Short results are ordinary lists, so
+ *	that they do not keep a large viewed list alive.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_Obj *
+TclListViewObjRange(
+    Tcl_Obj *viewObj,
+    Tcl_Size fromIdx,
+    Tcl_Size toIdx)
+{
+    ListView *viewPtr = ListViewGetRep(viewObj);
+    Tcl_Obj *resultObj, **elements;
+    Tcl_Size objc;
+
+    if (fromIdx < 0) {
+	fromIdx = 0;
+    }
+    if (toIdx >= viewPtr->length) {
+	toIdx = viewPtr->length - 1;
+    }
+    if (fromIdx > toIdx) {
+	TclNewObj(resultObj);
+	return resultObj;
+    }
+    if (fromIdx == 0 && toIdx == viewPtr->length - 1) {
+	TclNewObj(resultObj);
+	TclInvalidateStringRep(resultObj);
+	ListViewSetRep(resultObj, viewPtr);
+	return resultObj;
+    }
+    if (toIdx - fromIdx + 1 >= LIST_VIEW_MIN_LENGTH) {
+	return TclNewListViewObj(viewObj, fromIdx, 1, toIdx - fromIdx + 1);
+    }
+    TclListViewGetElements(viewObj, &objc, &elements);
+    return Tcl_NewListObj(toIdx - fromIdx + 1, elements + fromIdx);
+}
+
+Tcl_Obj *
+TclListViewObjReverse(
+    Tcl_Obj *viewObj)
+{
+    ListView *viewPtr = ListViewGetRep(viewObj);
+
+    return TclNewListViewObj(viewObj, viewPtr->length - 1, -1,
+	    viewPtr->length);
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 4
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,39 @@
+/*
+ * tclListView.h --
+ *
+ *	This file contains the declarations for list views, which present a
+ *	strided slice of another list, possibly in reverse order, without
+ *	copying its elements.
+ *
+ * See the file "license.terms" for information on usage and redistribution of
+ * this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ */
+
+#ifndef _TCLLISTVIEW
+#define _TCLLISTVIEW
+
+/*
+ * Lists shorter than this are copied rather than viewed.
+ */
+
+#define LIST_VIEW_MIN_LENGTH 64
+
+MODULE_SCOPE Tcl_Obj *	TclNewListViewObj(Tcl_Obj *listObj, Tcl_Size start,
+			    Tcl_Size stride, Tcl_Size length);
+MODULE_SCOPE Tcl_Obj *	TclListViewObjIndex(Tcl_Obj *viewObj,
+			    Tcl_Size index);
+MODULE_SCOPE int	TclListViewGetElements(Tcl_Obj *viewObj,
+			    Tcl_Size *objcPtr, Tcl_Obj ***objvPtr);
+MODULE_SCOPE Tcl_Obj *	TclListViewObjRange(Tcl_Obj *viewObj,
+			    Tcl_Size fromIdx, Tcl_Size toIdx);
+MODULE_SCOPE Tcl_Obj *	TclListViewObjReverse(Tcl_Obj *viewObj);
+
+#endif /* _TCLLISTVIEW */
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 4
+ * fill-column: 78
+ * End:
+ */
@@ -32,10 +32,6 @@ static size_t		AddLocalLiteralEntry(CompileEnv *envPtr,
 			    Tcl_Obj *objPtr, int localHash);
 static void		ExpandLocalLiteralArray(CompileEnv *envPtr);
 static size_t		HashString(const char *string, size_t length);
-#ifdef TCL_COMPILE_DEBUG
-static LiteralEntry *	LookupLiteralEntry(Tcl_Interp *interp,
-			    Tcl_Obj *objPtr);
-#endif
 static void		RebuildLiteralTable(LiteralTable *tablePtr);
 
 /*
@@ -272,7 +268,7 @@ TclCreateLiteral(
      * Yes, add it to the global literal table.
      */
 #ifdef TCL_COMPILE_DEBUG
-    if (LookupLiteralEntry((Tcl_Interp *) iPtr, objPtr) != NULL) {
+    if (TclLookupLiteralEntry((Tcl_Interp *) iPtr, objPtr) != NULL) {
 	Tcl_Panic("%s: literal \"%.*s\" found globally but shouldn't be",
 		"TclRegisterLiteral", (length>60? 60 : (int)length), bytes);
     }
@@ -485,14 +481,13 @@ TclRegisterLiteral(
     return objIndex;
 }
 
-#ifdef TCL_COMPILE_DEBUG
 /*
  *----------------------------------------------------------------------
  *
- * LookupLiteralEntry --
+ * TclLookupLiteralEntry --
  *
- *	Finds the LiteralEntry that corresponds to a literal Tcl object
- *	holding a literal.
+ *	Finds the LiteralEntry of the interpreter's global literal table that
+ *	corresponds to a literal Tcl object holding a literal.
  *
  * Results:
  *	Returns the matching LiteralEntry if found, otherwise NULL.
@@ -503,8 +498,8 @@ TclRegisterLiteral(
  *----------------------------------------------------------------------
  */
 
-static LiteralEntry *
-LookupLiteralEntry(
+LiteralEntry *
+TclLookupLiteralEntry(
     Tcl_Interp *interp,		/* Interpreter for which objPtr was created to
 				 * hold a literal. */
     Tcl_Obj *objPtr)	/* Points to a Tcl object holding a literal
@@ -515,7 +510,8 @@ LookupLiteralEntry(
     LiteralTable *globalTablePtr = &iPtr->literalTable;
     LiteralEntry *entryPtr;
     const char *bytes;
-    size_t globalHash, length;
+    size_t globalHash;
+    Tcl_Size length;
 
     bytes = Tcl_GetStringFromObj(objPtr, &length);
     globalHash = (HashString(bytes, length) & globalTablePtr->mask);
@@ -528,7 +524,6 @@ LookupLiteralEntry(
     return NULL;
 }
 
-#endif
 /*
  *----------------------------------------------------------------------
  *
@@ -913,45 +908,12 @@ HashString(
     const char *string,	/* String for which to compute hash value. */
     size_t length)			/* Number of bytes in the string. */
 {
-    size_t result = 0;
-
     /*
-     * I tried a zillion different hash functions and asked many other people
-     * for advice. Many people had their own favorite functions, all
-     * different, but no-one had much idea why they were good ones. I chose
-     * the one below (multiply by 9 and add new character) because of the
-     * following reasons:
-     *
-     * 1. Multiplying by 10 is perfect for keys that are decimal strings, and
-     *    multiplying by 9 is just about as good.
-     * 2. Times-9 is (shift-left-3) plus (old). This means that each
-     *    character's bits hang around in the low-order bits of the hash value
-     *    for ever, plus they spread fairly rapidly up to the high-order bits
-     *    to fill out the hash value. This seems works well both for decimal
-     *    and non-decimal strings.
-     *
-     * Note that this function is very weak against malicious strings; it's
-     * very easy to generate multiple keys that have the same hashcode. On the
-     * other hand, that hardly ever actually occurs and this function *is*
-     * very cheap, even by comparison with industry-standard hashes like FNV.
-     * If real strength of hash is required though, use a custom hash based on
-     * Bob Jenkins's lookup3(), but be aware that it's significantly slower.
-     * Tcl scripts tend to not have a big issue in this area, and literals
-     * mostly aren't looked up by name anyway.
-     *
-     * See also HashStringKey in tclHash.c.
-     * See also TclObjHashKey in tclObj.c.
-     *
-     * See [tcl-Feature Request #2958832]
+     * Literals are hashed like string and Tcl_Obj keys; see TclHashBytes in
+     * tclHash.c.
      */
 
-    if (length > 0) {
-	result = UCHAR(*string);
-	while (--length) {
-	    result += (result << 3) + UCHAR(*++string);
-	}
-    }
-    return result;
+    return TclHashBytes(string, length);
 }
 
 /*
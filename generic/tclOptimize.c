@@ -19,6 +19,7 @@
 
 static void		AdvanceJumps(CompileEnv *envPtr);
 static void		ConvertZeroEffectToNOP(CompileEnv *envPtr);
+static void		FuseInstructions(CompileEnv *envPtr);
 static void		LocateTargetAddresses(CompileEnv *envPtr,
 			    Tcl_HashTable *tablePtr);
 static void		TrimUnreachable(CompileEnv *envPtr);
@@ -88,6 +89,7 @@ LocateTargetAddresses(
 	case INST_JUMP_TRUE4:
 	case INST_JUMP_FALSE4:
 	case INST_START_CMD:
+	case INST_INLINE_GUARD:
 	    targetInstPtr = currentInstPtr+TclGetInt4AtPtr(currentInstPtr+1);
 	    goto storeTarget;
 	case INST_BEGIN_CATCH4:
@@ -414,6 +416,77 @@ AdvanceJumps(
     }
 }
 
+/*
+ * ----------------------------------------------------------------------
+ *
+ * FuseInstructions --
+ *
+ *	Mark common instruction sequences for execution as a single
+ *	superinstruction, to save on dispatches in tight loops. Only the
+ *	opcode of the first instruction of the sequence is replaced; the
+ *	covered instructions stay as they are, as the superinstruction falls
+ *	back to running them whenever its fast path doesn't apply. This means
+ *	that jumps into the middle of a sequence keep working, but also that
+ *	this must be the last pass over the code.
+ *
+ * ----------------------------------------------------------------------
+ */
+
+static void
+FuseInstructions(
+    CompileEnv *envPtr)
+{
+    unsigned char *currentInstPtr, *nextInstPtr;
+
+    for (currentInstPtr = envPtr->codeStart ;
+	    currentInstPtr < envPtr->codeNext ;
+	    currentInstPtr = nextInstPtr) {
+	nextInstPtr = currentInstPtr + AddrLength(currentInstPtr);
+	if (nextInstPtr >= envPtr->codeNext) {
+	    break;
+	}
+
+	switch (*currentInstPtr) {
+	case INST_LOAD_SCALAR1:
+	    /*
+	     * loadScalar1 (push1|loadScalar1) add storeScalar1
+	     * loadScalar1 listIndex
+	     */
+
+	    if (*nextInstPtr == INST_LIST_INDEX) {
+		*currentInstPtr = INST_LIST_INDEX_SCALAR1;
+	    } else if ((*nextInstPtr == INST_PUSH1
+		    || *nextInstPtr == INST_LOAD_SCALAR1)
+		    && nextInstPtr + 5 <= envPtr->codeNext
+		    && nextInstPtr[2] == INST_ADD
+		    && nextInstPtr[3] == INST_STORE_SCALAR1) {
+		*currentInstPtr = (*nextInstPtr == INST_PUSH1)
+			? INST_ADD_SCALAR_LIT1 : INST_ADD_SCALAR_SCALAR1;
+	    }
+	    break;
+	case INST_EQ:
+	case INST_NEQ:
+	case INST_LT:
+	case INST_GT:
+	case INST_LE:
+	case INST_GE:
+	    /*
+	     * Comparison followed by a conditional jump.
+	     */
+
+	    switch (*nextInstPtr) {
+	    case INST_JUMP_TRUE1:
+	    case INST_JUMP_FALSE1:
+	    case INST_JUMP_TRUE4:
+	    case INST_JUMP_FALSE4:
+		*currentInstPtr += INST_EQ_JUMP - INST_EQ;
+		break;
+	    }
+	    break;
+	}
+    }
+}
+
 /*
  * ----------------------------------------------------------------------
  *
@@ -431,6 +504,7 @@ TclOptimizeBytecode(
     ConvertZeroEffectToNOP((CompileEnv *)envPtr);
     AdvanceJumps((CompileEnv *)envPtr);
     TrimUnreachable((CompileEnv *)envPtr);
+    FuseInstructions((CompileEnv *)envPtr);
 }
 
 /*
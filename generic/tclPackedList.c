@@ -0,0 +1,879 @@
+/*
+ * tclPackedList.c --
+ *
+ *	This file contains the packed numeric list representation. A packed
+ *	list holds only integers or only doubles, stored unboxed in a
+ *	contiguous array, and boxes its elements into Tcl_Obj values on demand.
+ *
+ * See the file "license.terms" for information on usage and redistribution of
+ * this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ */
+
+#include "tclInt.h"
+#include "tclPackedList.h"
+#include <math.h>
+
+/*
+ * The storage of a packed list. It is shared between duplicated values and
+ * only modified in place when not shared. The boxed elements array, when
+ * present, has room for capacity elements; unboxed slots are NULL.
+ */
+
+typedef struct {
+    size_t refCount;		/* Number of values using this storage. */
+    Tcl_Size used;		/* Number of elements in the list. */
+    Tcl_Size capacity;		/* Number of elements there is room for. */
+    int isDouble;		/* Whether the elements are doubles rather
+				 * than integers. */
+    Tcl_Obj **elements;		/* Lazily boxed elements, or NULL. */
+    PackedValue values[TCLFLEXARRAY];
+				/* The elements themselves. */
+} PackedStore;
+
+#define PACKED_STORE_SIZE(n) \
+    (offsetof(PackedStore, values) + (size_t)(n) * sizeof(PackedValue))
+#define PACKED_MAX \
+    ((Tcl_Size) ((TCL_SIZE_MAX - offsetof(PackedStore, values)) \
+	    / sizeof(PackedValue)))
+#define PACKED_MIN_CAPACITY 8
+
+#define PackedListGetStore(objPtr) \
+    ((PackedStore *) (objPtr)->internalRep.twoPtrValue.ptr1)
+
+/*
+ * Prototypes for procedures defined later in this file:
+ */
+
+static void		DupPackedListInternalRep(Tcl_Obj *srcPtr,
+			    Tcl_Obj *copyPtr);
+static void		FreePackedListInternalRep(Tcl_Obj *listObj);
+static Tcl_Size		PackedListObjLength(Tcl_Obj *listObj);
+static void		UpdateStringOfPackedList(Tcl_Obj *listObj);
+
+/*
+ * The packed list type. Like the arithmetic series it is an abstract list:
+ * it is not created from a string, but list operations that know about it
+ * work on it without converting it to a list of boxed values.
+ */
+
+const TclObjTypeWithAbstractList tclPackedListType = {
+    {"packedlist",			/* name */
+    FreePackedListInternalRep,		/* freeIntRepProc */
+    DupPackedListInternalRep,		/* dupIntRepProc */
+    UpdateStringOfPackedList,		/* updateStringProc */
+    NULL,				/* setFromAnyProc */
+    TCL_OBJTYPE_V0_1(
+    PackedListObjLength
+    )}
+};
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * NewPackedStore, ReleasePackedStore, PackedListSetRep --
+ *
+ *	Allocation, release and attachment of packed list storage.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static PackedStore *
+NewPackedStore(
+    int isDouble,
+    Tcl_Size capacity)
+{
+    PackedStore *storePtr = (PackedStore *)
+	    Tcl_Alloc(PACKED_STORE_SIZE(capacity));
+
+    storePtr->refCount = 0;
+    storePtr->used = 0;
+    storePtr->capacity = capacity;
+    storePtr->isDouble = isDouble;
+    storePtr->elements = NULL;
+    return storePtr;
+}
+
+static void
+ReleasePackedStore(
+    PackedStore *storePtr)
+{
+    if (storePtr->refCount-- > 1) {
+	return;
+    }
+    if (storePtr->elements != NULL) {
+	Tcl_Size i;
+
+	for (i = 0; i < storePtr->used; i++) {
+	    if (storePtr->elements[i] != NULL) {
+		Tcl_DecrRefCount(storePtr->elements[i]);
+	    }
+	}
+	Tcl_Free(storePtr->elements);
+    }
+    Tcl_Free(storePtr);
+}
+
+static void
+PackedListSetRep(
+    Tcl_Obj *listObj,
+    PackedStore *storePtr)
+{
+    storePtr->refCount++;
+    listObj->internalRep.twoPtrValue.ptr1 = storePtr;
+    listObj->internalRep.twoPtrValue.ptr2 = NULL;
+    listObj->typePtr = &tclPackedListType.objType;
+}
+
+static inline Tcl_Obj *
+BoxValue(
+    PackedStore *storePtr,
+    Tcl_Size index)
+{
+    if (storePtr->isDouble) {
+	return Tcl_NewDoubleObj(storePtr->values[index].doubleValue);
+    }
+    return Tcl_NewWideIntObj(storePtr->values[index].wideValue);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * FreePackedListInternalRep, DupPackedListInternalRep --
+ *
+ *	Release and duplicate the internal representation. Duplicates share
+ *	the storage, which is copied when either of them is modified.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+FreePackedListInternalRep(
+    Tcl_Obj *listObj)
+{
+    ReleasePackedStore(PackedListGetStore(listObj));
+    listObj->internalRep.twoPtrValue.ptr1 = NULL;
+}
+
+static void
+DupPackedListInternalRep(
+    Tcl_Obj *srcPtr,
+    Tcl_Obj *copyPtr)
+{
+    PackedListSetRep(copyPtr, PackedListGetStore(srcPtr));
+}
+
+static Tcl_Size
+PackedListObjLength(
+    Tcl_Obj *listObj)
+{
+    return PackedListGetStore(listObj)->used;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * UpdateStringOfPackedList --
+ *
+ *	Generate the string representation. Integers and doubles need no
+ *	quoting, so the elements are simply separated by spaces.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+UpdateStringOfPackedList(
+    Tcl_Obj *listObj)
+{
+    PackedStore *storePtr = PackedListGetStore(listObj);
+    size_t maxLength = (size_t) storePtr->used *
+	    ((storePtr->isDouble ? TCL_DOUBLE_SPACE : TCL_INTEGER_SPACE) + 1);
+    Tcl_Size i;
+    char *start, *p;
+
+    if (maxLength > (size_t) TCL_SIZE_MAX) {
+	Tcl_Panic("max size for a Tcl value (%" TCL_SIZE_MODIFIER
+		"d bytes) exceeded", TCL_SIZE_MAX);
+    }
+    start = p = Tcl_InitStringRep(listObj, NULL, maxLength);
+    TclOOM(p, maxLength);
+    for (i = 0; i < storePtr->used; i++) {
+	if (i > 0) {
+	    *p++ = ' ';
+	}
+	if (storePtr->isDouble) {
+	    Tcl_PrintDouble(NULL, storePtr->values[i].doubleValue, p);
+	    p += strlen(p);
+	} else {
+	    p += snprintf(p, TCL_INTEGER_SPACE, "%" TCL_LL_MODIFIER "d",
+		    storePtr->values[i].wideValue);
+	}
+    }
+    (void) Tcl_InitStringRep(listObj, NULL, p - start);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclNewPackedListObj --
+ *
+ *	Create a packed list of the given non-zero length, whose values the
+ *	caller fills in through *valuesPtr. The returned value has refcount 0.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_Obj *
+TclNewPackedListObj(
+    int isDouble,
+    Tcl_Size length,
+    PackedValue **valuesPtr)
+{
+    PackedStore *storePtr = NewPackedStore(isDouble, length);
+    Tcl_Obj *listObj;
+
+    storePtr->used = length;
+    TclNewObj(listObj);
+    TclInvalidateStringRep(listObj);
+    PackedListSetRep(listObj, storePtr);
+    *valuesPtr = storePtr->values;
+    return listObj;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclGetPackableValue --
+ *
+ *	Decide whether a value can be stored in a packed list: it must be an
+ *	integer or a double whose string representation, if it has one, is
+ *	the canonical one, so that boxing the value again reproduces it.
+ *
+ * Results:
+ *	1 with *isDoublePtr and *valuePtr set when the value is packable,
+ *	otherwise 0.
+ *
+ * Side effects:
+ *	A short string may be given a numeric internal representation.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclGetPackableValue(
+    Tcl_Obj *objPtr,
+    int *isDoublePtr,
+    PackedValue *valuePtr)
+{
+    char buf[TCL_DOUBLE_SPACE + TCL_INTEGER_SPACE];
+    Tcl_Size length;
+
+    if (objPtr->typePtr == &tclIntType.objType) {
+	valuePtr->wideValue = objPtr->internalRep.wideValue;
+	*isDoublePtr = 0;
+    } else if (objPtr->typePtr == &tclDoubleType.objType) {
+	valuePtr->doubleValue = objPtr->internalRep.doubleValue;
+	*isDoublePtr = 1;
+    } else if (objPtr->bytes == NULL || objPtr->length == 0
+	    || objPtr->length > TCL_DOUBLE_SPACE) {
+	return 0;
+    } else {
+	void *clientData;
+	int type;
+
+	if (Tcl_GetNumberFromObj(NULL, objPtr, &clientData,
+		&type) != TCL_OK) {
+	    return 0;
+	}
+	if (type == TCL_NUMBER_INT) {
+	    valuePtr->wideValue = *(Tcl_WideInt *) clientData;
+	    *isDoublePtr = 0;
+	} else if (type == TCL_NUMBER_DOUBLE) {
+	    valuePtr->doubleValue = *(double *) clientData;
+	    *isDoublePtr = 1;
+	} else {
+	    return 0;
+	}
+    }
+
+    if (*isDoublePtr && isnan(valuePtr->doubleValue)) {
+	return 0;
+    }
+    if (objPtr->bytes == NULL) {
+	return 1;
+    }
+    if (*isDoublePtr) {
+	Tcl_PrintDouble(NULL, valuePtr->doubleValue, buf);
+	length = strlen(buf);
+    } else {
+	length = snprintf(buf, sizeof(buf), "%" TCL_LL_MODIFIER "d",
+		valuePtr->wideValue);
+    }
+    return (length == objPtr->length
+	    && memcmp(buf, objPtr->bytes, length) == 0);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclNewPackedListFromObjv --
+ *
+ *	Create a packed list holding the given values.
+ *
+ * Results:
+ *	A new value with refcount 0, or NULL if there are no values or they
+ *	are not all packable integers or all packable doubles.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_Obj *
+TclNewPackedListFromObjv(
+    Tcl_Size objc,
+    Tcl_Obj *const objv[])
+{
+    PackedStore *storePtr;
+    PackedValue value;
+    int isDouble, elemIsDouble;
+    Tcl_Size i;
+    Tcl_Obj *listObj;
+
+    if (objc <= 0 || !TclGetPackableValue(objv[0], &isDouble, &value)) {
+	return NULL;
+    }
+    storePtr = NewPackedStore(isDouble, objc);
+    storePtr->values[0] = value;
+    for (i = 1; i < objc; i++) {
+	if (!TclGetPackableValue(objv[i], &elemIsDouble,
+		&storePtr->values[i]) || elemIsDouble != isDouble) {
+	    Tcl_Free(storePtr);
+	    return NULL;
+	}
+    }
+    storePtr->used = objc;
+    TclNewObj(listObj);
+    TclInvalidateStringRep(listObj);
+    PackedListSetRep(listObj, storePtr);
+    return listObj;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclGetPackedListValues --
+ *
+ *	Give direct read access to the values of a packed list.
+ *
+ * Results:
+ *	1 if the value is a packed list, with the out parameters set;
+ *	otherwise 0.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclGetPackedListValues(
+    Tcl_Obj *listObj,
+    int *isDoublePtr,
+    Tcl_Size *lengthPtr,
+    PackedValue **valuesPtr)
+{
+    PackedStore *storePtr;
+
+    if (!TclHasInternalRep(listObj, &tclPackedListType.objType)) {
+	return 0;
+    }
+    storePtr = PackedListGetStore(listObj);
+    *isDoublePtr = storePtr->isDouble;
+    *lengthPtr = storePtr->used;
+    *valuesPtr = storePtr->values;
+    return 1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclPackedListObjIndex --
+ *
+ *	Box one element of a packed list.
+ *
+ * Results:
+ *	A new value with refcount 0; the empty value if the index is out of
+ *	range.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_Obj *
+TclPackedListObjIndex(
+    Tcl_Obj *listObj,
+    Tcl_Size index)
+{
+    PackedStore *storePtr = PackedListGetStore(listObj);
+    Tcl_Obj *objPtr;
+
+    if (index < 0 || index >= storePtr->used) {
+	TclNewObj(objPtr);
+	return objPtr;
+    }
+    return BoxValue(storePtr, index);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclPackedListObjElement, TclPackedListGetElements --
+ *
+ *	Give access to boxed elements that the list keeps a reference to, for
+ *	callers that expect to borrow elements as they would from an ordinary
+ *	list. Elements are boxed the first time they are asked for.
+ *
+ * Results:
+ *	TclPackedListObjElement returns the element, or NULL if the index is
+ *	out of range. TclPackedListGetElements returns TCL_OK with the whole
+ *	array of elements.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_Obj **
+PackedListElements(
+    PackedStore *storePtr)
+{
+    if (storePtr->elements == NULL) {
+	storePtr->elements = (Tcl_Obj **)
+		Tcl_Alloc(storePtr->capacity * sizeof(Tcl_Obj *));
+	memset(storePtr->elements, 0,
+		storePtr->capacity * sizeof(Tcl_Obj *));
+    }
+    return storePtr->elements;
+}
+
+Tcl_Obj *
+TclPackedListObjElement(
+    Tcl_Obj *listObj,
+    Tcl_Size index)
+{
+    PackedStore *storePtr = PackedListGetStore(listObj);
+    Tcl_Obj **elements;
+
+    if (index < 0 || index >= storePtr->used) {
+	return NULL;
+    }
+    elements = PackedListElements(storePtr);
+    if (elements[index] == NULL) {
+	elements[index] = BoxValue(storePtr, index);
+	Tcl_IncrRefCount(elements[index]);
+    }
+    return elements[index];
+}
+
+int
+TclPackedListGetElements(
+    Tcl_Obj *listObj,
+    Tcl_Size *objcPtr,
+    Tcl_Obj ***objvPtr)
+{
+    PackedStore *storePtr = PackedListGetStore(listObj);
+    Tcl_Obj **elements = PackedListElements(storePtr);
+    Tcl_Size i;
+
+    for (i = 0; i < storePtr->used; i++) {
+	if (elements[i] == NULL) {
+	    elements[i] = BoxValue(storePtr, i);
+	    Tcl_IncrRefCount(elements[i]);
+	}
+    }
+    *objcPtr = storePtr->used;
+    *objvPtr = elements;
+    return TCL_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclPackedListObjRange, TclPackedListObjReverse --
+ *
+ *	Make a slice or a reversed copy of a packed list. The indices of a
+ *	range are clamped to the list.
+ *
+ * Results:
+ *	A new value with refcount 0.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_Obj *
+TclPackedListObjRange(
+    Tcl_Obj *listObj,
+    Tcl_Size fromIdx,
+    Tcl_Size toIdx)
+{
+    PackedStore *storePtr = PackedListGetStore(listObj);
+    PackedValue *values;
+    Tcl_Obj *resultObj;
+
+    if (fromIdx < 0) {
+	fromIdx = 0;
+    }
+    if (toIdx >= storePtr->used) {
+	toIdx = storePtr->used - 1;
+    }
+    if (fromIdx > toIdx) {
+	TclNewObj(resultObj);
+	return resultObj;
+    }
+    if (fromIdx == 0 && toIdx == storePtr->used - 1) {
+	TclNewObj(resultObj);
+	TclInvalidateStringRep(resultObj);
+	PackedListSetRep(resultObj, storePtr);
+	return resultObj;
+    }
+    resultObj = TclNewPackedListObj(storePtr->isDouble, toIdx - fromIdx + 1,
+	    &values);
+    memcpy(values, storePtr->values + fromIdx,
+	    (toIdx - fromIdx + 1) * sizeof(PackedValue));
+    return resultObj;
+}
+
+Tcl_Obj *
+TclPackedListObjReverse(
+    Tcl_Obj *listObj)
+{
+    PackedStore *storePtr = PackedListGetStore(listObj);
+    PackedValue *values;
+    Tcl_Obj *resultObj;
+    Tcl_Size i, n = storePtr->used;
+
+    resultObj = TclNewPackedListObj(storePtr->isDouble, n, &values);
+    for (i = 0; i < n; i++) {
+	values[i] = storePtr->values[n - 1 - i];
+    }
+    return resultObj;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclPackedListObjAppend --
+ *
+ *	Append values to an unshared packed list, or start a packed list in
+ *	an unshared empty list.
+ *
+ * Results:
+ *	1 if the values were appended; 0 if the list is not packed or empty,
+ *	or the values do not all fit in it, in which case nothing was done and
+ *	the caller appends the ordinary way.
+ *
+ * Side effects:
+ *	The storage is copied first if it is shared with another value.
+ *
+ *----------------------------------------------------------------------
+ */
+
+#define PACKED_STATIC_VALUES 16
+
+int
+TclPackedListObjAppend(
+    Tcl_Obj *listObj,
+    Tcl_Size objc,
+    Tcl_Obj *const objv[])
+{
+    PackedStore *storePtr = NULL;
+    PackedValue staticValues[PACKED_STATIC_VALUES], *values = staticValues;
+    int isDouble, elemIsDouble, result = 0;
+    Tcl_Size i, needed;
+
+    if (Tcl_IsShared(listObj) || objc <= 0) {
+	return 0;
+    }
+    if (TclHasInternalRep(listObj, &tclPackedListType.objType)) {
+	storePtr = PackedListGetStore(listObj);
+	if (objc > PACKED_MAX - storePtr->used) {
+	    return 0;
+	}
+    } else {
+	Tcl_Size length;
+
+	if (listObj->typePtr == &tclListType.objType) {
+	    ListObjLength(listObj, length);
+	} else if (listObj->typePtr == NULL
+		&& listObj->bytes == &tclEmptyString) {
+	    length = 0;
+	} else {
+	    return 0;
+	}
+	if (length != 0 || objc > PACKED_MAX) {
+	    return 0;
+	}
+    }
+
+    /*
+     * Convert all the values before touching the storage: they may be
+     * elements boxed by this very list.
+     */
+
+    if (objc > PACKED_STATIC_VALUES) {
+	values = (PackedValue *) Tcl_Alloc(objc * sizeof(PackedValue));
+    }
+    isDouble = storePtr ? storePtr->isDouble : -1;
+    for (i = 0; i < objc; i++) {
+	if (!TclGetPackableValue(objv[i], &elemIsDouble, &values[i])) {
+	    goto done;
+	}
+	if (isDouble < 0) {
+	    isDouble = elemIsDouble;
+	} else if (elemIsDouble != isDouble) {
+	    goto done;
+	}
+    }
+
+    if (storePtr == NULL) {
+	storePtr = NewPackedStore(isDouble,
+		objc > PACKED_MIN_CAPACITY ? objc : PACKED_MIN_CAPACITY);
+	TclFreeInternalRep(listObj);
+	PackedListSetRep(listObj, storePtr);
+    } else if (storePtr->refCount > 1
+	    || objc > storePtr->capacity - storePtr->used) {
+	Tcl_Size newCapacity = storePtr->capacity;
+
+	needed = storePtr->used + objc;
+	if (needed > newCapacity) {
+	    newCapacity = (needed > PACKED_MAX / 2) ? PACKED_MAX : 2 * needed;
+	}
+	if (storePtr->refCount > 1) {
+	    PackedStore *newStorePtr = NewPackedStore(isDouble, newCapacity);
+
+	    memcpy(newStorePtr->values, storePtr->values,
+		    storePtr->used * sizeof(PackedValue));
+	    newStorePtr->used = storePtr->used;
+	    ReleasePackedStore(storePtr);
+	    storePtr = newStorePtr;
+	    PackedListSetRep(listObj, storePtr);
+	} else {
+	    storePtr = (PackedStore *) Tcl_Realloc(storePtr,
+		    PACKED_STORE_SIZE(newCapacity));
+	    storePtr->capacity = newCapacity;
+	    if (storePtr->elements != NULL) {
+		storePtr->elements = (Tcl_Obj **) Tcl_Realloc(
+			storePtr->elements, newCapacity * sizeof(Tcl_Obj *));
+	    }
+	    listObj->internalRep.twoPtrValue.ptr1 = storePtr;
+	}
+    }
+
+    for (i = 0; i < objc; i++) {
+	if (storePtr->elements != NULL) {
+	    storePtr->elements[storePtr->used] = NULL;
+	}
+	storePtr->values[storePtr->used++] = values[i];
+    }
+    TclInvalidateStringRep(listObj);
+    result = 1;
+
+  done:
+    if (values != staticValues) {
+	Tcl_Free(values);
+    }
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclPackedListObjSetElement --
+ *
+ *	Replace one element of an unshared packed list.
+ *
+ * Results:
+ *	1 if the element was replaced; 0 if the index is out of range or the
+ *	value does not fit in the list, in which case nothing was done.
+ *
+ * Side effects:
+ *	The storage is copied first if it is shared with another value.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclPackedListObjSetElement(
+    Tcl_Obj *listObj,
+    Tcl_Size index,
+    Tcl_Obj *valueObj)
+{
+    PackedStore *storePtr = PackedListGetStore(listObj);
+    PackedValue value;
+    int isDouble;
+
+    if (Tcl_IsShared(listObj) || index < 0 || index >= storePtr->used
+	    || !TclGetPackableValue(valueObj, &isDouble, &value)
+	    || isDouble != storePtr->isDouble) {
+	return 0;
+    }
+    if (storePtr->refCount > 1) {
+	PackedStore *newStorePtr = NewPackedStore(isDouble,
+		storePtr->capacity);
+
+	memcpy(newStorePtr->values, storePtr->values,
+		storePtr->used * sizeof(PackedValue));
+	newStorePtr->used = storePtr->used;
+	ReleasePackedStore(storePtr);
+	storePtr = newStorePtr;
+	PackedListSetRep(listObj, storePtr);
+    } else if (storePtr->elements != NULL
+	    && storePtr->elements[index] != NULL) {
+	Tcl_DecrRefCount(storePtr->elements[index]);
+	storePtr->elements[index] = NULL;
+    }
+    storePtr->values[index] = value;
+    TclInvalidateStringRep(listObj);
+    return 1;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclPackedListObjFind --
+ *
+ *	Find the first element of a packed list whose string is equal to the
+ *	string of a value, without boxing the elements. Only the canonical
+ *	form of a number can be equal to the string of an element.
+ *
+ * Results:
+ *	The index of the element, or TCL_INDEX_NONE.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_Size
+TclPackedListObjFind(
+    Tcl_Obj *listObj,
+    Tcl_Obj *valueObj)
+{
+    PackedStore *storePtr = PackedListGetStore(listObj);
+    PackedValue value;
+    int isDouble;
+    Tcl_Size i;
+
+    if (valueObj->bytes == NULL
+	    && valueObj->typePtr != &tclIntType.objType
+	    && valueObj->typePtr != &tclDoubleType.objType) {
+	(void) TclGetString(valueObj);
+    }
+    if (!TclGetPackableValue(valueObj, &isDouble, &value)
+	    || isDouble != storePtr->isDouble) {
+	return TCL_INDEX_NONE;
+    }
+
+    /*
+     * Distinct doubles have distinct canonical strings, so comparing the
+     * bits of the values compares their strings for both kinds of list.
+     */
+
+    for (i = 0; i < storePtr->used; i++) {
+	if (storePtr->values[i].wideValue == value.wideValue) {
+	    return i;
+	}
+    }
+    return TCL_INDEX_NONE;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclPackedListObjSort --
+ *
+ *	Sort a packed list by the numeric value of its elements, as [lsort
+ *	-integer] or [lsort -real] would. The sort is stable, and with unique
+ *	set only the last of each run of equal elements is kept.
+ *
+ * Results:
+ *	A new packed list with refcount 0: either the sorted elements or, if
+ *	indices is set, their indices in the original list.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+ComparePackedKeys(
+    const void *first,
+    const void *second)
+{
+    const TclSortKey *a = (const TclSortKey *) first;
+    const TclSortKey *b = (const TclSortKey *) second;
+
+    if (a->key != b->key) {
+	return (a->key < b->key) ? -1 : 1;
+    }
+    return (a->index < b->index) ? -1 : (a->index > b->index);
+}
+
+Tcl_Obj *
+TclPackedListObjSort(
+    Tcl_Obj *listObj,
+    int asDouble,
+    int isIncreasing,
+    int unique,
+    int indices)
+{
+    PackedStore *storePtr = PackedListGetStore(listObj);
+    Tcl_Size i, j, n = storePtr->used;
+    TclSortKey *items;
+    PackedValue *values;
+    Tcl_Obj *resultObj;
+
+    items = (TclSortKey *) Tcl_Alloc(n * sizeof(TclSortKey));
+    for (i = 0; i < n; i++) {
+	PackedValue value = storePtr->values[i];
+
+	if (!asDouble) {
+	    items[i].key = TclWideSortKey(value.wideValue);
+	} else if (storePtr->isDouble) {
+	    items[i].key = TclDoubleSortKey(value.doubleValue);
+	} else {
+	    items[i].key = TclDoubleSortKey((double) value.wideValue);
+	}
+
+	/*
+	 * Sorting decreasing by complemented keys keeps equal elements in
+	 * their original order, as the merge sort of [lsort] does.
+	 */
+
+	if (!isIncreasing) {
+	    items[i].key = ~items[i].key;
+	}
+	items[i].index = i;
+    }
+    if (!TclSortKeys(items, n)) {
+	qsort(items, n, sizeof(TclSortKey), ComparePackedKeys);
+    }
+
+    if (unique) {
+	for (i = j = 0; i < n; i++) {
+	    if (i + 1 < n && items[i].key == items[i + 1].key) {
+		continue;
+	    }
+	    items[j++] = items[i];
+	}
+	n = j;
+    }
+
+    resultObj = TclNewPackedListObj(indices ? 0 : storePtr->isDouble, n,
+	    &values);
+    for (i = 0; i < n; i++) {
+	if (indices) {
+	    values[i].wideValue = items[i].index;
+	} else {
+	    values[i] = storePtr->values[items[i].index];
+	}
+    }
+    Tcl_Free(items);
+    return resultObj;
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 4
+ * fill-column: 78
+ * End:
+ */
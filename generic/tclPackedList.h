@@ -0,0 +1,60 @@
+/*
+ * tclPackedList.h --
+ *
+ *	This file contains the declarations for the packed numeric list
+ *	representation, which stores a list of integers or of doubles unboxed
+ *	in a contiguous array.
+ *
+ * See the file "license.terms" for information on usage and redistribution of
+ * this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ */
+
+#ifndef _TCLPACKEDLIST
+#define _TCLPACKEDLIST
+
+/*
+ * A single element of a packed list. Whether the integer or the double member
+ * is in use is a property of the whole list.
+ */
+
+typedef union {
+    Tcl_WideInt wideValue;
+    double doubleValue;
+} PackedValue;
+
+MODULE_SCOPE Tcl_Obj *	TclNewPackedListObj(int isDouble, Tcl_Size length,
+			    PackedValue **valuesPtr);
+MODULE_SCOPE Tcl_Obj *	TclNewPackedListFromObjv(Tcl_Size objc,
+			    Tcl_Obj *const objv[]);
+MODULE_SCOPE int	TclGetPackableValue(Tcl_Obj *objPtr, int *isDoublePtr,
+			    PackedValue *valuePtr);
+MODULE_SCOPE int	TclGetPackedListValues(Tcl_Obj *listObj,
+			    int *isDoublePtr, Tcl_Size *lengthPtr,
+			    PackedValue **valuesPtr);
+MODULE_SCOPE Tcl_Obj *	TclPackedListObjIndex(Tcl_Obj *listObj,
+			    Tcl_Size index);
+MODULE_SCOPE Tcl_Obj *	TclPackedListObjElement(Tcl_Obj *listObj,
+			    Tcl_Size index);
+MODULE_SCOPE int	TclPackedListGetElements(Tcl_Obj *listObj,
+			    Tcl_Size *objcPtr, Tcl_Obj ***objvPtr);
+MODULE_SCOPE Tcl_Obj *	TclPackedListObjRange(Tcl_Obj *listObj,
+			    Tcl_Size fromIdx, Tcl_Size toIdx);
+MODULE_SCOPE Tcl_Obj *	TclPackedListObjReverse(Tcl_Obj *listObj);
+MODULE_SCOPE int	TclPackedListObjAppend(Tcl_Obj *listObj,
+			    Tcl_Size objc, Tcl_Obj *const objv[]);
+MODULE_SCOPE int	TclPackedListObjSetElement(Tcl_Obj *listObj,
+			    Tcl_Size index, Tcl_Obj *valueObj);
+MODULE_SCOPE Tcl_Size	TclPackedListObjFind(Tcl_Obj *listObj,
+			    Tcl_Obj *valueObj);
+MODULE_SCOPE Tcl_Obj *	TclPackedListObjSort(Tcl_Obj *listObj, int asDouble,
+			    int isIncreasing, int unique, int indices);
+
+#endif /* _TCLPACKEDLIST */
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 4
+ * fill-column: 78
+ * End:
+ */
@@ -1779,6 +1779,9 @@ TclNRInterpProcCore(
     procPtr->refCount++;
     ByteCodeGetInternalRep(procPtr->bodyPtr, &tclByteCodeType, codePtr);
 
+    if (iPtr->execStatsPtr) {
+	TclStartProcStats(interp, procPtr);
+    }
     TclNRAddCallback(interp, InterpProcNR2, procNameObj, errorProc,
 	    NULL, NULL);
     return TclNRExecuteByteCode(interp, codePtr);
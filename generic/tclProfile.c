@@ -0,0 +1,1082 @@
+/*
+ * tclProfile.c --
+ *
+ *	This file implements two ways of finding out where Tcl scripts spend
+ *	their time, both switchable at runtime in each interpreter.
+ *
+ *	The sampling profiler is controlled with [tcl::unsupported::profile].
+ *	While the profiler of an interpreter runs, a separate thread marks an
+ *	asynchronous handler at regular intervals; the handler is invoked by
+ *	the bytecode engine at its next safe point, and records the stack of
+ *	procedures then running. The counts of the distinct stacks are
+ *	reported in the "collapsed stack" format read by flame graph tools.
+ *
+ *	The execution statistics are controlled with
+ *	[tcl::unsupported::execstats]. While they are enabled, the bytecode
+ *	engine counts the instructions it executes, every command invocation
+ *	is counted, and the calls of procedures are counted and timed.
+ *
+ * See the file "license.terms" for information on usage and redistribution of
+ * this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ */
+
+#include "tclInt.h"
+#include "tclCompile.h"
+
+#define PROFILE_ASSOC_KEY	"tclProfiler"
+#define PROFILE_DEFAULT_INTERVAL 1000	/* Microseconds between samples. */
+#define EXECSTATS_ASSOC_KEY	"tclExecStats"
+
+/*
+ * Per-interpreter state of the profiler, kept as associated data.
+ */
+
+typedef struct {
+    Tcl_Interp *interp;		/* Interpreter being profiled. */
+    Tcl_AsyncHandler async;	/* Handler that takes the samples, or NULL if
+				 * the profiler is stopped. */
+    Tcl_ThreadId thread;	/* The thread that marks the handler. */
+    Tcl_Mutex lock;		/* Protects the running field... */
+    Tcl_Condition cond;		/* ... and wakes the thread when it changes. */
+    int running;		/* Set while the thread should keep marking
+				 * the handler. */
+    Tcl_WideInt interval;	/* Microseconds between two samples. */
+    int lines;			/* Whether to record the line number of the
+				 * innermost procedure in the samples. */
+    Tcl_HashTable stacks;	/* Maps each distinct stack (as a string) to
+				 * the number of samples of it. */
+    size_t numSamples;		/* Total number of samples taken. */
+} Profiler;
+
+/*
+ * The value of an entry in the commands table of the ExecStats.
+ */
+
+typedef struct {
+    Tcl_Obj *nameObj;		/* Full name of the command when it was first
+				 * invoked. */
+    size_t count;		/* Number of invocations. */
+} CommandStats;
+
+/*
+ * The value of an entry in the procs table of the ExecStats.
+ */
+
+typedef struct {
+    size_t calls;		/* Number of calls. */
+    long long time;		/* Microseconds spent in the calls, including
+				 * the procedures they called. */
+} ProcStats;
+
+/*
+ * A call of a procedure that is being timed.
+ */
+
+typedef struct {
+    Tcl_Obj *nameObj;		/* Name of the procedure. */
+    long long start;		/* When the call started, in microseconds. */
+} ProcCall;
+
+/*
+ * Prototypes for procedures defined later in this file:
+ */
+
+static void		AppendFrameName(Tcl_Interp *interp, Proc *procPtr,
+			    Tcl_Obj *namePtr);
+static int		CompareStacks(const void *first, const void *second);
+static void		DeleteExecStats(void *clientData, Tcl_Interp *interp);
+static void		DeleteProfiler(void *clientData, Tcl_Interp *interp);
+static Tcl_NRPostProc	FinishProcStats;
+static ExecStats *	GetExecStats(Tcl_Interp *interp);
+static Profiler *	GetProfiler(Tcl_Interp *interp);
+static void		ProfilerExitHandler(void *clientData);
+static void		RecordSample(Profiler *profPtr);
+static void		ResetExecStats(ExecStats *statsPtr);
+static void		ResetProfiler(Profiler *profPtr);
+static Tcl_AsyncProc	SampleProc;
+static Tcl_ThreadCreateProc SamplerThreadProc;
+static int		StartProfiler(Tcl_Interp *interp, Profiler *profPtr);
+static void		StopProfiler(Profiler *profPtr);
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetProfiler --
+ *
+ *	Returns the profiler of an interpreter, creating it (stopped) if
+ *	needed.
+ *
+ * Results:
+ *	The profiler.
+ *
+ * Side effects:
+ *	May allocate memory.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Profiler *
+GetProfiler(
+    Tcl_Interp *interp)
+{
+    Profiler *profPtr = (Profiler *)
+	    Tcl_GetAssocData(interp, PROFILE_ASSOC_KEY, NULL);
+
+    if (profPtr == NULL) {
+	profPtr = (Profiler *) Tcl_Alloc(sizeof(Profiler));
+	memset(profPtr, 0, sizeof(Profiler));
+	profPtr->interp = interp;
+	profPtr->interval = PROFILE_DEFAULT_INTERVAL;
+	Tcl_InitHashTable(&profPtr->stacks, TCL_STRING_KEYS);
+	Tcl_SetAssocData(interp, PROFILE_ASSOC_KEY, DeleteProfiler, profPtr);
+    }
+    return profPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * DeleteProfiler --
+ *
+ *	Stops and frees the profiler of an interpreter being deleted.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Frees memory.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+DeleteProfiler(
+    void *clientData,
+    TCL_UNUSED(Tcl_Interp *))
+{
+    Profiler *profPtr = (Profiler *) clientData;
+
+    StopProfiler(profPtr);
+    ResetProfiler(profPtr);
+    Tcl_DeleteHashTable(&profPtr->stacks);
+    Tcl_MutexFinalize(&profPtr->lock);
+    Tcl_ConditionFinalize(&profPtr->cond);
+    Tcl_Free(profPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ProfilerExitHandler --
+ *
+ *	Stops the profiler when its thread is finalized, before the
+ *	asynchronous handlers of the thread are.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	See StopProfiler.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ProfilerExitHandler(
+    void *clientData)
+{
+    StopProfiler((Profiler *) clientData);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * StartProfiler, StopProfiler --
+ *
+ *	Start and stop the thread that triggers the samples of a profiler.
+ *	Both do nothing if the profiler is already in the desired state.
+ *
+ * Results:
+ *	StartProfiler returns a standard Tcl result, with an error message in
+ *	the interpreter if the thread could not be created.
+ *
+ * Side effects:
+ *	Create or delete the asynchronous handler and the thread.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+StartProfiler(
+    Tcl_Interp *interp,
+    Profiler *profPtr)
+{
+    if (profPtr->async != NULL) {
+	return TCL_OK;
+    }
+    profPtr->async = Tcl_AsyncCreate(SampleProc, profPtr);
+    profPtr->running = 1;
+    if (Tcl_CreateThread(&profPtr->thread, SamplerThreadProc, profPtr,
+	    TCL_THREAD_STACK_DEFAULT, TCL_THREAD_JOINABLE) != TCL_OK) {
+	profPtr->running = 0;
+	Tcl_AsyncDelete(profPtr->async);
+	profPtr->async = NULL;
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(
+		"can't create the profiler thread", -1));
+	Tcl_SetErrorCode(interp, "TCL", "PROFILE", "THREAD", (char *)NULL);
+	return TCL_ERROR;
+    }
+    Tcl_CreateThreadExitHandler(ProfilerExitHandler, profPtr);
+    return TCL_OK;
+}
+
+static void
+StopProfiler(
+    Profiler *profPtr)
+{
+    int status;
+
+    if (profPtr->async == NULL) {
+	return;
+    }
+    Tcl_MutexLock(&profPtr->lock);
+    profPtr->running = 0;
+    Tcl_ConditionNotify(&profPtr->cond);
+    Tcl_MutexUnlock(&profPtr->lock);
+    Tcl_JoinThread(profPtr->thread, &status);
+
+    /*
+     * The thread is gone, so nothing can mark the handler any more.
+     */
+
+    Tcl_AsyncDelete(profPtr->async);
+    profPtr->async = NULL;
+    Tcl_DeleteThreadExitHandler(ProfilerExitHandler, profPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SamplerThreadProc --
+ *
+ *	The body of the thread of a running profiler: marks its asynchronous
+ *	handler once per interval until told to stop.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Makes the profiled thread take samples.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static Tcl_ThreadCreateType
+SamplerThreadProc(
+    void *clientData)
+{
+    Profiler *profPtr = (Profiler *) clientData;
+    Tcl_Time delay;
+
+    delay.sec = (long) (profPtr->interval / 1000000);
+    delay.usec = (long) (profPtr->interval % 1000000);
+
+    Tcl_MutexLock(&profPtr->lock);
+    while (profPtr->running) {
+	Tcl_ConditionWait(&profPtr->cond, &profPtr->lock, &delay);
+	if (profPtr->running) {
+	    Tcl_AsyncMark(profPtr->async);
+	}
+    }
+    Tcl_MutexUnlock(&profPtr->lock);
+    Tcl_ExitThread(TCL_OK);
+    TCL_THREAD_CREATE_RETURN;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * SampleProc --
+ *
+ *	The asynchronous handler of a profiler. It takes a sample when invoked
+ *	on behalf of the profiled interpreter; the bytecode engine then makes
+ *	its current frame visible to [info frame] and the like.
+ *
+ * Results:
+ *	The code passed in, unchanged.
+ *
+ * Side effects:
+ *	See RecordSample.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+SampleProc(
+    void *clientData,
+    Tcl_Interp *interp,
+    int code)
+{
+    Profiler *profPtr = (Profiler *) clientData;
+
+    if (interp == profPtr->interp) {
+	RecordSample(profPtr);
+    }
+    return code;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * RecordSample --
+ *
+ *	Takes one sample: walks the command frames of the interpreter to find
+ *	the procedures running, and counts the stack made of their names,
+ *	outermost first and separated by semicolons. Consecutive command
+ *	frames in the same procedure call (e.g., an [eval] in its body) count
+ *	once. Code running outside of any procedure is "(global)". If line
+ *	numbers are requested, the line of the innermost command is appended
+ *	to the innermost name, after a colon.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Updates the counts of the profiler.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+RecordSample(
+    Profiler *profPtr)
+{
+    Interp *iPtr = (Interp *) profPtr->interp;
+    CmdFrame *cfPtr;
+    CallFrame *lastFramePtr = NULL;
+    Tcl_Obj *namesPtr, **names;
+    Tcl_Size numNames, i;
+    Tcl_DString stack;
+    Tcl_HashEntry *hPtr;
+    int isNew, innermost = 1, line = -1;
+
+    TclNewObj(namesPtr);
+    Tcl_IncrRefCount(namesPtr);
+    for (cfPtr = iPtr->cmdFramePtr; cfPtr != NULL; cfPtr = cfPtr->nextPtr) {
+	CallFrame *framePtr = cfPtr->framePtr;
+	Tcl_Obj *nameObj;
+
+	if (profPtr->lines && (line < 0)) {
+	    if (cfPtr->type == TCL_LOCATION_BC) {
+		CmdFrame frame = *cfPtr;
+
+		if (frame.data.tebc.pc != NULL) {
+		    TclGetSrcInfoForPc(&frame);
+		    if (frame.type == TCL_LOCATION_SOURCE) {
+			Tcl_DecrRefCount(frame.data.eval.path);
+		    }
+		}
+		line = (frame.line ? frame.line[0] : 0);
+	    } else {
+		line = (cfPtr->line ? cfPtr->line[0] : 0);
+	    }
+	}
+	if ((framePtr == lastFramePtr) || (framePtr == NULL)
+		|| (framePtr->procPtr == NULL)) {
+	    continue;
+	}
+	lastFramePtr = framePtr;
+
+	TclNewObj(nameObj);
+	AppendFrameName((Tcl_Interp *) iPtr, framePtr->procPtr, nameObj);
+	if (innermost && (line > 0)) {
+	    Tcl_AppendPrintfToObj(nameObj, ":%d", line);
+	}
+	innermost = 0;
+	Tcl_ListObjAppendElement(NULL, namesPtr, nameObj);
+    }
+
+    Tcl_DStringInit(&stack);
+    Tcl_ListObjGetElements(NULL, namesPtr, &numNames, &names);
+    if (numNames == 0) {
+	Tcl_DStringAppend(&stack, "(global)", -1);
+	if (line > 0) {
+	    char buf[TCL_INTEGER_SPACE + 1];
+
+	    snprintf(buf, sizeof(buf), ":%d", line);
+	    Tcl_DStringAppend(&stack, buf, -1);
+	}
+    }
+    for (i = numNames - 1; i >= 0; i--) {
+	Tcl_DStringAppend(&stack, TclGetString(names[i]), names[i]->length);
+	if (i > 0) {
+	    TclDStringAppendLiteral(&stack, ";");
+	}
+    }
+    Tcl_DecrRefCount(namesPtr);
+
+    hPtr = Tcl_CreateHashEntry(&profPtr->stacks, Tcl_DStringValue(&stack),
+	    &isNew);
+    Tcl_SetHashValue(hPtr, INT2PTR(
+	    (isNew ? 0 : PTR2INT(Tcl_GetHashValue(hPtr))) + 1));
+    profPtr->numSamples++;
+    Tcl_DStringFree(&stack);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * AppendFrameName --
+ *
+ *	Appends the name of a procedure-like call to an object: the full name
+ *	of a procedure, the declaring class or object and the name of a
+ *	method, or "apply" for a lambda. This follows how [info frame]
+ *	describes such calls.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Modifies the object.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+AppendFrameName(
+    Tcl_Interp *interp,
+    Proc *procPtr,
+    Tcl_Obj *namePtr)
+{
+    Command *cmdPtr = procPtr->cmdPtr;
+    ExtraFrameInfo *efiPtr;
+    Tcl_Size i;
+
+    if (cmdPtr == NULL) {
+	Tcl_AppendToObj(namePtr, "(unknown)", -1);
+	return;
+    }
+    if (cmdPtr->hPtr != NULL) {
+	Tcl_GetCommandFullName(interp, (Tcl_Command) cmdPtr, namePtr);
+	return;
+    }
+    efiPtr = (ExtraFrameInfo *) cmdPtr->clientData;
+    if (efiPtr == NULL) {
+	Tcl_AppendToObj(namePtr, "(unknown)", -1);
+	return;
+    }
+    if (!strcmp(efiPtr->fields[0].name, "lambda")) {
+	Tcl_AppendToObj(namePtr, "apply", -1);
+	return;
+    }
+
+    /*
+     * A method: the declarer (the second field) comes first.
+     */
+
+    for (i = efiPtr->length - 1; i >= 0; i--) {
+	Tcl_Obj *fieldPtr;
+
+	if (efiPtr->fields[i].proc) {
+	    fieldPtr = efiPtr->fields[i].proc(efiPtr->fields[i].clientData);
+	} else {
+	    fieldPtr = (Tcl_Obj *) efiPtr->fields[i].clientData;
+	}
+	if (fieldPtr == NULL) {
+	    continue;
+	}
+	Tcl_IncrRefCount(fieldPtr);
+	if (i < efiPtr->length - 1) {
+	    Tcl_AppendToObj(namePtr, " ", 1);
+	}
+	Tcl_AppendObjToObj(namePtr, fieldPtr);
+	Tcl_DecrRefCount(fieldPtr);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ResetProfiler --
+ *
+ *	Forgets all samples taken by a profiler.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Frees memory.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ResetProfiler(
+    Profiler *profPtr)
+{
+    Tcl_DeleteHashTable(&profPtr->stacks);
+    Tcl_InitHashTable(&profPtr->stacks, TCL_STRING_KEYS);
+    profPtr->numSamples = 0;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CompareStacks --
+ *
+ *	Orders the entries of the stack table by decreasing count, then by
+ *	stack, for qsort.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+CompareStacks(
+    const void *first,
+    const void *second)
+{
+    Tcl_HashEntry *firstPtr = *(Tcl_HashEntry *const *) first;
+    Tcl_HashEntry *secondPtr = *(Tcl_HashEntry *const *) second;
+    size_t firstCount = PTR2UINT(Tcl_GetHashValue(firstPtr));
+    size_t secondCount = PTR2UINT(Tcl_GetHashValue(secondPtr));
+
+    if (firstCount != secondCount) {
+	return (firstCount > secondCount) ? -1 : 1;
+    }
+    return strcmp((const char *) firstPtr->key.string,
+	    (const char *) secondPtr->key.string);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tcl_ProfileObjCmd --
+ *
+ *	Implements [tcl::unsupported::profile], which controls the sampling
+ *	profiler of the interpreter:
+ *
+ *	    profile start ?-interval microseconds? ?-lines boolean?
+ *	    profile stop
+ *	    profile reset
+ *	    profile report
+ *	    profile status
+ *
+ *	[report] returns one line per distinct stack, made of the stack and
+ *	its number of samples separated by a space, the most frequent first.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	See the subcommands.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+Tcl_ProfileObjCmd(
+    TCL_UNUSED(void *),
+    Tcl_Interp *interp,		/* Current interpreter. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    static const char *const subcommands[] = {
+	"report", "reset", "start", "status", "stop", NULL
+    };
+    enum ProfileSubcommands {
+	PROF_REPORT, PROF_RESET, PROF_START, PROF_STATUS, PROF_STOP
+    } index;
+    static const char *const options[] = {
+	"-interval", "-lines", NULL
+    };
+    enum ProfileOptions {
+	PROF_INTERVAL, PROF_LINES
+    } optIndex;
+    Profiler *profPtr;
+    Tcl_Obj *resultPtr;
+    int i;
+
+    if (objc < 2) {
+	Tcl_WrongNumArgs(interp, 1, objv, "subcommand ?arg ...?");
+	return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj(interp, objv[1], subcommands, "subcommand", 0,
+	    &index) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if ((index != PROF_START) && (objc != 2)) {
+	Tcl_WrongNumArgs(interp, 2, objv, NULL);
+	return TCL_ERROR;
+    }
+    profPtr = GetProfiler(interp);
+
+    switch (index) {
+    case PROF_START: {
+	Tcl_WideInt interval = profPtr->interval;
+	int lines = profPtr->lines;
+
+	if (objc % 2) {
+	    Tcl_WrongNumArgs(interp, 2, objv,
+		    "?-interval microseconds? ?-lines boolean?");
+	    return TCL_ERROR;
+	}
+	for (i = 2; i < objc; i += 2) {
+	    if (Tcl_GetIndexFromObj(interp, objv[i], options, "option", 0,
+		    &optIndex) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    switch (optIndex) {
+	    case PROF_INTERVAL:
+		if (TclGetWideIntFromObj(interp, objv[i+1],
+			&interval) != TCL_OK) {
+		    return TCL_ERROR;
+		}
+		if (interval <= 0) {
+		    Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+			    "expected positive interval but got \"%s\"",
+			    TclGetString(objv[i+1])));
+		    Tcl_SetErrorCode(interp, "TCL", "VALUE", "NUMBER",
+			    (char *)NULL);
+		    return TCL_ERROR;
+		}
+		break;
+	    case PROF_LINES:
+		if (Tcl_GetBooleanFromObj(interp, objv[i+1],
+			&lines) != TCL_OK) {
+		    return TCL_ERROR;
+		}
+		break;
+	    }
+	}
+
+	/*
+	 * The thread reads the interval when it starts, so restart it to
+	 * apply a new one.
+	 */
+
+	if (interval != profPtr->interval) {
+	    StopProfiler(profPtr);
+	}
+	profPtr->interval = interval;
+	profPtr->lines = lines;
+	return StartProfiler(interp, profPtr);
+    }
+    case PROF_STOP:
+	StopProfiler(profPtr);
+	break;
+    case PROF_RESET:
+	ResetProfiler(profPtr);
+	break;
+    case PROF_STATUS:
+	TclNewObj(resultPtr);
+	Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("running", -1),
+		Tcl_NewBooleanObj(profPtr->async != NULL));
+	Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("interval", -1),
+		Tcl_NewWideIntObj(profPtr->interval));
+	Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("lines", -1),
+		Tcl_NewBooleanObj(profPtr->lines));
+	Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("samples", -1),
+		Tcl_NewWideIntObj((Tcl_WideInt) profPtr->numSamples));
+	Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("stacks", -1),
+		Tcl_NewWideIntObj(profPtr->stacks.numEntries));
+	Tcl_SetObjResult(interp, resultPtr);
+	break;
+    case PROF_REPORT: {
+	Tcl_Size numStacks = profPtr->stacks.numEntries, n = 0;
+	Tcl_HashEntry **entries, *hPtr;
+	Tcl_HashSearch search;
+
+	TclNewObj(resultPtr);
+	if (numStacks == 0) {
+	    Tcl_SetObjResult(interp, resultPtr);
+	    break;
+	}
+	entries = (Tcl_HashEntry **)
+		Tcl_Alloc(numStacks * sizeof(Tcl_HashEntry *));
+	for (hPtr = Tcl_FirstHashEntry(&profPtr->stacks, &search);
+		hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	    entries[n++] = hPtr;
+	}
+	qsort(entries, numStacks, sizeof(Tcl_HashEntry *), CompareStacks);
+	for (n = 0; n < numStacks; n++) {
+	    Tcl_AppendPrintfToObj(resultPtr, "%s%s %" TCL_Z_MODIFIER "u",
+		    (n ? "\n" : ""), (const char *) entries[n]->key.string,
+		    (size_t) PTR2UINT(Tcl_GetHashValue(entries[n])));
+	}
+	Tcl_Free(entries);
+	Tcl_SetObjResult(interp, resultPtr);
+	break;
+    }
+    }
+    return TCL_OK;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetExecStats --
+ *
+ *	Returns the execution statistics of an interpreter, creating them
+ *	(disabled) if needed.
+ *
+ * Results:
+ *	The statistics.
+ *
+ * Side effects:
+ *	May allocate memory.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static ExecStats *
+GetExecStats(
+    Tcl_Interp *interp)
+{
+    ExecStats *statsPtr = (ExecStats *)
+	    Tcl_GetAssocData(interp, EXECSTATS_ASSOC_KEY, NULL);
+
+    if (statsPtr == NULL) {
+	statsPtr = (ExecStats *) Tcl_Alloc(sizeof(ExecStats));
+	memset(statsPtr->instCounts, 0, sizeof(statsPtr->instCounts));
+	Tcl_InitHashTable(&statsPtr->commands, TCL_ONE_WORD_KEYS);
+	Tcl_InitHashTable(&statsPtr->procs, TCL_STRING_KEYS);
+	Tcl_SetAssocData(interp, EXECSTATS_ASSOC_KEY, DeleteExecStats,
+		statsPtr);
+    }
+    return statsPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * DeleteExecStats --
+ *
+ *	Frees the execution statistics of an interpreter being deleted.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Frees memory, and stops collecting statistics.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+DeleteExecStats(
+    void *clientData,
+    Tcl_Interp *interp)
+{
+    ExecStats *statsPtr = (ExecStats *) clientData;
+
+    ((Interp *) interp)->execStatsPtr = NULL;
+    ResetExecStats(statsPtr);
+    Tcl_DeleteHashTable(&statsPtr->commands);
+    Tcl_DeleteHashTable(&statsPtr->procs);
+    Tcl_Free(statsPtr);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * ResetExecStats --
+ *
+ *	Forgets all execution statistics collected.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Frees memory, and releases the commands counted.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+ResetExecStats(
+    ExecStats *statsPtr)
+{
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+
+    memset(statsPtr->instCounts, 0, sizeof(statsPtr->instCounts));
+    for (hPtr = Tcl_FirstHashEntry(&statsPtr->commands, &search);
+	    hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	CommandStats *csPtr = (CommandStats *) Tcl_GetHashValue(hPtr);
+	Command *cmdPtr = (Command *) Tcl_GetHashKey(&statsPtr->commands,
+		hPtr);
+
+	Tcl_DecrRefCount(csPtr->nameObj);
+	Tcl_Free(csPtr);
+	TclCleanupCommandMacro(cmdPtr);
+	Tcl_DeleteHashEntry(hPtr);
+    }
+    for (hPtr = Tcl_FirstHashEntry(&statsPtr->procs, &search);
+	    hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	Tcl_Free(Tcl_GetHashValue(hPtr));
+	Tcl_DeleteHashEntry(hPtr);
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclCountCommand --
+ *
+ *	Counts an invocation of a command. Called by EvalObjvCore, only while
+ *	execution statistics are collected. The command is kept from being
+ *	freed until the statistics are reset, so that its address remains
+ *	unique.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	Updates the statistics.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TclCountCommand(
+    Interp *iPtr,
+    Command *cmdPtr)
+{
+    ExecStats *statsPtr = iPtr->execStatsPtr;
+    Tcl_HashEntry *hPtr;
+    CommandStats *csPtr;
+    int isNew;
+
+    hPtr = Tcl_CreateHashEntry(&statsPtr->commands, cmdPtr, &isNew);
+    if (isNew) {
+	csPtr = (CommandStats *) Tcl_Alloc(sizeof(CommandStats));
+	TclNewObj(csPtr->nameObj);
+	Tcl_IncrRefCount(csPtr->nameObj);
+	Tcl_GetCommandFullName((Tcl_Interp *) iPtr, (Tcl_Command) cmdPtr,
+		csPtr->nameObj);
+	csPtr->count = 0;
+	cmdPtr->refCount++;
+	Tcl_SetHashValue(hPtr, csPtr);
+    } else {
+	csPtr = (CommandStats *) Tcl_GetHashValue(hPtr);
+    }
+    csPtr->count++;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclStartProcStats, FinishProcStats --
+ *
+ *	Time a call of a procedure, method or lambda. TclStartProcStats is
+ *	called by TclNRInterpProcCore, only while execution statistics are
+ *	collected, and schedules FinishProcStats to run once the call is
+ *	over. The call is only counted if statistics are still being
+ *	collected then.
+ *
+ * Results:
+ *	FinishProcStats returns the result of the call, unchanged.
+ *
+ * Side effects:
+ *	Updates the statistics.
+ *
+ *----------------------------------------------------------------------
+ */
+
+void
+TclStartProcStats(
+    Tcl_Interp *interp,
+    Proc *procPtr)
+{
+    ProcCall *callPtr = (ProcCall *) Tcl_Alloc(sizeof(ProcCall));
+
+    TclNewObj(callPtr->nameObj);
+    Tcl_IncrRefCount(callPtr->nameObj);
+    AppendFrameName(interp, procPtr, callPtr->nameObj);
+    callPtr->start = TclpGetMicroseconds();
+    TclNRAddCallback(interp, FinishProcStats, callPtr, NULL, NULL, NULL);
+}
+
+static int
+FinishProcStats(
+    void *data[],
+    Tcl_Interp *interp,
+    int result)
+{
+    ProcCall *callPtr = (ProcCall *) data[0];
+    ExecStats *statsPtr = ((Interp *) interp)->execStatsPtr;
+
+    if (statsPtr != NULL) {
+	Tcl_HashEntry *hPtr;
+	ProcStats *psPtr;
+	int isNew;
+
+	hPtr = Tcl_CreateHashEntry(&statsPtr->procs,
+		TclGetString(callPtr->nameObj), &isNew);
+	if (isNew) {
+	    psPtr = (ProcStats *) Tcl_Alloc(sizeof(ProcStats));
+	    psPtr->calls = 0;
+	    psPtr->time = 0;
+	    Tcl_SetHashValue(hPtr, psPtr);
+	} else {
+	    psPtr = (ProcStats *) Tcl_GetHashValue(hPtr);
+	}
+	psPtr->calls++;
+	psPtr->time += TclpGetMicroseconds() - callPtr->start;
+    }
+    Tcl_DecrRefCount(callPtr->nameObj);
+    Tcl_Free(callPtr);
+    return result;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tcl_ExecStatsObjCmd --
+ *
+ *	Implements [tcl::unsupported::execstats], which controls the
+ *	execution statistics of the interpreter:
+ *
+ *	    execstats enable ?boolean?
+ *	    execstats get
+ *	    execstats reset
+ *
+ *	[get] returns a dictionary with three keys: "instructions" maps the
+ *	name of each instruction executed to its count, "commands" maps the
+ *	full name of each command invoked to its count, and "procs" maps the
+ *	name of each procedure, method (its declarer and name) or lambda
+ *	("apply") called to a dictionary of its number of "calls" and of the
+ *	"time" spent in them, in microseconds. Statistics are kept when they
+ *	are disabled, until reset.
+ *
+ * Results:
+ *	A standard Tcl result.
+ *
+ * Side effects:
+ *	Enabling or disabling the statistics makes the code of the
+ *	interpreter be compiled again if procedures may be inlined.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+Tcl_ExecStatsObjCmd(
+    TCL_UNUSED(void *),
+    Tcl_Interp *interp,		/* Current interpreter. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    static const char *const subcommands[] = {
+	"enable", "get", "reset", NULL
+    };
+    enum ExecStatsSubcommands {
+	STATS_ENABLE, STATS_GET, STATS_RESET
+    } index;
+    Interp *iPtr = (Interp *) interp;
+    ExecStats *statsPtr;
+    Tcl_Obj *resultPtr, *dictPtr, *valuePtr;
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    int enabled, i;
+
+    if (objc < 2) {
+	Tcl_WrongNumArgs(interp, 1, objv, "subcommand ?arg ...?");
+	return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj(interp, objv[1], subcommands, "subcommand", 0,
+	    &index) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    if ((index == STATS_ENABLE) ? (objc > 3) : (objc != 2)) {
+	Tcl_WrongNumArgs(interp, 2, objv,
+		(index == STATS_ENABLE) ? "?boolean?" : NULL);
+	return TCL_ERROR;
+    }
+    statsPtr = GetExecStats(interp);
+
+    switch (index) {
+    case STATS_ENABLE:
+	if (objc == 3) {
+	    if (Tcl_GetBooleanFromObj(interp, objv[2], &enabled) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (enabled != (iPtr->execStatsPtr != NULL)) {
+		iPtr->execStatsPtr = (enabled ? statsPtr : NULL);
+		if (iPtr->flags & INLINE_PROCS) {
+		    iPtr->compileEpoch++;
+		}
+	    }
+	}
+	Tcl_SetObjResult(interp, Tcl_NewBooleanObj(iPtr->execStatsPtr != NULL));
+	break;
+    case STATS_RESET:
+	ResetExecStats(statsPtr);
+	break;
+    case STATS_GET:
+	TclNewObj(resultPtr);
+
+	TclNewObj(dictPtr);
+	for (i = 0; i < LAST_INST_OPCODE; i++) {
+	    if (statsPtr->instCounts[i]) {
+		Tcl_DictObjPut(NULL, dictPtr,
+			Tcl_NewStringObj(tclInstructionTable[i].name, -1),
+			Tcl_NewWideIntObj((Tcl_WideInt)
+				statsPtr->instCounts[i]));
+	    }
+	}
+	Tcl_DictObjPut(NULL, resultPtr,
+		Tcl_NewStringObj("instructions", -1), dictPtr);
+
+	/*
+	 * Commands that had the same name (e.g., a procedure and the one that
+	 * replaced it) are reported together.
+	 */
+
+	TclNewObj(dictPtr);
+	for (hPtr = Tcl_FirstHashEntry(&statsPtr->commands, &search);
+		hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	    CommandStats *csPtr = (CommandStats *) Tcl_GetHashValue(hPtr);
+	    Tcl_WideInt count = (Tcl_WideInt) csPtr->count;
+
+	    Tcl_DictObjGet(NULL, dictPtr, csPtr->nameObj, &valuePtr);
+	    if (valuePtr != NULL) {
+		Tcl_WideInt previous;
+
+		TclGetWideIntFromObj(NULL, valuePtr, &previous);
+		count += previous;
+	    }
+	    Tcl_DictObjPut(NULL, dictPtr, csPtr->nameObj,
+		    Tcl_NewWideIntObj(count));
+	}
+	Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("commands", -1),
+		dictPtr);
+
+	TclNewObj(dictPtr);
+	for (hPtr = Tcl_FirstHashEntry(&statsPtr->procs, &search);
+		hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	    ProcStats *psPtr = (ProcStats *) Tcl_GetHashValue(hPtr);
+
+	    TclNewObj(valuePtr);
+	    Tcl_DictObjPut(NULL, valuePtr, Tcl_NewStringObj("calls", -1),
+		    Tcl_NewWideIntObj((Tcl_WideInt) psPtr->calls));
+	    Tcl_DictObjPut(NULL, valuePtr, Tcl_NewStringObj("time", -1),
+		    Tcl_NewWideIntObj(psPtr->time));
+	    Tcl_DictObjPut(NULL, dictPtr, Tcl_NewStringObj((const char *)
+		    Tcl_GetHashKey(&statsPtr->procs, hPtr), -1), valuePtr);
+	}
+	Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("procs", -1),
+		dictPtr);
+
+	Tcl_SetObjResult(interp, resultPtr);
+	break;
+    }
+    return TCL_OK;
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 4
+ * fill-column: 78
+ * End:
+ */
@@ -61,22 +61,42 @@
 
 /*
  * Thread local storage used to maintain a per-thread cache of compiled
- * regular expressions.
+ * regular expressions. The cache is a hash table keyed by pattern and flags,
+ * with the entries that are not pinned on a list in order of last use so
+ * that the least recently used one is dropped when the cache is full.
+ * Patterns are pinned by [tcl::unsupported::regexpcache pin]; their
+ * compilations, with any flags, are never dropped.
  */
 
-#define NUM_REGEXPS 30
+#define NUM_REGEXPS 30		/* Default number of unpinned entries. */
+
+typedef struct RegexpCacheEntry {
+    int flags;			/* Compilation flags. */
+    size_t length;		/* Number of bytes in pattern. */
+    char *pattern;		/* The pattern, NUL-terminated. Malloc-ed. */
+    TclRegexp *regexpPtr;	/* Compiled form of the pattern, holding a
+				 * reference for the cache. */
+    Tcl_HashEntry *hPtr;	/* Entry of this in the cache table. */
+    int pinned;			/* Whether the pattern is pinned. Pinned
+				 * entries are not on the list. */
+    struct RegexpCacheEntry *prevPtr;
+				/* More recently used entry, or NULL. */
+    struct RegexpCacheEntry *nextPtr;
+				/* Less recently used entry, or NULL. */
+} RegexpCacheEntry;
 
 typedef struct {
     int initialized;		/* Set to 1 when the module is initialized. */
-    char *patterns[NUM_REGEXPS];/* Strings corresponding to compiled regular
-				 * expression patterns. NULL means that this
-				 * slot isn't used. Malloc-ed. */
-    size_t patLengths[NUM_REGEXPS];/* Number of non-null characters in
-				 * corresponding entry in patterns. -1 means
-				 * entry isn't used. */
-    struct TclRegexp *regexps[NUM_REGEXPS];
-				/* Compiled forms of above strings. Also
-				 * malloc-ed, or NULL if not in use yet. */
+    Tcl_HashTable cache;	/* Cached compilations. The keys and values
+				 * are RegexpCacheEntry structures. */
+    Tcl_HashTable pinned;	/* Pinned patterns, as string keys. */
+    RegexpCacheEntry *firstPtr;	/* Most recently used unpinned entry. */
+    RegexpCacheEntry *lastPtr;	/* Least recently used unpinned entry. */
+    size_t numUnpinned;		/* Number of entries on the list. */
+    size_t capacity;		/* Most unpinned entries to keep. */
+    Tcl_WideUInt hits;		/* Lookups that found a compilation. */
+    Tcl_WideUInt misses;	/* Lookups that had to compile. */
+    Tcl_WideUInt evictions;	/* Entries dropped to make room. */
 } ThreadSpecificData;
 
 static Tcl_ThreadDataKey dataKey;
@@ -85,18 +105,47 @@ static Tcl_ThreadDataKey dataKey;
  * Declarations for functions used only in this file.
  */
 
+static void		CacheEvict(ThreadSpecificData *tsdPtr, size_t keep);
+static void		CacheFree(ThreadSpecificData *tsdPtr,
+			    RegexpCacheEntry *entryPtr);
+static void		CacheLink(ThreadSpecificData *tsdPtr,
+			    RegexpCacheEntry *entryPtr);
+static void		CacheUnlink(ThreadSpecificData *tsdPtr,
+			    RegexpCacheEntry *entryPtr);
+static int		CompareCacheKeys(void *keyPtr, Tcl_HashEntry *hPtr);
 static TclRegexp *	CompileRegexp(Tcl_Interp *interp, const char *pattern,
 			    size_t length, int flags);
+static ThreadSpecificData *GetRegexpCache(void);
 static void		DupRegexpInternalRep(Tcl_Obj *srcPtr,
 			    Tcl_Obj *copyPtr);
 static void		FinalizeRegexp(void *clientData);
 static void		FreeRegexp(TclRegexp *regexpPtr);
 static void		FreeRegexpInternalRep(Tcl_Obj *objPtr);
-static int		RegExpExecUniChar(Tcl_Interp *interp, Tcl_RegExp re,
-			    const Tcl_UniChar *uniString, size_t numChars,
+static size_t		FindPrefix(TclRegexp *regexpPtr,
+			    const Tcl_UniChar *wString,
+			    const unsigned char *bString, size_t numChars);
+static int		RegExpExecChars(Tcl_Interp *interp, Tcl_RegExp re,
+			    const Tcl_UniChar *uniString,
+			    const unsigned char *byteString, size_t numChars,
 			    size_t nmatches, int flags);
+static TCL_HASH_TYPE	HashCacheKey(Tcl_HashTable *tablePtr, void *keyPtr);
 static int		SetRegexpFromAny(Tcl_Interp *interp, Tcl_Obj *objPtr);
 
+/*
+ * The key type of the cache table. Keys are RegexpCacheEntry structures of
+ * which only the flags and the pattern are looked at; a stack-allocated one
+ * serves for lookups, and the entry itself is the key of its table entry.
+ */
+
+static const Tcl_HashKeyType regexpCacheKeyType = {
+    TCL_HASH_KEY_TYPE_VERSION,		/* version */
+    0,					/* flags */
+    HashCacheKey,			/* hashKeyProc */
+    CompareCacheKeys,			/* compareKeysProc */
+    NULL,				/* allocEntryProc */
+    NULL				/* freeEntryProc */
+};
+
 /*
  * The regular expression Tcl object type. This serves as a cache of the
  * compiled form of the regular expression.
@@ -223,8 +272,8 @@ Tcl_RegExpExec(
     Tcl_DStringInit(&ds);
     ustr = Tcl_UtfToUniCharDString(text, TCL_INDEX_NONE, &ds);
     numChars = Tcl_DStringLength(&ds) / sizeof(Tcl_UniChar);
-    result = RegExpExecUniChar(interp, re, ustr, numChars, TCL_INDEX_NONE /* nmatches */,
-	    flags);
+    result = RegExpExecChars(interp, re, ustr, NULL, numChars,
+	    TCL_INDEX_NONE /* nmatches */, flags);
     Tcl_DStringFree(&ds);
 
     return result;
@@ -282,10 +331,12 @@ Tcl_RegExpRange(
 /*
  *---------------------------------------------------------------------------
  *
- * RegExpExecUniChar --
+ * RegExpExecChars --
  *
  *	Execute the regular expression matcher using a compiled form of a
  *	regular expression and save information about any match that is found.
+ *	The string is given either as Tcl_UniChar or, when every character is
+ *	one byte, as bytes; the latter needs no conversion at all.
  *
  * Results:
  *	If an error occurs during the matching operation then -1 is returned
@@ -300,12 +351,16 @@ Tcl_RegExpRange(
  */
 
 static int
-RegExpExecUniChar(
+RegExpExecChars(
     Tcl_Interp *interp,		/* Interpreter to use for error reporting. */
     Tcl_RegExp re,		/* Compiled regular expression; returned by a
 				 * previous call to Tcl_GetRegExpFromObj */
-    const Tcl_UniChar *wString,	/* String against which to match re. */
-    size_t numChars,		/* Length of Tcl_UniChar string. */
+    const Tcl_UniChar *wString,	/* String against which to match re, or
+				 * NULL to use bString. */
+    const unsigned char *bString,
+				/* String of one-byte characters against
+				 * which to match re, or NULL. */
+    size_t numChars,		/* Length of the string. */
     size_t nm,		/* How many subexpression matches (counting
 				 * the whole match as subexpression 0) are of
 				 * interest. -1 means "don't know". */
@@ -314,13 +369,47 @@ RegExpExecUniChar(
     int status;
     TclRegexp *regexpPtr = (TclRegexp *) re;
     size_t last = regexpPtr->re.re_nsub + 1;
+    size_t skip = 0, i;
 
     if (nm >= last) {
 	nm = last;
     }
 
-    status = TclReExec(&regexpPtr->re, wString, numChars,
-	    &regexpPtr->details, nm, regexpPtr->matches, flags);
+    /*
+     * If every match has to begin with a known literal, a string without it
+     * cannot match. When the RE does not look at the text in front of a
+     * match, the engine can also be started at the first occurrence.
+     */
+
+    if (regexpPtr->prefix != NULL && !(regexpPtr->flags & REG_EXPECT)) {
+	skip = FindPrefix(regexpPtr, wString, bString, numChars);
+	if (skip == (size_t) TCL_INDEX_NONE) {
+	    return 0;
+	}
+	if (!(regexpPtr->prefixFlags & REG_PREFIX_NOCONTEXT)) {
+	    skip = 0;
+	}
+    }
+
+    if (skip) {
+	flags |= REG_NOTBOL;
+    }
+    if (bString != NULL) {
+	status = TclReExecBytes(&regexpPtr->re, bString + skip,
+		numChars - skip, &regexpPtr->details, nm, regexpPtr->matches,
+		flags);
+    } else {
+	status = TclReExec(&regexpPtr->re, wString + skip, numChars - skip,
+		&regexpPtr->details, nm, regexpPtr->matches, flags);
+    }
+    if (skip && status == REG_OKAY) {
+	for (i = 0; i < nm; i++) {
+	    if (regexpPtr->matches[i].rm_so != (size_t) TCL_INDEX_NONE) {
+		regexpPtr->matches[i].rm_so += skip;
+		regexpPtr->matches[i].rm_eo += skip;
+	    }
+	}
+    }
 
     /*
      * Check for errors.
@@ -339,6 +428,82 @@ RegExpExecUniChar(
     return 1;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * FindPrefix --
+ *
+ *	Looks for the literal that every match of a regexp begins with.
+ *
+ * Results:
+ *	The index of the first place in the string where a match could begin,
+ *	or TCL_INDEX_NONE if the string cannot match at all.
+ *
+ * Side effects:
+ *	None.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static size_t
+FindPrefix(
+    TclRegexp *regexpPtr,	/* Compiled regexp with a known prefix. */
+    const Tcl_UniChar *wString,	/* String to search, or NULL. */
+    const unsigned char *bString,
+				/* String of one-byte characters to search,
+				 * used when wString is NULL. */
+    size_t numChars)		/* Length of the string. */
+{
+    const Tcl_UniChar *prefix = regexpPtr->prefix;
+    size_t length = regexpPtr->prefixLength;
+    const Tcl_UniChar *p, *last;
+    const unsigned char *bp, *blast;
+    size_t i;
+
+    if (numChars < length) {
+	return TCL_INDEX_NONE;
+    }
+    if (bString != NULL) {
+	for (i = 0; i < length; i++) {
+	    if (prefix[i] > 0xFF) {
+		return TCL_INDEX_NONE;
+	    }
+	}
+	if (regexpPtr->prefixFlags & REG_PREFIX_BOS) {
+	    blast = bString;
+	} else {
+	    blast = bString + numChars - length;
+	}
+	for (bp = bString; bp <= blast; bp++) {
+	    bp = (const unsigned char *) memchr(bp, prefix[0], blast - bp + 1);
+	    if (bp == NULL) {
+		break;
+	    }
+	    for (i = 1; i < length && bp[i] == prefix[i]; i++) {
+		/* Empty loop body. */
+	    }
+	    if (i == length) {
+		return bp - bString;
+	    }
+	}
+	return TCL_INDEX_NONE;
+    }
+    if (regexpPtr->prefixFlags & REG_PREFIX_BOS) {
+	if (memcmp(wString, prefix, length * sizeof(Tcl_UniChar)) != 0) {
+	    return TCL_INDEX_NONE;
+	}
+	return 0;
+    }
+    last = wString + numChars - length;
+    for (p = wString; p <= last; p++) {
+	if (*p == prefix[0] && memcmp(p + 1, prefix + 1,
+		(length - 1) * sizeof(Tcl_UniChar)) == 0) {
+	    return p - wString;
+	}
+    }
+    return TCL_INDEX_NONE;
+}
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -452,6 +617,7 @@ Tcl_RegExpExecObj(
 {
     TclRegexp *regexpPtr = (TclRegexp *) re;
     Tcl_UniChar *udata;
+    const unsigned char *bdata;
     Tcl_Size length;
     int reflags = regexpPtr->flags;
 #define TCL_REG_GLOBOK_FLAGS \
@@ -483,6 +649,23 @@ Tcl_RegExpExecObj(
     regexpPtr->string = NULL;
     regexpPtr->objPtr = textObj;
 
+    /*
+     * Text whose characters are all one byte is matched as it is, without
+     * making a Tcl_UniChar copy. Match indices are character indices either
+     * way. Back references are only compared as Tcl_UniChar.
+     */
+
+    if (!(regexpPtr->re.re_info & REG_UBACKREF)) {
+	bdata = TclStringCharBytes(textObj, &length);
+	if (bdata != NULL) {
+	    if (offset > length) {
+		offset = length;
+	    }
+	    return RegExpExecChars(interp, re, NULL, bdata + offset,
+		    length - offset, nmatches, flags);
+	}
+    }
+
     udata = Tcl_GetUnicodeFromObj(textObj, &length);
 
     if (offset > length) {
@@ -491,7 +674,7 @@ Tcl_RegExpExecObj(
     udata += offset;
     length -= offset;
 
-    return RegExpExecUniChar(interp, re, udata, length, nmatches, flags);
+    return RegExpExecChars(interp, re, udata, NULL, length, nmatches, flags);
 }
 
 /*
@@ -864,14 +1047,11 @@ CompileRegexp(
 {
     TclRegexp *regexpPtr;
     const Tcl_UniChar *uniString;
-    int numChars, status, i, exact;
+    int numChars, status, exact, isNew;
     Tcl_DString stringBuf;
-    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
-
-    if (!tsdPtr->initialized) {
-	tsdPtr->initialized = 1;
-	Tcl_CreateThreadExitHandler(FinalizeRegexp, NULL);
-    }
+    RegexpCacheEntry key, *entryPtr;
+    Tcl_HashEntry *hPtr;
+    ThreadSpecificData *tsdPtr = GetRegexpCache();
 
     /*
      * This routine maintains a second-level regular expression cache in
@@ -885,33 +1065,20 @@ CompileRegexp(
      * if it has the same pattern and the same flags.
      */
 
-    for (i = 0; (i < NUM_REGEXPS) && (tsdPtr->patterns[i] != NULL); i++) {
-	if ((length == tsdPtr->patLengths[i])
-		&& (tsdPtr->regexps[i]->flags == flags)
-		&& (strcmp(string, tsdPtr->patterns[i]) == 0)) {
-	    /*
-	     * Move the matched pattern to the first slot in the cache and
-	     * shift the other patterns down one position.
-	     */
-
-	    if (i != 0) {
-		int j;
-		char *cachedString;
-
-		cachedString = tsdPtr->patterns[i];
-		regexpPtr = tsdPtr->regexps[i];
-		for (j = i-1; j >= 0; j--) {
-		    tsdPtr->patterns[j+1] = tsdPtr->patterns[j];
-		    tsdPtr->patLengths[j+1] = tsdPtr->patLengths[j];
-		    tsdPtr->regexps[j+1] = tsdPtr->regexps[j];
-		}
-		tsdPtr->patterns[0] = cachedString;
-		tsdPtr->patLengths[0] = length;
-		tsdPtr->regexps[0] = regexpPtr;
-	    }
-	    return tsdPtr->regexps[0];
+    key.flags = flags;
+    key.length = length;
+    key.pattern = (char *) string;
+    hPtr = Tcl_FindHashEntry(&tsdPtr->cache, &key);
+    if (hPtr != NULL) {
+	entryPtr = (RegexpCacheEntry *) Tcl_GetHashValue(hPtr);
+	if (!entryPtr->pinned && entryPtr != tsdPtr->firstPtr) {
+	    CacheUnlink(tsdPtr, entryPtr);
+	    CacheLink(tsdPtr, entryPtr);
 	}
+	tsdPtr->hits++;
+	return entryPtr->regexpPtr;
     }
+    tsdPtr->misses++;
 
     /*
      * This is a new expression, so compile it and add it to the cache.
@@ -952,6 +1119,18 @@ CompileRegexp(
 	return NULL;
     }
 
+    /*
+     * Remember the literal every match begins with, if the compiler found
+     * one. RegExpExecChars uses it to reject or skip text quickly.
+     */
+
+    if (TclRePrefix(&regexpPtr->re, &regexpPtr->prefix,
+	    &regexpPtr->prefixLength, &regexpPtr->prefixFlags) != REG_OKAY) {
+	regexpPtr->prefix = NULL;
+	regexpPtr->prefixLength = 0;
+	regexpPtr->prefixFlags = 0;
+    }
+
     /*
      * Convert RE to a glob pattern equivalent, if any, and cache it.  If this
      * is not possible, then globObjPtr will be NULL.  This is used by
@@ -981,29 +1160,191 @@ CompileRegexp(
     regexpPtr->refCount = 1;
 
     /*
-     * Free the last regexp, if necessary, and make room at the head of the
-     * list for the new regexp.
+     * Add the regexp to the cache, dropping the least recently used ones if
+     * necessary to make room for it.
      */
 
-    if (tsdPtr->patterns[NUM_REGEXPS-1] != NULL) {
-	TclRegexp *oldRegexpPtr = tsdPtr->regexps[NUM_REGEXPS-1];
+    entryPtr = (RegexpCacheEntry *)Tcl_Alloc(sizeof(RegexpCacheEntry));
+    entryPtr->flags = flags;
+    entryPtr->length = length;
+    entryPtr->pattern = (char *)Tcl_Alloc(length + 1);
+    memcpy(entryPtr->pattern, string, length);
+    entryPtr->pattern[length] = '\0';
+    entryPtr->regexpPtr = regexpPtr;
+    entryPtr->pinned =
+	    (Tcl_FindHashEntry(&tsdPtr->pinned, entryPtr->pattern) != NULL);
+    if (!entryPtr->pinned) {
+	CacheEvict(tsdPtr, tsdPtr->capacity - 1);
+	CacheLink(tsdPtr, entryPtr);
+    }
+    hPtr = Tcl_CreateHashEntry(&tsdPtr->cache, entryPtr, &isNew);
+    Tcl_SetHashValue(hPtr, entryPtr);
+    entryPtr->hPtr = hPtr;
+
+    return regexpPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * GetRegexpCache --
+ *
+ *	Get the per-thread regexp cache, setting it up if necessary.
+ *
+ * Results:
+ *	The thread-specific data holding the cache.
+ *
+ * Side effects:
+ *	May initialize the cache and arrange for it to be freed when the
+ *	thread exits.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static ThreadSpecificData *
+GetRegexpCache(void)
+{
+    ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
 
-	if (oldRegexpPtr->refCount-- <= 1) {
-	    FreeRegexp(oldRegexpPtr);
+    if (!tsdPtr->initialized) {
+	tsdPtr->initialized = 1;
+	Tcl_InitCustomHashTable(&tsdPtr->cache, TCL_CUSTOM_PTR_KEYS,
+		&regexpCacheKeyType);
+	Tcl_InitHashTable(&tsdPtr->pinned, TCL_STRING_KEYS);
+	tsdPtr->firstPtr = tsdPtr->lastPtr = NULL;
+	tsdPtr->numUnpinned = 0;
+	if (tsdPtr->capacity == 0) {
+	    tsdPtr->capacity = NUM_REGEXPS;
 	}
-	Tcl_Free(tsdPtr->patterns[NUM_REGEXPS-1]);
+	Tcl_CreateThreadExitHandler(FinalizeRegexp, NULL);
+    }
+    return tsdPtr;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * HashCacheKey, CompareCacheKeys --
+ *
+ *	Hash and compare keys of the per-thread regexp cache, which are
+ *	patterns with their compilation flags.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static TCL_HASH_TYPE
+HashCacheKey(
+    TCL_UNUSED(Tcl_HashTable *),
+    void *keyPtr)		/* Key from which to compute hash value. */
+{
+    RegexpCacheEntry *entryPtr = (RegexpCacheEntry *) keyPtr;
+
+    return TclHashBytes(entryPtr->pattern, entryPtr->length)
+	    + (TCL_HASH_TYPE) entryPtr->flags;
+}
+
+static int
+CompareCacheKeys(
+    void *keyPtr,		/* New key to compare. */
+    Tcl_HashEntry *hPtr)	/* Existing key to compare. */
+{
+    RegexpCacheEntry *newPtr = (RegexpCacheEntry *) keyPtr;
+    RegexpCacheEntry *oldPtr = (RegexpCacheEntry *) hPtr->key.oneWordValue;
+
+    return (newPtr->flags == oldPtr->flags)
+	    && (newPtr->length == oldPtr->length)
+	    && (memcmp(newPtr->pattern, oldPtr->pattern, newPtr->length) == 0);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * CacheLink, CacheUnlink --
+ *
+ *	Put an entry of the per-thread regexp cache at the front of the list
+ *	of unpinned entries, or take it off the list.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+CacheLink(
+    ThreadSpecificData *tsdPtr,
+    RegexpCacheEntry *entryPtr)
+{
+    entryPtr->prevPtr = NULL;
+    entryPtr->nextPtr = tsdPtr->firstPtr;
+    if (tsdPtr->firstPtr != NULL) {
+	tsdPtr->firstPtr->prevPtr = entryPtr;
+    } else {
+	tsdPtr->lastPtr = entryPtr;
     }
-    for (i = NUM_REGEXPS - 2; i >= 0; i--) {
-	tsdPtr->patterns[i+1] = tsdPtr->patterns[i];
-	tsdPtr->patLengths[i+1] = tsdPtr->patLengths[i];
-	tsdPtr->regexps[i+1] = tsdPtr->regexps[i];
+    tsdPtr->firstPtr = entryPtr;
+    tsdPtr->numUnpinned++;
+}
+
+static void
+CacheUnlink(
+    ThreadSpecificData *tsdPtr,
+    RegexpCacheEntry *entryPtr)
+{
+    if (entryPtr->prevPtr != NULL) {
+	entryPtr->prevPtr->nextPtr = entryPtr->nextPtr;
+    } else {
+	tsdPtr->firstPtr = entryPtr->nextPtr;
     }
-    tsdPtr->patterns[0] = (char *)Tcl_Alloc(length + 1);
-    memcpy(tsdPtr->patterns[0], string, length + 1);
-    tsdPtr->patLengths[0] = length;
-    tsdPtr->regexps[0] = regexpPtr;
+    if (entryPtr->nextPtr != NULL) {
+	entryPtr->nextPtr->prevPtr = entryPtr->prevPtr;
+    } else {
+	tsdPtr->lastPtr = entryPtr->prevPtr;
+    }
+    entryPtr->prevPtr = entryPtr->nextPtr = NULL;
+    tsdPtr->numUnpinned--;
+}
 
-    return regexpPtr;
+/*
+ *----------------------------------------------------------------------
+ *
+ * CacheEvict, CacheFree --
+ *
+ *	Drop the least recently used unpinned entries of the per-thread regexp
+ *	cache until at most keep are left, or drop one given entry.
+ *
+ * Results:
+ *	None.
+ *
+ * Side effects:
+ *	The compiled regexps of the entries are released, and freed unless
+ *	some value still refers to them.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+CacheEvict(
+    ThreadSpecificData *tsdPtr,
+    size_t keep)
+{
+    while (tsdPtr->numUnpinned > keep) {
+	CacheFree(tsdPtr, tsdPtr->lastPtr);
+	tsdPtr->evictions++;
+    }
+}
+
+static void
+CacheFree(
+    ThreadSpecificData *tsdPtr,
+    RegexpCacheEntry *entryPtr)
+{
+    if (!entryPtr->pinned) {
+	CacheUnlink(tsdPtr, entryPtr);
+    }
+    Tcl_DeleteHashEntry(entryPtr->hPtr);
+    if (entryPtr->regexpPtr->refCount-- <= 1) {
+	FreeRegexp(entryPtr->regexpPtr);
+    }
+    Tcl_Free(entryPtr->pattern);
+    Tcl_Free(entryPtr);
 }
 
 /*
@@ -1056,18 +1397,18 @@ static void
 FinalizeRegexp(
     TCL_UNUSED(void *))
 {
-    int i;
-    TclRegexp *regexpPtr;
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
     ThreadSpecificData *tsdPtr = TCL_TSD_INIT(&dataKey);
 
-    for (i = 0; (i < NUM_REGEXPS) && (tsdPtr->patterns[i] != NULL); i++) {
-	regexpPtr = tsdPtr->regexps[i];
-	if (regexpPtr->refCount-- <= 1) {
-	    FreeRegexp(regexpPtr);
-	}
-	Tcl_Free(tsdPtr->patterns[i]);
-	tsdPtr->patterns[i] = NULL;
+    if (!tsdPtr->initialized) {
+	return;
+    }
+    while ((hPtr = Tcl_FirstHashEntry(&tsdPtr->cache, &search)) != NULL) {
+	CacheFree(tsdPtr, (RegexpCacheEntry *) Tcl_GetHashValue(hPtr));
     }
+    Tcl_DeleteHashTable(&tsdPtr->cache);
+    Tcl_DeleteHashTable(&tsdPtr->pinned);
 
     /*
      * We may find ourselves reinitialized if another finalization routine
@@ -1077,6 +1418,166 @@ FinalizeRegexp(
     tsdPtr->initialized = 0;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * Tcl_RegexpCacheObjCmd --
+ *
+ *	Implements [tcl::unsupported::regexpcache], which controls the regexp
+ *	cache of the current thread:
+ *
+ *	    regexpcache size ?count?
+ *	    regexpcache pin pattern
+ *	    regexpcache unpin pattern
+ *	    regexpcache reset
+ *	    regexpcache stats
+ *
+ *	[size] sets the number of unpinned compilations kept. [pin] compiles
+ *	a pattern as [regexp] does without options and keeps all compilations
+ *	of it, whatever their flags, until it is unpinned. [reset] drops the
+ *	unpinned compilations and clears the counters reported by [stats].
+ *
+ * Results:
+ *	A standard Tcl result. [size] returns the size and [stats] a
+ *	dictionary of the size, the numbers of entries and pinned patterns,
+ *	and the numbers of hits, misses and evictions.
+ *
+ * Side effects:
+ *	See the subcommands.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+Tcl_RegexpCacheObjCmd(
+    TCL_UNUSED(void *),
+    Tcl_Interp *interp,		/* Current interpreter. */
+    int objc,			/* Number of arguments. */
+    Tcl_Obj *const objv[])	/* Argument objects. */
+{
+    static const char *const subcommands[] = {
+	"pin", "reset", "size", "stats", "unpin", NULL
+    };
+    enum RegexpCacheSubcommands {
+	CACHE_PIN, CACHE_RESET, CACHE_SIZE, CACHE_STATS, CACHE_UNPIN
+    } index;
+    ThreadSpecificData *tsdPtr;
+    Tcl_HashEntry *hPtr;
+    Tcl_HashSearch search;
+    RegexpCacheEntry *entryPtr;
+    Tcl_Obj *resultPtr;
+    const char *pattern;
+    Tcl_WideInt size;
+    int isNew;
+
+    if (objc < 2) {
+	Tcl_WrongNumArgs(interp, 1, objv, "subcommand ?arg ...?");
+	return TCL_ERROR;
+    }
+    if (Tcl_GetIndexFromObj(interp, objv[1], subcommands, "subcommand", 0,
+	    &index) != TCL_OK) {
+	return TCL_ERROR;
+    }
+    tsdPtr = GetRegexpCache();
+
+    switch (index) {
+    case CACHE_SIZE:
+	if (objc > 3) {
+	    Tcl_WrongNumArgs(interp, 2, objv, "?count?");
+	    return TCL_ERROR;
+	}
+	if (objc == 3) {
+	    if (TclGetWideIntFromObj(interp, objv[2], &size) != TCL_OK) {
+		return TCL_ERROR;
+	    }
+	    if (size <= 0) {
+		Tcl_SetObjResult(interp, Tcl_ObjPrintf(
+			"expected positive size but got \"%s\"",
+			TclGetString(objv[2])));
+		Tcl_SetErrorCode(interp, "TCL", "VALUE", "NUMBER",
+			(char *)NULL);
+		return TCL_ERROR;
+	    }
+	    tsdPtr->capacity = (size_t) size;
+	    CacheEvict(tsdPtr, tsdPtr->capacity);
+	}
+	Tcl_SetObjResult(interp,
+		Tcl_NewWideIntObj((Tcl_WideInt) tsdPtr->capacity));
+	break;
+    case CACHE_PIN:
+    case CACHE_UNPIN:
+	if (objc != 3) {
+	    Tcl_WrongNumArgs(interp, 2, objv, "pattern");
+	    return TCL_ERROR;
+	}
+	pattern = TclGetString(objv[2]);
+	if (index == CACHE_PIN) {
+	    hPtr = Tcl_CreateHashEntry(&tsdPtr->pinned, pattern, &isNew);
+	    if (isNew && Tcl_GetRegExpFromObj(interp, objv[2],
+		    REG_ADVANCED) == NULL) {
+		Tcl_DeleteHashEntry(hPtr);
+		return TCL_ERROR;
+	    }
+	} else {
+	    hPtr = Tcl_FindHashEntry(&tsdPtr->pinned, pattern);
+	    if (hPtr == NULL) {
+		break;
+	    }
+	    Tcl_DeleteHashEntry(hPtr);
+	}
+
+	/*
+	 * Move the compilations of the pattern off or onto the list.
+	 */
+
+	for (hPtr = Tcl_FirstHashEntry(&tsdPtr->cache, &search);
+		hPtr != NULL; hPtr = Tcl_NextHashEntry(&search)) {
+	    entryPtr = (RegexpCacheEntry *) Tcl_GetHashValue(hPtr);
+	    if (strcmp(entryPtr->pattern, pattern) != 0) {
+		continue;
+	    }
+	    if (index == CACHE_PIN && !entryPtr->pinned) {
+		CacheUnlink(tsdPtr, entryPtr);
+		entryPtr->pinned = 1;
+	    } else if (index == CACHE_UNPIN && entryPtr->pinned) {
+		entryPtr->pinned = 0;
+		CacheLink(tsdPtr, entryPtr);
+	    }
+	}
+	CacheEvict(tsdPtr, tsdPtr->capacity);
+	break;
+    case CACHE_RESET:
+	if (objc != 2) {
+	    Tcl_WrongNumArgs(interp, 2, objv, NULL);
+	    return TCL_ERROR;
+	}
+	CacheEvict(tsdPtr, 0);
+	tsdPtr->hits = tsdPtr->misses = tsdPtr->evictions = 0;
+	break;
+    case CACHE_STATS:
+	if (objc != 2) {
+	    Tcl_WrongNumArgs(interp, 2, objv, NULL);
+	    return TCL_ERROR;
+	}
+	TclNewObj(resultPtr);
+	Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("size", -1),
+		Tcl_NewWideIntObj((Tcl_WideInt) tsdPtr->capacity));
+	Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("entries", -1),
+		Tcl_NewWideIntObj(tsdPtr->cache.numEntries));
+	Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("pinned", -1),
+		Tcl_NewWideIntObj(tsdPtr->pinned.numEntries));
+	Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("hits", -1),
+		Tcl_NewWideIntObj((Tcl_WideInt) tsdPtr->hits));
+	Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("misses", -1),
+		Tcl_NewWideIntObj((Tcl_WideInt) tsdPtr->misses));
+	Tcl_DictObjPut(NULL, resultPtr, Tcl_NewStringObj("evictions", -1),
+		Tcl_NewWideIntObj((Tcl_WideInt) tsdPtr->evictions));
+	Tcl_SetObjResult(interp, resultPtr);
+	break;
+    }
+    return TCL_OK;
+}
+
 /*
  * Local Variables:
  * mode: c
@@ -39,6 +39,11 @@ typedef struct TclRegexp {
 				 * used only for REG_EXPECT). */
     size_t refCount;		/* Count of number of references to this
 				 * compiled regexp. */
+    const Tcl_UniChar *prefix;	/* Literal that every match begins with, or
+				 * NULL if there is none. Owned by re. */
+    size_t prefixLength;	/* Number of chars in prefix. */
+    int prefixFlags;		/* REG_PREFIX_* flags describing where the
+				 * prefix may occur. */
 } TclRegexp;
 
 #endif /* _TCLREGEXP */
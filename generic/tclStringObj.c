@@ -35,6 +35,7 @@
 #include "tclInt.h"
 #include "tclTomMath.h"
 #include "tclStringRep.h"
+#include "tclStringRope.h"
 #include "assert.h"
 /*
  * Prototypes for functions defined later in this file:
@@ -58,14 +59,17 @@ static void		ExtendUnicodeRepWithString(Tcl_Obj *objPtr,
 			    const char *bytes, Tcl_Size numBytes,
 			    Tcl_Size numAppendChars);
 static void		FillUnicodeRep(Tcl_Obj *objPtr);
+static void		FreeStringIndex(String *stringPtr);
 static void		FreeStringInternalRep(Tcl_Obj *objPtr);
 static void		GrowStringBuffer(Tcl_Obj *objPtr, Tcl_Size needed, int flag);
 static void		GrowUnicodeBuffer(Tcl_Obj *objPtr, Tcl_Size needed);
 static int		SetStringFromAny(Tcl_Interp *interp, Tcl_Obj *objPtr);
+static const char *	StringIndexLookup(Tcl_Obj *objPtr, Tcl_Size index);
 static void		SetUnicodeObj(Tcl_Obj *objPtr,
 			    const Tcl_UniChar *unicode, Tcl_Size numChars);
 static Tcl_Size		UnicodeLength(const Tcl_UniChar *unicode);
 static void		UpdateStringOfString(Tcl_Obj *objPtr);
+static int		UseUtfBytes(Tcl_Obj *needle, Tcl_Obj *haystack);
 
 #if TCL_UTF_MAX > 3
 #define ISCONTINUATION(bytes) (\
@@ -76,6 +80,25 @@ static void		UpdateStringOfString(Tcl_Obj *objPtr);
 	&& (((bytes)[1] & 0xF0) == 0xB0) && (((bytes)[2] & 0xC0) == 0x80))))
 #endif
 
+/*
+ * A sparse index from characters to bytes lets long UTF-8 strings that are
+ * not all ASCII be indexed without making a Tcl_UniChar representation four
+ * times their size. Entry k is the byte offset of character
+ * k*STRING_INDEX_STEP; entries are filled in as far as they have been needed.
+ * The index is dropped whenever the bytes may change other than by having
+ * more appended, and when a Tcl_UniChar representation is made.
+ */
+
+#define STRING_INDEX_STEP	64
+#define STRING_INDEX_MIN_LENGTH	1024
+
+typedef struct StringIndex {
+    Tcl_Size numIndexed;	/* Number of entries filled in. */
+    Tcl_Size numAllocated;	/* Number of entries there is room for. */
+    Tcl_Size offsets[TCLFLEXARRAY];
+				/* Byte offsets of the indexed characters. */
+} StringIndex;
+
 
 /*
  * The structure below defines the string Tcl object type by means of
@@ -397,6 +420,14 @@ Tcl_GetCharLength(
 	return objPtr->length;
     }
 
+    /*
+     * A rope knows the lengths of its pieces.
+     */
+
+    if (TclHasInternalRep(objPtr, &tclStringRopeType)) {
+	return TclStringRopeCharLength(objPtr);
+    }
+
     /*
      * Optimize the case where we're really dealing with a bytearray object;
      * we don't need to convert to a string to perform the get-length operation.
@@ -548,6 +579,10 @@ Tcl_GetUniChar(
 	return -1;
     }
 
+    if (TclHasInternalRep(objPtr, &tclStringRopeType)) {
+	return TclStringRopeGetUniChar(objPtr, index);
+    }
+
     /*
      * Optimize the case where we're really dealing with a ByteArray object
      * we don't need to convert to a string to perform the indexing operation.
@@ -581,6 +616,15 @@ Tcl_GetUniChar(
 	if (stringPtr->numChars == objPtr->length) {
 	    return (unsigned char) objPtr->bytes[index];
 	}
+#if TCL_UTF_MAX > 3
+	if (objPtr->length >= STRING_INDEX_MIN_LENGTH) {
+	    if (index >= stringPtr->numChars) {
+		return -1;
+	    }
+	    TclUtfToUCS4(StringIndexLookup(objPtr, index), &ch);
+	    return ch;
+	}
+#endif
 	FillUnicodeRep(objPtr);
 	stringPtr = GET_STRING(objPtr);
     }
@@ -754,6 +798,10 @@ Tcl_GetRange(
 	first = 0;
     }
 
+    if (TclHasInternalRep(objPtr, &tclStringRopeType)) {
+	return TclStringRopeRange(objPtr, first, last);
+    }
+
     /*
      * Optimize the case where we're really dealing with a bytearray object
      * we don't need to convert to a string to perform the substring operation.
@@ -806,6 +854,25 @@ Tcl_GetRange(
 	    stringPtr->numChars = newObjPtr->length;
 	    return newObjPtr;
 	}
+#if TCL_UTF_MAX > 3
+	if (objPtr->length >= STRING_INDEX_MIN_LENGTH) {
+	    const char *begin, *end;
+
+	    if (last < 0 || last >= stringPtr->numChars) {
+		last = stringPtr->numChars - 1;
+	    }
+	    if (last < first) {
+		TclNewObj(newObjPtr);
+		return newObjPtr;
+	    }
+	    begin = StringIndexLookup(objPtr, first);
+	    end = StringIndexLookup(objPtr, last + 1);
+	    newObjPtr = Tcl_NewStringObj(begin, end - begin);
+	    SetStringFromAny(NULL, newObjPtr);
+	    GET_STRING(newObjPtr)->numChars = last - first + 1;
+	    return newObjPtr;
+	}
+#endif
 	FillUnicodeRep(objPtr);
 	stringPtr = GET_STRING(objPtr);
     }
@@ -875,6 +942,95 @@ TclGetRange(
     const char *end = TclUtfAtIndex(objPtr->bytes, last + 1);
     return Tcl_NewStringObj(begin, end - begin);
 }
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclStringUtfAtIndex --
+ *
+ *	Find a character in the string representation of a value, as
+ *	Tcl_UtfAtIndex does, but using the sparse index of a long string.
+ *	Values with no internal representation are made Strings for this.
+ *
+ * Results:
+ *	A pointer into the string representation of objPtr. The index must
+ *	not exceed the number of characters.
+ *
+ *----------------------------------------------------------------------
+ */
+
+const char *
+TclStringUtfAtIndex(
+    Tcl_Obj *objPtr,		/* Value to find a character in. */
+    Tcl_Size index)		/* Index of the character. */
+{
+    const char *bytes = TclGetString(objPtr);
+
+#if TCL_UTF_MAX > 3
+    if (objPtr->length >= STRING_INDEX_MIN_LENGTH && (objPtr->typePtr == NULL
+	    || TclHasInternalRep(objPtr, &tclStringType))) {
+	String *stringPtr;
+
+	SetStringFromAny(NULL, objPtr);
+	stringPtr = GET_STRING(objPtr);
+	if (!stringPtr->hasUnicode) {
+	    if (stringPtr->numChars == TCL_INDEX_NONE) {
+		TclNumUtfCharsM(stringPtr->numChars, bytes, objPtr->length);
+	    }
+	    if (stringPtr->numChars == objPtr->length) {
+		return bytes + index;
+	    }
+	    return StringIndexLookup(objPtr, index);
+	}
+    }
+#endif
+    return Tcl_UtfAtIndex(bytes, index);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclStringCharBytes --
+ *
+ *	Get the characters of a value as bytes, when each character is one
+ *	byte: a pure byte array, or a string whose length in characters is its
+ *	length in bytes. Values that already have a Unicode representation
+ *	are left to Tcl_GetUnicodeFromObj.
+ *
+ * Results:
+ *	A pointer to the bytes, with their number stored in *lengthPtr, or
+ *	NULL if the characters are not available as bytes.
+ *
+ * Side effects:
+ *	May convert the value to the String type, as Tcl_GetCharLength does.
+ *
+ *----------------------------------------------------------------------
+ */
+
+const unsigned char *
+TclStringCharBytes(
+    Tcl_Obj *objPtr,		/* Value to get the characters of. */
+    Tcl_Size *lengthPtr)	/* Where to store the number of characters. */
+{
+    String *stringPtr;
+
+    if (TclIsPureByteArray(objPtr)) {
+	return Tcl_GetByteArrayFromObj(objPtr, lengthPtr);
+    }
+    SetStringFromAny(NULL, objPtr);
+    stringPtr = GET_STRING(objPtr);
+    if (stringPtr->hasUnicode) {
+	return NULL;
+    }
+    if (stringPtr->numChars == TCL_INDEX_NONE) {
+	TclNumUtfCharsM(stringPtr->numChars, objPtr->bytes, objPtr->length);
+    }
+    if (stringPtr->numChars != objPtr->length) {
+	return NULL;
+    }
+    *lengthPtr = objPtr->length;
+    return (const unsigned char *) objPtr->bytes;
+}
 
 /*
  *----------------------------------------------------------------------
@@ -1000,6 +1156,7 @@ Tcl_SetObjLength(
 
 	stringPtr->numChars = TCL_INDEX_NONE;
 	stringPtr->hasUnicode = 0;
+	FreeStringIndex(stringPtr);
     } else {
 	if (length > stringPtr->maxChars) {
 	    stringPtr = stringRealloc(stringPtr, length);
@@ -1014,6 +1171,7 @@ Tcl_SetObjLength(
 	stringPtr->numChars = length;
 	stringPtr->unicode[length] = 0;
 	stringPtr->hasUnicode = 1;
+	FreeStringIndex(stringPtr);
 
 	/*
 	 * Can only get here when objPtr->bytes == NULL. No need to invalidate
@@ -1102,6 +1260,7 @@ Tcl_AttemptSetObjLength(
 
 	stringPtr->numChars = TCL_INDEX_NONE;
 	stringPtr->hasUnicode = 0;
+	FreeStringIndex(stringPtr);
     } else {
 	/*
 	 * Changing length of pure Unicode string.
@@ -1123,6 +1282,7 @@ Tcl_AttemptSetObjLength(
 	stringPtr->unicode[length] = 0;
 	stringPtr->numChars = length;
 	stringPtr->hasUnicode = 1;
+	FreeStringIndex(stringPtr);
 
 	/*
 	 * Can only get here when objPtr->bytes == NULL. No need to invalidate
@@ -1205,6 +1365,7 @@ SetUnicodeObj(
     stringPtr->unicode[numChars] = 0;
     stringPtr->numChars = numChars;
     stringPtr->hasUnicode = 1;
+    stringPtr->indexPtr = NULL;
 
     TclInvalidateStringRep(objPtr);
     stringPtr->allocated = 0;
@@ -1426,6 +1587,15 @@ Tcl_AppendObjToObj(
 	return;
     }
 
+    /*
+     * A rope takes the value as another piece.
+     */
+
+    if (TclHasInternalRep(objPtr, &tclStringRopeType)
+	    && TclStringRopeConcat(objPtr, 1, &appendObjPtr, 1) != NULL) {
+	return;
+    }
+
     if (
 	TclIsPureByteArray(appendObjPtr)
 	&& (TclIsPureByteArray(objPtr) || objPtr->bytes == &tclEmptyString)
@@ -3144,6 +3314,20 @@ TclStringCat(
 
     /* assert ( objc >= 2 ) */
 
+    /*
+     * Appending to a rope, or to a large string that cannot be changed in
+     * place, makes a rope rather than copying the string.
+     */
+
+    if (TclHasInternalRep(objv[0], &tclStringRopeType) || (!inPlace
+	    && objv[0]->bytes && objv[0]->length >= STRING_ROPE_MIN_LENGTH)) {
+	objResultPtr = TclStringRopeConcat(objv[0], objc - 1, objv + 1,
+		inPlace);
+	if (objResultPtr != NULL) {
+	    return objResultPtr;
+	}
+    }
+
     /*
      * Analyze to determine what representation result should be.
      * GOALS:	Avoid shimmering & string rep generation.
@@ -3168,7 +3352,8 @@ TclStringCat(
 	 	binary = 0;
 	 	if (ov > objv+1 && ISCONTINUATION(TclGetString(objPtr))) {
 	 	    forceUniChar = 1;
-	 	} else if ((objPtr->typePtr) && (objPtr->typePtr != &tclStringType)) {
+	 	} else if ((objPtr->typePtr) && (objPtr->typePtr != &tclStringType)
+			&& (objPtr->typePtr != &tclStringRopeType)) {
 		    /* Prevent shimmer of non-string types. */
 		    allowUniChar = 0;
 		}
@@ -3179,7 +3364,7 @@ TclStringCat(
 	    if (TclHasInternalRep(objPtr, &tclStringType)) {
 		/* Have a pure Unicode value; ask to preserve it */
 		requestUniChar = 1;
-	    } else {
+	    } else if (!TclHasInternalRep(objPtr, &tclStringRopeType)) {
 		/* Have another type; prevent shimmer */
 		allowUniChar = 0;
 	    }
@@ -3683,6 +3868,44 @@ TclStringCmp(
     return match;
 }
 
+/*
+ *---------------------------------------------------------------------------
+ *
+ * UseUtfBytes --
+ *
+ *	Decide whether a search for needle in haystack can be done on their
+ *	UTF-8 bytes rather than on Tcl_UniChar arrays. This is so when needle
+ *	is all ASCII other than NUL, since such a byte always stands for a
+ *	character of its own, and haystack has bytes but no Tcl_UniChar array
+ *	to search.
+ *
+ * Results:
+ *	1 if so, 0 otherwise.
+ *
+ *---------------------------------------------------------------------------
+ */
+
+static int
+UseUtfBytes(
+    Tcl_Obj *needle,
+    Tcl_Obj *haystack)
+{
+    Tcl_Size i, length;
+    const char *bytes;
+
+    if (haystack->bytes == NULL || (TclHasInternalRep(haystack, &tclStringType)
+	    && GET_STRING(haystack)->hasUnicode)) {
+	return 0;
+    }
+    bytes = Tcl_GetStringFromObj(needle, &length);
+    for (i = 0; i < length; i++) {
+	if (bytes[i] == '\0' || UCHAR(bytes[i]) >= 0x80) {
+	    return 0;
+	}
+    }
+    return 1;
+}
+
 /*
  *---------------------------------------------------------------------------
  *
@@ -3709,7 +3932,8 @@ TclStringFirst(
 {
     Tcl_Size lh = 0, ln = Tcl_GetCharLength(needle);
     Tcl_Size value = -1;
-    Tcl_UniChar *checkStr, *endStr, *uh, *un;
+    const Tcl_UniChar *checkStr;
+    Tcl_UniChar *uh, *un;
     Tcl_Obj *obj;
 
     if (start < 0) {
@@ -3723,8 +3947,8 @@ TclStringFirst(
     }
 
     if (TclIsPureByteArray(needle) && TclIsPureByteArray(haystack)) {
-	unsigned char *end, *check, *bh;
-	unsigned char *bn = Tcl_GetByteArrayFromObj(needle, &ln);
+	const unsigned char *check;
+	unsigned char *bh, *bn = Tcl_GetByteArrayFromObj(needle, &ln);
 
 	/* Find bytes in bytes */
 	bh = Tcl_GetByteArrayFromObj(haystack, &lh);
@@ -3732,31 +3956,34 @@ TclStringFirst(
 	    /* Don't start the loop if there cannot be a valid answer */
 	    goto firstEnd;
 	}
-	end = bh + lh;
+	check = TclFindBytes(bh + start, lh - start, bn, ln);
+	if (check != NULL) {
+	    value = (check - bh);
+	}
+	goto firstEnd;
+    }
 
-	check = bh + start;
-	while (check + ln <= end) {
-	    /*
-	     * Look for the leading byte of the needle in the haystack
-	     * starting at check and stopping when there's not enough room
-	     * for the needle left.
-	     */
-	    check = (unsigned char *)memchr(check, bn[0], (end + 1 - ln) - check);
-	    if (check == NULL) {
-		/* Leading byte not found -> needle cannot be found. */
-		goto firstEnd;
-	    }
-	    /* Leading byte found, check rest of needle. */
-	    if (0 == memcmp(check+1, bn+1, ln-1)) {
-		/* Checks! Return the successful index. */
-		value = (check - bh);
-		goto firstEnd;
-	    }
-	    /* Rest of needle match failed; Iterate to continue search. */
-	    check++;
+#if TCL_UTF_MAX > 3
+    if (UseUtfBytes(needle, haystack)) {
+	const unsigned char *bh, *from, *check;
+
+	/* Find ASCII in UTF-8 */
+	lh = Tcl_GetCharLength(haystack);
+	if ((lh < ln) || (start > lh - ln)) {
+	    goto firstEnd;
+	}
+	bh = (const unsigned char *) haystack->bytes;
+	from = (start > 0) ? (const unsigned char *)
+		TclStringUtfAtIndex(haystack, start) : bh;
+	check = TclFindBytes(from, haystack->length - (from - bh),
+		(const unsigned char *) needle->bytes, ln);
+	if (check != NULL) {
+	    value = (lh == haystack->length) ? (check - bh)
+		    : start + Tcl_NumUtfChars((const char *) from, check - from);
 	}
 	goto firstEnd;
     }
+#endif
 
     /*
      * TODO: It might be nice to support some cases where it is not
@@ -3776,14 +4003,9 @@ TclStringFirst(
 	/* Don't start the loop if there cannot be a valid answer */
 	goto firstEnd;
     }
-    endStr = uh + lh;
-
-    for (checkStr = uh + start; checkStr + ln <= endStr; checkStr++) {
-	if ((*checkStr == *un) && (0 ==
-		memcmp(checkStr + 1, un + 1, (ln-1) * sizeof(Tcl_UniChar)))) {
-	    value =  (checkStr - uh);
-	    goto firstEnd;
-	}
+    checkStr = TclUniCharFind(uh + start, lh - start, un, ln);
+    if (checkStr != NULL) {
+	value = (checkStr - uh);
     }
   firstEnd:
     TclNewIndexObj(obj, value);
@@ -3816,7 +4038,8 @@ TclStringLast(
 {
     Tcl_Size lh = 0, ln = Tcl_GetCharLength(needle);
     Tcl_Size value = -1;
-    Tcl_UniChar *checkStr, *uh, *un;
+    const Tcl_UniChar *checkStr;
+    Tcl_UniChar *uh, *un;
     Tcl_Obj *obj;
 
     if (ln == 0) {
@@ -3830,7 +4053,8 @@ TclStringLast(
     }
 
     if (TclIsPureByteArray(needle) && TclIsPureByteArray(haystack)) {
-	unsigned char *check, *bh = Tcl_GetByteArrayFromObj(haystack, &lh);
+	const unsigned char *check;
+	unsigned char *bh = Tcl_GetByteArrayFromObj(haystack, &lh);
 	unsigned char *bn = Tcl_GetByteArrayFromObj(needle, &ln);
 
 	if (last >= lh) {
@@ -3840,18 +4064,36 @@ TclStringLast(
 	    /* Don't start the loop if there cannot be a valid answer */
 	    goto lastEnd;
 	}
-	check = bh + last + 1 - ln;
+	check = TclFindLastBytes(bh, last + 1, bn, ln);
+	if (check != NULL) {
+	    value = (check - bh);
+	}
+	goto lastEnd;
+    }
 
-	while (check >= bh) {
-	    if ((*check == bn[0])
-		    && (0 == memcmp(check+1, bn+1, ln-1))) {
-		value = (check - bh);
-		goto lastEnd;
-	    }
-	    check--;
+#if TCL_UTF_MAX > 3
+    if (UseUtfBytes(needle, haystack)) {
+	const unsigned char *bh, *to, *check;
+
+	/* Find ASCII in UTF-8 */
+	lh = Tcl_GetCharLength(haystack);
+	if (last >= lh) {
+	    last = lh - 1;
+	}
+	if (last + 1 < ln) {
+	    goto lastEnd;
+	}
+	bh = (const unsigned char *) haystack->bytes;
+	to = (const unsigned char *) TclStringUtfAtIndex(haystack, last + 1);
+	check = TclFindLastBytes(bh, to - bh,
+		(const unsigned char *) needle->bytes, ln);
+	if (check != NULL) {
+	    value = (lh == haystack->length) ? (check - bh)
+		    : Tcl_NumUtfChars((const char *) bh, check - bh);
 	}
 	goto lastEnd;
     }
+#endif
 
     uh = Tcl_GetUnicodeFromObj(haystack, &lh);
     un = Tcl_GetUnicodeFromObj(needle, &ln);
@@ -3863,14 +4105,9 @@ TclStringLast(
 	/* Don't start the loop if there cannot be a valid answer */
 	goto lastEnd;
     }
-    checkStr = uh + last + 1 - ln;
-    while (checkStr >= uh) {
-	if ((*checkStr == un[0])
-		&& (0 == memcmp(checkStr+1, un+1, (ln-1)*sizeof(Tcl_UniChar)))) {
-	    value = (checkStr - uh);
-	    goto lastEnd;
-	}
-	checkStr--;
+    checkStr = TclUniCharFindLast(uh, last + 1, un, ln);
+    if (checkStr != NULL) {
+	value = (checkStr - uh);
     }
   lastEnd:
     TclNewIndexObj(obj, value);
@@ -4020,6 +4257,12 @@ TclStringReverse(
 	if (!inPlace || Tcl_IsShared(objPtr)) {
 	    TclNewObj(objPtr);
 	    Tcl_SetObjLength(objPtr, numBytes);
+	} else {
+	    /*
+	     * The characters move, so the sparse index no longer fits them.
+	     */
+
+	    FreeStringIndex(stringPtr);
 	}
 	to = objPtr->bytes;
 
@@ -4258,6 +4501,7 @@ ExtendUnicodeRepWithString(
     }
 
     stringPtr->hasUnicode = 1;
+    FreeStringIndex(stringPtr);
     if (bytes) {
 	stringPtr->numChars = needed;
     } else {
@@ -4336,6 +4580,7 @@ DupStringInternalRep(
     }
     copyStringPtr->hasUnicode = srcStringPtr->hasUnicode;
     copyStringPtr->numChars = srcStringPtr->numChars;
+    copyStringPtr->indexPtr = NULL;
 
     /*
      * Tricky point: the string value was copied by generic object management
@@ -4390,6 +4635,7 @@ SetStringFromAny(
 	stringPtr->allocated = objPtr->length;
 	stringPtr->maxChars = 0;
 	stringPtr->hasUnicode = 0;
+	stringPtr->indexPtr = NULL;
 	SET_STRING(objPtr, stringPtr);
 	objPtr->typePtr = &tclStringType;
     }
@@ -4529,9 +4775,70 @@ static void
 FreeStringInternalRep(
     Tcl_Obj *objPtr)		/* Object with internal rep to free. */
 {
+    FreeStringIndex(GET_STRING(objPtr));
     Tcl_Free(GET_STRING(objPtr));
     objPtr->typePtr = NULL;
 }
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * StringIndexLookup, FreeStringIndex --
+ *
+ *	Find a character of a String value by its sparse index, extending the
+ *	index as needed, and release the index.
+ *
+ * Results:
+ *	StringIndexLookup returns a pointer into the string representation.
+ *	The value must not have a Tcl_UniChar representation, its number of
+ *	characters must be known, and the index must not exceed it.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static const char *
+StringIndexLookup(
+    Tcl_Obj *objPtr,		/* String value to index. */
+    Tcl_Size index)		/* Index of the character to find. */
+{
+    String *stringPtr = GET_STRING(objPtr);
+    StringIndex *indexPtr = stringPtr->indexPtr;
+    Tcl_Size k = index / STRING_INDEX_STEP;
+
+    if (indexPtr == NULL || k >= indexPtr->numAllocated) {
+	Tcl_Size numAllocated = stringPtr->numChars / STRING_INDEX_STEP + 1;
+	size_t size = offsetof(StringIndex, offsets)
+		+ numAllocated * sizeof(Tcl_Size);
+
+	if (indexPtr == NULL) {
+	    indexPtr = (StringIndex *)Tcl_Alloc(size);
+	    indexPtr->numIndexed = 1;
+	    indexPtr->offsets[0] = 0;
+	} else {
+	    indexPtr = (StringIndex *)Tcl_Realloc(indexPtr, size);
+	}
+	indexPtr->numAllocated = numAllocated;
+	stringPtr->indexPtr = indexPtr;
+    }
+    while (indexPtr->numIndexed <= k) {
+	Tcl_Size n = indexPtr->numIndexed++;
+
+	indexPtr->offsets[n] = Tcl_UtfAtIndex(objPtr->bytes
+		+ indexPtr->offsets[n - 1], STRING_INDEX_STEP) - objPtr->bytes;
+    }
+    return Tcl_UtfAtIndex(objPtr->bytes + indexPtr->offsets[k],
+	    index % STRING_INDEX_STEP);
+}
+
+static void
+FreeStringIndex(
+    String *stringPtr)
+{
+    if (stringPtr->indexPtr != NULL) {
+	Tcl_Free(stringPtr->indexPtr);
+	stringPtr->indexPtr = NULL;
+    }
+}
 
 /*
  * Local Variables:
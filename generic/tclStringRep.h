@@ -42,6 +42,10 @@ typedef struct {
 				 * space allocated for the Unicode array. */
     int hasUnicode;		/* Boolean determining whether the string has
 				 * a Tcl_UniChar representation. */
+    struct StringIndex *indexPtr;
+				/* Byte offsets of every STRING_INDEX_STEP'th
+				 * character of a long UTF-8 string without a
+				 * Tcl_UniChar representation, or NULL. */
     Tcl_UniChar unicode[TCLFLEXARRAY];	/* The array of Tcl_UniChar units.
 				 * The actual size of this field depends on
 				 * the maxChars field above. */
@@ -0,0 +1,606 @@
+/*
+ * tclStringRope.c --
+ *
+ *	This file contains the string rope representation. A rope holds a
+ *	string built by concatenation as a sequence of pieces, each a
+ *	reference to an existing value, so that appending to a large shared
+ *	string costs time in proportion to what is appended rather than to
+ *	the whole string. The flat string is only made when it is asked for,
+ *	and characters can be located by binary search over the pieces.
+ *
+ * See the file "license.terms" for information on usage and redistribution of
+ * this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ */
+
+#include "tclInt.h"
+#include "tclStringRope.h"
+
+/*
+ * A piece of a rope and the cumulative byte and character counts at its end.
+ */
+
+typedef struct {
+    Tcl_Obj *objPtr;		/* Value holding the bytes of the piece. */
+    Tcl_Size byteEnd;		/* Bytes in this and all earlier pieces. */
+    Tcl_Size charEnd;		/* Characters in this and all earlier pieces,
+				 * valid for the first numCounted pieces. */
+} RopePiece;
+
+/*
+ * The storage of pieces. Like a list store, it can be shared by several
+ * values, each of which uses a prefix of the pieces, and the value that uses
+ * all of them may add more without disturbing the others.
+ */
+
+typedef struct {
+    size_t refCount;		/* Number of values using this storage. */
+    Tcl_Size numPieces;		/* Number of pieces in use by some value. */
+    Tcl_Size numAllocated;	/* Number of pieces there is room for. */
+    Tcl_Size numCounted;	/* Number of pieces whose charEnd is known. */
+    Tcl_Size numShared;		/* Largest number of pieces a value was given
+				 * when attached to this storage. Values that
+				 * add pieces in place own those past it. */
+    RopePiece pieces[TCLFLEXARRAY];
+} RopeStore;
+
+/*
+ * Appended values shorter than this are copied into a piece of the rope's
+ * own, which takes further short values as long as it stays shorter than
+ * this and no other value uses it, so that a rope that is appended to in
+ * small steps does not get a piece per step.
+ */
+
+#define ROPE_SHORT_LENGTH	1024
+
+#define ROPE_STORE_SIZE(numPieces) \
+    (offsetof(RopeStore, pieces) + (numPieces) * sizeof(RopePiece))
+
+#define RopeGetStore(objPtr) \
+    ((RopeStore *) (objPtr)->internalRep.twoPtrValue.ptr1)
+#define RopeGetCount(objPtr) \
+    ((Tcl_Size) PTR2INT((objPtr)->internalRep.twoPtrValue.ptr2))
+
+#if TCL_UTF_MAX > 3
+#define ISCONTINUATION(bytes) (\
+	((bytes)[0] & 0xC0) == 0x80)
+#else
+#define ISCONTINUATION(bytes) (\
+	((((bytes)[0] & 0xC0) == 0x80) || (((bytes)[0] == '\xED') \
+	&& (((bytes)[1] & 0xF0) == 0xB0) && (((bytes)[2] & 0xC0) == 0x80))))
+#endif
+
+/*
+ * Prototypes for procedures defined later in this file:
+ */
+
+static void		DupRopeInternalRep(Tcl_Obj *srcPtr, Tcl_Obj *copyPtr);
+static void		FreeRopeInternalRep(Tcl_Obj *ropeObj);
+static const char *	RopePieceAt(RopeStore *storePtr, Tcl_Size i,
+			    Tcl_Size charIndex);
+static Tcl_Size		RopeFindPiece(RopeStore *storePtr, Tcl_Size count,
+			    Tcl_Size charIndex);
+static void		RopeStoreAppend(RopeStore *storePtr, Tcl_Obj *objPtr,
+			    Tcl_Size numBytes);
+static void		RopeStoreAppendShort(RopeStore *storePtr,
+			    Tcl_Size firstOwned, const char *bytes,
+			    Tcl_Size numBytes);
+static Tcl_Size		RopeStoreCount(RopeStore *storePtr, Tcl_Size count);
+static void		UpdateStringOfRope(Tcl_Obj *ropeObj);
+
+/*
+ * The rope type. It is not created from a string; string operations that do
+ * not know about it take the string representation, which flattens the
+ * rope.
+ */
+
+const Tcl_ObjType tclStringRopeType = {
+    "rope",				/* name */
+    FreeRopeInternalRep,		/* freeIntRepProc */
+    DupRopeInternalRep,			/* dupIntRepProc */
+    UpdateStringOfRope,			/* updateStringProc */
+    NULL,				/* setFromAnyProc */
+    TCL_OBJTYPE_V0
+};
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * RopeSetRep, FreeRopeInternalRep, DupRopeInternalRep --
+ *
+ *	Attachment, release and duplication of the internal representation.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+RopeSetRep(
+    Tcl_Obj *ropeObj,
+    RopeStore *storePtr,
+    Tcl_Size count)
+{
+    storePtr->refCount++;
+    if (storePtr->numShared < count) {
+	storePtr->numShared = count;
+    }
+    ropeObj->internalRep.twoPtrValue.ptr1 = storePtr;
+    ropeObj->internalRep.twoPtrValue.ptr2 = INT2PTR(count);
+    ropeObj->typePtr = &tclStringRopeType;
+}
+
+static void
+FreeRopeInternalRep(
+    Tcl_Obj *ropeObj)
+{
+    RopeStore *storePtr = RopeGetStore(ropeObj);
+
+    if (storePtr->refCount-- <= 1) {
+	Tcl_Size i;
+
+	for (i = 0; i < storePtr->numPieces; i++) {
+	    Tcl_DecrRefCount(storePtr->pieces[i].objPtr);
+	}
+	Tcl_Free(storePtr);
+    }
+    ropeObj->internalRep.twoPtrValue.ptr1 = NULL;
+}
+
+static void
+DupRopeInternalRep(
+    Tcl_Obj *srcPtr,
+    Tcl_Obj *copyPtr)
+{
+    RopeSetRep(copyPtr, RopeGetStore(srcPtr), RopeGetCount(srcPtr));
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * UpdateStringOfRope --
+ *
+ *	Generate the string representation by copying the pieces in order.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+UpdateStringOfRope(
+    Tcl_Obj *ropeObj)
+{
+    RopeStore *storePtr = RopeGetStore(ropeObj);
+    Tcl_Size i, count = RopeGetCount(ropeObj);
+    Tcl_Size numBytes = storePtr->pieces[count - 1].byteEnd;
+    char *dst = Tcl_InitStringRep(ropeObj, NULL, numBytes);
+
+    TclOOM(dst, numBytes);
+    for (i = 0; i < count; i++) {
+	Tcl_Size more;
+	const char *src = Tcl_GetStringFromObj(storePtr->pieces[i].objPtr,
+		&more);
+
+	memcpy(dst, src, more);
+	dst += more;
+    }
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * RopeStoreAppend, RopeStoreAppendShort, RopeStoreCount, RopeFindPiece,
+ * RopePieceAt --
+ *
+ *	Helpers to add a piece to a store that has room for it, to add a short
+ *	value (see ROPE_SHORT_LENGTH), to make sure the character counts of
+ *	the first count pieces are known and return their total, to find the
+ *	piece holding a character, and to find the bytes of a character within
+ *	a piece.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static void
+RopeStoreAppend(
+    RopeStore *storePtr,
+    Tcl_Obj *objPtr,
+    Tcl_Size numBytes)
+{
+    RopePiece *piecePtr = storePtr->pieces + storePtr->numPieces;
+
+    piecePtr->objPtr = objPtr;
+    Tcl_IncrRefCount(objPtr);
+    piecePtr->byteEnd = numBytes;
+    if (storePtr->numPieces > 0) {
+	piecePtr->byteEnd += piecePtr[-1].byteEnd;
+    }
+    storePtr->numPieces++;
+}
+
+static void
+RopeStoreAppendShort(
+    RopeStore *storePtr,
+    Tcl_Size firstOwned,	/* Index of the first piece that no value
+				 * but the one being made uses. */
+    const char *bytes,
+    Tcl_Size numBytes)
+{
+    Tcl_Size last = storePtr->numPieces - 1;
+    RopePiece *piecePtr = storePtr->pieces + last;
+    Tcl_Obj *objPtr = piecePtr->objPtr;
+
+    if (last >= firstOwned && objPtr->refCount == 1
+	    && (objPtr->typePtr == NULL || objPtr->typePtr == &tclStringType)
+	    && objPtr->bytes != NULL
+	    && objPtr->length + numBytes < ROPE_SHORT_LENGTH) {
+	Tcl_AppendToObj(objPtr, bytes, numBytes);
+	piecePtr->byteEnd += numBytes;
+	if (storePtr->numCounted > last) {
+	    storePtr->numCounted = last;
+	}
+    } else {
+	RopeStoreAppend(storePtr, Tcl_NewStringObj(bytes, numBytes),
+		numBytes);
+    }
+}
+
+static Tcl_Size
+RopeStoreCount(
+    RopeStore *storePtr,
+    Tcl_Size count)
+{
+    Tcl_Size i = storePtr->numCounted;
+
+    if (i < count) {
+	Tcl_Size byteStart = 0, numChars = 0;
+
+	if (i > 0) {
+	    byteStart = storePtr->pieces[i - 1].byteEnd;
+	    numChars = storePtr->pieces[i - 1].charEnd;
+	}
+	for (; i < count; i++) {
+	    RopePiece *piecePtr = storePtr->pieces + i;
+
+	    numChars += Tcl_NumUtfChars(TclGetString(piecePtr->objPtr),
+		    piecePtr->byteEnd - byteStart);
+	    piecePtr->charEnd = numChars;
+	    byteStart = piecePtr->byteEnd;
+	}
+	storePtr->numCounted = count;
+    }
+    return storePtr->pieces[count - 1].charEnd;
+}
+
+static Tcl_Size
+RopeFindPiece(
+    RopeStore *storePtr,
+    Tcl_Size count,
+    Tcl_Size charIndex)		/* Less than the number of characters in the
+				 * first count pieces, which are counted. */
+{
+    Tcl_Size lo = 0, hi = count - 1;
+
+    while (lo < hi) {
+	Tcl_Size mid = lo + (hi - lo) / 2;
+
+	if (storePtr->pieces[mid].charEnd > charIndex) {
+	    hi = mid;
+	} else {
+	    lo = mid + 1;
+	}
+    }
+    return lo;
+}
+
+static const char *
+RopePieceAt(
+    RopeStore *storePtr,
+    Tcl_Size i,			/* Index of a counted piece. */
+    Tcl_Size charIndex)		/* Index of a character in the whole rope,
+				 * within or just past the end of piece i. */
+{
+    RopePiece *piecePtr = storePtr->pieces + i;
+    const char *bytes = TclGetString(piecePtr->objPtr);
+    Tcl_Size byteStart = 0, charStart = 0;
+
+    if (i > 0) {
+	byteStart = piecePtr[-1].byteEnd;
+	charStart = piecePtr[-1].charEnd;
+    }
+    if (piecePtr->charEnd - charStart == piecePtr->byteEnd - byteStart) {
+	return bytes + (charIndex - charStart);
+    }
+    return TclStringUtfAtIndex(piecePtr->objPtr, charIndex - charStart);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclStringRopeConcat --
+ *
+ *	Concatenate values onto the end of a string without copying it. The
+ *	head must be a rope or have a string representation. Pieces that are
+ *	themselves ropes contribute their pieces.
+ *
+ * Results:
+ *	The head itself, changed in place, if inPlace is set and the head is
+ *	an unshared rope; otherwise a new rope value with refcount 0. NULL if
+ *	the values cannot be joined by simply placing their bytes side by side
+ *	(a value starts with the continuation of a character), or if the
+ *	result would be too long, in which case the caller should concatenate
+ *	the ordinary way.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_Obj *
+TclStringRopeConcat(
+    Tcl_Obj *headObj,		/* String to append to. */
+    Tcl_Size objc,		/* Number of values to append. */
+    Tcl_Obj *const objv[],	/* Values to append. */
+    int inPlace)		/* Whether headObj may be changed. */
+{
+    RopeStore *storePtr = NULL, *srcPtr;
+    Tcl_Size i, j, count = 0, numPieces, numBytes, more, firstOwned;
+    Tcl_Obj *ropeObj;
+
+    if (TclHasInternalRep(headObj, &tclStringRopeType)) {
+	storePtr = RopeGetStore(headObj);
+	count = RopeGetCount(headObj);
+	numPieces = count;
+	numBytes = storePtr->pieces[count - 1].byteEnd;
+    } else {
+	(void) Tcl_GetStringFromObj(headObj, &numBytes);
+	if (numBytes == 0) {
+	    return NULL;
+	}
+	numPieces = 1;
+	inPlace = 0;
+    }
+
+    /*
+     * Check the values and count the pieces they add.
+     */
+
+    for (i = 0; i < objc; i++) {
+	Tcl_Obj *objPtr = objv[i];
+	const char *bytes;
+
+	if (TclHasInternalRep(objPtr, &tclStringRopeType)) {
+	    srcPtr = RopeGetStore(objPtr);
+	    bytes = TclGetString(srcPtr->pieces[0].objPtr);
+	    more = srcPtr->pieces[RopeGetCount(objPtr) - 1].byteEnd;
+	    numPieces += RopeGetCount(objPtr);
+	} else {
+	    bytes = Tcl_GetStringFromObj(objPtr, &more);
+	    if (more == 0) {
+		continue;
+	    }
+	    numPieces++;
+	}
+	if (ISCONTINUATION(bytes) || more > TCL_SIZE_MAX - numBytes) {
+	    return NULL;
+	}
+	numBytes += more;
+    }
+    if (numPieces == (storePtr ? count : 1)) {
+	return headObj;
+    }
+
+    /*
+     * Find room for the pieces. The store of the head can be extended if no
+     * other value uses pieces past the end of the head, and grown if no
+     * other value uses it at all. Otherwise the pieces of the head are copied
+     * to a new store.
+     */
+
+    if (storePtr && storePtr->refCount == 1 && count < storePtr->numPieces) {
+	for (j = count; j < storePtr->numPieces; j++) {
+	    Tcl_DecrRefCount(storePtr->pieces[j].objPtr);
+	}
+	storePtr->numPieces = count;
+	if (storePtr->numCounted > count) {
+	    storePtr->numCounted = count;
+	}
+	if (storePtr->numShared > count) {
+	    storePtr->numShared = count;
+	}
+    }
+    if (storePtr && count == storePtr->numPieces
+	    && numPieces > storePtr->numAllocated
+	    && storePtr->refCount == 1) {
+	storePtr = (RopeStore *)Tcl_Realloc(storePtr,
+		ROPE_STORE_SIZE(2 * numPieces));
+	storePtr->numAllocated = 2 * numPieces;
+	headObj->internalRep.twoPtrValue.ptr1 = storePtr;
+    } else if (storePtr == NULL || count < storePtr->numPieces
+	    || numPieces > storePtr->numAllocated) {
+	srcPtr = storePtr;
+	storePtr = (RopeStore *)Tcl_Alloc(ROPE_STORE_SIZE(2 * numPieces));
+	storePtr->refCount = 0;
+	storePtr->numPieces = 0;
+	storePtr->numAllocated = 2 * numPieces;
+	storePtr->numCounted = 0;
+	storePtr->numShared = 0;
+	if (srcPtr == NULL) {
+	    RopeStoreAppend(storePtr, headObj, headObj->length);
+	} else {
+	    memcpy(storePtr->pieces, srcPtr->pieces, count * sizeof(RopePiece));
+	    for (j = 0; j < count; j++) {
+		Tcl_IncrRefCount(storePtr->pieces[j].objPtr);
+	    }
+	    storePtr->numPieces = count;
+	    storePtr->numCounted = (srcPtr->numCounted < count)
+		    ? srcPtr->numCounted : count;
+	}
+	if (inPlace) {
+	    TclFreeInternalRep(headObj);
+	    RopeSetRep(headObj, storePtr, count);
+	}
+    }
+
+    /*
+     * Short values can be added to the last piece when no other value uses it
+     * (see RopeStoreAppendShort): the pieces added now belong to the result,
+     * and when the head is changed in place, so do those past the ones other
+     * values were given.
+     */
+
+    firstOwned = storePtr->numPieces;
+    if (inPlace && storePtr->refCount == 1) {
+	firstOwned = 0;
+    } else if (inPlace && storePtr->numShared < firstOwned) {
+	firstOwned = storePtr->numShared;
+    }
+
+    for (i = 0; i < objc; i++) {
+	Tcl_Obj *objPtr = objv[i];
+
+	if (TclHasInternalRep(objPtr, &tclStringRopeType)) {
+	    /*
+	     * Looked up again since it may be the head, whose store may have
+	     * just moved.
+	     */
+
+	    Tcl_Size srcCount = RopeGetCount(objPtr), byteStart = 0;
+
+	    srcPtr = RopeGetStore(objPtr);
+	    for (j = 0; j < srcCount; j++) {
+		RopePiece *piecePtr = srcPtr->pieces + j;
+
+		RopeStoreAppend(storePtr, piecePtr->objPtr,
+			piecePtr->byteEnd - byteStart);
+		byteStart = piecePtr->byteEnd;
+	    }
+	} else {
+	    const char *bytes = Tcl_GetStringFromObj(objPtr, &more);
+
+	    if (more >= ROPE_SHORT_LENGTH) {
+		RopeStoreAppend(storePtr, objPtr, more);
+	    } else if (more) {
+		RopeStoreAppendShort(storePtr, firstOwned, bytes, more);
+	    }
+	}
+    }
+
+    if (inPlace) {
+	headObj->internalRep.twoPtrValue.ptr2 = INT2PTR(storePtr->numPieces);
+	TclInvalidateStringRep(headObj);
+	return headObj;
+    }
+    TclNewObj(ropeObj);
+    TclInvalidateStringRep(ropeObj);
+    RopeSetRep(ropeObj, storePtr, storePtr->numPieces);
+    return ropeObj;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclStringRopeCharLength, TclStringRopeGetUniChar, TclStringRopeRange --
+ *
+ *	The number of characters in a rope, one of them, and a range of them,
+ *	with the same conventions as Tcl_GetCharLength, Tcl_GetUniChar and
+ *	Tcl_GetRange. A character is found by binary search over the pieces
+ *	and a scan of its piece when that is not ASCII. Character counts are
+ *	computed when first needed and kept in the store.
+ *
+ * Results:
+ *	The length, the character or -1 if the index is out of range, and a
+ *	new value with refcount 0.
+ *
+ *----------------------------------------------------------------------
+ */
+
+Tcl_Size
+TclStringRopeCharLength(
+    Tcl_Obj *ropeObj)
+{
+    return RopeStoreCount(RopeGetStore(ropeObj), RopeGetCount(ropeObj));
+}
+
+int
+TclStringRopeGetUniChar(
+    Tcl_Obj *ropeObj,
+    Tcl_Size index)
+{
+    RopeStore *storePtr = RopeGetStore(ropeObj);
+    Tcl_Size count = RopeGetCount(ropeObj);
+    int ch = 0;
+
+    if (index < 0 || index >= RopeStoreCount(storePtr, count)) {
+	return -1;
+    }
+    TclUtfToUCS4(RopePieceAt(storePtr,
+	    RopeFindPiece(storePtr, count, index), index), &ch);
+    return ch;
+}
+
+Tcl_Obj *
+TclStringRopeRange(
+    Tcl_Obj *ropeObj,
+    Tcl_Size first,
+    Tcl_Size last)
+{
+    RopeStore *storePtr = RopeGetStore(ropeObj);
+    Tcl_Size i, k, count = RopeGetCount(ropeObj), headBytes, tailBytes;
+    Tcl_Size numChars = RopeStoreCount(storePtr, count);
+    Tcl_Obj *resultObj;
+    const char *start, *end;
+    char *dst;
+
+    if (first < 0) {
+	first = 0;
+    }
+    if (last < 0 || last >= numChars) {
+	last = numChars - 1;
+    }
+    TclNewObj(resultObj);
+    if (last < first) {
+	return resultObj;
+    }
+    if (first == 0 && last == numChars - 1) {
+	TclInvalidateStringRep(resultObj);
+	RopeSetRep(resultObj, storePtr, count);
+	return resultObj;
+    }
+
+    i = RopeFindPiece(storePtr, count, first);
+    k = RopeFindPiece(storePtr, count, last);
+    start = RopePieceAt(storePtr, i, first);
+    end = RopePieceAt(storePtr, k, last + 1);
+    if (i == k) {
+	Tcl_SetStringObj(resultObj, start, end - start);
+	return resultObj;
+    }
+
+    /*
+     * Copy the tail of piece i, the whole pieces between, and the head of
+     * piece k.
+     */
+
+    headBytes = storePtr->pieces[i].byteEnd - (i > 0
+	    ? storePtr->pieces[i - 1].byteEnd : 0)
+	    - (start - TclGetString(storePtr->pieces[i].objPtr));
+    tailBytes = end - TclGetString(storePtr->pieces[k].objPtr);
+    Tcl_SetObjLength(resultObj, headBytes + tailBytes
+	    + storePtr->pieces[k - 1].byteEnd - storePtr->pieces[i].byteEnd);
+    dst = TclGetString(resultObj);
+    memcpy(dst, start, headBytes);
+    dst += headBytes;
+    for (i++; i < k; i++) {
+	Tcl_Size more;
+	const char *src = Tcl_GetStringFromObj(storePtr->pieces[i].objPtr,
+		&more);
+
+	memcpy(dst, src, more);
+	dst += more;
+    }
+    memcpy(dst, end - tailBytes, tailBytes);
+    return resultObj;
+}
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 4
+ * fill-column: 78
+ * End:
+ */
@@ -0,0 +1,38 @@
+/*
+ * tclStringRope.h --
+ *
+ *	This file contains the declarations for string ropes, which hold a
+ *	string built by repeated concatenation as a sequence of pieces, so
+ *	that appending to a shared value does not copy it.
+ *
+ * See the file "license.terms" for information on usage and redistribution of
+ * this file, and for a DISCLAIMER OF ALL WARRANTIES.
+ */
+
+#ifndef _TCLSTRINGROPE
+#define _TCLSTRINGROPE
+
+/*
+ * Shared strings shorter than this are copied when appended to, rather than
+ * turned into a rope.
+ */
+
+#define STRING_ROPE_MIN_LENGTH 4096
+
+MODULE_SCOPE Tcl_Obj *	TclStringRopeConcat(Tcl_Obj *headObj, Tcl_Size objc,
+			    Tcl_Obj *const objv[], int inPlace);
+MODULE_SCOPE Tcl_Size	TclStringRopeCharLength(Tcl_Obj *ropeObj);
+MODULE_SCOPE int	TclStringRopeGetUniChar(Tcl_Obj *ropeObj,
+			    Tcl_Size index);
+MODULE_SCOPE Tcl_Obj *	TclStringRopeRange(Tcl_Obj *ropeObj, Tcl_Size first,
+			    Tcl_Size last);
+
+#endif /* _TCLSTRINGROPE */
+
+/*
+ * Local Variables:
+ * mode: c
+ * c-basic-offset: 4
+ * fill-column: 78
+ * End:
+ */
@@ -88,6 +88,31 @@ static const unsigned char complete[256] = {
  */
 
 static int		Invalid(const char *src);
+static int		UniCharMatch(const Tcl_UniChar *string,
+			    Tcl_Size strLen, const Tcl_UniChar *pattern,
+			    Tcl_Size ptnLen, int nocase);
+static int		UniCharMatchLiteral(const Tcl_UniChar *string,
+			    Tcl_Size strLen, const Tcl_UniChar *pattern,
+			    Tcl_Size ptnLen);
+
+/*
+ * A byte below 0xC0 is always a character of its own: either ASCII or a
+ * trail byte that is not part of a sequence. The following tells whether
+ * none of the 8 bytes at src starts a multi-byte sequence, so that runs of
+ * such bytes can be skipped a word at a time.
+ */
+
+#define NO_LEAD_BYTE_MASK ((Tcl_WideUInt) 0x8080808080808080)
+
+static inline int
+NoLeadBytes(
+    const char *src)
+{
+    Tcl_WideUInt word;
+
+    memcpy(&word, src, sizeof(word));
+    return ((word & (word << 1)) & NO_LEAD_BYTE_MASK) == 0;
+}
 
 /*
  *---------------------------------------------------------------------------
@@ -868,7 +893,29 @@ Tcl_NumUtfChars(
 	 */
 	while (src <= optPtr
 		/* && Tcl_UtfCharComplete(src, endPtr - src) */ ) {
-	    src += TclUtfToUniChar(src, &ch);
+	    int byte = UCHAR(*src);
+
+	    if (byte < 0xC0) {
+		if ((endPtr - src >= 8) && NoLeadBytes(src)) {
+		    src += 8;
+		    i += 8;
+		    continue;
+		}
+		src++;
+	    } else if ((byte >= 0xC2) && (byte < 0xE0)
+		    && ((src[1] & 0xC0) == 0x80)) {
+		/*
+		 * Well-formed two and three byte sequences are counted here;
+		 * the rest are left to Tcl_UtfToUniChar.
+		 */
+
+		src += 2;
+	    } else if ((byte > 0xE0) && (byte < 0xF0)
+		    && ((src[1] & 0xC0) == 0x80) && ((src[2] & 0xC0) == 0x80)) {
+		src += 3;
+	    } else {
+		src += TclUtfToUniChar(src, &ch);
+	    }
 	    i++;
 	}
 	/* Loop over the remaining string where call must happen */
@@ -1265,8 +1312,29 @@ Tcl_UtfAtIndex(
 
     if (index > 0) {
 	while (index--) {
-	    /* Make use of the #undef Tcl_UtfToUniChar above, which already handles UCS4. */
-	    src += Tcl_UtfToUniChar(src, &ch);
+	    int byte = UCHAR(*src);
+
+	    if (byte < 0xC0) {
+		while ((index >= 8) && NoLeadBytes(src)) {
+		    src += 8;
+		    index -= 8;
+		}
+		if (UCHAR(*src) < 0x80) {
+		    src++;
+		    continue;
+		}
+		byte = UCHAR(*src);
+	    }
+	    if ((byte >= 0xC2) && (byte < 0xE0)
+		    && ((src[1] & 0xC0) == 0x80)) {
+		src += 2;
+	    } else if ((byte > 0xE0) && (byte < 0xF0)
+		    && ((src[1] & 0xC0) == 0x80) && ((src[2] & 0xC0) == 0x80)) {
+		src += 3;
+	    } else {
+		/* Make use of the #undef Tcl_UtfToUniChar above, which already handles UCS4. */
+		src += Tcl_UtfToUniChar(src, &ch);
+	    }
 	}
     }
     return src;
@@ -2033,6 +2101,202 @@ TclUniCharNcasecmp(
     return 0;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclUniCharFind, TclUniCharFindLast, TclFindBytes, TclFindLastBytes --
+ *
+ *	Find the first or last occurrence of a Unicode or byte string in
+ *	another. Long needles in long haystacks are searched for with the
+ *	Horspool variant of Boyer-Moore, which skips ahead by as much as the
+ *	needle length after a mismatch. Characters are told apart by their low
+ *	byte only when choosing the skip, which keeps the table small and is
+ *	still correct. Short byte needles are looked for with memchr() on
+ *	their first byte.
+ *
+ * Results:
+ *	Returns a pointer to the start of the occurrence in haystack, or NULL
+ *	if there is none. The needle must not be empty.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+#define FIND_SKIP_MIN_NEEDLE	4
+#define FIND_SKIP_MIN_HAYSTACK	256
+
+const Tcl_UniChar *
+TclUniCharFind(
+    const Tcl_UniChar *haystack,/* String to search. */
+    Tcl_Size lh,		/* Number of characters in haystack. */
+    const Tcl_UniChar *needle,	/* String to search for. */
+    Tcl_Size ln)		/* Number of characters in needle, > 0. */
+{
+    const Tcl_UniChar *check, *last;
+
+    if (lh < ln) {
+	return NULL;
+    }
+    last = haystack + lh - ln;
+    if (ln < FIND_SKIP_MIN_NEEDLE || lh < FIND_SKIP_MIN_HAYSTACK) {
+	for (check = haystack; check <= last; check++) {
+	    if ((*check == *needle) && (0 == memcmp(check + 1, needle + 1,
+		    (ln - 1) * sizeof(Tcl_UniChar)))) {
+		return check;
+	    }
+	}
+    } else {
+	Tcl_Size i, skip[256];
+	Tcl_UniChar tail = needle[ln - 1];
+
+	for (i = 0; i < 256; i++) {
+	    skip[i] = ln;
+	}
+	for (i = 0; i < ln - 1; i++) {
+	    skip[needle[i] & 0xFF] = ln - 1 - i;
+	}
+	for (check = haystack; check <= last;
+		check += skip[check[ln - 1] & 0xFF]) {
+	    if ((check[ln - 1] == tail) && (0 == memcmp(check, needle,
+		    (ln - 1) * sizeof(Tcl_UniChar)))) {
+		return check;
+	    }
+	}
+    }
+    return NULL;
+}
+
+const Tcl_UniChar *
+TclUniCharFindLast(
+    const Tcl_UniChar *haystack,/* String to search. */
+    Tcl_Size lh,		/* Number of characters in haystack. */
+    const Tcl_UniChar *needle,	/* String to search for. */
+    Tcl_Size ln)		/* Number of characters in needle, > 0. */
+{
+    const Tcl_UniChar *check;
+
+    if (lh < ln) {
+	return NULL;
+    }
+    check = haystack + lh - ln;
+    if (ln < FIND_SKIP_MIN_NEEDLE || lh < FIND_SKIP_MIN_HAYSTACK) {
+	for (; check >= haystack; check--) {
+	    if ((*check == *needle) && (0 == memcmp(check + 1, needle + 1,
+		    (ln - 1) * sizeof(Tcl_UniChar)))) {
+		return check;
+	    }
+	}
+    } else {
+	Tcl_Size i, skip[256];
+
+	for (i = 0; i < 256; i++) {
+	    skip[i] = ln;
+	}
+	for (i = ln - 1; i > 0; i--) {
+	    skip[needle[i] & 0xFF] = i;
+	}
+	while (check >= haystack) {
+	    if ((*check == *needle) && (0 == memcmp(check + 1, needle + 1,
+		    (ln - 1) * sizeof(Tcl_UniChar)))) {
+		return check;
+	    }
+	    if (check - haystack < skip[*check & 0xFF]) {
+		break;
+	    }
+	    check -= skip[*check & 0xFF];
+	}
+    }
+    return NULL;
+}
+
+const unsigned char *
+TclFindBytes(
+    const unsigned char *haystack,
+    Tcl_Size lh,
+    const unsigned char *needle,
+    Tcl_Size ln)
+{
+    const unsigned char *check, *end;
+
+    if (lh < ln) {
+	return NULL;
+    }
+    end = haystack + lh - ln + 1;
+    if (ln < FIND_SKIP_MIN_NEEDLE || lh < FIND_SKIP_MIN_HAYSTACK) {
+	for (check = haystack; check < end; check++) {
+	    check = (const unsigned char *)memchr(check, needle[0], end - check);
+	    if (check == NULL) {
+		break;
+	    }
+	    if (0 == memcmp(check + 1, needle + 1, ln - 1)) {
+		return check;
+	    }
+	}
+    } else {
+	Tcl_Size i, skip[256];
+	unsigned char tail = needle[ln - 1];
+
+	for (i = 0; i < 256; i++) {
+	    skip[i] = ln;
+	}
+	for (i = 0; i < ln - 1; i++) {
+	    skip[needle[i]] = ln - 1 - i;
+	}
+	for (check = haystack; check < end; check += skip[check[ln - 1]]) {
+	    if ((check[ln - 1] == tail)
+		    && (0 == memcmp(check, needle, ln - 1))) {
+		return check;
+	    }
+	}
+    }
+    return NULL;
+}
+
+const unsigned char *
+TclFindLastBytes(
+    const unsigned char *haystack,
+    Tcl_Size lh,
+    const unsigned char *needle,
+    Tcl_Size ln)
+{
+    const unsigned char *check;
+
+    if (lh < ln) {
+	return NULL;
+    }
+    check = haystack + lh - ln;
+    if (ln < FIND_SKIP_MIN_NEEDLE || lh < FIND_SKIP_MIN_HAYSTACK) {
+	for (; check >= haystack; check--) {
+	    if ((*check == needle[0])
+		    && (0 == memcmp(check + 1, needle + 1, ln - 1))) {
+		return check;
+	    }
+	}
+    } else {
+	Tcl_Size i, skip[256];
+
+	for (i = 0; i < 256; i++) {
+	    skip[i] = ln;
+	}
+	for (i = ln - 1; i > 0; i--) {
+	    skip[needle[i]] = i;
+	}
+	while (1) {
+	    if ((*check == needle[0])
+		    && (0 == memcmp(check + 1, needle + 1, ln - 1))) {
+		return check;
+	    }
+	    if (check - haystack < skip[*check]) {
+		break;
+	    }
+	    check -= skip[*check];
+	}
+    }
+    return NULL;
+}
+
 /*
  *----------------------------------------------------------------------
  *
@@ -2590,6 +2854,96 @@ TclUniCharMatch(
 				 * characters. */
     Tcl_Size ptnLen,		/* Length of Pattern */
     int nocase)			/* 0 for case sensitive, 1 for insensitive */
+{
+    if (!nocase) {
+	int match = UniCharMatchLiteral(string, strLen, pattern, ptnLen);
+
+	if (match >= 0) {
+	    return match;
+	}
+    }
+    return UniCharMatch(string, strLen, pattern, ptnLen, nocase);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * UniCharMatchLiteral --
+ *
+ *	Match patterns that are a literal with "*" before it, after it or
+ *	both, or neither, by comparing or searching for the literal. Only
+ *	case sensitive matching is done here.
+ *
+ * Results:
+ *	1 if the string matches, 0 if not, -1 if the pattern is of another
+ *	form.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+UniCharMatchLiteral(
+    const Tcl_UniChar *string,	/* Unicode String. */
+    Tcl_Size strLen,		/* Length of String */
+    const Tcl_UniChar *pattern,	/* Pattern. */
+    Tcl_Size ptnLen)		/* Length of Pattern */
+{
+    Tcl_Size first = 0, last = ptnLen, i;
+
+    while (first < ptnLen && pattern[first] == '*') {
+	first++;
+    }
+    while (last > first && pattern[last - 1] == '*') {
+	last--;
+    }
+    if (first == last) {
+	return -1;
+    }
+    for (i = first; i < last; i++) {
+	if (pattern[i] == '*' || pattern[i] == '?' || pattern[i] == '['
+		|| pattern[i] == '\\') {
+	    return -1;
+	}
+    }
+    if (last - first > strLen) {
+	return 0;
+    }
+
+    if (first == 0) {
+	if (last == ptnLen && strLen != ptnLen) {
+	    return 0;
+	}
+	return memcmp(string, pattern, last * sizeof(Tcl_UniChar)) == 0;
+    }
+    if (last == ptnLen) {
+	return memcmp(string + strLen - (last - first), pattern + first,
+		(last - first) * sizeof(Tcl_UniChar)) == 0;
+    }
+    return TclUniCharFind(string, strLen, pattern + first,
+	    last - first) != NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * UniCharMatch --
+ *
+ *	The general matcher behind TclUniCharMatch.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+UniCharMatch(
+    const Tcl_UniChar *string,	/* Unicode String. */
+    Tcl_Size strLen,		/* Length of String */
+    const Tcl_UniChar *pattern,	/* Pattern, which may contain special
+				 * characters. */
+    Tcl_Size ptnLen,		/* Length of Pattern */
+    int nocase)			/* 0 for case sensitive, 1 for insensitive */
 {
     const Tcl_UniChar *stringEnd, *patternEnd;
     Tcl_UniChar p;
@@ -2654,7 +3008,7 @@ TclUniCharMatch(
 			}
 		    }
 		}
-		if (TclUniCharMatch(string, stringEnd - string,
+		if (UniCharMatch(string, stringEnd - string,
 			pattern, patternEnd - pattern, nocase)) {
 		    return 1;
 		}
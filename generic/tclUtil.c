@@ -112,6 +112,8 @@ static int		FindElement(Tcl_Interp *interp, const char *string,
 			    const char *typeCode, const char **elementPtr,
 			    const char **nextPtr, Tcl_Size *sizePtr,
 			    int *literalPtr);
+static int		StringCaseMatch(const char *str, const char *pattern,
+			    int nocase);
 /*
  * The following is the Tcl object type definition for an object that
  * represents a list index in the form, "end-offset". It is used as a
@@ -2103,6 +2105,106 @@ Tcl_StringCaseMatch(
     const char *pattern,	/* Pattern, which may contain special
 				 * characters. */
     int nocase)			/* 0 for case sensitive, 1 for insensitive */
+{
+    if (!nocase) {
+	int match = TclStringMatchLiteral(str, TCL_INDEX_NONE, pattern);
+
+	if (match >= 0) {
+	    return match;
+	}
+    }
+    return StringCaseMatch(str, pattern, nocase);
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclStringMatchLiteral --
+ *
+ *	Match patterns that are an ASCII literal with "*" before it, after it
+ *	or both, or neither, by comparing bytes of the UTF-8 string. Only case
+ *	sensitive matching is done here. An ASCII byte is always a character
+ *	of its own in the string, so comparing bytes gives the same result as
+ *	comparing characters, without converting the string to Unicode.
+ *
+ * Results:
+ *	1 if the string matches, 0 if not, -1 if the pattern is of another
+ *	form.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+int
+TclStringMatchLiteral(
+    const char *str,		/* String. */
+    Tcl_Size strLen,		/* Length of str in bytes, or
+				 * TCL_INDEX_NONE if it is NUL-terminated. */
+    const char *pattern)	/* Pattern. */
+{
+    const char *lit = pattern, *litEnd, *end;
+    Tcl_Size litLen;
+
+    while (*lit == '*') {
+	lit++;
+    }
+    for (litEnd = lit; *litEnd != '\0' && *litEnd != '*'; litEnd++) {
+	if (*litEnd == '?' || *litEnd == '[' || *litEnd == '\\'
+		|| UCHAR(*litEnd) >= 0x80) {
+	    return -1;
+	}
+    }
+    for (end = litEnd; *end == '*'; end++) {
+	/* empty body */
+    }
+    litLen = litEnd - lit;
+    if (*end != '\0' || litLen == 0) {
+	return -1;
+    }
+
+    if (lit == pattern && strLen < 0) {
+	if (litEnd == end) {
+	    return strcmp(str, lit) == 0;
+	}
+	return strncmp(str, lit, litLen) == 0;
+    }
+    if (strLen < 0) {
+	strLen = strlen(str);
+    }
+    if (strLen < litLen) {
+	return 0;
+    }
+    if (lit == pattern) {
+	if (litEnd == end) {
+	    return (strLen == litLen) && (memcmp(str, lit, litLen) == 0);
+	}
+	return memcmp(str, lit, litLen) == 0;
+    }
+    if (litEnd == end) {
+	return memcmp(str + strLen - litLen, lit, litLen) == 0;
+    }
+    return TclFindBytes((const unsigned char *) str, strLen,
+	    (const unsigned char *) lit, litLen) != NULL;
+}
+
+/*
+ *----------------------------------------------------------------------
+ *
+ * StringCaseMatch --
+ *
+ *	The general matcher behind Tcl_StringCaseMatch.
+ *
+ *----------------------------------------------------------------------
+ */
+
+static int
+StringCaseMatch(
+    const char *str,		/* String. */
+    const char *pattern,	/* Pattern, which may contain special
+				 * characters. */
+    int nocase)			/* 0 for case sensitive, 1 for insensitive */
 {
     int p, charLen;
     int ch1 = 0, ch2 = 0;
@@ -2187,7 +2289,7 @@ Tcl_StringCaseMatch(
 			}
 		    }
 		}
-		if (Tcl_StringCaseMatch(str, pattern, nocase)) {
+		if (StringCaseMatch(str, pattern, nocase)) {
 		    return 1;
 		}
 		if (*str == '\0') {
@@ -2526,6 +2628,14 @@ TclStringMatchObj(
     trivial = nocase ? 0 : TclMatchIsTrivial(TclGetString(ptnObj));
      */
 
+    if (!flags && (strObj->bytes != NULL)) {
+	match = TclStringMatchLiteral(strObj->bytes, strObj->length,
+		TclGetString(ptnObj));
+	if (match >= 0) {
+	    return match;
+	}
+    }
+
     if (TclHasInternalRep(strObj, &tclStringType) || (strObj->typePtr == NULL)) {
 	Tcl_UniChar *udata, *uptn;
 
@@ -3268,6 +3378,103 @@ TclNeedSpace(
     return 1;
 }
 
+/*
+ *----------------------------------------------------------------------
+ *
+ * TclSortKeys --
+ *
+ *	Stable sort of an array of unsigned keys. Short arrays are sorted by
+ *	insertion; longer ones by a least significant digit radix sort taking
+ *	a byte at a time, which skips the bytes all keys have in common, as
+ *	the high bytes of small integers are.
+ *
+ * Results:
+ *	1 if the keys were sorted; 0 if there was not enough memory, in which
+ *	case the keys are unchanged.
+ *
+ * Side effects:
+ *	None.
+ *
+ *----------------------------------------------------------------------
+ */
+
+#define SORT_KEYS_INSERTION 32
+#define SORT_KEYS_DIGITS 8
+
+int
+TclSortKeys(
+    TclSortKey *keys,		/* The keys to sort, in place. */
+    size_t numKeys)		/* Number of keys. */
+{
+    size_t (*counts)[256], i;
+    TclSortKey *buffer, *from, *to;
+    int digit;
+
+    if (numKeys < SORT_KEYS_INSERTION) {
+	for (i = 1; i < numKeys; i++) {
+	    TclSortKey item = keys[i];
+	    size_t j = i;
+
+	    while (j > 0 && keys[j - 1].key > item.key) {
+		keys[j] = keys[j - 1];
+		j--;
+	    }
+	    keys[j] = item;
+	}
+	return 1;
+    }
+
+    buffer = (TclSortKey *) Tcl_AttemptAlloc(numKeys * sizeof(TclSortKey));
+    counts = (size_t (*)[256])
+	    Tcl_AttemptAlloc(SORT_KEYS_DIGITS * sizeof(*counts));
+    if (buffer == NULL || counts == NULL) {
+	Tcl_Free(buffer);
+	Tcl_Free(counts);
+	return 0;
+    }
+
+    /*
+     * Count every digit in a single pass over the keys.
+     */
+
+    memset(counts, 0, SORT_KEYS_DIGITS * sizeof(*counts));
+    for (i = 0; i < numKeys; i++) {
+	Tcl_WideUInt key = keys[i].key;
+
+	for (digit = 0; digit < SORT_KEYS_DIGITS; digit++) {
+	    counts[digit][(key >> (8 * digit)) & 0xFF]++;
+	}
+    }
+
+    from = keys;
+    to = buffer;
+    for (digit = 0; digit < SORT_KEYS_DIGITS; digit++) {
+	size_t *count = counts[digit], offset = 0;
+	int shift = 8 * digit;
+
+	if (count[(from[0].key >> shift) & 0xFF] == numKeys) {
+	    continue;
+	}
+	for (i = 0; i < 256; i++) {
+	    size_t n = count[i];
+
+	    count[i] = offset;
+	    offset += n;
+	}
+	for (i = 0; i < numKeys; i++) {
+	    to[count[(from[i].key >> shift) & 0xFF]++] = from[i];
+	}
+	from = to;
+	to = (to == buffer) ? keys : buffer;
+    }
+    if (from != keys) {
+	memcpy(keys, from, numKeys * sizeof(TclSortKey));
+    }
+    Tcl_Free(buffer);
+    Tcl_Free(counts);
+    return 1;
+}
+
 /*
  *----------------------------------------------------------------------
  *
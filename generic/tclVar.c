@@ -19,6 +19,7 @@
 
 #include "tclInt.h"
 #include "tclOOInt.h"
+#include "tclStringRope.h"
 
 /*
  * Prototypes for the variable hash key methods.
@@ -1851,6 +1852,31 @@ StringAppendInVar(
      */
 
     if (Tcl_IsShared(oldValuePtr)) {	/* Append to copy. */
+	Tcl_Obj *ropePtr = NULL;
+
+	/*
+	 * A rope or a large string is not copied: the new value is a rope
+	 * that shares the pieces of the old one.
+	 */
+
+	if (TclHasInternalRep(oldValuePtr, &tclStringRopeType)
+		|| (oldValuePtr->bytes
+		&& oldValuePtr->length >= STRING_ROPE_MIN_LENGTH)) {
+	    ropePtr = TclStringRopeConcat(oldValuePtr, 1, &newValuePtr, 0);
+	}
+	if (ropePtr != NULL) {
+	    if (ropePtr != oldValuePtr) {
+		varPtr->value.objPtr = ropePtr;
+		Tcl_IncrRefCount(ropePtr);	/* Since var is ref */
+		TclContinuationsCopy(ropePtr, oldValuePtr);
+		TclDecrRefCount(oldValuePtr);
+	    }
+	    if (newValuePtr->refCount == 0) {
+		Tcl_DecrRefCount(newValuePtr);
+	    }
+	    return;
+	}
+
 	varPtr->value.objPtr = Tcl_DuplicateObj(oldValuePtr);
 
 	TclContinuationsCopy(varPtr->value.objPtr, oldValuePtr);
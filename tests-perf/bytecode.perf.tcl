@@ -0,0 +1,193 @@
+#!/usr/bin/tclsh
+# ------------------------------------------------------------------------
+#
+# bytecode.perf.tcl --
+#
+#  This file provides performance tests for the dispatch loop of the
+#  bytecode engine (TEBCresume): tight loops of cheap instructions, where
+#  the cost of getting from one instruction to the next dominates.
+#
+#  To compare the switch-based and the threaded (computed-goto) dispatch,
+#  run the file with a tclsh of each build, e.g.:
+#
+#    tclsh bytecode.perf.tcl -exec {/path/switch/tclsh /path/threaded/tclsh}
+#
+#  which runs the tests with every given executable and prints the timings
+#  side by side, relative to the first one.
+#
+# ------------------------------------------------------------------------
+#
+# See the file "license.terms" for information on usage and redistribution
+# of this file.
+#
+
+if {![namespace exists ::tclTestPerf]} {
+  source [file join [file dirname [info script]] test-performance.tcl]
+}
+
+
+namespace eval ::tclTestPerf-Bytecode {
+
+namespace path {::tclTestPerf}
+
+# procs are used so that everything measured is compiled to bytecode:
+
+proc sum-loop {n} {
+  set s 0
+  for {set i 0} {$i < $n} {incr i} {
+    set s [expr {$s + $i}]
+  }
+  return $s
+}
+proc arith-loop {n} {
+  set a 1; set b 3; set c 0
+  for {set i 0} {$i < $n} {incr i} {
+    set c [expr {($a * $i + $b) % 7 - ($c >> 1)}]
+  }
+  return $c
+}
+proc float-loop {n} {
+  set x 0.0; set y 1.5
+  for {set i 0} {$i < $n} {incr i} {
+    set x [expr {$x * 0.5 + $y - 0.25}]
+    if {$x > 100.0} {set x 0.0}
+  }
+  return $x
+}
+proc while-cmp {n} {
+  set i 0; set j $n
+  while {$i < $j} {
+    incr i
+    if {$i == $j - 1} {incr j -1}
+  }
+  return $i
+}
+proc str-ops {n} {
+  set r {}
+  for {set i 0} {$i < $n} {incr i} {
+    if {[string length $r] > 20} {set r {}}
+    append r [string index "abcdefgh" [expr {$i & 7}]]
+  }
+  return $r
+}
+proc list-walk {l} {
+  set s 0
+  foreach e $l {
+    if {$e & 1} {incr s $e} else {incr s -1}
+  }
+  return $s
+}
+proc list-index {l} {
+  set s 0
+  set n [llength $l]
+  for {set i 0} {$i < $n} {incr i} {
+    incr s [lindex $l $i]
+  }
+  return $s
+}
+proc fib {n} {
+  if {$n < 2} {return $n}
+  expr {[fib [expr {$n - 1}]] + [fib [expr {$n - 2}]]}
+}
+proc switch-loop {n} {
+  set r 0
+  for {set i 0} {$i < $n} {incr i} {
+    switch -- [expr {$i % 4}] {
+      0 {incr r} 1 {incr r 2} 2 {incr r -1} default {set r [expr {$r ^ 1}]}
+    }
+  }
+  return $r
+}
+
+proc test-dispatch {{reptime 1000}} {
+  _test_run -uplevel $reptime {
+    setup {set l [lseq 1000]; llength $l}
+    # for-loop with expr and set:
+    {sum-loop 1000}
+    # for-loop with mixed integer arithmetic:
+    {arith-loop 1000}
+    # for-loop with floating-point arithmetic:
+    {float-loop 1000}
+    # while-loop with comparisons and incr:
+    {while-cmp 1000}
+    # string instructions:
+    {str-ops 1000}
+    # foreach over a list:
+    {list-walk $l}
+    # lindex by position:
+    {list-index $l}
+    # recursive proc calls:
+    {fib 15}
+    # compiled switch (jump table):
+    {switch-loop 1000}
+    cleanup {unset l}
+  }
+}
+
+proc test {{reptime 1000}} {
+  puts "Build: [info patchlevel] ([::tcl::build-info])"
+  puts "Threaded dispatch: [::tcl::build-info threaded-dispatch]"
+  puts ""
+  test-dispatch $reptime
+
+  puts \n**OK**
+}
+
+# Run this file with each of the given executables and tabulate the
+# results (the first executable is the base of comparison).
+
+proc compare {execs reptime} {
+  set script [file normalize [info script]]
+  set ids {}
+  foreach exe $execs {
+    set out [exec $exe $script -time $reptime]
+    set cur {}
+    foreach line [split $out \n] {
+      if {[regexp {^% (.*)$} $line -> cur]} {
+        if {[regexp {^(?:#|setup |cleanup )} $cur]} {
+          set cur {}
+        }
+        continue
+      }
+      if {$cur ne "" && [regexp {^([\d.]+) \S+/# } $line -> tm]} {
+        if {$cur ni $ids} {lappend ids $cur}
+        set res($exe,$cur) $tm
+        set cur {}
+      }
+    }
+  }
+  set base [lindex $execs 0]
+  set i 0
+  foreach exe $execs {
+    puts [format "\[%d\] %s" [incr i] $exe]
+  }
+  puts [string repeat - 72]
+  foreach id $ids {
+    if {![info exists res($base,$id)]} continue
+    set line [format "%-32.32s" $id]
+    foreach exe $execs {
+      if {[info exists res($exe,$id)]} {
+        append line [format " %9.3fµs %5.2f" $res($exe,$id) \
+            [expr {$res($exe,$id) / $res($base,$id)}]]
+      } else {
+        append line [format " %16s" n/a]
+      }
+    }
+    puts $line
+  }
+}
+
+}; # end of ::tclTestPerf-Bytecode
+
+# ------------------------------------------------------------------------
+
+# if calling direct:
+if {[info exists ::argv0] && [file tail $::argv0] eq [file tail [info script]]} {
+  array set in {-time 500}
+  array set in $argv
+  if {[info exists in(-exec)]} {
+    ::tclTestPerf-Bytecode::compare $in(-exec) $in(-time)
+  } else {
+    ::tclTestPerf-Bytecode::test $in(-time)
+  }
+}